@@ -2,6 +2,7 @@
 #include <Console.h>
 #include <Scheduler.h>
 #include <VFS.h>
+#include <VFRFS.h>
 #include <Ipc.h>
 #include <MemOps.h>
 
@@ -10,11 +11,10 @@
 
 typedef struct {
     bool in_use;
-    char path[256];
-    uint64_t position;
-} FileHandle;
+    int vfs_fd;     // VFS open file, which tracks the position
+} SyscallFile;
 
-static FileHandle file_descriptor_table[MAX_FILE_DESCRIPTORS];
+static SyscallFile file_descriptor_table[MAX_FILE_DESCRIPTORS];
 
 void InitializeSyscall() {
     for (int i = 0; i < MAX_FILE_DESCRIPTORS; i++) {
@@ -30,7 +30,7 @@ uint64_t SyscallHandler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint
         case SYS_WRITE: {
             int fd = (int)arg1;
             const void* user_buffer = (const void*)arg2;
-            uint32_t count = (uint32_t)arg3;
+            uint64_t count = arg3;
 
             if (fd == 1 || fd == 2) { // stdout or stderr
                 if (count > MAX_SYSCALL_BUFFER_SIZE) {
@@ -54,11 +54,7 @@ uint64_t SyscallHandler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint
                 if (CopyFromUser(kernel_buffer, user_buffer, count) != 0) {
                     return -1;
                 }
-                int bytes_written = VfsWriteAt(file_descriptor_table[fd].path, kernel_buffer, file_descriptor_table[fd].position, count);
-                if (bytes_written > 0) {
-                    file_descriptor_table[fd].position += bytes_written;
-                }
-                return bytes_written;
+                return VfsWrite(file_descriptor_table[fd].vfs_fd, kernel_buffer, count);
             }
             return -1;
         }
@@ -71,18 +67,17 @@ uint64_t SyscallHandler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint
         case SYS_READ: {
             int fd = (int)arg1;
             void* user_buffer = (void*)arg2;
-            uint32_t count = (uint32_t)arg3;
+            uint64_t count = arg3;
 
             if (fd >= 3 && fd < MAX_FILE_DESCRIPTORS && file_descriptor_table[fd].in_use) {
                 if (count > MAX_SYSCALL_BUFFER_SIZE) {
                     count = MAX_SYSCALL_BUFFER_SIZE;
                 }
-                int bytes_read = VfsReadAt(file_descriptor_table[fd].path, kernel_buffer, file_descriptor_table[fd].position, count);
+                int64_t bytes_read = VfsRead(file_descriptor_table[fd].vfs_fd, kernel_buffer, count);
                 if (bytes_read > 0) {
                     if (CopyToUser(user_buffer, kernel_buffer, bytes_read) != 0) {
                         return -1;
                     }
-                    file_descriptor_table[fd].position += bytes_read;
                 }
                 return bytes_read;
             }
@@ -91,16 +86,28 @@ uint64_t SyscallHandler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint
 
         case SYS_OPEN: {
             const char* user_path = (const char*)arg1;
+            const uint64_t open_flags = arg2;
+            if (open_flags & ~(uint64_t)(SYS_OPEN_READ | SYS_OPEN_WRITE | SYS_OPEN_APPEND | SYS_OPEN_CREATE)) {
+                return -1;
+            }
             if (CopyFromUser(path_buffer, user_path, MAX_SYSCALL_STR_LEN) != 0) {
                 return -1;
             }
             path_buffer[MAX_SYSCALL_STR_LEN - 1] = '\0';
 
+            int flags = 0;
+            if (open_flags & SYS_OPEN_READ) flags |= FS_READ;
+            if (open_flags & SYS_OPEN_WRITE) flags |= FS_WRITE;
+            if (open_flags & SYS_OPEN_APPEND) flags |= FS_APPEND;
+            if (open_flags & SYS_OPEN_CREATE) flags |= FS_CREATE;
+            if (!(flags & (FS_WRITE | FS_APPEND))) flags |= FS_READ;
+
             for (int i = 3; i < MAX_FILE_DESCRIPTORS; i++) {
                 if (!file_descriptor_table[i].in_use) {
+                    int vfs_fd = VfsOpen(path_buffer, flags);
+                    if (vfs_fd < 0) return -1;
                     file_descriptor_table[i].in_use = true;
-                    strncpy(file_descriptor_table[i].path, path_buffer, sizeof(file_descriptor_table[i].path) - 1);
-                    file_descriptor_table[i].position = 0;
+                    file_descriptor_table[i].vfs_fd = vfs_fd;
                     return i;
                 }
             }
@@ -110,12 +117,21 @@ uint64_t SyscallHandler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint
         case SYS_CLOSE: {
             int fd = (int)arg1;
             if (fd >= 3 && fd < MAX_FILE_DESCRIPTORS && file_descriptor_table[fd].in_use) {
+                VfsClose(file_descriptor_table[fd].vfs_fd);
                 file_descriptor_table[fd].in_use = false;
                 return 0;
             }
             return -1; // Invalid file descriptor
         }
 
+        case SYS_SEEK: {
+            int fd = (int)arg1;
+            if (fd >= 3 && fd < MAX_FILE_DESCRIPTORS && file_descriptor_table[fd].in_use) {
+                return VfsSeek(file_descriptor_table[fd].vfs_fd, (int64_t)arg2, (int)arg3);
+            }
+            return -1;
+        }
+
         case SYS_CREATE_FILE: {
             const char* user_path = (const char*)arg1;
             if (CopyFromUser(path_buffer, user_path, MAX_SYSCALL_STR_LEN) != 0) {
@@ -17,8 +17,15 @@
 #define SYS_YIELD 11
 #define SYS_IPC_SEND_MESSAGE 12
 #define SYS_IPC_RECEIVE_MESSAGE 13
+#define SYS_SEEK 14
 #define SYS_EXIT 60
 
+// SYS_OPEN flags (arg2); without an access bit the file is opened read-only
+#define SYS_OPEN_READ   0x1
+#define SYS_OPEN_WRITE  0x2
+#define SYS_OPEN_APPEND 0x4     // implies write
+#define SYS_OPEN_CREATE 0x8     // create the file if it does not exist
+
 #define SYSCALL_INTERRUPT_VECTOR 80
 #define IDT_INTERRUPT_GATE_KERNEL 0x8E
 #define SYSCALL_SEGMENT_SELECTOR 0x08
@@ -22,6 +22,7 @@ option(VF_CONFIG_ENABLE_IDE "Enable IDE support" ON)
 option(VF_CONFIG_ENABLE_VFCOMPOSITOR "Enable VFCompositor support" ON)
 option(VF_CONFIG_ENABLE_AHCI "Enable AHCI support" ON)
 option(VF_CONFIG_ENABLE_NVME "Enable NVMe support" ON)
+option(VF_CONFIG_ENABLE_RAMDISK "Enable RAM disk support" ON)
 option(VF_CONFIG_ENABLE_GENERIC_SOUND "Enable Generic Sound support" ON)
 option(VF_CONFIG_RTC_CENTURY "Enable RTC Century support" ON)
 option(VF_CONFIG_ENFORCE_MEMORY_PROTECTION "Enforce memory protection" ON)
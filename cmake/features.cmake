@@ -32,6 +32,9 @@ endif()
 if(VF_CONFIG_ENABLE_NVME)
     add_compile_definitions(VF_CONFIG_ENABLE_NVME)
 endif()
+if(VF_CONFIG_ENABLE_RAMDISK)
+    add_compile_definitions(VF_CONFIG_ENABLE_RAMDISK)
+endif()
 if(VF_CONFIG_ENABLE_GENERIC_SOUND)
     add_compile_definitions(VF_CONFIG_ENABLE_GENERIC_SOUND)
 endif()
@@ -39,6 +39,7 @@ set(KERNEL_ETC_SOURCES
         kernel/etc/Editor.c
         kernel/etc/StringOps.c
         kernel/etc/POST.c
+        kernel/etc/BlkBench.c
 )
 
 set(UBSAN_SOURCES
@@ -82,6 +83,9 @@ set(FS_SOURCES
         fs/Iso9660.c
         fs/VFS.c
         fs/BlockDevice.c
+        fs/BlockCache.c
+        fs/DCache.c
+        fs/IoScheduler.c
         fs/FileSystem.c
         fs/MBR.c
         fs/DriveNaming.c
@@ -115,6 +119,7 @@ set(DRIVER_SOURCES
         drivers/sound/Generic.c
         drivers/storage/AHCI.c
         drivers/storage/NVMe.c
+        drivers/storage/RamDisk.c
         drivers/LPT/LPT.c
         drivers/virtio/VirtioBlk.c
         drivers/vmware/SVGAII.c
@@ -1,4 +1,5 @@
 #include <ACPI.h>
+#include <BlockCache.h>
 #include <Console.h>
 #include <Io.h>
 #include <MemOps.h>
@@ -149,6 +150,7 @@ bool ACPIInit(void) {
 void ACPIResetProcedure() {
     PrintKernel("ACPI: Unmounting Filesystems...\n");
     VfsUnmountAll();
+    BlockCacheSyncAll();
     PrintKernelSuccess("ACPI: Filesystems unmounted\n");
 
     PrintKernel("ACPI: Stopping all processes and services...\n");
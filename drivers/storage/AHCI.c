@@ -15,12 +15,19 @@
 #define ATA_CMD_READ_SECTORS 0x20
 #define ATA_CMD_WRITE_SECTORS 0x30
 #define ATA_CMD_IDENTIFY    0xEC
+#define ATA_CMD_DSM         0x06
+#define ATA_DSM_TRIM        0x01
+
+// A DSM TRIM payload block holds 64 entries of 48-bit LBA + 16-bit length
+#define ATA_TRIM_ENTRIES        64
+#define ATA_TRIM_MAX_SECTORS    0xFFFF
 
 static AHCIController g_ahci_controller = {0};
 
 // Forward declarations
 static int AHCI_ReadBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint32_t count, void* buffer);
 static int AHCI_WriteBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint32_t count, const void* buffer);
+static int AHCI_DiscardBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint64_t count);
 
 static uint32_t AHCI_ReadReg(uint32_t offset) {
     return *(volatile uint32_t*)(g_ahci_controller.mmio_base + offset);
@@ -154,7 +161,7 @@ static int AHCI_InitPort(int port) {
     return 0;
 }
 
-static int AHCI_SendCommand(int port, uint8_t command, uint64_t lba, uint16_t count, void* buffer, int write) {
+static int AHCI_SendCommandEx(int port, uint8_t command, uint8_t features, uint64_t lba, uint16_t count, void* buffer, int write) {
     AHCIPort* ahci_port = &g_ahci_controller.ports[port];
     if (!ahci_port->active) return -1;
     
@@ -188,6 +195,7 @@ static int AHCI_SendCommand(int port, uint8_t command, uint64_t lba, uint16_t co
     fis->fis_type = FIS_TYPE_REG_H2D;
     fis->c = 1; // Command
     fis->command = command;
+    fis->featurel = features;
     fis->device = 1 << 6; // LBA mode
     
     fis->lba0 = lba & 0xFF;
@@ -248,6 +256,10 @@ static int AHCI_SendCommand(int port, uint8_t command, uint64_t lba, uint16_t co
     return 0;
 }
 
+static int AHCI_SendCommand(int port, uint8_t command, uint64_t lba, uint16_t count, void* buffer, int write) {
+    return AHCI_SendCommandEx(port, command, 0, lba, count, buffer, write);
+}
+
 static uint64_t AHCI_GetDriveCapacity(int port) {
     // Allocate buffer for IDENTIFY data
     uint16_t* identify_data = (uint16_t*)KernelMemoryAlloc(512);
@@ -273,6 +285,8 @@ static uint64_t AHCI_GetDriveCapacity(int port) {
         // LBA28 - use words 60-61
         total_sectors = *(uint32_t*)(identify_data + 60);
     }
+
+    g_ahci_controller.ports[port].trim = (identify_data[169] & 1) != 0;
     
     KernelFree(identify_data);
     
@@ -302,6 +316,32 @@ int AHCI_WriteSectors(int port, uint64_t lba, uint16_t count, const void* buffer
     return AHCI_SendCommand(port, ATA_CMD_WRITE_DMA_EX, lba, count, (void*)buffer, 1);
 }
 
+int AHCI_TrimSectors(int port, uint64_t lba, uint64_t count) {
+    if (!g_ahci_controller.initialized || !g_ahci_controller.ports[port].active ||
+        !g_ahci_controller.ports[port].trim) {
+        return -1;
+    }
+
+    uint64_t* ranges = (uint64_t*)KernelMemoryAlloc(512);
+    if (!ranges) return -1;
+
+    int result = 0;
+    while (count > 0 && result == 0) {
+        FastMemset(ranges, 0, 512); // zero-length entries are ignored
+        for (int i = 0; i < ATA_TRIM_ENTRIES && count > 0; i++) {
+            const uint64_t n = count > ATA_TRIM_MAX_SECTORS ? ATA_TRIM_MAX_SECTORS : count;
+            ranges[i] = (lba & 0xFFFFFFFFFFFFULL) | (n << 48);
+            lba += n;
+            count -= n;
+        }
+        // Count is the number of 512-byte payload blocks, sent as a DMA write
+        result = AHCI_SendCommandEx(port, ATA_CMD_DSM, ATA_DSM_TRIM, 0, 1, ranges, 1);
+    }
+
+    KernelFree(ranges);
+    return result;
+}
+
 int AHCI_Init(void) {
     PrintKernel("AHCI: Initializing AHCI driver...\n");
     
@@ -454,6 +494,10 @@ int AHCI_Init(void) {
                 PrintKernel("AHCI: Registered block device: ");
                 PrintKernel(dev_name);
                 PrintKernel("\n");
+                if (g_ahci_controller.ports[i].trim) {
+                    dev->discard_blocks = AHCI_DiscardBlocksWrapper;
+                    PrintKernel("AHCI: TRIM supported\n");
+                }
                 BlockDeviceDetectAndRegisterPartitions(dev);
             }
         }
@@ -491,4 +535,10 @@ static int AHCI_WriteBlocksWrapper(struct BlockDevice* device, uint64_t start_lb
     
     // AHCI_WriteSectors expects sectors, not blocks, but they're the same for 512-byte sectors
     return AHCI_WriteSectors(port, start_lba, count, buffer);
-}
\ No newline at end of file
+}
+
+static int AHCI_DiscardBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint64_t count) {
+    if (!device || !device->driver_data) return -1;
+    int port = (uintptr_t)device->driver_data - 1;
+    return AHCI_TrimSectors(port, start_lba, count);
+}
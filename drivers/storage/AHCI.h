@@ -116,6 +116,7 @@ typedef struct {
     uint64_t cmd_table_phys;
     int port_num;
     int active;
+    int trim;           // IDENTIFY word 169 bit 0: DSM TRIM supported
 } AHCIPort;
 
 // AHCI Controller structure
@@ -132,6 +133,7 @@ typedef struct {
 int AHCI_Init(void);
 int AHCI_ReadSectors(int port, uint64_t lba, uint16_t count, void* buffer);
 int AHCI_WriteSectors(int port, uint64_t lba, uint16_t count, const void* buffer);
+int AHCI_TrimSectors(int port, uint64_t lba, uint64_t count);
 const AHCIController* AHCI_GetController(void);
 
 #endif // VOIDFRAME_AHCI_H
\ No newline at end of file
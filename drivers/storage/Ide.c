@@ -6,10 +6,43 @@
 #include <Format.h>
 #include <Io.h>
 #include <MemOps.h>
+#include <PCI/PCI.h>
+#include <Scheduler.h>
 #include <SpinlockRust.h>
+#include <TSC.h>
+#include <VMem.h>
 
 static IdeChannel channels[2];
-static RustSpinLock* ide_lock = NULL;
+static RustSpinLock* ide_lock = NULL; // guards the channel claims only
+
+// Gives the CPU away while waiting on the drive: the yield hands the rest
+// of the slice to other processes, and with interrupts enabled the CPU
+// halts until the next IRQ (the drive's own, or the timer) instead of
+// spinning.
+static void IdeIdle(void) {
+    Yield();
+    if (save_irq_flags() & (1 << 9)) __asm__ volatile("hlt");
+    else __asm__ volatile("pause");
+}
+
+// A channel runs one command at a time. The claim is taken under ide_lock
+// but the transfer itself, DMA wait included, runs without any spinlock.
+static void IdeClaim(IdeChannel* ch) {
+    for (;;) {
+        rust_spinlock_lock(ide_lock);
+        if (!ch->busy) {
+            ch->busy = 1;
+            rust_spinlock_unlock(ide_lock);
+            return;
+        }
+        rust_spinlock_unlock(ide_lock);
+        IdeIdle();
+    }
+}
+
+static void IdeRelease(IdeChannel* ch) {
+    __atomic_store_n(&ch->busy, 0, __ATOMIC_RELEASE);
+}
 
 // Wait for drive to be ready (not busy)
 static int IdeWaitReady(uint16_t base_port) {
@@ -112,6 +145,227 @@ static int IdeIdentifyDrive(uint16_t base_port, uint8_t drive, uint16_t* buffer,
     return IDE_OK;
 }
 
+// Send a 12-byte ATAPI packet and read `bytes` of data in PIO mode. The drive
+// hands the data over in DRQ blocks and reports each block's size in the
+// byte count registers.
+static int IdeAtapiPacketIn(uint16_t base_port, uint8_t drive_num, const uint8_t* packet, void* buffer, uint32_t bytes) {
+    int result = IdeSelectDrive(base_port, drive_num, 0); // LBA is in the packet
+    if (result != IDE_OK) return result;
+
+    outb(base_port + IDE_REG_FEATURES, 0); // PIO mode
+    outb(base_port + IDE_REG_LBA_MID, IDE_ATAPI_SECTOR_SIZE & 0xFF);
+    outb(base_port + IDE_REG_LBA_HIGH, IDE_ATAPI_SECTOR_SIZE >> 8);
+    outb(base_port + IDE_REG_COMMAND, IDE_CMD_PACKET);
+
+    result = IdeWaitData(base_port);
+    if (result != IDE_OK) return result;
+
+    const uint16_t* packet_ptr = (const uint16_t*)packet;
+    for (int i = 0; i < 6; i++) {
+        outw(base_port + IDE_REG_DATA, packet_ptr[i]);
+    }
+
+    uint16_t* buf16 = (uint16_t*)buffer;
+    uint32_t received = 0;
+    while (received < bytes) {
+        result = IdeWaitData(base_port);
+        if (result != IDE_OK) return result;
+
+        uint32_t block = inb(base_port + IDE_REG_LBA_MID) | ((uint32_t)inb(base_port + IDE_REG_LBA_HIGH) << 8);
+        if (block == 0) return IDE_ERROR_IO;
+        for (uint32_t i = 0; i < block; i += 2) {
+            const uint16_t word = inw(base_port + IDE_REG_DATA);
+            if (received < bytes) buf16[received / 2] = word;
+            received += 2;
+        }
+    }
+    return IdeWaitReady(base_port);
+}
+
+// READ CAPACITY: number of 2048-byte sectors on the medium, 0 without one
+static uint64_t IdeAtapiCapacity(uint16_t base_port, uint8_t drive_num) {
+    const uint8_t packet[12] = {ATAPI_CMD_READ_CAPACITY, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t reply[8];
+    if (IdeAtapiPacketIn(base_port, drive_num, packet, reply, sizeof(reply)) != IDE_OK) return 0;
+
+    const uint32_t last_lba = ((uint32_t)reply[0] << 24) | ((uint32_t)reply[1] << 16) | ((uint32_t)reply[2] << 8) | reply[3];
+    const uint32_t block_len = ((uint32_t)reply[4] << 24) | ((uint32_t)reply[5] << 16) | ((uint32_t)reply[6] << 8) | reply[7];
+    if (block_len != IDE_ATAPI_SECTOR_SIZE) return 0;
+    return (uint64_t)last_lba + 1;
+}
+
+static int IdeAtapiRead(uint16_t base_port, uint8_t drive_num, uint32_t lba, uint32_t count, void* buffer) {
+    const uint8_t packet[12] = {
+        ATAPI_CMD_READ_10, 0,
+        (lba >> 24) & 0xFF, (lba >> 16) & 0xFF, (lba >> 8) & 0xFF, lba & 0xFF,
+        0, (count >> 8) & 0xFF, count & 0xFF,
+        0, 0, 0
+    };
+    return IdeAtapiPacketIn(base_port, drive_num, packet, buffer, count * IDE_ATAPI_SECTOR_SIZE);
+}
+
+// Allocate the PRD table and bounce buffer for one channel. Each PRD covers one
+// 4K page of the bounce buffer, so no entry can straddle a 64K boundary.
+static int IdeSetupChannelDma(IdeChannel* ch) {
+    ch->prdt = (IdePrdEntry*)VMemAlloc(PAGE_SIZE);
+    if (!ch->prdt) return IDE_ERROR_IO;
+    ch->dma_buffer = (uint8_t*)VMemAlloc(IDE_DMA_BUFFER_SIZE);
+    if (!ch->dma_buffer) {
+        VMemFree(ch->prdt, PAGE_SIZE);
+        ch->prdt = NULL;
+        return IDE_ERROR_IO;
+    }
+    FastMemset(ch->prdt, 0, PAGE_SIZE);
+
+    // Bus master IDE only takes 32-bit physical addresses
+    ch->prdt_phys = VMemGetPhysAddr((uint64_t)ch->prdt);
+    if (ch->prdt_phys == 0 || ch->prdt_phys > 0xFFFFFFFFULL) goto fail;
+
+    for (int i = 0; i < IDE_DMA_PRD_COUNT; i++) {
+        uint64_t phys = VMemGetPhysAddr((uint64_t)(ch->dma_buffer + i * PAGE_SIZE));
+        if (phys == 0 || phys + PAGE_SIZE > 0x100000000ULL) goto fail;
+        ch->prdt[i].phys_addr = (uint32_t)phys;
+        ch->prdt[i].byte_count = PAGE_SIZE;
+        ch->prdt[i].flags = 0;
+    }
+    return IDE_OK;
+
+fail:
+    VMemFree(ch->dma_buffer, IDE_DMA_BUFFER_SIZE);
+    VMemFree(ch->prdt, PAGE_SIZE);
+    ch->dma_buffer = NULL;
+    ch->prdt = NULL;
+    return IDE_ERROR_IO;
+}
+
+// Locate the PCI IDE function and enable bus-master DMA through BAR4 (BMIDE)
+static void IdeSetupBusMaster(void) {
+    channels[0].bm_port = 0;
+    channels[1].bm_port = 0;
+
+    PciDevice pci_dev;
+    static const uint8_t prog_ifs[] = { 0x80, 0x8A, 0x85, 0x8F };
+    int found = 0;
+    for (uint32_t i = 0; i < sizeof(prog_ifs) && !found; i++) {
+        found = PciFindByClass(IDE_PCI_CLASS_CODE, IDE_PCI_SUBCLASS, prog_ifs[i], &pci_dev) == 0;
+    }
+    if (!found) {
+        PrintKernelWarning("IDE: No bus-master IDE controller, using PIO\n");
+        return;
+    }
+
+    uint32_t bar4 = PciConfigReadDWord(pci_dev.bus, pci_dev.device, pci_dev.function, IDE_PCI_BAR4_REG);
+    if (!(bar4 & 1) || (bar4 & 0xFFFC) == 0) {
+        PrintKernelWarning("IDE: BMIDE BAR is not an I/O BAR, using PIO\n");
+        return;
+    }
+    uint16_t bm_base = bar4 & 0xFFFC;
+
+    // Enable I/O space and bus mastering
+    uint16_t cmd = PciReadConfig16(pci_dev.bus, pci_dev.device, pci_dev.function, PCI_COMMAND_REG);
+    PciWriteConfig16(pci_dev.bus, pci_dev.device, pci_dev.function, PCI_COMMAND_REG,
+                     cmd | 0x01 | PCI_CMD_BUS_MASTER_EN);
+
+    for (int channel = 0; channel < 2; channel++) {
+        IdeChannel* ch = &channels[channel];
+        if (!ch->dma_capable[0] && !ch->dma_capable[1]) continue;
+        if (IdeSetupChannelDma(ch) != IDE_OK) {
+            PrintKernelWarning("IDE: Failed to allocate DMA buffers, channel uses PIO\n");
+            continue;
+        }
+
+        ch->bm_port = bm_base + channel * IDE_BM_SECONDARY_OFFSET;
+
+        // Advertise DMA capability and clear stale IRQ/error bits
+        uint8_t status = IDE_BM_STATUS_IRQ | IDE_BM_STATUS_ERR;
+        if (ch->dma_capable[0]) status |= IDE_BM_STATUS_DRV0_DMA;
+        if (ch->dma_capable[1]) status |= IDE_BM_STATUS_DRV1_DMA;
+        outb(ch->bm_port + IDE_BM_REG_STATUS, status);
+        outl(ch->bm_port + IDE_BM_REG_PRDT, (uint32_t)ch->prdt_phys);
+
+        PrintKernel("IDE: Bus-master DMA enabled on channel ");
+        PrintKernelInt(channel);
+        PrintKernel(" (BMIDE=0x");
+        PrintKernelHex(ch->bm_port);
+        PrintKernel(")\n");
+    }
+}
+
+// Wait for the DMA completion IRQ, idling the CPU in between. The BM status
+// register is polled as well so completion is still seen when interrupts
+// are masked (early boot, panics).
+static int IdeWaitDma(IdeChannel* ch) {
+    uint64_t start = GetTimeInMs();
+    while ((GetTimeInMs() - start) < 5000) {
+        if (ch->dma_done) return (ch->dma_irq_status & IDE_BM_STATUS_ERR) ? IDE_ERROR_IO : IDE_OK;
+
+        uint8_t bm_status = inb(ch->bm_port + IDE_BM_REG_STATUS);
+        if (bm_status & IDE_BM_STATUS_ERR) return IDE_ERROR_IO;
+        if ((bm_status & IDE_BM_STATUS_IRQ) && !(bm_status & IDE_BM_STATUS_ACTIVE)) return IDE_OK;
+        IdeIdle();
+    }
+    return IDE_ERROR_TIMEOUT;
+}
+
+// Run one bus-master transfer of up to IDE_DMA_MAX_SECTORS through the bounce
+// buffer. Caller has claimed the channel.
+static int IdeDmaTransfer(IdeChannel* ch, uint8_t drive_num, uint32_t lba, uint32_t count, int write) {
+    const uint16_t base_port = ch->base_port;
+    const uint32_t bytes = count * 512;
+
+    // Trim the PRD list to the transfer length
+    uint32_t last = (bytes - 1) / PAGE_SIZE;
+    for (uint32_t i = 0; i <= last; i++) {
+        uint32_t chunk = (i == last) ? bytes - i * PAGE_SIZE : PAGE_SIZE;
+        ch->prdt[i].byte_count = (uint16_t)chunk;
+        ch->prdt[i].flags = (i == last) ? IDE_PRD_EOT : 0;
+    }
+
+    outb(ch->bm_port + IDE_BM_REG_COMMAND, 0);
+    outl(ch->bm_port + IDE_BM_REG_PRDT, (uint32_t)ch->prdt_phys);
+    outb(ch->bm_port + IDE_BM_REG_COMMAND, write ? 0 : IDE_BM_CMD_READ);
+    outb(ch->bm_port + IDE_BM_REG_STATUS,
+         inb(ch->bm_port + IDE_BM_REG_STATUS) | IDE_BM_STATUS_IRQ | IDE_BM_STATUS_ERR);
+
+    ch->dma_done = 0;
+    ch->dma_irq_status = 0;
+
+    int result = IdeSelectDrive(base_port, drive_num, lba);
+    if (result != IDE_OK) return result;
+
+    outb(base_port + IDE_REG_SECTOR_COUNT, (uint8_t)count);
+    outb(base_port + IDE_REG_LBA_LOW, lba & 0xFF);
+    outb(base_port + IDE_REG_LBA_MID, (lba >> 8) & 0xFF);
+    outb(base_port + IDE_REG_LBA_HIGH, (lba >> 16) & 0xFF);
+    outb(base_port + IDE_REG_COMMAND, write ? IDE_CMD_WRITE_DMA : IDE_CMD_READ_DMA);
+
+    __asm__ volatile("mfence" ::: "memory");
+    outb(ch->bm_port + IDE_BM_REG_COMMAND, (write ? 0 : IDE_BM_CMD_READ) | IDE_BM_CMD_START);
+
+    result = IdeWaitDma(ch);
+
+    // Stop the bus master and acknowledge both controller and drive
+    outb(ch->bm_port + IDE_BM_REG_COMMAND, write ? 0 : IDE_BM_CMD_READ);
+    outb(ch->bm_port + IDE_BM_REG_STATUS,
+         inb(ch->bm_port + IDE_BM_REG_STATUS) | IDE_BM_STATUS_IRQ | IDE_BM_STATUS_ERR);
+    uint8_t status = inb(base_port + IDE_REG_STATUS);
+
+    if (result != IDE_OK) return result;
+    if (status & (IDE_STATUS_ERR | IDE_STATUS_DF)) return IDE_ERROR_IO;
+    return IDE_OK;
+}
+
+static int IdeDmaUsable(const IdeChannel* ch, uint8_t drive_num, uint64_t start_lba, uint32_t count) {
+    return ch->bm_port && ch->dma_capable[drive_num] && start_lba + count <= 0x0FFFFFFFULL;
+}
+
+static void IdeDisableDma(IdeChannel* ch, int result) {
+    PrintKernelWarning("IDE: DMA transfer failed (");
+    PrintKernelInt(result);
+    PrintKernelWarning("), falling back to PIO\n");
+    ch->bm_port = 0;
+}
+
 int IdeInit(void) {
     if (!ide_lock) {
         ide_lock = rust_spinlock_new();
@@ -170,6 +424,10 @@ int IdeInit(void) {
                     channels[channel].is_atapi[drive] = 1;
                 }
 
+                // Word 49 bit 8: DMA supported
+                channels[channel].dma_capable[drive] =
+                    !channels[channel].is_atapi[drive] && (identify_buffer[49] & (1 << 8));
+
                 // Extract model string (words 27-46, byte-swapped)
                 char* model = channels[channel].model[drive];
                 for (int i = 0; i < 20; i++) {
@@ -187,6 +445,20 @@ int IdeInit(void) {
                 char dev_name[16];
                 GenerateDriveNameInto(DEVICE_TYPE_IDE, dev_name);
 
+                if (channels[channel].is_atapi[drive]) {
+                    // Optical drive: 2048-byte sectors, read-only, no partition table
+                    BlockDeviceRegister(
+                        DEVICE_TYPE_IDE,
+                        IDE_ATAPI_SECTOR_SIZE,
+                        IdeAtapiCapacity(channels[channel].base_port, drive),
+                        dev_name,
+                        (void*)(uintptr_t)(channel * 2 + drive + 1),
+                        (ReadBlocksFunc)IdeAtapiReadBlocks,
+                        NULL
+                    );
+                    continue;
+                }
+
                 BlockDevice* dev = BlockDeviceRegister(
                     DEVICE_TYPE_IDE,
                     512,
@@ -211,41 +483,23 @@ int IdeInit(void) {
     PrintKernelInt(drives_found);
     PrintKernel(" drive(s) found\n");
 
+    IdeSetupBusMaster();
+
     PrintKernel("Unmasking IDE IRQs\n");
     ApicEnableIrq(12);
     ApicEnableIrq(14);
+    ApicEnableIrq(15);
     PrintKernelSuccess("IDE IRQs unmasked\n");
     return IDE_OK;
 }
 
-int IdeReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, void* buffer) {
-    if (!device || !device->driver_data) {
-        PrintKernel("IDE: Invalid device or driver_data\n");
-        return -1;
-    }
-    uint8_t drive = (uintptr_t)device->driver_data - 1;
-
-    uint8_t channel = drive / 2;
-    uint8_t drive_num = drive % 2;
-
-
-    if (!channels[channel].drive_exists[drive_num]) {
-        PrintKernel("IDE: Drive does not exist\n");
-        return IDE_ERROR_NO_DRIVE;
-    }
-
-    rust_spinlock_lock(ide_lock);
-    const uint16_t base_port = channels[channel].base_port;
-
+static int IdePioRead(uint16_t base_port, uint8_t drive_num, uint64_t start_lba, uint32_t count, void* buffer) {
     for (uint32_t i = 0; i < count; i++) {
         uint64_t lba = start_lba + i;
         uint8_t* buf = (uint8_t*)buffer + (i * 512);
 
         int result = IdeSelectDrive(base_port, drive_num, lba);
-        if (result != IDE_OK) {
-            rust_spinlock_unlock(ide_lock);
-            return result;
-        }
+        if (result != IDE_OK) return result;
 
         outb(base_port + IDE_REG_SECTOR_COUNT, 1);
         outb(base_port + IDE_REG_LBA_LOW, lba & 0xFF);
@@ -258,7 +512,6 @@ int IdeReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, void*
             PrintKernel("IDE: Wait for data failed with error ");
             PrintKernelInt(result);
             PrintKernel("\n");
-            rust_spinlock_unlock(ide_lock);
             return result;
         }
 
@@ -267,34 +520,16 @@ int IdeReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, void*
             buf16[j] = inw(base_port + IDE_REG_DATA);
         }
     }
-
-    rust_spinlock_unlock(ide_lock);
-    return 0;
+    return IDE_OK;
 }
 
-int IdeWriteBlocks(struct BlockDevice* device, uint64_t start_lba, uint32_t count, const void* buffer) {
-    if (!device || !device->driver_data) return -1;
-    uint8_t drive = (uintptr_t)device->driver_data - 1;
-
-    uint8_t channel = drive / 2;
-    uint8_t drive_num = drive % 2;
-
-    if (!channels[channel].drive_exists[drive_num]) {
-        return IDE_ERROR_NO_DRIVE;
-    }
-
-    rust_spinlock_lock(ide_lock);
-    uint16_t base_port = channels[channel].base_port;
-
+static int IdePioWrite(uint16_t base_port, uint8_t drive_num, uint64_t start_lba, uint32_t count, const void* buffer) {
     for (uint32_t i = 0; i < count; i++) {
         uint64_t lba = start_lba + i;
         const uint8_t* buf = (const uint8_t*)buffer + (i * 512);
 
         int result = IdeSelectDrive(base_port, drive_num, lba);
-        if (result != IDE_OK) {
-            rust_spinlock_unlock(ide_lock);
-            return result;
-        }
+        if (result != IDE_OK) return result;
 
         outb(base_port + IDE_REG_SECTOR_COUNT, 1);
         outb(base_port + IDE_REG_LBA_LOW, lba & 0xFF);
@@ -303,10 +538,7 @@ int IdeWriteBlocks(struct BlockDevice* device, uint64_t start_lba, uint32_t coun
         outb(base_port + IDE_REG_COMMAND, IDE_CMD_WRITE_SECTORS);
 
         result = IdeWaitData(base_port);
-        if (result != IDE_OK) {
-            rust_spinlock_unlock(ide_lock);
-            return result;
-        }
+        if (result != IDE_OK) return result;
 
         const uint16_t* buf16 = (const uint16_t*)buf;
         for (int j = 0; j < 256; j++) {
@@ -314,14 +546,82 @@ int IdeWriteBlocks(struct BlockDevice* device, uint64_t start_lba, uint32_t coun
         }
 
         result = IdeWaitReady(base_port);
+        if (result != IDE_OK) return result;
+    }
+    return IDE_OK;
+}
+
+int IdeReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, void* buffer) {
+    if (!device || !device->driver_data) {
+        PrintKernel("IDE: Invalid device or driver_data\n");
+        return -1;
+    }
+    uint8_t drive = (uintptr_t)device->driver_data - 1;
+
+    uint8_t channel = drive / 2;
+    uint8_t drive_num = drive % 2;
+
+
+    if (!channels[channel].drive_exists[drive_num]) {
+        PrintKernel("IDE: Drive does not exist\n");
+        return IDE_ERROR_NO_DRIVE;
+    }
+
+    IdeChannel* ch = &channels[channel];
+    IdeClaim(ch);
+    int result = IDE_OK;
+
+    while (count > 0 && IdeDmaUsable(ch, drive_num, start_lba, count)) {
+        uint32_t chunk = count > IDE_DMA_MAX_SECTORS ? IDE_DMA_MAX_SECTORS : count;
+        result = IdeDmaTransfer(ch, drive_num, (uint32_t)start_lba, chunk, 0);
         if (result != IDE_OK) {
-            rust_spinlock_unlock(ide_lock);
-            return result;
+            IdeDisableDma(ch, result);
+            break;
+        }
+        FastMemcpy(buffer, ch->dma_buffer, chunk * 512);
+        buffer = (uint8_t*)buffer + chunk * 512;
+        start_lba += chunk;
+        count -= chunk;
+    }
+
+    if (count > 0) result = IdePioRead(ch->base_port, drive_num, start_lba, count, buffer);
+
+    IdeRelease(ch);
+    return result;
+}
+
+int IdeWriteBlocks(struct BlockDevice* device, uint64_t start_lba, uint32_t count, const void* buffer) {
+    if (!device || !device->driver_data) return -1;
+    uint8_t drive = (uintptr_t)device->driver_data - 1;
+
+    uint8_t channel = drive / 2;
+    uint8_t drive_num = drive % 2;
+
+    if (!channels[channel].drive_exists[drive_num]) {
+        return IDE_ERROR_NO_DRIVE;
+    }
+
+    IdeChannel* ch = &channels[channel];
+    IdeClaim(ch);
+    int result = IDE_OK;
+
+    while (count > 0 && IdeDmaUsable(ch, drive_num, start_lba, count)) {
+        uint32_t chunk = count > IDE_DMA_MAX_SECTORS ? IDE_DMA_MAX_SECTORS : count;
+        FastMemcpy(ch->dma_buffer, buffer, chunk * 512);
+        result = IdeDmaTransfer(ch, drive_num, (uint32_t)start_lba, chunk, 1);
+        if (result != IDE_OK) {
+            IdeDisableDma(ch, result);
+            break;
         }
+        buffer = (const uint8_t*)buffer + chunk * 512;
+        start_lba += chunk;
+        count -= chunk;
     }
 
-    rust_spinlock_unlock(ide_lock);
-    return 0;
+    if (count > 0) result = IdePioWrite(ch->base_port, drive_num, start_lba, count, buffer);
+
+    IdeRelease(ch);
+    return result;
 }
 
 int IdeGetDriveInfo(uint8_t drive, char* model_out) {
@@ -341,17 +641,25 @@ int IdeGetDriveInfo(uint8_t drive, char* model_out) {
     return IDE_OK;
 }
 
-// IDE interrupt handlers - just acknowledge for now
-void IDEPrimaryIRQH(void) {
-    // Primary IDE channel interrupt
+// Latch bus-master completion for IdeWaitDma, then acknowledge the drive
+static void IdeHandleIrq(IdeChannel* ch, uint16_t base_port) {
+    if (ch->bm_port) {
+        uint8_t bm_status = inb(ch->bm_port + IDE_BM_REG_STATUS);
+        if (bm_status & IDE_BM_STATUS_IRQ) {
+            ch->dma_irq_status = bm_status;
+            ch->dma_done = 1;
+        }
+    }
     // Read status to acknowledge
-    inb(IDE_PRIMARY_BASE + IDE_REG_STATUS);
+    inb(base_port + IDE_REG_STATUS);
+}
+
+void IDEPrimaryIRQH(void) {
+    IdeHandleIrq(&channels[0], IDE_PRIMARY_BASE);
 }
 
 void IDESecondaryIRQH(void) {
-    // Secondary IDE channel interrupt
-    // Read status to acknowledge
-    inb(IDE_SECONDARY_BASE + IDE_REG_STATUS);
+    IdeHandleIrq(&channels[1], IDE_SECONDARY_BASE);
 }
 
 int IdeReadLBA2048(uint8_t drive, uint32_t lba, void* buffer) {
@@ -364,50 +672,34 @@ int IdeReadLBA2048(uint8_t drive, uint32_t lba, void* buffer) {
         return IDE_ERROR_NO_DRIVE;
     }
 
-    rust_spinlock_lock(ide_lock);
-    uint16_t base_port = channels[channel].base_port;
-    rust_spinlock_unlock(ide_lock);
-    int result;
-
-    result = IdeSelectDrive(base_port, drive_num, 0); // LBA is in the packet
-    if (result != IDE_OK) {
-        return result;
-    }
-
-    uint8_t atapi_packet[12] = {
-        ATAPI_CMD_READ_10, 0,
-        (lba >> 24) & 0xFF, (lba >> 16) & 0xFF, (lba >> 8) & 0xFF, lba & 0xFF,
-        0, 0, 1, // 1 sector
-        0, 0, 0
-    };
-
-    outb(base_port + IDE_REG_FEATURES, 0); // PIO mode
-    outb(base_port + IDE_REG_LBA_MID, 2048 & 0xFF);
-    outb(base_port + IDE_REG_LBA_HIGH, 2048 >> 8);
-
-    outb(base_port + IDE_REG_COMMAND, IDE_CMD_PACKET);
+    IdeClaim(&channels[channel]);
+    const int result = IdeAtapiRead(channels[channel].base_port, drive_num, lba, 1, buffer);
+    IdeRelease(&channels[channel]);
+    return result;
+}
 
-    result = IdeWaitData(base_port);
-    if (result != IDE_OK) {
-        return result;
-    }
+int IdeAtapiReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, void* buffer) {
+    if (!device || !device->driver_data) return -1;
+    uint8_t drive = (uintptr_t)device->driver_data - 1;
 
-    // Send packet
-    uint16_t* packet_ptr = (uint16_t*)atapi_packet;
-    for (int i = 0; i < 6; i++) {
-        outw(base_port + IDE_REG_DATA, packet_ptr[i]);
-    }
+    uint8_t channel = drive / 2;
+    uint8_t drive_num = drive % 2;
 
-    result = IdeWaitData(base_port);
-    if (result != IDE_OK) {
-        return result;
+    if (!channels[channel].drive_exists[drive_num] || !channels[channel].is_atapi[drive_num]) {
+        return IDE_ERROR_NO_DRIVE;
     }
-
-    // Read data
-    uint16_t* buf16 = (uint16_t*)buffer;
-    for (int i = 0; i < 1024; i++) { // 2048 bytes = 1024 words
-        buf16[i] = inw(base_port + IDE_REG_DATA);
+    if (start_lba + count > UINT32_MAX) return IDE_ERROR_IO;
+
+    IdeClaim(&channels[channel]);
+    int result = IDE_OK;
+    while (count > 0) {
+        uint32_t chunk = count > IDE_ATAPI_MAX_SECTORS ? IDE_ATAPI_MAX_SECTORS : count;
+        result = IdeAtapiRead(channels[channel].base_port, drive_num, (uint32_t)start_lba, chunk, buffer);
+        if (result != IDE_OK) break;
+        buffer = (uint8_t*)buffer + chunk * IDE_ATAPI_SECTOR_SIZE;
+        start_lba += chunk;
+        count -= chunk;
     }
-
-    return IDE_OK;
+    IdeRelease(&channels[channel]);
+    return result;
 }
\ No newline at end of file
@@ -36,7 +36,40 @@
 #define IDE_CMD_IDENTIFY        0xEC
 #define IDE_CMD_PACKET          0xA0
 #define IDE_CMD_IDENTIFY_PACKET 0xA1
+#define IDE_CMD_READ_DMA        0xC8
+#define IDE_CMD_WRITE_DMA       0xCA
 #define ATAPI_CMD_READ_10       0x28
+#define ATAPI_CMD_READ_CAPACITY 0x25
+
+#define IDE_ATAPI_SECTOR_SIZE   2048
+#define IDE_ATAPI_MAX_SECTORS   32      // sectors per READ(10) packet
+
+// PCI IDE controller (class/subclass, prog_if bit 7 = bus mastering)
+#define IDE_PCI_CLASS_CODE      0x01
+#define IDE_PCI_SUBCLASS        0x01
+#define IDE_PCI_PROG_IF_BM      0x80
+#define IDE_PCI_BAR4_REG        0x20
+
+// Bus master IDE registers (offset from BMIDE base, +8 for secondary)
+#define IDE_BM_REG_COMMAND      0x00
+#define IDE_BM_REG_STATUS       0x02
+#define IDE_BM_REG_PRDT         0x04
+#define IDE_BM_SECONDARY_OFFSET 0x08
+
+#define IDE_BM_CMD_START        0x01
+#define IDE_BM_CMD_READ         0x08  // Device -> memory
+
+#define IDE_BM_STATUS_ACTIVE    0x01
+#define IDE_BM_STATUS_ERR       0x02
+#define IDE_BM_STATUS_IRQ       0x04
+#define IDE_BM_STATUS_DRV0_DMA  0x20
+#define IDE_BM_STATUS_DRV1_DMA  0x40
+
+// DMA bounce buffer: one PRD per 4K page, never crosses a 64K boundary
+#define IDE_DMA_BUFFER_SIZE     (64 * 1024)
+#define IDE_DMA_MAX_SECTORS     (IDE_DMA_BUFFER_SIZE / 512)
+#define IDE_DMA_PRD_COUNT       (IDE_DMA_BUFFER_SIZE / 4096)
+#define IDE_PRD_EOT             0x8000
 
 
 // Drive Selection
@@ -50,12 +83,30 @@
 #define IDE_ERROR_NO_DRIVE  (-3)
 #define IDE_ERROR_IO        (-4)
 
+// Physical Region Descriptor
+typedef struct {
+    uint32_t phys_addr;
+    uint16_t byte_count;      // 0 means 64K
+    uint16_t flags;           // IDE_PRD_EOT on the last entry
+} __attribute__((packed)) IdePrdEntry;
+
 typedef struct {
     uint16_t base_port;
     uint16_t ctrl_port;
     uint8_t drive_exists[2];  // master/slave
     char model[2][41];        // drive model strings
     uint8_t is_atapi[2];
+    uint8_t dma_capable[2];   // IDENTIFY word 49 bit 8
+
+    // Bus master DMA state (bm_port == 0 means PIO only)
+    uint16_t bm_port;
+    IdePrdEntry* prdt;
+    uint64_t prdt_phys;
+    uint8_t* dma_buffer;
+    volatile uint8_t dma_irq_status;
+    volatile int dma_done;
+
+    volatile int busy;        // claimed by a transfer, see IdeClaim
 } IdeChannel;
 
 // Core Functions
@@ -65,6 +116,7 @@ int IdeReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, void*
 int IdeWriteBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, const void* buffer);
 int IdeGetDriveInfo(uint8_t drive, char* model_out);
 int IdeReadLBA2048(uint8_t drive, uint32_t lba, void* buffer);
+int IdeAtapiReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, void* buffer);
 int IdeIsAtapi(uint8_t drive);
 
 
@@ -193,6 +193,25 @@ static uint64_t NVMe_GetNamespaceSize(void) {
     return nsze;
 }
 
+static int NVMe_SupportsDsm(void) {
+    uint8_t* identify_data = (uint8_t*)KernelMemoryAlloc(4096);
+    if (!identify_data) return 0;
+
+    FastMemset(identify_data, 0, 4096);
+    NVMeSubmissionEntry cmd = {0};
+    cmd.cdw0 = NVME_ADMIN_IDENTIFY | ((uint32_t)(++g_nvme_controller.next_cid) << 16);
+    cmd.prp1 = VMemGetPhysAddr((uint64_t)identify_data);
+    cmd.cdw10 = 1; // CNS 1: Identify Controller
+
+    int supported = 0;
+    if (NVMe_SubmitAdminCommand(&cmd) == 0) {
+        uint16_t oncs = *(uint16_t*)(identify_data + NVME_ID_CTRL_ONCS);
+        supported = (oncs & NVME_ONCS_DSM) != 0;
+    }
+    KernelFree(identify_data);
+    return supported;
+}
+
 static int NVMe_SetupPrpList(uint64_t buffer_phys, uint32_t total_bytes) {
     NVMeController* ctrl = &g_nvme_controller;
     uint32_t page_size = 4096;
@@ -282,6 +301,37 @@ int NVMe_WriteSectors(uint64_t lba, uint16_t count, const void* buffer) {
     return NVMe_Flush();
 }
 
+// Deallocates (TRIMs) a range with Dataset Management, packing up to
+// NVME_DSM_MAX_RANGES descriptors into each command
+int NVMe_DeallocateSectors(uint64_t lba, uint64_t count) {
+    NVMeController* ctrl = &g_nvme_controller;
+    if (!ctrl->initialized || !ctrl->dsm_ranges) return -1;
+
+    while (count > 0) {
+        uint32_t nr = 0;
+        while (count > 0 && nr < NVME_DSM_MAX_RANGES) {
+            const uint32_t nlb = count > 0xFFFFFFFFULL ? 0xFFFFFFFFU : (uint32_t)count;
+            ctrl->dsm_ranges[nr].cattr = 0;
+            ctrl->dsm_ranges[nr].nlb = nlb;
+            ctrl->dsm_ranges[nr].slba = lba;
+            nr++;
+            lba += nlb;
+            count -= nlb;
+        }
+
+        NVMeSubmissionEntry cmd = {0};
+        cmd.cdw0 = NVME_CMD_DSM | ((uint32_t)(++ctrl->next_cid) << 16);
+        cmd.nsid = 1;
+        cmd.prp1 = VMemGetPhysAddr((uint64_t)ctrl->dsm_ranges);
+        cmd.cdw10 = nr - 1;
+        cmd.cdw11 = NVME_DSM_ATTR_DEALLOCATE;
+
+        int st = NVMe_SubmitIOCommand(&cmd);
+        if (st != 0) return st;
+    }
+    return 0;
+}
+
 void NVMe_Shutdown(void) {
     if (!g_nvme_controller.initialized) return;
 
@@ -295,6 +345,7 @@ void NVMe_Shutdown(void) {
     if (g_nvme_controller.io_sq) VMemFree(g_nvme_controller.io_sq, NVME_IO_QUEUE_SIZE * sizeof(NVMeSubmissionEntry));
     if (g_nvme_controller.io_cq) VMemFree(g_nvme_controller.io_cq, NVME_IO_QUEUE_SIZE * sizeof(NVMeCompletionEntry));
     if (g_nvme_controller.prp_list) VMemFree(g_nvme_controller.prp_list, PRP_LIST_ENTRIES * sizeof(uint64_t));
+    if (g_nvme_controller.dsm_ranges) VMemFree(g_nvme_controller.dsm_ranges, NVME_DSM_MAX_RANGES * sizeof(NVMeDsmRange));
 
     if (g_nvme_controller.mmio_base) {
         VMemUnmap((uint64_t)g_nvme_controller.mmio_base, g_nvme_controller.mmio_size);
@@ -319,6 +370,11 @@ static int NVMe_WriteBlocksWrapper(struct BlockDevice* device, uint64_t start_lb
     return NVMe_WriteSectors(start_lba, count, buffer);
 }
 
+static int NVMe_DiscardBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint64_t count) {
+    (void)device;
+    return NVMe_DeallocateSectors(start_lba, count);
+}
+
 int NVMe_Init(void) {
     PrintKernel("NVMe: Initializing NVMe driver...\n");
     
@@ -440,6 +496,10 @@ int NVMe_Init(void) {
         return -1;
     }
 
+    if (NVMe_SupportsDsm()) {
+        g_nvme_controller.dsm_ranges = (NVMeDsmRange*)VMemAlloc(NVME_DSM_MAX_RANGES * sizeof(NVMeDsmRange));
+    }
+
     g_nvme_controller.initialized = 1;
     
     char dev_name[16];
@@ -456,6 +516,10 @@ int NVMe_Init(void) {
     );
     
     if (nvme_device) {
+        if (g_nvme_controller.dsm_ranges) {
+            nvme_device->discard_blocks = NVMe_DiscardBlocksWrapper;
+            PrintKernel("NVMe: Dataset Management (deallocate) supported\n");
+        }
         PrintKernel("NVMe: Successfully initialized NVMe controller\n");
         BlockDeviceDetectAndRegisterPartitions(nvme_device);
         return 0;
@@ -38,6 +38,13 @@
 #define NVME_CMD_READ           0x02
 #define NVME_CMD_WRITE          0x01
 #define NVME_CMD_FLUSH          0x00
+#define NVME_CMD_DSM            0x09    // Dataset Management
+
+// Dataset Management
+#define NVME_DSM_ATTR_DEALLOCATE (1 << 2)
+#define NVME_DSM_MAX_RANGES     256
+#define NVME_ONCS_DSM           (1 << 2)  // Identify Controller ONCS bit
+#define NVME_ID_CTRL_ONCS       520       // byte offset of ONCS
 
 // Queue sizes
 #define NVME_ADMIN_QUEUE_SIZE   64
@@ -61,6 +68,13 @@ typedef struct {
     uint32_t cdw15;
 } __attribute__((packed)) NVMeSubmissionEntry;
 
+// Dataset Management range descriptor
+typedef struct {
+    uint32_t cattr;     // Context Attributes
+    uint32_t nlb;       // Length in logical blocks
+    uint64_t slba;      // Starting LBA
+} __attribute__((packed)) NVMeDsmRange;
+
 // NVMe Completion Queue Entry
 typedef struct {
     uint32_t dw0;       // Command-specific
@@ -103,6 +117,7 @@ typedef struct {
     
     uint16_t next_cid;
     uint32_t namespace_size;
+    NVMeDsmRange* dsm_ranges;   // one page of ranges, NULL without DSM support
     int initialized;
 } NVMeController;
 
@@ -111,5 +126,6 @@ int NVMe_Init(void);
 void NVMe_Shutdown(void);
 int NVMe_ReadSectors(uint64_t lba, uint16_t count, void* buffer);
 int NVMe_WriteSectors(uint64_t lba, uint16_t count, const void* buffer);
+int NVMe_DeallocateSectors(uint64_t lba, uint64_t count);
 
 #endif // VOIDFRAME_NVME_H
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include <RamDisk.h>
+#include <Console.h>
+#include <DriveNaming.h>
+#include <MemOps.h>
+#include <Multiboot2.h>
+#include <PMem.h>
+#include <StringOps.h>
+#include <VMem.h>
+
+extern uint32_t g_multiboot_info_addr;
+
+static RamDisk g_ramdisks[RAMDISK_MAX_DISKS];
+static int g_ramdisk_count = 0;
+
+static int RamDiskReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, void* buffer) {
+    const RamDisk* rd = device->driver_data;
+    const uint64_t offset = start_lba * RAMDISK_BLOCK_SIZE;
+    const uint64_t bytes = (uint64_t)count * RAMDISK_BLOCK_SIZE;
+    if (!rd || offset > rd->size || bytes > rd->size - offset) return -1;
+    FastMemcpy(buffer, rd->base + offset, bytes);
+    return 0;
+}
+
+static int RamDiskWriteBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, const void* buffer) {
+    const RamDisk* rd = device->driver_data;
+    const uint64_t offset = start_lba * RAMDISK_BLOCK_SIZE;
+    const uint64_t bytes = (uint64_t)count * RAMDISK_BLOCK_SIZE;
+    if (!rd || offset > rd->size || bytes > rd->size - offset) return -1;
+    FastMemcpy(rd->base + offset, buffer, bytes);
+    return 0;
+}
+
+// Discarded blocks read back as zeroes, as with a fresh disk
+static int RamDiskDiscardBlocks(BlockDevice* device, uint64_t start_lba, uint64_t count) {
+    const RamDisk* rd = device->driver_data;
+    const uint64_t offset = start_lba * RAMDISK_BLOCK_SIZE;
+    if (!rd || offset > rd->size || count > (rd->size - offset) / RAMDISK_BLOCK_SIZE) return -1;
+    FastMemset(rd->base + offset, 0, count * RAMDISK_BLOCK_SIZE);
+    return 0;
+}
+
+BlockDevice* RamDiskCreate(uint64_t size, const void* image, uint64_t image_size) {
+    if (size < image_size) size = image_size;
+    size = (size + RAMDISK_BLOCK_SIZE - 1) & ~(uint64_t)(RAMDISK_BLOCK_SIZE - 1);
+    if (size == 0 || size > RAMDISK_MAX_SIZE) {
+        PrintKernelError("RamDisk: invalid size\n");
+        return NULL;
+    }
+    if (g_ramdisk_count >= RAMDISK_MAX_DISKS) {
+        PrintKernelError("RamDisk: too many ramdisks\n");
+        return NULL;
+    }
+
+    const uint64_t huge_pages = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE;
+    void* phys = AllocHugePages(huge_pages);
+    if (!phys) {
+        PrintKernelErrorF("RamDisk: no contiguous memory for %llu MiB\n",
+                          (unsigned long long)(huge_pages * 2));
+        return NULL;
+    }
+    if ((uint64_t)phys + huge_pages * HUGE_PAGE_SIZE > IDENTITY_MAP_SIZE) {
+        PrintKernelError("RamDisk: backing memory is outside the identity map\n");
+        FreeHugePages(phys, huge_pages);
+        return NULL;
+    }
+
+    RamDisk* rd = &g_ramdisks[g_ramdisk_count];
+    rd->base = (uint8_t*)phys;
+    rd->size = size;
+    rd->huge_pages = huge_pages;
+
+    if (image && image_size) FastMemcpy(rd->base, image, image_size);
+    FastMemset(rd->base + image_size, 0, size - image_size);
+
+    char name[16];
+    GenerateDriveNameInto(DEVICE_TYPE_RAMDISK, name);
+    BlockDevice* dev = BlockDeviceRegister(DEVICE_TYPE_RAMDISK, RAMDISK_BLOCK_SIZE,
+                                           size / RAMDISK_BLOCK_SIZE, name, rd,
+                                           RamDiskReadBlocks, RamDiskWriteBlocks);
+    if (!dev) {
+        FreeHugePages(phys, huge_pages);
+        return NULL;
+    }
+    dev->discard_blocks = RamDiskDiscardBlocks;
+    g_ramdisk_count++;
+
+    PrintKernelSuccessF("RamDisk: %s ready, %llu KiB%s\n", name, (unsigned long long)(size / 1024),
+                        image_size ? " (from image)" : "");
+    BlockDeviceDetectAndRegisterPartitions(dev);
+    return dev;
+}
+
+int RamDiskIsModule(const char* cmdline) {
+    const size_t len = sizeof(RAMDISK_MODULE_PREFIX) - 1;
+    if (!cmdline || FastStrnCmp(cmdline, RAMDISK_MODULE_PREFIX, len) != 0) return 0;
+    return cmdline[len] == '\0' || cmdline[len] == ':';
+}
+
+// Parses "<n>[K|M|G]" into bytes
+static uint64_t ParseSize(const char* s) {
+    uint64_t value = 0;
+    while (*s >= '0' && *s <= '9') value = value * 10 + (uint64_t)(*s++ - '0');
+    if (*s == 'k' || *s == 'K') value <<= 10;
+    else if (*s == 'm' || *s == 'M') value <<= 20;
+    else if (*s == 'g' || *s == 'G') value <<= 30;
+    return value;
+}
+
+static void RamDiskFromCmdline(const char* cmdline) {
+    const size_t opt_len = sizeof(RAMDISK_CMDLINE_OPTION) - 1;
+    for (const char* p = cmdline; *p; p++) {
+        if ((p == cmdline || p[-1] == ' ') && FastStrnCmp(p, RAMDISK_CMDLINE_OPTION, opt_len) == 0) {
+            const uint64_t size = ParseSize(p + opt_len);
+            if (size) RamDiskCreate(size, NULL, 0);
+        }
+    }
+}
+
+void RamDiskInit(void) {
+    if (!g_multiboot_info_addr) return;
+
+    struct MultibootTag* tag = (struct MultibootTag*)(uintptr_t)(g_multiboot_info_addr + 8);
+    for (; tag->type != MULTIBOOT2_TAG_TYPE_END;
+         tag = (struct MultibootTag*)((uint8_t*)tag + ((tag->size + 7) & ~7))) {
+        if (tag->type == MULTIBOOT2_TAG_TYPE_CMDLINE) {
+            RamDiskFromCmdline((const char*)(tag + 1));
+        } else if (tag->type == MULTIBOOT2_TAG_TYPE_MODULE) {
+            struct MultibootModuleTag* mod = (struct MultibootModuleTag*)tag;
+            if (!RamDiskIsModule(mod->cmdline) || mod->mod_end <= mod->mod_start) continue;
+            PrintKernelF("RamDisk: loading image module '%s'\n", mod->cmdline);
+            const void* image = (const void*)(uintptr_t)mod->mod_start;
+            RamDiskCreate(0, image, mod->mod_end - mod->mod_start);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef VOIDFRAME_RAMDISK_H
+#define VOIDFRAME_RAMDISK_H
+
+#include <BlockDevice.h>
+#include <stdint.h>
+
+#define RAMDISK_BLOCK_SIZE      512
+#define RAMDISK_MAX_DISKS       4
+#define RAMDISK_MAX_SIZE        (4ULL * 1024 * 1024 * 1024)
+
+// Kernel command line option ("ramdisk=64M") creating an empty disk, and
+// the prefix of multiboot module command lines that are loaded as disk
+// images ("ramdisk" or "ramdisk:<label>") instead of being copied to the VFS.
+#define RAMDISK_CMDLINE_OPTION  "ramdisk="
+#define RAMDISK_MODULE_PREFIX   "ramdisk"
+
+typedef struct {
+    uint8_t* base;          // identity-mapped start of the huge-page backing
+    uint64_t size;          // bytes exposed through the block device
+    uint64_t huge_pages;    // 2 MiB pages allocated for base
+} RamDisk;
+
+// Creates a ramdisk of at least `size` bytes, optionally pre-filled from
+// `image`. Returns the registered device or NULL.
+BlockDevice* RamDiskCreate(uint64_t size, const void* image, uint64_t image_size);
+
+// Creates ramdisks requested on the kernel command line and from
+// multiboot modules.
+void RamDiskInit(void);
+
+int RamDiskIsModule(const char* cmdline);
+
+#endif // VOIDFRAME_RAMDISK_H
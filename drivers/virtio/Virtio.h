@@ -61,6 +61,7 @@ struct VirtioPciCommonCfg {
 
 // VirtIO Block Device Feature Bits
 #define VIRTIO_BLK_F_RO 5 // Device is read-only
+#define VIRTIO_BLK_F_DISCARD 13 // Device can handle VIRTIO_BLK_T_DISCARD
 
 // --- Virtqueue Structures ---
 
@@ -95,6 +96,7 @@ struct VirtqUsed {
 
 #define VIRTIO_BLK_T_IN  0 // Read request
 #define VIRTIO_BLK_T_OUT 1 // Write request
+#define VIRTIO_BLK_T_DISCARD 11 // Discard request
 
 struct VirtioBlkReq {
     uint32_t type;
@@ -102,5 +104,12 @@ struct VirtioBlkReq {
     uint64_t sector;
 } __attribute__((packed));
 
+// Data segment of a VIRTIO_BLK_T_DISCARD request
+struct VirtioBlkDiscardWriteZeroes {
+    uint64_t sector;
+    uint32_t num_sectors;
+    uint32_t flags;
+} __attribute__((packed));
+
 
 #endif //VOIDFRAME_VIRTIO_H
@@ -24,6 +24,7 @@ static struct VirtqUsed* vq_used_ring;
 static uint16_t vq_size;
 static uint16_t vq_next_desc_idx = 0;
 static uint16_t last_used_idx = 0;
+static bool have_discard = false;
 
 // A structure to keep track of pending requests
 struct VirtioBlkRequest {
@@ -40,6 +41,7 @@ volatile struct VirtioPciCommonCfg* common_cfg_ptr;
 // Forward declarations
 static int VirtioBlk_ReadBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint32_t count, void* buffer);
 static int VirtioBlk_WriteBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint32_t count, const void* buffer);
+static int VirtioBlk_DiscardBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint64_t count);
 
 void ReadVirtioCapability(PciDevice device, uint8_t cap_offset, struct VirtioPciCap* cap) {
     // cap->cap_vndr is known to be 0x09, not reading
@@ -62,6 +64,11 @@ static int VirtioBlk_WriteBlocksWrapper(struct BlockDevice* device, uint64_t sta
     return VirtioBlkWrite(start_lba, (void*)buffer, count);
 }
 
+static int VirtioBlk_DiscardBlocksWrapper(struct BlockDevice* device, uint64_t start_lba, uint64_t count) {
+    (void)device;
+    return VirtioBlkDiscard(start_lba, count);
+}
+
 // Implementation for the VirtIO Block device driver.
 
 void InitializeVirtioBlk(PciDevice device) {
@@ -188,8 +195,11 @@ void InitializeVirtioBlk(PciDevice device) {
     PrintKernelHex(device_features);
     PrintKernel("\n");
     
+    // The only optional feature we drive is discard
+    uint32_t driver_features = device_features & (1U << VIRTIO_BLK_F_DISCARD);
     common_cfg_ptr->driver_feature_select = 0;
-    common_cfg_ptr->driver_feature = 0;
+    common_cfg_ptr->driver_feature = driver_features;
+    have_discard = driver_features != 0;
     PrintKernel("VirtIO-Blk: Features negotiated\n");
 
     // 5. Set FEATURES_OK status bit
@@ -278,6 +288,10 @@ void InitializeVirtioBlk(PciDevice device) {
         PrintKernel("VirtIO-Blk: Registered block device: ");
         PrintKernel(dev_name);
         PrintKernel("\n");
+        if (have_discard) {
+            dev->discard_blocks = VirtioBlk_DiscardBlocksWrapper;
+            PrintKernel("VirtIO-Blk: Discard supported\n");
+        }
         BlockDeviceDetectAndRegisterPartitions(dev);
     } else {
         PrintKernel("VirtIO-Blk: Failed to register block device\n");
@@ -427,3 +441,89 @@ int VirtioBlkWrite(uint64_t sector, void* buffer, uint32_t count) {
     
     return result;
 }
+
+// Sends one VIRTIO_BLK_T_DISCARD request per segment. max_discard_sectors
+// lives in the device config space we don't map, so segments stay small
+// enough for any sane device.
+#define VIRTIO_BLK_DISCARD_MAX_SECTORS (1U << 22)
+
+int VirtioBlkDiscard(uint64_t sector, uint64_t count) {
+    if (!virtio_lock || !common_cfg_ptr || !have_discard) return -1;
+
+    rust_spinlock_lock(virtio_lock);
+
+    struct VirtioBlkReq* req = VMemAlloc(sizeof(struct VirtioBlkReq));
+    struct VirtioBlkDiscardWriteZeroes* seg = VMemAlloc(sizeof(struct VirtioBlkDiscardWriteZeroes));
+    uint8_t* status = VMemAlloc(1);
+
+    if (!req || !seg || !status) {
+        if (req) VMemFree(req, sizeof(struct VirtioBlkReq));
+        if (seg) VMemFree(seg, sizeof(struct VirtioBlkDiscardWriteZeroes));
+        if (status) VMemFree(status, 1);
+        rust_spinlock_unlock(virtio_lock);
+        return -1;
+    }
+
+    int result = 0;
+    while (count > 0 && result == 0) {
+        const uint32_t n = count > VIRTIO_BLK_DISCARD_MAX_SECTORS ? VIRTIO_BLK_DISCARD_MAX_SECTORS : (uint32_t)count;
+
+        req->type = VIRTIO_BLK_T_DISCARD;
+        req->reserved = 0;
+        req->sector = 0;
+        seg->sector = sector;
+        seg->num_sectors = n;
+        seg->flags = 0;
+        *status = 0xFF;
+
+        uint16_t desc_idx = vq_next_desc_idx;
+
+        // Descriptor 0: Request header (device reads)
+        vq_desc_table[desc_idx].addr = VMemGetPhysAddr((uint64_t)req);
+        vq_desc_table[desc_idx].len = sizeof(struct VirtioBlkReq);
+        vq_desc_table[desc_idx].flags = VIRTQ_DESC_F_NEXT;
+        vq_desc_table[desc_idx].next = (desc_idx + 1) % vq_size;
+
+        // Descriptor 1: Discard segment (device reads)
+        vq_desc_table[(desc_idx + 1) % vq_size].addr = VMemGetPhysAddr((uint64_t)seg);
+        vq_desc_table[(desc_idx + 1) % vq_size].len = sizeof(struct VirtioBlkDiscardWriteZeroes);
+        vq_desc_table[(desc_idx + 1) % vq_size].flags = VIRTQ_DESC_F_NEXT;
+        vq_desc_table[(desc_idx + 1) % vq_size].next = (desc_idx + 2) % vq_size;
+
+        // Descriptor 2: Status byte (device writes)
+        vq_desc_table[(desc_idx + 2) % vq_size].addr = VMemGetPhysAddr((uint64_t)status);
+        vq_desc_table[(desc_idx + 2) % vq_size].len = 1;
+        vq_desc_table[(desc_idx + 2) % vq_size].flags = VIRTQ_DESC_F_WRITE;
+        vq_desc_table[(desc_idx + 2) % vq_size].next = 0;
+
+        uint16_t avail_idx = vq_avail_ring->idx % vq_size;
+        vq_avail_ring->ring[avail_idx] = desc_idx;
+        vq_avail_ring->idx++;
+
+        __asm__ volatile("" ::: "memory");
+        if (notify_ptr) { *notify_ptr = 0; }
+
+        uint64_t spins = 0, max_spins = 10000000;
+        while (vq_used_ring->idx == last_used_idx && spins++ < max_spins) {
+            __asm__ volatile("pause");
+        }
+        if (vq_used_ring->idx == last_used_idx) {
+            result = -1;
+            break;
+        }
+
+        last_used_idx = vq_used_ring->idx;
+        vq_next_desc_idx = (desc_idx + 3) % vq_size;
+
+        if (*status != 0) result = -1;
+        sector += n;
+        count -= n;
+    }
+
+    VMemFree(req, sizeof(struct VirtioBlkReq));
+    VMemFree(seg, sizeof(struct VirtioBlkDiscardWriteZeroes));
+    VMemFree(status, 1);
+    rust_spinlock_unlock(virtio_lock);
+
+    return result;
+}
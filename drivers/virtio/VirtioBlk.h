@@ -7,4 +7,5 @@
 void InitializeVirtioBlk(PciDevice device);
 int VirtioBlkRead(uint64_t sector, void* buffer, uint32_t count);
 int VirtioBlkWrite(uint64_t sector, void* buffer, uint32_t count);
+int VirtioBlkDiscard(uint64_t sector, uint64_t count);
 #endif //VOIDFRAME_VIRTIOBLK_H
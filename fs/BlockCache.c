@@ -0,0 +1,1000 @@
+#include <BlockCache.h>
+#include <Console.h>
+#include <IoScheduler.h>
+#include <KernelHeap.h>
+#include <MemOps.h>
+#include <Scheduler.h>
+#include <SpinlockRust.h>
+#include <TSC.h>
+
+// 2Q queues: A1in holds blocks touched once (FIFO), Am holds blocks that
+// were re-referenced after leaving A1in (LRU). A1out remembers the keys of
+// blocks recently evicted from A1in so a second touch promotes to Am.
+#define BH_QUEUE_NONE   0
+#define BH_QUEUE_A1IN   1
+#define BH_QUEUE_AM     2
+
+typedef struct {
+    BufferHead* head;   // most recent
+    BufferHead* tail;   // next victim
+    uint32_t count;
+} BhList;
+
+typedef struct {
+    int device_id;
+    uint64_t lba;
+} GhostEntry;
+
+static BufferHead g_heads[BLOCK_CACHE_MAX_BUFFERS];
+static BufferHead* g_hash[BLOCK_CACHE_HASH_BUCKETS];
+static BufferHead* g_free_heads = NULL;
+static BhList g_a1in;
+static BhList g_am;
+
+static GhostEntry g_ghost[BLOCK_CACHE_GHOST_ENTRIES];
+static uint32_t g_ghost_next = 0;
+static uint32_t g_ghost_count = 0;
+
+static BufferHead* g_sync_list[BLOCK_CACHE_MAX_BUFFERS];
+static BlockRequest g_sync_reqs[BLOCK_CACHE_MAX_BUFFERS];
+static uint32_t g_dirty_count = 0;
+static uint64_t g_oldest_dirty = 0;
+static int g_writeback_busy = 0;    // a sync or discard pass owns g_sync_* and runs unlocked
+
+typedef struct {
+    int device_id;
+    uint64_t last;      // last unit read by the stream
+    uint64_t ra_end;    // first unit past everything prefetched so far
+    uint64_t marker;    // reaching this unit triggers the next window
+    uint32_t window;    // units; 0 until the stream proves sequential
+} RaStream;
+
+static RaStream g_streams[BLOCK_CACHE_RA_STREAMS];
+static uint32_t g_stream_next = 0;
+static BufferHead* g_ra_heads[BLOCK_CACHE_RA_MAX_UNITS + 1];  // + the demand unit
+static BlockRequest g_ra_reqs[BLOCK_CACHE_RA_MAX_UNITS + 1];
+static int g_ra_busy = 0;           // a prefetch batch owns g_ra_* and runs unlocked
+
+typedef struct {
+    int device_id;
+    uint64_t lba;
+    uint64_t count;
+} DiscardExtent;
+
+static DiscardExtent g_discards[BLOCK_CACHE_DISCARD_EXTENTS];
+static uint32_t g_discard_count = 0;
+static uint64_t g_oldest_discard = 0;
+static DiscardExtent g_discard_inflight;    // count == 0 when idle
+
+// Device transfers that go around the cache. Misses inside an in-flight
+// write wait for it instead of caching blocks that are about to change, and
+// reclaim leaves units under an in-flight read alone so the read's overlay
+// still finds anything newer than what it got from the disk.
+typedef struct {
+    int device_id;
+    int write;
+    uint64_t lba;
+    uint64_t count;     // 0: free slot
+} ThroughRange;
+
+static ThroughRange g_through[BLOCK_CACHE_THROUGH_SLOTS];
+
+static BlockCacheStats g_stats;
+static RustSpinLock* g_cache_lock = NULL;
+static int g_cache_ready = 0;
+
+static inline int BlockCacheUsable(const BlockDevice* dev) {
+    return g_cache_ready && dev->block_size &&
+           dev->block_size <= BLOCK_CACHE_UNIT_SIZE &&
+           (BLOCK_CACHE_UNIT_SIZE % dev->block_size) == 0;
+}
+
+static inline uint32_t UnitSectors(const BlockDevice* dev) {
+    return BLOCK_CACHE_UNIT_SIZE / dev->block_size;
+}
+
+static inline uint32_t HashIndex(int device_id, uint64_t unit_lba) {
+    uint64_t key = (unit_lba >> 3) ^ ((uint64_t)device_id * 0x9E3779B1ULL);
+    key ^= key >> 17;
+    return (uint32_t)(key % BLOCK_CACHE_HASH_BUCKETS);
+}
+
+static BufferHead* HashLookup(int device_id, uint64_t unit_lba) {
+    BufferHead* bh = g_hash[HashIndex(device_id, unit_lba)];
+    while (bh) {
+        if (bh->device_id == device_id && bh->lba == unit_lba) return bh;
+        bh = bh->hash_next;
+    }
+    return NULL;
+}
+
+static void HashInsert(BufferHead* bh) {
+    uint32_t idx = HashIndex(bh->device_id, bh->lba);
+    bh->hash_next = g_hash[idx];
+    g_hash[idx] = bh;
+}
+
+static void HashRemove(BufferHead* bh) {
+    BufferHead** link = &g_hash[HashIndex(bh->device_id, bh->lba)];
+    while (*link) {
+        if (*link == bh) {
+            *link = bh->hash_next;
+            bh->hash_next = NULL;
+            return;
+        }
+        link = &(*link)->hash_next;
+    }
+}
+
+static void ListPushFront(BhList* list, BufferHead* bh) {
+    bh->prev = NULL;
+    bh->next = list->head;
+    if (list->head) list->head->prev = bh;
+    list->head = bh;
+    if (!list->tail) list->tail = bh;
+    list->count++;
+}
+
+static void ListRemove(BhList* list, BufferHead* bh) {
+    if (bh->prev) bh->prev->next = bh->next;
+    else list->head = bh->next;
+    if (bh->next) bh->next->prev = bh->prev;
+    else list->tail = bh->prev;
+    bh->prev = bh->next = NULL;
+    list->count--;
+}
+
+static BhList* QueueOf(const BufferHead* bh) {
+    if (bh->queue == BH_QUEUE_A1IN) return &g_a1in;
+    if (bh->queue == BH_QUEUE_AM) return &g_am;
+    return NULL;
+}
+
+static int GhostFind(int device_id, uint64_t unit_lba) {
+    for (uint32_t i = 0; i < g_ghost_count; i++) {
+        if (g_ghost[i].device_id == device_id && g_ghost[i].lba == unit_lba) return (int)i;
+    }
+    return -1;
+}
+
+static void GhostAdd(int device_id, uint64_t unit_lba) {
+    g_ghost[g_ghost_next].device_id = device_id;
+    g_ghost[g_ghost_next].lba = unit_lba;
+    g_ghost_next = (g_ghost_next + 1) % BLOCK_CACHE_GHOST_ENTRIES;
+    if (g_ghost_count < BLOCK_CACHE_GHOST_ENTRIES) g_ghost_count++;
+}
+
+static void MarkDirtyLocked(BufferHead* bh) {
+    if (bh->flags & BH_DIRTY) return;
+    bh->flags |= BH_DIRTY;
+    bh->dirty_since = GetTimeInMs();
+    if (g_dirty_count++ == 0) g_oldest_dirty = bh->dirty_since;
+}
+
+// Device I/O never runs under g_cache_lock. Whoever has to wait for an
+// in-flight unit or pass drops the lock, gives up the CPU and takes the lock
+// back; anything looked up before the wait must be looked up again.
+static void WaitLocked(void) {
+    rust_spinlock_unlock(g_cache_lock);
+    Yield();
+    __asm__ volatile("pause");
+    rust_spinlock_lock(g_cache_lock);
+}
+
+static int ThroughOverlapLocked(int device_id, uint64_t lba, uint64_t count, int writes_only) {
+    for (uint32_t i = 0; i < BLOCK_CACHE_THROUGH_SLOTS; i++) {
+        const ThroughRange* t = &g_through[i];
+        if (!t->count || t->device_id != device_id || (writes_only && !t->write)) continue;
+        if (t->lba < lba + count && lba < t->lba + t->count) return 1;
+    }
+    return 0;
+}
+
+// device_id < 0 matches any device
+static int ThroughWriteActiveLocked(int device_id) {
+    for (uint32_t i = 0; i < BLOCK_CACHE_THROUGH_SLOTS; i++) {
+        const ThroughRange* t = &g_through[i];
+        if (t->count && t->write && (device_id < 0 || t->device_id == device_id)) return 1;
+    }
+    return 0;
+}
+
+static ThroughRange* ThroughSlotLocked(void) {
+    for (uint32_t i = 0; i < BLOCK_CACHE_THROUGH_SLOTS; i++) {
+        if (!g_through[i].count) return &g_through[i];
+    }
+    return NULL;
+}
+
+static void DetachLocked(BufferHead* bh) {
+    BhList* list = QueueOf(bh);
+    if (list) ListRemove(list, bh);
+    HashRemove(bh);
+    if (bh->flags & BH_DIRTY) g_dirty_count--;
+    bh->queue = BH_QUEUE_NONE;
+    bh->flags = 0;
+}
+
+// Only clean, unreferenced units are taken; dirty ones wait for write-back
+// (in-flight units always hold a reference).
+static BufferHead* ScanForVictim(BhList* list) {
+    for (BufferHead* bh = list->tail; bh; bh = bh->prev) {
+        if (bh->refcount || (bh->flags & BH_DIRTY)) continue;
+        if (ThroughOverlapLocked(bh->device_id, bh->lba, bh->sectors, 0)) continue;
+        return bh;
+    }
+    return NULL;
+}
+
+static BufferHead* ReclaimLocked(void) {
+    const uint32_t a1in_target = BLOCK_CACHE_MAX_BUFFERS * BLOCK_CACHE_A1IN_PERCENT / 100;
+    BufferHead* victim = NULL;
+
+    if (g_a1in.count > a1in_target || g_am.count == 0) {
+        victim = ScanForVictim(&g_a1in);
+        if (!victim) victim = ScanForVictim(&g_am);
+    } else {
+        victim = ScanForVictim(&g_am);
+        if (!victim) victim = ScanForVictim(&g_a1in);
+    }
+    if (!victim) return NULL;
+
+    if (victim->queue == BH_QUEUE_A1IN) GhostAdd(victim->device_id, victim->lba);
+    DetachLocked(victim);
+    g_stats.evictions++;
+    g_stats.buffers--;
+    return victim;
+}
+
+static BufferHead* AllocHeadLocked(void) {
+    BufferHead* bh = g_free_heads;
+    if (bh) {
+        g_free_heads = bh->next;
+        bh->next = NULL;
+        if (!bh->data) {
+            bh->data = KernelMemoryAlloc(BLOCK_CACHE_UNIT_SIZE);
+            if (!bh->data) {
+                bh->next = g_free_heads;
+                g_free_heads = bh;
+                return ReclaimLocked();
+            }
+        }
+        return bh;
+    }
+    return ReclaimLocked();
+}
+
+static void FreeHeadLocked(BufferHead* bh) {
+    bh->next = g_free_heads;
+    g_free_heads = bh;
+}
+
+static void InitHead(BufferHead* bh, const BlockDevice* dev, uint64_t unit_lba) {
+    uint32_t sectors = UnitSectors(dev);
+    if (dev->total_blocks && unit_lba + sectors > dev->total_blocks) {
+        sectors = (uint32_t)(dev->total_blocks - unit_lba);
+    }
+    bh->device_id = dev->id;
+    bh->lba = unit_lba;
+    bh->sectors = sectors;
+    bh->block_size = dev->block_size;
+    bh->refcount = 0;
+    bh->flags = 0;
+}
+
+static void InsertLocked(BufferHead* bh, uint8_t queue) {
+    bh->queue = queue;
+    ListPushFront(queue == BH_QUEUE_AM ? &g_am : &g_a1in, bh);
+    HashInsert(bh);
+    g_stats.buffers++;
+}
+
+// Forgets a cached unit without writing it back
+static void DropLocked(BufferHead* bh) {
+    DetachLocked(bh);
+    bh->device_id = -1;
+    g_stats.buffers--;
+    FreeHeadLocked(bh);
+}
+
+static int SyncLocked(int device_id);
+
+// Returns a referenced buffer for the unit containing `lba`. With fill == 0
+// the data is not read from the device; the caller promises to overwrite the
+// whole unit before dropping the lock. A miss inserts the unit BH_LOCKED and
+// reads it with the lock dropped, so other users of the unit wait for it.
+static BufferHead* GetLocked(BlockDevice* dev, uint64_t lba, int fill) {
+    const uint32_t spu = UnitSectors(dev);
+    const uint64_t unit_lba = lba - (lba % spu);
+    int synced = 0;
+
+    for (;;) {
+        BufferHead* bh = HashLookup(dev->id, unit_lba);
+        if (bh) {
+            if ((bh->flags & (BH_LOCKED | BH_VALID)) == BH_LOCKED) {
+                WaitLocked(); // still being read in
+                continue;
+            }
+            g_stats.hits++;
+            if (bh->flags & BH_READAHEAD) {
+                bh->flags &= ~BH_READAHEAD;
+                g_stats.readahead_hits++;
+            }
+            if (bh->queue == BH_QUEUE_AM && g_am.head != bh) {
+                ListRemove(&g_am, bh);
+                ListPushFront(&g_am, bh);
+            }
+            bh->refcount++;
+            return bh;
+        }
+
+        if (ThroughOverlapLocked(dev->id, unit_lba, spu, 1)) {
+            WaitLocked();
+            continue;
+        }
+
+        bh = AllocHeadLocked();
+        if (!bh) {
+            // Everything unreferenced is dirty: write back once and retry
+            if (synced || !g_dirty_count) return NULL;
+            synced = 1;
+            SyncLocked(-1);
+            continue;
+        }
+
+        g_stats.misses++;
+        InitHead(bh, dev, unit_lba);
+        int ghost = GhostFind(dev->id, unit_lba);
+        if (ghost >= 0) {
+            g_stats.ghost_hits++;
+            g_ghost[ghost].device_id = -1;
+        }
+        InsertLocked(bh, ghost >= 0 ? BH_QUEUE_AM : BH_QUEUE_A1IN);
+        bh->refcount++;
+        if (!fill) return bh;
+
+        bh->flags |= BH_LOCKED;
+        rust_spinlock_unlock(g_cache_lock);
+        const int rc = BlockDeviceRead(dev->id, unit_lba, bh->sectors, bh->data);
+        rust_spinlock_lock(g_cache_lock);
+        bh->flags &= ~BH_LOCKED;
+        if (rc != 0) {
+            bh->refcount = 0;
+            DropLocked(bh);
+            return NULL;
+        }
+        bh->flags |= BH_VALID;
+        return bh;
+    }
+}
+
+// Reads the missing units in [from, limit) as one batch; the I/O scheduler
+// merges them into as few driver calls as possible. If the unit being read
+// (`demand`) missed too it leads the batch, so the device sees one ascending
+// run instead of the window followed by a seek back; it is then returned
+// referenced like GetLocked would. The units are inserted BH_LOCKED before
+// the lock is dropped for the I/O, so readers of them wait for the batch
+// instead of issuing their own reads. Prefetched units enter A1in like any
+// first-touch block, so an abandoned stream ages out quickly.
+static BufferHead* PrefetchLocked(BlockDevice* dev, uint64_t demand, uint64_t from, uint64_t limit) {
+    const uint32_t spu = UnitSectors(dev);
+    BufferHead* demand_bh = NULL;
+    uint32_t n = 0;
+
+    if (g_ra_busy) return NULL; // readahead is a hint; skip rather than wait
+    if (!HashLookup(dev->id, demand) && !ThroughOverlapLocked(dev->id, demand, spu, 1)) {
+        demand_bh = AllocHeadLocked();
+        if (demand_bh) {
+            g_stats.misses++;
+            InitHead(demand_bh, dev, demand);
+            int ghost = GhostFind(dev->id, demand);
+            if (ghost >= 0) {
+                g_stats.ghost_hits++;
+                g_ghost[ghost].device_id = -1;
+            }
+            demand_bh->flags = BH_LOCKED;
+            demand_bh->refcount = 1;
+            InsertLocked(demand_bh, ghost >= 0 ? BH_QUEUE_AM : BH_QUEUE_A1IN);
+            g_ra_heads[n] = demand_bh;
+            g_ra_reqs[n] = (BlockRequest){.op = BIO_READ, .lba = demand, .count = demand_bh->sectors,
+                                          .buffer = demand_bh->data};
+            n++;
+        }
+    }
+    for (uint64_t unit = from; unit < limit && n < BLOCK_CACHE_RA_MAX_UNITS + (demand_bh != NULL);
+         unit += spu) {
+        if (dev->total_blocks && unit >= dev->total_blocks) break;
+        if (HashLookup(dev->id, unit)) continue;
+        if (ThroughOverlapLocked(dev->id, unit, spu, 1)) break;
+        BufferHead* bh = AllocHeadLocked();
+        if (!bh) break;
+        InitHead(bh, dev, unit);
+        bh->flags = BH_LOCKED;
+        bh->refcount = 1;
+        InsertLocked(bh, BH_QUEUE_A1IN);
+        g_ra_heads[n] = bh;
+        g_ra_reqs[n] = (BlockRequest){.op = BIO_READ, .lba = unit, .count = bh->sectors, .buffer = bh->data};
+        n++;
+    }
+    if (n == 0) return NULL;
+
+    g_ra_busy = 1;
+    rust_spinlock_unlock(g_cache_lock);
+    IoSubmit(dev, g_ra_reqs, n);
+    rust_spinlock_lock(g_cache_lock);
+    g_ra_busy = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        BufferHead* bh = g_ra_heads[i];
+        bh->refcount = 0;
+        if (g_ra_reqs[i].status != 0) {
+            if (bh == demand_bh) demand_bh = NULL;
+            DropLocked(bh);
+            continue;
+        }
+        if (bh == demand_bh) {
+            bh->flags = BH_VALID;
+            bh->refcount = 1;
+            continue;
+        }
+        bh->flags = BH_VALID | BH_READAHEAD;
+        g_stats.readahead++;
+    }
+    return demand_bh;
+}
+
+// Called for every unit a cached read touches. A unit that directly follows
+// the previous one on the same device continues a stream; the first
+// continuation prefetches the minimum window, and from then on every miss
+// or arrival at the start of the last prefetched window doubles the window
+// and fetches the next one, keeping a full window ahead of the reader.
+// Returns the referenced unit when it was read as part of the batch, NULL
+// when the caller still has to look it up.
+static BufferHead* ReadaheadLocked(BlockDevice* dev, uint64_t unit) {
+    const uint32_t spu = UnitSectors(dev);
+    RaStream* s = NULL;
+
+    for (uint32_t i = 0; i < BLOCK_CACHE_RA_STREAMS; i++) {
+        RaStream* c = &g_streams[i];
+        if (c->device_id != dev->id) continue;
+        if (c->last == unit) return NULL; // several small blocks inside one unit
+        if (c->last + spu == unit) {
+            s = c;
+            break;
+        }
+    }
+
+    if (!s) {
+        s = &g_streams[g_stream_next];
+        g_stream_next = (g_stream_next + 1) % BLOCK_CACHE_RA_STREAMS;
+        s->device_id = dev->id;
+        s->last = unit;
+        s->ra_end = unit + spu;
+        s->marker = 0;
+        s->window = 0;
+        return NULL;
+    }
+
+    s->last = unit;
+    if (s->window == 0) {
+        s->window = BLOCK_CACHE_RA_MIN_UNITS;
+    } else {
+        if (HashLookup(dev->id, unit) && unit < s->marker) return NULL;
+        if (s->window < BLOCK_CACHE_RA_MAX_UNITS) s->window *= 2;
+    }
+
+    const uint64_t from = s->ra_end > unit + spu ? s->ra_end : unit + spu;
+    const uint64_t limit = unit + spu + (uint64_t)s->window * spu;
+    if (from >= limit) return NULL;
+
+    s->ra_end = limit;
+    s->marker = from;
+    return PrefetchLocked(dev, unit, from, limit);
+}
+
+static void SortByLocation(BufferHead** list, uint32_t n) {
+    for (uint32_t gap = n / 2; gap > 0; gap /= 2) {
+        for (uint32_t i = gap; i < n; i++) {
+            BufferHead* tmp = list[i];
+            uint32_t j = i;
+            while (j >= gap && (list[j - gap]->device_id > tmp->device_id ||
+                   (list[j - gap]->device_id == tmp->device_id && list[j - gap]->lba > tmp->lba))) {
+                list[j] = list[j - gap];
+                j -= gap;
+            }
+            list[j] = tmp;
+        }
+    }
+}
+
+// device_id < 0 syncs every device. The dirty units are marked BH_LOCKED
+// and clean before the lock is dropped for the I/O; a unit dirtied again
+// meanwhile stays dirty, and a failed write re-dirties it.
+static int SyncLocked(int device_id) {
+    while (g_writeback_busy || ThroughWriteActiveLocked(device_id)) WaitLocked();
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < BLOCK_CACHE_MAX_BUFFERS; i++) {
+        BufferHead* bh = &g_heads[i];
+        if (!(bh->flags & BH_DIRTY)) continue;
+        if (device_id >= 0 && bh->device_id != device_id) continue;
+        g_sync_list[n++] = bh;
+    }
+    if (n == 0) return 0;
+
+    SortByLocation(g_sync_list, n);
+    for (uint32_t k = 0; k < n; k++) {
+        BufferHead* bh = g_sync_list[k];
+        bh->flags = (bh->flags | BH_LOCKED) & ~BH_DIRTY;
+        bh->refcount++;
+        g_dirty_count--;
+        g_sync_reqs[k] = (BlockRequest){.op = BIO_WRITE, .lba = bh->lba, .count = bh->sectors,
+                                        .buffer = bh->data, .status = -1};
+    }
+    g_writeback_busy = 1;
+    rust_spinlock_unlock(g_cache_lock);
+
+    // Submit each device's dirty units as one batch so the I/O scheduler
+    // can merge neighbouring units into larger writes.
+    int result = 0;
+    uint32_t i = 0;
+    while (i < n) {
+        const int dev_id = g_sync_list[i]->device_id;
+        uint32_t j = i;
+        while (j < n && g_sync_list[j]->device_id == dev_id) j++;
+
+        BlockDevice* dev = BlockDeviceGet(dev_id);
+        if (!dev || IoSubmit(dev, &g_sync_reqs[i], j - i) != 0) result = -1;
+        i = j;
+    }
+
+    rust_spinlock_lock(g_cache_lock);
+    g_writeback_busy = 0;
+    for (uint32_t k = 0; k < n; k++) {
+        BufferHead* bh = g_sync_list[k];
+        bh->flags &= ~BH_LOCKED;
+        bh->refcount--;
+        if (g_sync_reqs[k].status == 0) {
+            g_stats.writebacks++;
+        } else {
+            MarkDirtyLocked(bh);
+        }
+    }
+    if (g_dirty_count) g_oldest_dirty = GetTimeInMs();
+    return result;
+}
+
+// Removes [lba, lba + count) from the device's pending discards because
+// those blocks are being written again.
+static void DiscardCancelLocked(int device_id, uint64_t lba, uint64_t count) {
+    const uint64_t end = lba + count;
+    uint32_t i = 0;
+    while (i < g_discard_count) {
+        DiscardExtent* ext = &g_discards[i];
+        const uint64_t ext_end = ext->lba + ext->count;
+        if (ext->device_id != device_id || ext_end <= lba || ext->lba >= end) {
+            i++;
+        } else if (ext->lba >= lba && ext_end <= end) {
+            *ext = g_discards[--g_discard_count];
+        } else if (ext->lba < lba && ext_end > end) {
+            // Split; without a free slot the tail just isn't discarded
+            ext->count = lba - ext->lba;
+            if (g_discard_count < BLOCK_CACHE_DISCARD_EXTENTS) {
+                g_discards[g_discard_count++] = (DiscardExtent){device_id, end, ext_end - end};
+            }
+            i++;
+        } else if (ext->lba < lba) {
+            ext->count = lba - ext->lba;
+            i++;
+        } else {
+            ext->lba = end;
+            ext->count = ext_end - end;
+            i++;
+        }
+    }
+}
+
+// device_id < 0 flushes every device. Dirty units are written back first
+// so nothing overlapping a discarded range reaches the disk after it; the
+// pass then holds off write-back and uncached writes to the extent being
+// discarded while the lock is dropped for the command.
+static int DiscardFlushLocked(int device_id) {
+    if (g_discard_count == 0) return 0;
+    int result = SyncLocked(device_id);
+
+    while (g_writeback_busy) WaitLocked();
+    g_writeback_busy = 1;
+    uint32_t i = 0;
+    while (i < g_discard_count) {
+        const DiscardExtent ext = g_discards[i];
+        if (device_id >= 0 && ext.device_id != device_id) {
+            i++;
+            continue;
+        }
+        g_discards[i] = g_discards[--g_discard_count];
+        g_discard_inflight = ext;
+        rust_spinlock_unlock(g_cache_lock);
+        const int rc = BlockDeviceDiscard(ext.device_id, ext.lba, ext.count);
+        rust_spinlock_lock(g_cache_lock);
+        g_discard_inflight.count = 0;
+        if (rc != 0) {
+            result = -1;
+            continue;
+        }
+        g_stats.discards++;
+        g_stats.discard_sectors += ext.count;
+    }
+    g_writeback_busy = 0;
+    if (g_discard_count) g_oldest_discard = GetTimeInMs();
+    return result;
+}
+
+// Flushing is opportunistic here: if another pass is already running, the
+// buffers are left for it or the next caller.
+static void MaybeFlushLocked(void) {
+    if (g_writeback_busy) return;
+    const uint64_t now = GetTimeInMs();
+    if (g_dirty_count && (g_dirty_count >= BLOCK_CACHE_DIRTY_HIGH ||
+                          now - g_oldest_dirty >= BLOCK_CACHE_WRITEBACK_MS)) {
+        SyncLocked(-1);
+    }
+    if (g_discard_count && !g_writeback_busy &&
+        now - g_oldest_discard >= BLOCK_CACHE_WRITEBACK_MS) {
+        DiscardFlushLocked(-1);
+    }
+}
+
+void BlockCacheInit(void) {
+    PrintKernel("BlockCache: Initializing buffer cache...\n");
+    FastMemset(g_heads, 0, sizeof(g_heads));
+    FastMemset(g_hash, 0, sizeof(g_hash));
+    FastMemset(&g_stats, 0, sizeof(g_stats));
+    g_a1in = (BhList){0};
+    g_am = (BhList){0};
+    g_ghost_next = g_ghost_count = 0;
+    FastMemset(g_through, 0, sizeof(g_through));
+    g_dirty_count = 0;
+    g_writeback_busy = g_ra_busy = 0;
+    g_discard_count = 0;
+    g_discard_inflight.count = 0;
+    for (int i = 0; i < BLOCK_CACHE_RA_STREAMS; i++) g_streams[i].device_id = -1;
+    g_stream_next = 0;
+
+    g_free_heads = NULL;
+    for (int i = BLOCK_CACHE_MAX_BUFFERS - 1; i >= 0; i--) {
+        g_heads[i].device_id = -1;
+        FreeHeadLocked(&g_heads[i]);
+    }
+
+    if (!g_cache_lock) g_cache_lock = rust_spinlock_new();
+    if (!g_cache_lock) {
+        PrintKernelWarning("BlockCache: Failed to allocate lock, caching disabled\n");
+        return;
+    }
+    g_cache_ready = 1;
+    PrintKernelSuccess("BlockCache: Buffer cache initialized\n");
+}
+
+// Copies the part of [start_lba, start_lba + count) covered by bh to/from buf.
+static void CopyOverlap(BufferHead* bh, uint64_t start_lba, uint32_t count, uint8_t* buf, int to_cache) {
+    uint64_t lo = bh->lba > start_lba ? bh->lba : start_lba;
+    uint64_t hi_bh = bh->lba + bh->sectors;
+    uint64_t hi_req = start_lba + count;
+    uint64_t hi = hi_bh < hi_req ? hi_bh : hi_req;
+    if (lo >= hi) return;
+
+    uint8_t* cache_ptr = bh->data + (lo - bh->lba) * bh->block_size;
+    uint8_t* buf_ptr = buf + (lo - start_lba) * bh->block_size;
+    uint64_t bytes = (hi - lo) * bh->block_size;
+    if (to_cache) FastMemcpy(cache_ptr, buf_ptr, bytes);
+    else FastMemcpy(buf_ptr, cache_ptr, bytes);
+}
+
+// Reads [lba, lba + count) straight into buf with the lock dropped, then
+// overlays any cached units since they may be newer than the disk.
+static int ReadThroughLocked(BlockDevice* dev, uint64_t lba, uint32_t count, uint8_t* buf) {
+    ThroughRange* slot;
+    while (!(slot = ThroughSlotLocked())) WaitLocked();
+    *slot = (ThroughRange){dev->id, 0, lba, count};
+
+    rust_spinlock_unlock(g_cache_lock);
+    const int result = BlockDeviceRead(dev->id, lba, count, buf);
+    rust_spinlock_lock(g_cache_lock);
+    slot->count = 0;
+    if (result != 0) return result;
+
+    const uint32_t spu = UnitSectors(dev);
+    for (uint64_t unit = lba - lba % spu; unit < lba + count; unit += spu) {
+        BufferHead* bh = HashLookup(dev->id, unit);
+        if (bh && (bh->flags & BH_VALID)) CopyOverlap(bh, lba, count, buf, 0);
+    }
+    return 0;
+}
+
+static int ThroughWriteBusyLocked(const BlockDevice* dev, uint64_t lba, uint32_t count) {
+    const DiscardExtent* d = &g_discard_inflight;
+    if (d->count && d->device_id == dev->id && d->lba < lba + count && lba < d->lba + d->count) {
+        return 1;
+    }
+    const uint32_t spu = UnitSectors(dev);
+    for (uint64_t unit = lba - lba % spu; unit < lba + count; unit += spu) {
+        BufferHead* bh = HashLookup(dev->id, unit);
+        if (bh && (bh->flags & BH_LOCKED)) return 1;
+    }
+    return 0;
+}
+
+// Writes [lba, lba + count) straight to the device with the lock dropped.
+// In-flight I/O on the range is waited out first; while the write runs,
+// misses inside it wait and write-back stays away, so afterwards cached
+// copies can simply be refreshed (and wholly covered ones cleaned).
+static int WriteThroughLocked(BlockDevice* dev, uint64_t lba, uint32_t count, const uint8_t* buf) {
+    ThroughRange* slot;
+    while (!(slot = ThroughSlotLocked()) || ThroughWriteBusyLocked(dev, lba, count)) WaitLocked();
+    *slot = (ThroughRange){dev->id, 1, lba, count};
+
+    rust_spinlock_unlock(g_cache_lock);
+    const int result = BlockDeviceWrite(dev->id, lba, count, buf);
+    rust_spinlock_lock(g_cache_lock);
+    slot->count = 0;
+    if (result != 0) return result;
+
+    const uint32_t spu = UnitSectors(dev);
+    const uint64_t end = lba + count;
+    for (uint64_t unit = lba - lba % spu; unit < end; unit += spu) {
+        BufferHead* bh = HashLookup(dev->id, unit);
+        if (!bh || !(bh->flags & BH_VALID)) continue;
+        CopyOverlap(bh, lba, count, (uint8_t*)buf, 1);
+        if ((bh->flags & BH_DIRTY) && bh->lba >= lba && bh->lba + bh->sectors <= end) {
+            bh->flags &= ~BH_DIRTY;
+            g_dirty_count--;
+        }
+    }
+    return 0;
+}
+
+int BlockCacheRead(int device_id, uint64_t start_lba, uint32_t count, void* buffer) {
+    BlockDevice* dev = BlockDeviceGet(device_id);
+    if (!dev || !buffer) return -1;
+    if (count == 0) return 0;
+    if (!BlockCacheUsable(dev)) return BlockDeviceRead(device_id, start_lba, count, buffer);
+
+    const uint32_t spu = UnitSectors(dev);
+    const uint64_t first_unit = start_lba - (start_lba % spu);
+    const uint64_t end_lba = start_lba + count;
+    uint8_t* out = buffer;
+    int result = 0;
+
+    rust_spinlock_lock(g_cache_lock);
+
+    if ((end_lba - first_unit + spu - 1) / spu > BLOCK_CACHE_BYPASS_UNITS) {
+        // Large transfer: read straight into the caller's buffer
+        g_stats.bypassed++;
+        result = ReadThroughLocked(dev, start_lba, count, out);
+        rust_spinlock_unlock(g_cache_lock);
+        return result;
+    }
+
+    for (uint64_t unit = first_unit; unit < end_lba; unit += spu) {
+        BufferHead* bh = ReadaheadLocked(dev, unit);
+        if (!bh) bh = GetLocked(dev, unit, 1);
+        if (!bh) {
+            // Every buffer is pinned or the unit is unreadable as a whole;
+            // go to the device for our slice only.
+            uint64_t lo = unit > start_lba ? unit : start_lba;
+            uint64_t hi = unit + spu < end_lba ? unit + spu : end_lba;
+            if (ReadThroughLocked(dev, lo, (uint32_t)(hi - lo),
+                                  out + (lo - start_lba) * dev->block_size) != 0) {
+                result = -1;
+                break;
+            }
+            continue;
+        }
+        CopyOverlap(bh, start_lba, count, out, 0);
+        bh->refcount--;
+    }
+
+    rust_spinlock_unlock(g_cache_lock);
+    return result;
+}
+
+int BlockCacheWrite(int device_id, uint64_t start_lba, uint32_t count, const void* buffer) {
+    BlockDevice* dev = BlockDeviceGet(device_id);
+    if (!dev || !buffer) return -1;
+    if (count == 0) return 0;
+    if (!BlockCacheUsable(dev)) return BlockDeviceWrite(device_id, start_lba, count, buffer);
+
+    const uint32_t spu = UnitSectors(dev);
+    const uint64_t first_unit = start_lba - (start_lba % spu);
+    const uint64_t end_lba = start_lba + count;
+    uint8_t* in = (uint8_t*)buffer;
+    int result = 0;
+
+    rust_spinlock_lock(g_cache_lock);
+    DiscardCancelLocked(device_id, start_lba, count);
+
+    if ((end_lba - first_unit + spu - 1) / spu > BLOCK_CACHE_BYPASS_UNITS) {
+        // Large transfer: write through and refresh any cached copies.
+        g_stats.bypassed++;
+        result = WriteThroughLocked(dev, start_lba, count, in);
+        rust_spinlock_unlock(g_cache_lock);
+        return result;
+    }
+
+    for (uint64_t unit = first_unit; unit < end_lba; unit += spu) {
+        uint64_t unit_end = unit + spu;
+        if (dev->total_blocks && unit_end > dev->total_blocks) unit_end = dev->total_blocks;
+        const int whole = unit >= start_lba && unit_end <= end_lba;
+
+        BufferHead* bh = GetLocked(dev, unit, !whole);
+        if (!bh) {
+            uint64_t lo = unit > start_lba ? unit : start_lba;
+            uint64_t hi = unit_end < end_lba ? unit_end : end_lba;
+            if (WriteThroughLocked(dev, lo, (uint32_t)(hi - lo),
+                                   in + (lo - start_lba) * dev->block_size) != 0) {
+                result = -1;
+                break;
+            }
+            continue;
+        }
+        CopyOverlap(bh, start_lba, count, in, 1);
+        bh->flags |= BH_VALID;
+        MarkDirtyLocked(bh);
+        bh->refcount--;
+    }
+
+    MaybeFlushLocked();
+    rust_spinlock_unlock(g_cache_lock);
+    return result;
+}
+
+BufferHead* BlockCacheGet(int device_id, uint64_t lba, uint32_t* offset) {
+    BlockDevice* dev = BlockDeviceGet(device_id);
+    if (!dev || !BlockCacheUsable(dev)) return NULL;
+
+    rust_spinlock_lock(g_cache_lock);
+    BufferHead* bh = GetLocked(dev, lba, 1);
+    rust_spinlock_unlock(g_cache_lock);
+
+    if (bh && offset) *offset = (uint32_t)((lba - bh->lba) * bh->block_size);
+    return bh;
+}
+
+void BlockCacheRelease(BufferHead* bh) {
+    if (!bh) return;
+    rust_spinlock_lock(g_cache_lock);
+    if (bh->refcount) bh->refcount--;
+    rust_spinlock_unlock(g_cache_lock);
+}
+
+void BlockCacheMarkDirty(BufferHead* bh) {
+    if (!bh) return;
+    rust_spinlock_lock(g_cache_lock);
+    DiscardCancelLocked(bh->device_id, bh->lba, bh->sectors);
+    MarkDirtyLocked(bh);
+    MaybeFlushLocked();
+    rust_spinlock_unlock(g_cache_lock);
+}
+
+int BlockCacheSync(int device_id) {
+    if (!g_cache_ready) return 0;
+    rust_spinlock_lock(g_cache_lock);
+    int result = SyncLocked(device_id);
+    if (DiscardFlushLocked(device_id) != 0) result = -1;
+    rust_spinlock_unlock(g_cache_lock);
+    return result;
+}
+
+int BlockCacheSyncAll(void) {
+    return BlockCacheSync(-1);
+}
+
+void BlockCacheWriteback(void) {
+    if (!g_cache_ready || (!g_dirty_count && !g_discard_count)) return;
+    rust_spinlock_lock(g_cache_lock);
+    MaybeFlushLocked();
+    rust_spinlock_unlock(g_cache_lock);
+}
+
+// Drops every unreferenced buffer of the device. Dirty data is discarded,
+// so callers normally BlockCacheSync() first.
+void BlockCacheInvalidate(int device_id) {
+    if (!g_cache_ready) return;
+    rust_spinlock_lock(g_cache_lock);
+    for (uint32_t i = 0; i < BLOCK_CACHE_MAX_BUFFERS; i++) {
+        BufferHead* bh = &g_heads[i];
+        if (bh->queue == BH_QUEUE_NONE || bh->device_id != device_id || bh->refcount) continue;
+        DropLocked(bh);
+    }
+    for (uint32_t i = 0; i < g_ghost_count; i++) {
+        if (g_ghost[i].device_id == device_id) g_ghost[i].device_id = -1;
+    }
+    for (uint32_t i = 0; i < BLOCK_CACHE_RA_STREAMS; i++) {
+        if (g_streams[i].device_id == device_id) g_streams[i].device_id = -1;
+    }
+    DiscardCancelLocked(device_id, 0, UINT64_MAX);
+    rust_spinlock_unlock(g_cache_lock);
+}
+
+void BlockCacheDiscard(int device_id, uint64_t start_lba, uint64_t count) {
+    BlockDevice* dev = BlockDeviceGet(device_id);
+    if (!dev || !dev->discard_blocks || count == 0) return;
+    if (!BlockCacheUsable(dev)) {
+        BlockDeviceDiscard(device_id, start_lba, count);
+        return;
+    }
+
+    rust_spinlock_lock(g_cache_lock);
+
+    // Widen an overlapping or adjacent extent, otherwise take a new slot
+    DiscardExtent* ext = NULL;
+    for (uint32_t i = 0; i < g_discard_count; i++) {
+        DiscardExtent* e = &g_discards[i];
+        if (e->device_id != device_id) continue;
+        if (start_lba > e->lba + e->count || start_lba + count < e->lba) continue;
+        const uint64_t lo = e->lba < start_lba ? e->lba : start_lba;
+        const uint64_t hi = e->lba + e->count > start_lba + count ? e->lba + e->count : start_lba + count;
+        e->lba = lo;
+        e->count = hi - lo;
+        ext = e;
+        break;
+    }
+    if (!ext) {
+        while (g_discard_count == BLOCK_CACHE_DISCARD_EXTENTS) DiscardFlushLocked(-1);
+        if (g_discard_count == 0) g_oldest_discard = GetTimeInMs();
+        ext = &g_discards[g_discard_count++];
+        *ext = (DiscardExtent){device_id, start_lba, count};
+    }
+
+    // Units now wholly inside freed space never need writing back
+    const uint32_t spu = UnitSectors(dev);
+    const uint64_t end = ext->lba + ext->count;
+    for (uint64_t unit = ext->lba - ext->lba % spu; unit < end; unit += spu) {
+        BufferHead* bh = HashLookup(device_id, unit);
+        if (!bh || bh->refcount || bh->lba < ext->lba || bh->lba + bh->sectors > end) continue;
+        DropLocked(bh);
+    }
+
+    rust_spinlock_unlock(g_cache_lock);
+}
+
+int BlockCacheDiscardFlush(int device_id) {
+    if (!g_cache_ready) return 0;
+    rust_spinlock_lock(g_cache_lock);
+    int result = DiscardFlushLocked(device_id);
+    rust_spinlock_unlock(g_cache_lock);
+    return result;
+}
+
+void BlockCacheGetStats(BlockCacheStats* stats) {
+    if (!stats) return;
+    if (!g_cache_ready) {
+        FastMemset(stats, 0, sizeof(*stats));
+        return;
+    }
+    rust_spinlock_lock(g_cache_lock);
+    *stats = g_stats;
+    stats->dirty = g_dirty_count;
+    stats->discard_pending = g_discard_count;
+    rust_spinlock_unlock(g_cache_lock);
+}
+
+void BlockCachePrintStats(void) {
+    BlockCacheStats s;
+    BlockCacheGetStats(&s);
+    const uint64_t lookups = s.hits + s.misses;
+    PrintKernelF("BlockCache: %u/%u buffers (%u dirty), A1in=%u Am=%u\n",
+                 s.buffers, BLOCK_CACHE_MAX_BUFFERS, s.dirty, g_a1in.count, g_am.count);
+    PrintKernelF("BlockCache: hits=%llu misses=%llu ghost=%llu hit-rate=%llu%%\n",
+                 (unsigned long long)s.hits, (unsigned long long)s.misses,
+                 (unsigned long long)s.ghost_hits,
+                 (unsigned long long)(lookups ? s.hits * 100 / lookups : 0));
+    PrintKernelF("BlockCache: evictions=%llu writebacks=%llu bypassed=%llu\n",
+                 (unsigned long long)s.evictions, (unsigned long long)s.writebacks,
+                 (unsigned long long)s.bypassed);
+    PrintKernelF("BlockCache: readahead=%llu used=%llu\n",
+                 (unsigned long long)s.readahead, (unsigned long long)s.readahead_hits);
+    PrintKernelF("BlockCache: discards=%llu sectors=%llu pending=%u\n",
+                 (unsigned long long)s.discards, (unsigned long long)s.discard_sectors,
+                 s.discard_pending);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <BlockDevice.h>
+#include <stdint.h>
+
+// Shared buffer cache sitting between the filesystems and BlockDevice.
+// Caching is done in fixed-size units (BLOCK_CACHE_UNIT_SIZE bytes) keyed by
+// (device id, first LBA of the unit); callers may read or write any LBA range
+// and the cache splits it across units. Replacement uses 2Q so that a single
+// large sequential scan cannot flush hot metadata (bitmaps, inode tables,
+// directories) out of the cache.
+
+#define BLOCK_CACHE_UNIT_SIZE       4096
+#define BLOCK_CACHE_MAX_BUFFERS     1024    // 4 MiB of cached data
+#define BLOCK_CACHE_HASH_BUCKETS    512
+#define BLOCK_CACHE_A1IN_PERCENT    25      // share of the cache for first-touch blocks
+#define BLOCK_CACHE_GHOST_ENTRIES   (BLOCK_CACHE_MAX_BUFFERS / 2)
+#define BLOCK_CACHE_BYPASS_UNITS    16      // larger requests skip the cache
+#define BLOCK_CACHE_DIRTY_HIGH      (BLOCK_CACHE_MAX_BUFFERS / 2)
+#define BLOCK_CACHE_WRITEBACK_MS    5000    // max age of a dirty buffer
+
+// Readahead: sequential streams start with a small window that doubles on
+// every trigger up to the cap (32 units = 128 KiB, one merged request).
+#define BLOCK_CACHE_RA_STREAMS      8
+#define BLOCK_CACHE_RA_MIN_UNITS    4
+#define BLOCK_CACHE_RA_MAX_UNITS    32
+
+// Discard batching: freed extents are merged and held until write-back
+// (or an explicit BlockCacheDiscardFlush), so one TRIM covers many frees
+// and blocks reallocated in the meantime are never discarded.
+#define BLOCK_CACHE_DISCARD_EXTENTS 64
+
+// Uncached (bypass or fallback) transfers in flight at once
+#define BLOCK_CACHE_THROUGH_SLOTS   8
+
+// BufferHead flags
+#define BH_VALID    (1 << 0)
+#define BH_DIRTY    (1 << 1)
+#define BH_READAHEAD (1 << 2)  // prefetched and not yet used
+#define BH_LOCKED   (1 << 3)   // device I/O in flight; the I/O holds a reference
+
+typedef struct BufferHead {
+    int device_id;
+    uint64_t lba;           // first device block held by this unit
+    uint32_t sectors;       // device blocks held (clamped at the end of the device)
+    uint32_t block_size;
+    uint8_t* data;
+    uint32_t refcount;
+    uint16_t flags;
+    uint8_t queue;          // which 2Q list currently owns the buffer
+    uint64_t dirty_since;   // GetTimeInMs() when the buffer first became dirty
+    struct BufferHead* hash_next;
+    struct BufferHead* prev;
+    struct BufferHead* next;
+} BufferHead;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t ghost_hits;
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint64_t bypassed;
+    uint64_t readahead;     // units prefetched
+    uint64_t readahead_hits; // prefetched units that were later read
+    uint64_t discards;      // extents sent to the device
+    uint64_t discard_sectors;
+    uint32_t discard_pending;
+    uint32_t buffers;
+    uint32_t dirty;
+} BlockCacheStats;
+
+void BlockCacheInit(void);
+
+// Copying interface, drop-in for BlockDeviceRead/BlockDeviceWrite
+int BlockCacheRead(int device_id, uint64_t start_lba, uint32_t count, void* buffer);
+int BlockCacheWrite(int device_id, uint64_t start_lba, uint32_t count, const void* buffer);
+
+// Buffer-head interface: returns a referenced unit containing `lba`.
+// The caller must BlockCacheRelease() it; *offset receives the byte offset
+// of `lba` inside bh->data.
+BufferHead* BlockCacheGet(int device_id, uint64_t lba, uint32_t* offset);
+void BlockCacheRelease(BufferHead* bh);
+void BlockCacheMarkDirty(BufferHead* bh);
+
+// Write-back and invalidation
+int BlockCacheSync(int device_id);
+int BlockCacheSyncAll(void);
+// Writes back dirty buffers and discards that have aged past
+// BLOCK_CACHE_WRITEBACK_MS; called from the idle loop.
+void BlockCacheWriteback(void);
+void BlockCacheInvalidate(int device_id);
+
+// Called by filesystems for blocks they just freed. Cached copies wholly
+// inside the range are dropped without write-back and the extent is queued
+// for discard; a later write to any part of it cancels that part.
+// No-op on devices without discard support.
+void BlockCacheDiscard(int device_id, uint64_t start_lba, uint64_t count);
+// Writes back and discards pending extents now (device_id < 0: all devices)
+int BlockCacheDiscardFlush(int device_id);
+
+void BlockCacheGetStats(BlockCacheStats* stats);
+void BlockCachePrintStats(void);
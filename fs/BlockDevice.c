@@ -1,7 +1,13 @@
 #include <BlockDevice.h>
+#include <BlockCache.h>
+#include <IoScheduler.h>
 #include <MBR.h>
 #include <StringOps.h>
 #include <Console.h>
+#include <Format.h>
+#include <MemOps.h>
+#include <TSC.h>
+#include <arch/x86_64/features/x64.h>
 
 static BlockDevice g_block_devices[MAX_BLOCK_DEVICES];
 static int g_next_device_id = 0;
@@ -13,6 +19,7 @@ void BlockDeviceInit() {
     }
     g_next_device_id = 0;
     PrintKernel("BlockDevice: Block device table cleared\n");
+    BlockCacheInit();
 }
 
 BlockDevice* BlockDeviceRegister(BlockDeviceType type, uint32_t block_size, uint64_t total_blocks, const char* name, void* driver_data, ReadBlocksFunc read, WriteBlocksFunc write) {
@@ -41,8 +48,11 @@ BlockDevice* BlockDeviceRegister(BlockDeviceType type, uint32_t block_size, uint
     dev->driver_data = driver_data;
     dev->read_blocks = read;
     dev->write_blocks = write;
+    dev->discard_blocks = NULL;
     dev->parent = NULL;
     dev->lba_offset = 0;
+    FastMemset(&dev->stats, 0, sizeof(dev->stats));
+    IoQueueAttach(dev);
 
     PrintKernel("BlockDevice: Successfully registered '");
     PrintKernel(name);
@@ -65,7 +75,8 @@ int BlockDeviceRead(int device_id, uint64_t start_lba, uint32_t count, void* buf
     if (!dev || !dev->read_blocks) {
         return -1;
     }
-    return dev->read_blocks(dev, start_lba, count, buffer);
+    BlockRequest rq = {.op = BIO_READ, .lba = start_lba, .count = count, .buffer = buffer};
+    return IoSubmit(dev, &rq, 1);
 }
 
 int BlockDeviceWrite(int device_id, uint64_t start_lba, uint32_t count, const void* buffer) {
@@ -73,7 +84,31 @@ int BlockDeviceWrite(int device_id, uint64_t start_lba, uint32_t count, const vo
     if (!dev || !dev->write_blocks) {
         return -1;
     }
-    return dev->write_blocks(dev, start_lba, count, buffer);
+    BlockRequest rq = {.op = BIO_WRITE, .lba = start_lba, .count = count, .buffer = (void*)buffer};
+    return IoSubmit(dev, &rq, 1);
+}
+
+int BlockDeviceDiscard(int device_id, uint64_t start_lba, uint64_t count) {
+    BlockDevice* dev = BlockDeviceGet(device_id);
+    if (!dev || !dev->discard_blocks) {
+        return -1;
+    }
+    if (count == 0) return 0;
+    if (start_lba >= dev->total_blocks || count > dev->total_blocks - start_lba) {
+        return -1;
+    }
+
+    const int result = dev->discard_blocks(dev, start_lba, count);
+    if (result == 0) {
+        dev->stats.discards++;
+        dev->stats.discard_sectors += count;
+    }
+    return result;
+}
+
+bool BlockDeviceCanDiscard(int device_id) {
+    const BlockDevice* dev = BlockDeviceGet(device_id);
+    return dev && dev->discard_blocks;
 }
 
 void BlockDeviceDetectAndRegisterPartitions(BlockDevice* drive) {
@@ -108,4 +143,117 @@ BlockDevice* SearchBlockDevice(const char* name) {
         if (FastStrCmp(dev->name, name) == 0) return dev;
     }
     return NULL;
-}
\ No newline at end of file
+}
+static uint64_t TscToUs(uint64_t ticks) {
+    const uint64_t per_us = TSCGetFrequency() / 1000000;
+    return per_us ? ticks / per_us : 0;
+}
+
+uint64_t BlockDeviceIoStart(BlockDevice* device) {
+    const uint64_t now = rdtsc();
+    if (device->stats.in_flight++ == 0) device->stats.busy_start = now;
+    return now;
+}
+
+void BlockDeviceIoDone(BlockDevice* device, BlockIoOp op, uint32_t sectors, uint32_t merges, uint64_t start, int result) {
+    BlockDeviceStats* st = &device->stats;
+    const uint64_t now = rdtsc();
+    const uint64_t us = TscToUs(now - start);
+
+    if (st->in_flight && --st->in_flight == 0) st->busy_us += TscToUs(now - st->busy_start);
+    if (result != 0) {
+        st->errors[op]++;
+        return;
+    }
+
+    uint32_t bucket = us ? 64 - __builtin_clzll(us) : 0;
+    if (bucket >= BLOCK_LAT_BUCKETS) bucket = BLOCK_LAT_BUCKETS - 1;
+
+    st->ios[op]++;
+    st->merges[op] += merges;
+    st->sectors[op] += sectors;
+    st->ticks_us[op] += us;
+    st->latency[op][bucket]++;
+}
+
+// One line per device, loosely following Linux /proc/diskstats:
+// id name reads rd_merges rd_sectors rd_us writes wr_merges wr_sectors
+// wr_us in_flight busy_us errors
+int BlockDeviceFormatDiskStats(char* buffer, uint32_t size) {
+    uint32_t len = 0;
+    for (int i = 0; i < g_next_device_id && len < size; i++) {
+        const BlockDevice* dev = &g_block_devices[i];
+        if (!dev->active) continue;
+        const BlockDeviceStats* st = &dev->stats;
+        int n = snprintf(buffer + len, size - len,
+                         "%d %s %llu %llu %llu %llu %llu %llu %llu %llu %u %llu %llu\n",
+                         dev->id, dev->name,
+                         st->ios[BIO_READ], st->merges[BIO_READ], st->sectors[BIO_READ], st->ticks_us[BIO_READ],
+                         st->ios[BIO_WRITE], st->merges[BIO_WRITE], st->sectors[BIO_WRITE], st->ticks_us[BIO_WRITE],
+                         st->in_flight, st->busy_us, st->errors[BIO_READ] + st->errors[BIO_WRITE]);
+        if (n < 0) break;
+        len += (uint32_t)n;
+    }
+    return len < size ? (int)len : (int)size;
+}
+
+// Non-empty latency buckets per device and direction, as "<upper_us>:<count>"
+int BlockDeviceFormatLatency(char* buffer, uint32_t size) {
+    static const char* const op_names[2] = {"read", "write"};
+    uint32_t len = 0;
+    for (int i = 0; i < g_next_device_id && len < size; i++) {
+        const BlockDevice* dev = &g_block_devices[i];
+        if (!dev->active) continue;
+        for (int op = 0; op < 2 && len < size; op++) {
+            int n = snprintf(buffer + len, size - len, "%s %s", dev->name, op_names[op]);
+            if (n < 0) return (int)len;
+            len += (uint32_t)n;
+            for (int b = 0; b < BLOCK_LAT_BUCKETS && len < size; b++) {
+                if (!dev->stats.latency[op][b]) continue;
+                n = snprintf(buffer + len, size - len, " %llu:%llu",
+                             1ULL << b, dev->stats.latency[op][b]);
+                if (n < 0) return (int)len;
+                len += (uint32_t)n;
+            }
+            if (len < size) buffer[len++] = '\n';
+        }
+    }
+    return len < size ? (int)len : (int)size;
+}
+
+static uint64_t LatencyPercentile(const uint64_t* hist, uint64_t total, uint32_t permille) {
+    const uint64_t target = (total * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (int b = 0; b < BLOCK_LAT_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= target) return 1ULL << b;
+    }
+    return 1ULL << (BLOCK_LAT_BUCKETS - 1);
+}
+
+void BlockDevicePrintIoStat(const BlockDevice* dev, bool histogram) {
+    const BlockDeviceStats* st = &dev->stats;
+    const uint64_t uptime_us = GetTimeInMs() * 1000;
+
+    PrintKernelF("%s: util=%llu%% inflight=%u errors=%llu\n", dev->name,
+                 uptime_us ? st->busy_us * 100 / uptime_us : 0, st->in_flight,
+                 st->errors[BIO_READ] + st->errors[BIO_WRITE]);
+    if (st->discards) {
+        PrintKernelF("  discard: requests=%llu KiB=%llu\n", st->discards,
+                     st->discard_sectors * dev->block_size / 1024);
+    }
+    for (int op = 0; op < 2; op++) {
+        const uint64_t ios = st->ios[op];
+        PrintKernelF("  %s: ios=%llu merges=%llu KiB=%llu avg=%lluus p50<%lluus p99<%lluus\n",
+                     op == BIO_READ ? "read " : "write", ios, st->merges[op],
+                     st->sectors[op] * dev->block_size / 1024,
+                     ios ? st->ticks_us[op] / ios : 0,
+                     ios ? LatencyPercentile(st->latency[op], ios, 500) : 0,
+                     ios ? LatencyPercentile(st->latency[op], ios, 990) : 0);
+        if (!histogram || !ios) continue;
+        for (int b = 0; b < BLOCK_LAT_BUCKETS; b++) {
+            if (!st->latency[op][b]) continue;
+            PrintKernelF("    <%lluus: %llu\n", 1ULL << b, st->latency[op][b]);
+        }
+    }
+}
@@ -12,13 +12,39 @@ typedef enum {
     DEVICE_TYPE_NVME,
     DEVICE_TYPE_USB,
     DEVICE_TYPE_VIRTIO,
-    DEVICE_TYPE_PARTITION
+    DEVICE_TYPE_PARTITION,
+    DEVICE_TYPE_RAMDISK
 } BlockDeviceType;
 
+typedef enum {
+    BIO_READ = 0,
+    BIO_WRITE = 1
+} BlockIoOp;
+
+// log2 latency buckets in microseconds: bucket i holds [2^(i-1), 2^i) us,
+// bucket 0 holds sub-microsecond requests and the last one everything slower
+#define BLOCK_LAT_BUCKETS 24
+
+typedef struct {
+    uint64_t ios[2];            // completed driver requests, by BlockIoOp
+    uint64_t merges[2];         // requests folded into another one
+    uint64_t sectors[2];
+    uint64_t errors[2];
+    uint64_t discards;          // discard requests sent to the driver
+    uint64_t discard_sectors;
+    uint64_t ticks_us[2];       // time spent in completed requests
+    uint64_t busy_us;           // time with at least one request in flight
+    uint64_t busy_start;        // TSC when in_flight last left zero
+    uint32_t in_flight;
+    uint64_t latency[2][BLOCK_LAT_BUCKETS];
+} BlockDeviceStats;
+
 struct BlockDevice;
 
 typedef int (*ReadBlocksFunc)(struct BlockDevice* device, uint64_t start_lba, uint32_t count, void* buffer);
 typedef int (*WriteBlocksFunc)(struct BlockDevice* device, uint64_t start_lba, uint32_t count, const void* buffer);
+// Tells the device the range no longer holds data (TRIM/UNMAP/DISCARD)
+typedef int (*DiscardBlocksFunc)(struct BlockDevice* device, uint64_t start_lba, uint64_t count);
 
 typedef struct BlockDevice {
     int id;
@@ -38,6 +64,9 @@ typedef struct BlockDevice {
     // Function pointers for I/O
     ReadBlocksFunc read_blocks;
     WriteBlocksFunc write_blocks;
+    DiscardBlocksFunc discard_blocks; // NULL when the device can't discard
+
+    BlockDeviceStats stats;
 } BlockDevice;
 
 void BlockDeviceInit();
@@ -45,6 +74,17 @@ BlockDevice* BlockDeviceRegister(BlockDeviceType type, uint32_t block_size, uint
 BlockDevice* BlockDeviceGet(int id);
 int BlockDeviceRead(int device_id, uint64_t start_lba, uint32_t count, void* buffer);
 int BlockDeviceWrite(int device_id, uint64_t start_lba, uint32_t count, const void* buffer);
+// Returns 0 on success, -1 on failure or when the device has no discard support.
+// Callers must not have writes to the range still queued (see BlockCacheDiscard).
+int BlockDeviceDiscard(int device_id, uint64_t start_lba, uint64_t count);
+bool BlockDeviceCanDiscard(int device_id);
 void BlockDeviceDetectAndRegisterPartitions(BlockDevice* drive);
 void BlockDevicePrint(const char* args);
 BlockDevice* SearchBlockDevice(const char* name);
+
+// I/O accounting, called around every driver request
+uint64_t BlockDeviceIoStart(BlockDevice* device);
+void BlockDeviceIoDone(BlockDevice* device, BlockIoOp op, uint32_t sectors, uint32_t merges, uint64_t start, int result);
+int BlockDeviceFormatDiskStats(char* buffer, uint32_t size);
+int BlockDeviceFormatLatency(char* buffer, uint32_t size);
+void BlockDevicePrintIoStat(const BlockDevice* device, bool histogram);
@@ -0,0 +1,196 @@
+#include <DCache.h>
+#include <Console.h>
+#include <MemOps.h>
+#include <SpinlockRust.h>
+
+typedef struct DCacheEntry {
+    const void* sb;             // NULL while the entry is free
+    uint64_t parent;
+    uint64_t ino;               // 0: negative entry
+    uint32_t hash;
+    uint8_t name_len;
+    char name[DCACHE_NAME_MAX];
+    struct DCacheEntry* hash_next;
+    struct DCacheEntry* prev;   // LRU list, head is most recent
+    struct DCacheEntry* next;
+} DCacheEntry;
+
+static DCacheEntry g_entries[DCACHE_MAX_ENTRIES];
+static DCacheEntry* g_hash[DCACHE_HASH_BUCKETS];
+static DCacheEntry* g_lru_head = NULL;
+static DCacheEntry* g_lru_tail = NULL;
+static DCacheEntry* g_free = NULL;
+static DCacheStats g_stats;
+static RustSpinLock* g_dcache_lock = NULL;
+
+static uint32_t DCacheHash(const void* sb, uint64_t parent, const char* name, uint32_t len) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (uint32_t i = 0; i < len; i++) {
+        h ^= (uint8_t)name[i];
+        h *= 16777619u;
+    }
+    h ^= (uint32_t)parent ^ (uint32_t)(parent >> 32);
+    h ^= (uint32_t)((uintptr_t)sb >> 4);
+    h *= 16777619u;
+    return h;
+}
+
+static void LruUnlink(DCacheEntry* e) {
+    if (e->prev) e->prev->next = e->next;
+    else g_lru_head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else g_lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void LruPushFront(DCacheEntry* e) {
+    e->prev = NULL;
+    e->next = g_lru_head;
+    if (g_lru_head) g_lru_head->prev = e;
+    g_lru_head = e;
+    if (!g_lru_tail) g_lru_tail = e;
+}
+
+static void HashUnlink(DCacheEntry* e) {
+    DCacheEntry** link = &g_hash[e->hash % DCACHE_HASH_BUCKETS];
+    while (*link) {
+        if (*link == e) {
+            *link = e->hash_next;
+            e->hash_next = NULL;
+            return;
+        }
+        link = &(*link)->hash_next;
+    }
+}
+
+static void FreeEntryLocked(DCacheEntry* e) {
+    HashUnlink(e);
+    LruUnlink(e);
+    e->sb = NULL;
+    e->next = g_free;
+    g_free = e;
+    g_stats.entries--;
+}
+
+static DCacheEntry* FindLocked(const void* sb, uint64_t parent, const char* name, uint32_t len, uint32_t hash) {
+    for (DCacheEntry* e = g_hash[hash % DCACHE_HASH_BUCKETS]; e; e = e->hash_next) {
+        if (e->hash == hash && e->sb == sb && e->parent == parent && e->name_len == len &&
+            FastMemcmp(e->name, name, len) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+void DCacheInit(void) {
+    FastMemset(g_entries, 0, sizeof(g_entries));
+    FastMemset(g_hash, 0, sizeof(g_hash));
+    FastMemset(&g_stats, 0, sizeof(g_stats));
+    g_lru_head = g_lru_tail = NULL;
+    g_free = NULL;
+    for (int i = DCACHE_MAX_ENTRIES - 1; i >= 0; i--) {
+        g_entries[i].next = g_free;
+        g_free = &g_entries[i];
+    }
+
+    if (!g_dcache_lock) g_dcache_lock = rust_spinlock_new();
+    if (!g_dcache_lock) {
+        PrintKernelWarning("DCache: Failed to allocate lock, dentry caching disabled\n");
+    }
+}
+
+int DCacheLookup(const void* sb, uint64_t parent, const char* name, uint32_t len, uint64_t* ino) {
+    if (!g_dcache_lock || !sb || len == 0 || len > DCACHE_NAME_MAX) return 0;
+    const uint32_t hash = DCacheHash(sb, parent, name, len);
+
+    rust_spinlock_lock(g_dcache_lock);
+    DCacheEntry* e = FindLocked(sb, parent, name, len, hash);
+    if (!e) {
+        g_stats.misses++;
+        rust_spinlock_unlock(g_dcache_lock);
+        return 0;
+    }
+    LruUnlink(e);
+    LruPushFront(e);
+    *ino = e->ino;
+    if (e->ino) g_stats.hits++;
+    else g_stats.negative_hits++;
+    rust_spinlock_unlock(g_dcache_lock);
+    return 1;
+}
+
+void DCacheInsert(const void* sb, uint64_t parent, const char* name, uint32_t len, uint64_t ino) {
+    if (!g_dcache_lock || !sb || len == 0 || len > DCACHE_NAME_MAX) return;
+    const uint32_t hash = DCacheHash(sb, parent, name, len);
+
+    rust_spinlock_lock(g_dcache_lock);
+    DCacheEntry* e = FindLocked(sb, parent, name, len, hash);
+    if (e) {
+        LruUnlink(e);
+    } else {
+        if (!g_free) {
+            FreeEntryLocked(g_lru_tail);
+            g_stats.evictions++;
+        }
+        e = g_free;
+        g_free = e->next;
+        e->sb = sb;
+        e->parent = parent;
+        e->hash = hash;
+        e->name_len = (uint8_t)len;
+        FastMemcpy(e->name, name, len);
+        e->hash_next = g_hash[hash % DCACHE_HASH_BUCKETS];
+        g_hash[hash % DCACHE_HASH_BUCKETS] = e;
+        g_stats.entries++;
+    }
+    e->ino = ino;
+    LruPushFront(e);
+    rust_spinlock_unlock(g_dcache_lock);
+}
+
+void DCacheInvalidate(const void* sb, uint64_t parent, const char* name, uint32_t len) {
+    if (!g_dcache_lock || !sb || len == 0 || len > DCACHE_NAME_MAX) return;
+    const uint32_t hash = DCacheHash(sb, parent, name, len);
+
+    rust_spinlock_lock(g_dcache_lock);
+    DCacheEntry* e = FindLocked(sb, parent, name, len, hash);
+    if (e) FreeEntryLocked(e);
+    rust_spinlock_unlock(g_dcache_lock);
+}
+
+void DCacheInvalidateDir(const void* sb, uint64_t parent) {
+    if (!g_dcache_lock || !sb) return;
+    rust_spinlock_lock(g_dcache_lock);
+    for (int i = 0; i < DCACHE_MAX_ENTRIES; i++) {
+        if (g_entries[i].sb == sb && g_entries[i].parent == parent) FreeEntryLocked(&g_entries[i]);
+    }
+    rust_spinlock_unlock(g_dcache_lock);
+}
+
+void DCachePurge(const void* sb) {
+    if (!g_dcache_lock || !sb) return;
+    rust_spinlock_lock(g_dcache_lock);
+    for (int i = 0; i < DCACHE_MAX_ENTRIES; i++) {
+        if (g_entries[i].sb == sb) FreeEntryLocked(&g_entries[i]);
+    }
+    rust_spinlock_unlock(g_dcache_lock);
+}
+
+void DCacheGetStats(DCacheStats* stats) {
+    if (!stats) return;
+    if (g_dcache_lock) rust_spinlock_lock(g_dcache_lock);
+    *stats = g_stats;
+    if (g_dcache_lock) rust_spinlock_unlock(g_dcache_lock);
+}
+
+void DCachePrintStats(void) {
+    DCacheStats s;
+    DCacheGetStats(&s);
+    const uint64_t lookups = s.hits + s.negative_hits + s.misses;
+    PrintKernelF("DCache: %u/%u entries\n", s.entries, DCACHE_MAX_ENTRIES);
+    PrintKernelF("DCache: hits=%llu negative=%llu misses=%llu hit-rate=%llu%%\n",
+                 (unsigned long long)s.hits, (unsigned long long)s.negative_hits,
+                 (unsigned long long)s.misses,
+                 (unsigned long long)(lookups ? (s.hits + s.negative_hits) * 100 / lookups : 0));
+    PrintKernelF("DCache: evictions=%llu\n", (unsigned long long)s.evictions);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Directory entry cache shared by all mounted filesystems. It maps
+// (volume, parent directory, component name) to the child's inode number
+// (MFT record, directory-entry location, ...), so that repeated path walks
+// become hash probes instead of directory scans. The volume key is the
+// filesystem's per-mount context and the inode numbers are whatever the
+// filesystem uses to identify a directory; both are opaque here.
+//
+// An inode number of 0 is a negative entry: the name is known not to exist.
+// Filesystems must invalidate (or re-insert) a name when they create or
+// remove it, drop a directory's children when the directory is deleted,
+// and purge the volume on unmount.
+
+#define DCACHE_MAX_ENTRIES      1024
+#define DCACHE_HASH_BUCKETS     512
+#define DCACHE_NAME_MAX         63      // longer components are never cached
+
+typedef struct {
+    uint64_t hits;
+    uint64_t negative_hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint32_t entries;
+} DCacheStats;
+
+void DCacheInit(void);
+
+// Returns 1 and sets *ino on a hit (0 for a negative entry), 0 on a miss
+int DCacheLookup(const void* sb, uint64_t parent, const char* name, uint32_t len, uint64_t* ino);
+void DCacheInsert(const void* sb, uint64_t parent, const char* name, uint32_t len, uint64_t ino);
+
+void DCacheInvalidate(const void* sb, uint64_t parent, const char* name, uint32_t len);
+void DCacheInvalidateDir(const void* sb, uint64_t parent);
+void DCachePurge(const void* sb);
+
+void DCacheGetStats(DCacheStats* stats);
+void DCachePrintStats(void);
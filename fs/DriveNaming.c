@@ -6,6 +6,7 @@ static int ide_count = 0;
 static int ahci_count = 0;
 static int nvme_count = 0;
 static int virtio_count = 0;
+static int ramdisk_count = 0;
 static RustSpinLock* dn_lock = NULL;
 
 void GenerateDriveNameInto(BlockDeviceType type, char* out_name) {
@@ -24,6 +25,9 @@ void GenerateDriveNameInto(BlockDeviceType type, char* out_name) {
         case DEVICE_TYPE_VIRTIO:
             snprintf(out_name, 16, "vd%c", 'a' + virtio_count++);
             break;
+        case DEVICE_TYPE_RAMDISK:
+            snprintf(out_name, 16, "ram%d", ramdisk_count++);
+            break;
         default:
             snprintf(out_name, 16, "unk%d", 0);
             break;
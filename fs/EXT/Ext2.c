@@ -6,13 +6,36 @@
 #include <mm/MemOps.h>
 #include <VFS.h>
 #include <FileSystem.h>
+#include <VFRFS.h>
 #include <Rtc.h>
 #include <SpinlockRust.h>
+#include <BlockCache.h>
+#include <DCache.h>
 
 #define EXT2_SUPERBLOCK_OFFSET 1024
 #define EXT2_MAGIC 0xEF53
 
-typedef struct {
+// In-memory inode cache, one per volume. Entries referenced by open files
+// are pinned; dirty entries are written back by Ext2SyncMetadata() and are
+// never recycled before that. An inode deleted while open stays pinned by
+// its handles but is marked unlinked: lookups skip it, so a reuse of the
+// inode number gets a fresh entry, and I/O through the old handles fails.
+#define EXT2_ICACHE_ENTRIES 128
+#define EXT2_ICACHE_BUCKETS 64
+
+typedef struct Ext2CachedInode {
+    uint32_t inode_num;         // 0 while the entry is unused
+    uint32_t refcount;
+    int dirty;
+    uint32_t map_gen;           // bumped whenever the block map changes
+    int unlinked;               // inode freed; only old handles still refer to it
+    Ext2Inode inode;
+    struct Ext2CachedInode* hash_next;
+    struct Ext2CachedInode* prev;   // LRU list, head is most recent
+    struct Ext2CachedInode* next;
+} Ext2CachedInode;
+
+typedef struct Ext2Volume {
     BlockDevice* device;
     uint32_t block_size;
     uint32_t inode_size;
@@ -21,38 +44,80 @@ typedef struct {
     uint32_t num_groups;
     Ext2Superblock superblock;
     Ext2GroupDesc* group_descs;
+    uint32_t gdt_blocks;        // blocks occupied by group_descs on disk
+    // Allocation bitmaps are cached per group on first use and written
+    // back, with the group descriptors and superblock counts, by
+    // Ext2SyncMetadata() once per operation rather than per block.
+    uint8_t** block_bitmaps;
+    uint8_t** inode_bitmaps;
+    uint8_t* bitmap_dirty;      // EXT2_BITMAP_* flags per group
+    int meta_dirty;
+    Ext2CachedInode* icache;
+    Ext2CachedInode* ihash[EXT2_ICACHE_BUCKETS];
+    Ext2CachedInode* ilru_head;
+    Ext2CachedInode* ilru_tail;
+    RustSpinLock* icache_lock;  // guards the hash, LRU and refcounts
     RustRwLock* lock;
 } Ext2Volume;
 
-// Per-device volume registry and active context
+#define EXT2_BITMAP_BLOCKS_DIRTY 0x1
+#define EXT2_BITMAP_INODES_DIRTY 0x2
+
+// Blocks reserved past each allocation for an open file, so appends stay
+// contiguous even when several files grow at once; unused ones are
+// returned on close.
+#define EXT2_PREALLOC_BLOCKS 8
+
+// Per-device volume registry; each mount passes its volume as fs_data
 static Ext2Volume* g_ext2_by_dev[MAX_BLOCK_DEVICES] = {0};
-static Ext2Volume* g_ext2_active = NULL;
-#define volume (*g_ext2_active)
+#define volume (*vol)
 
-void Ext2SetActive(BlockDevice* device) {
-    if (device == NULL) {
-        g_ext2_active = NULL;
-        return;
-    }
-    int id = device->id;
-    if (id < 0 || id >= MAX_BLOCK_DEVICES) {
-        g_ext2_active = NULL;
-        return;
-    }
-    Ext2Volume* vol = g_ext2_by_dev[id];
-    if (!vol->lock) return;
-    rust_rwlock_write_lock(vol->lock, GetCurrentProcess()->pid);
-    g_ext2_active = vol;
-    rust_rwlock_write_unlock(vol->lock);
-}
+// Indirect blocks an open file keeps in memory: enough for one full path
+// through the triple-indirect tree plus a spare, so sequential access
+// re-reads none of them. Several files can be open on one inode, so each
+// records the inode's map_gen its copies belong to and drops them as soon
+// as another one has changed the block map.
+#define EXT2_IND_CACHE_SLOTS 4
+
+typedef struct {
+    uint32_t block;     // disk block held, 0 if the slot is empty
+    uint32_t* table;    // block_size / 4 block numbers
+    uint32_t last_use;
+    int dirty;
+} Ext2IndSlot;
+
+typedef struct {
+    Ext2Volume* vol;
+    uint32_t inode_num;
+    Ext2CachedInode* ci;        // pinned for as long as the file is open
+    Ext2Inode* inode;           // &ci->inode
+    uint32_t ind_tick;
+    uint32_t ind_gen;           // ci->map_gen the cached indirect blocks match
+    Ext2IndSlot ind[EXT2_IND_CACHE_SLOTS];
+    uint32_t alloc_goal;        // block after the last one allocated, 0 if none yet
+    uint32_t prealloc_start;
+    uint32_t prealloc_count;
+} Ext2File;
+
+static void Ext2TruncateBlocks(Ext2Volume* vol, Ext2Inode* inode, uint64_t first_index);
+static int Ext2SyncMetadata(Ext2Volume* vol);
+static void Ext2FreeBitmaps(Ext2Volume* vol);
+static int Ext2ICacheInit(Ext2Volume* vol);
+static void Ext2ICacheFree(Ext2Volume* vol);
+static uint64_t Ext2Span(Ext2Volume* vol, uint32_t depth);
+static Ext2File* Ext2FileGet(Ext2Volume* vol, uint32_t inode_num);
+static int Ext2FileFlush(Ext2File* file);
+static void Ext2FileTruncateBlocks(Ext2File* file, uint64_t first_index);
+static int Ext2BlockMap(Ext2File* file, uint64_t index, int create, uint32_t* out, int* fresh);
 
 int Ext2Detect(BlockDevice* device) {
     PrintKernel("EXT2: Detecting EXT2 on device ");
     PrintKernel(device->name);
     PrintKernel("\n");
+    if (device->block_size != 512) return 0; // superblock is read as sectors 2-3
 
     uint8_t sb_buffer[1024];
-    int read_result = BlockDeviceRead(device->id, 2, 2, sb_buffer);
+    int read_result = BlockCacheRead(device->id, 2, 2, sb_buffer);
     if (read_result != 0) {
         PrintKernel("EXT2: Failed to read superblock from device ");
         PrintKernel(device->name);
@@ -83,16 +148,17 @@ int Ext2Detect(BlockDevice* device) {
 }
 
 
-static int Ext2WriteBlock(uint32_t block, const void* buffer) {
+// Writes `count` consecutive blocks starting at `block` in one request
+static int Ext2WriteBlocks(Ext2Volume* vol, uint32_t block, uint32_t count, const void* buffer) {
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
-    if (block >= volume.superblock.s_blocks_count) {
-        PrintKernelF("EXT2: Block %u out of bounds (max: %u)",
-                     block, volume.superblock.s_blocks_count - 1);
+    if (block >= volume.superblock.s_blocks_count || count > volume.superblock.s_blocks_count - block) {
+        PrintKernelF("EXT2: Block %u+%u out of bounds (max: %u)",
+                     block, count, volume.superblock.s_blocks_count - 1);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
     uint32_t num_sectors   = volume.block_size / 512;
-    if (BlockDeviceWrite(volume.device->id, block * num_sectors, num_sectors, buffer) != 0) {
+    if (BlockCacheWrite(volume.device->id, (uint64_t)block * num_sectors, count * num_sectors, buffer) != 0) {
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
@@ -100,17 +166,21 @@ static int Ext2WriteBlock(uint32_t block, const void* buffer) {
     return 0;
 }
 
-// Helper to read a block from the disk
-int Ext2ReadBlock(uint32_t block, void* buffer) {
+static int Ext2WriteBlock(Ext2Volume* vol, uint32_t block, const void* buffer) {
+    return Ext2WriteBlocks(vol, block, 1, buffer);
+}
+
+// Reads `count` consecutive blocks starting at `block` in one request
+static int Ext2ReadBlocks(Ext2Volume* vol, uint32_t block, uint32_t count, void* buffer) {
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
-    if (block >= volume.superblock.s_blocks_count) {
-        PrintKernelF("EXT2: Block %u out of bounds (max: %u)",
-                     block, volume.superblock.s_blocks_count - 1);
+    if (block >= volume.superblock.s_blocks_count || count > volume.superblock.s_blocks_count - block) {
+        PrintKernelF("EXT2: Block %u+%u out of bounds (max: %u)",
+                     block, count, volume.superblock.s_blocks_count - 1);
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return -1;
     }
     uint32_t num_sectors   = volume.block_size / 512;
-    if (BlockDeviceRead(volume.device->id, block * num_sectors, num_sectors, buffer) != 0) {
+    if (BlockCacheRead(volume.device->id, (uint64_t)block * num_sectors, count * num_sectors, buffer) != 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return -1;
     }
@@ -118,7 +188,10 @@ int Ext2ReadBlock(uint32_t block, void* buffer) {
     return 0;
 }
 
-static FileSystemDriver ext2_driver = {"EXT2", Ext2Detect, Ext2Mount, Ext2Unmount};
+// Helper to read a block from the disk
+int Ext2ReadBlock(Ext2Volume* vol, uint32_t block, void* buffer) {
+    return Ext2ReadBlocks(vol, block, 1, buffer);
+}
 
 int Ext2Mount(BlockDevice* device, const char* mount_point) {
     // Prepare or reuse per-device volume
@@ -140,7 +213,6 @@ int Ext2Mount(BlockDevice* device, const char* mount_point) {
         FastMemset(vol, 0, sizeof(Ext2Volume));
         g_ext2_by_dev[device->id] = vol;
     }
-    g_ext2_active = vol; // Set active for init path below via `volume` macro
 
     if (!volume.lock) volume.lock = rust_rwlock_new();
     if (!volume.lock) {
@@ -151,7 +223,7 @@ int Ext2Mount(BlockDevice* device, const char* mount_point) {
     volume.device = device;
 
     uint8_t sb_buffer[1024];
-    if (BlockDeviceRead(device->id, 2, 2, sb_buffer) != 0) {
+    if (BlockCacheRead(device->id, 2, 2, sb_buffer) != 0) {
         PrintKernelF("EXT2: Failed to read superblock.\n");
         rust_rwlock_write_unlock(volume.lock);
         return -1;
@@ -200,7 +272,7 @@ int Ext2Mount(BlockDevice* device, const char* mount_point) {
     // Read each BGDT block into buffer
     uint32_t bgdt_block = (volume.block_size == 1024) ? 2 : 1;
     for (uint32_t i = 0; i < bgdt_blocks; ++i) {
-        if (Ext2ReadBlock(bgdt_block + i, bgdt_buffer + i * volume.block_size) != 0) {
+        if (Ext2ReadBlock(vol, bgdt_block + i, bgdt_buffer + i * volume.block_size) != 0) {
             PrintKernelF("EXT2: Failed to read BGD table.\n");
             KernelFree(bgdt_buffer);
             rust_rwlock_write_unlock(volume.lock);
@@ -209,11 +281,37 @@ int Ext2Mount(BlockDevice* device, const char* mount_point) {
     }
     // Assign descriptor pointer to the allocated buffer
     volume.group_descs = (Ext2GroupDesc*)bgdt_buffer;
+    volume.gdt_blocks = bgdt_blocks;
+
+    volume.block_bitmaps = KernelMemoryAlloc(volume.num_groups * sizeof(uint8_t*));
+    volume.inode_bitmaps = KernelMemoryAlloc(volume.num_groups * sizeof(uint8_t*));
+    volume.bitmap_dirty = KernelMemoryAlloc(volume.num_groups);
+    if (!volume.block_bitmaps || !volume.inode_bitmaps || !volume.bitmap_dirty) {
+        PrintKernelF("EXT2: Failed to allocate bitmap cache.\n");
+        Ext2FreeBitmaps(vol);
+        KernelFree(volume.group_descs);
+        volume.group_descs = NULL;
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
+    FastMemset(volume.block_bitmaps, 0, volume.num_groups * sizeof(uint8_t*));
+    FastMemset(volume.inode_bitmaps, 0, volume.num_groups * sizeof(uint8_t*));
+    FastMemset(volume.bitmap_dirty, 0, volume.num_groups);
+    if (Ext2ICacheInit(vol) != 0) {
+        PrintKernelF("EXT2: Failed to allocate inode cache.\n");
+        Ext2FreeBitmaps(vol);
+        KernelFree(volume.group_descs);
+        volume.group_descs = NULL;
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
 
     PrintKernelF("EXT2: Mounting filesystem...\n");
     VfsCreateDir(mount_point);
-    if (VfsMount(mount_point, device, &ext2_driver) != 0) {
+    if (VfsMount(mount_point, device, &g_ext2_driver, vol) != 0) {
         PrintKernelF("EXT2: Failed to register mount point %s\n", mount_point);
+        Ext2FreeBitmaps(vol);
+        Ext2ICacheFree(vol);
         KernelFree(volume.group_descs);
         volume.group_descs = NULL;
         volume.device = NULL;
@@ -237,14 +335,15 @@ int Ext2Unmount(BlockDevice* device) {
     if (lock) {
         rust_rwlock_write_lock(lock, GetCurrentProcess()->pid);
     }
-    if (g_ext2_active == vol) {
-        g_ext2_active = NULL;
-    }
+    Ext2SyncMetadata(vol);
+    Ext2FreeBitmaps(vol);
+    Ext2ICacheFree(vol);
     if (vol->group_descs) {
         KernelFree(vol->group_descs);
         vol->group_descs = NULL;
     }
     g_ext2_by_dev[device_id] = NULL;
+    DCachePurge(vol);
     if (lock) {
         rust_rwlock_write_unlock(lock);
         rust_rwlock_free(lock);
@@ -253,7 +352,7 @@ int Ext2Unmount(BlockDevice* device) {
     return 0;
 }
 
-int Ext2ReadInode(uint32_t inode_num, Ext2Inode* inode) {
+static int Ext2ReadInodeDisk(Ext2Volume* vol, uint32_t inode_num, Ext2Inode* inode) {
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
     if (inode_num == 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
@@ -278,7 +377,7 @@ int Ext2ReadInode(uint32_t inode_num, Ext2Inode* inode) {
         return -1;
     }
 
-    if (Ext2ReadBlock(inode_table_block + block_offset, block_buffer) != 0) {
+    if (Ext2ReadBlock(vol, inode_table_block + block_offset, block_buffer) != 0) {
         KernelFree(block_buffer);
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return -1;
@@ -291,7 +390,7 @@ int Ext2ReadInode(uint32_t inode_num, Ext2Inode* inode) {
     return 0;
 }
 
-static int Ext2WriteInode(uint32_t inode_num, Ext2Inode* inode) {
+static int Ext2WriteInodeDisk(Ext2Volume* vol, uint32_t inode_num, const Ext2Inode* inode) {
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
     if (inode_num == 0) {
         rust_rwlock_write_unlock(volume.lock);
@@ -317,7 +416,7 @@ static int Ext2WriteInode(uint32_t inode_num, Ext2Inode* inode) {
     }
 
     // Read-modify-write the block containing the inode
-    if (Ext2ReadBlock(inode_table_block + block_offset, block_buffer) != 0) {
+    if (Ext2ReadBlock(vol, inode_table_block + block_offset, block_buffer) != 0) {
         KernelFree(block_buffer);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
@@ -325,7 +424,7 @@ static int Ext2WriteInode(uint32_t inode_num, Ext2Inode* inode) {
 
     FastMemcpy(block_buffer + offset_in_block, inode, sizeof(Ext2Inode));
 
-    if (Ext2WriteBlock(inode_table_block + block_offset, block_buffer) != 0) {
+    if (Ext2WriteBlock(vol, inode_table_block + block_offset, block_buffer) != 0) {
         KernelFree(block_buffer);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
@@ -336,8 +435,548 @@ static int Ext2WriteInode(uint32_t inode_num, Ext2Inode* inode) {
     return 0;
 }
 
+static int Ext2ICacheInit(Ext2Volume* vol) {
+    volume.icache = KernelMemoryAlloc(EXT2_ICACHE_ENTRIES * sizeof(Ext2CachedInode));
+    volume.icache_lock = rust_spinlock_new();
+    if (!volume.icache || !volume.icache_lock) {
+        Ext2ICacheFree(vol);
+        return -1;
+    }
+    FastMemset(volume.icache, 0, EXT2_ICACHE_ENTRIES * sizeof(Ext2CachedInode));
+    FastMemset(volume.ihash, 0, sizeof(volume.ihash));
+    volume.ilru_head = volume.ilru_tail = NULL;
+    for (int i = 0; i < EXT2_ICACHE_ENTRIES; i++) {
+        Ext2CachedInode* ci = &volume.icache[i];
+        ci->prev = volume.ilru_tail;
+        if (volume.ilru_tail) volume.ilru_tail->next = ci;
+        else volume.ilru_head = ci;
+        volume.ilru_tail = ci;
+    }
+    return 0;
+}
+
+static void Ext2ICacheFree(Ext2Volume* vol) {
+    if (volume.icache) KernelFree(volume.icache);
+    if (volume.icache_lock) rust_spinlock_free(volume.icache_lock);
+    volume.icache = NULL;
+    volume.icache_lock = NULL;
+}
+
+// Moves ci to the head of the LRU list; icache_lock held
+static void Ext2ITouch(Ext2Volume* vol, Ext2CachedInode* ci) {
+    if (volume.ilru_head == ci) return;
+    if (ci->prev) ci->prev->next = ci->next;
+    if (ci->next) ci->next->prev = ci->prev;
+    else volume.ilru_tail = ci->prev;
+    ci->prev = NULL;
+    ci->next = volume.ilru_head;
+    volume.ilru_head->prev = ci;
+    volume.ilru_head = ci;
+}
+
+static Ext2CachedInode* Ext2IFindLocked(Ext2Volume* vol, uint32_t inode_num) {
+    for (Ext2CachedInode* ci = volume.ihash[inode_num % EXT2_ICACHE_BUCKETS]; ci; ci = ci->hash_next) {
+        if (ci->inode_num == inode_num && !ci->unlinked) return ci;
+    }
+    return NULL;
+}
+
+// Returns a referenced cache entry for inode_num, recycling the least
+// recently used clean and unreferenced entry on a miss. The entry is read
+// from disk when `load` is set; otherwise the caller is about to overwrite
+// it. NULL if the inode cannot be read or no entry can be recycled.
+static Ext2CachedInode* Ext2IGet(Ext2Volume* vol, uint32_t inode_num, int load) {
+    if (!volume.icache || inode_num == 0 || inode_num > volume.superblock.s_inodes_count) return NULL;
+
+    rust_spinlock_lock(volume.icache_lock);
+    Ext2CachedInode* ci = Ext2IFindLocked(vol, inode_num);
+    if (ci) {
+        ci->refcount++;
+        Ext2ITouch(vol, ci);
+        rust_spinlock_unlock(volume.icache_lock);
+        return ci;
+    }
+    rust_spinlock_unlock(volume.icache_lock);
+
+    Ext2Inode disk_inode;
+    if (load && Ext2ReadInodeDisk(vol, inode_num, &disk_inode) != 0) return NULL;
+
+    rust_spinlock_lock(volume.icache_lock);
+    ci = Ext2IFindLocked(vol, inode_num); // Another reader may have won the race
+    if (!ci) {
+        // The new entry supersedes a deleted one still pinned under this number
+        for (ci = volume.ihash[inode_num % EXT2_ICACHE_BUCKETS]; ci; ci = ci->hash_next) {
+            if (ci->inode_num == inode_num) ci->dirty = 0;
+        }
+        for (ci = volume.ilru_tail; ci && (ci->refcount || ci->dirty); ci = ci->prev) {}
+        if (!ci) {
+            rust_spinlock_unlock(volume.icache_lock);
+            return NULL;
+        }
+        if (ci->inode_num) {
+            Ext2CachedInode** link = &volume.ihash[ci->inode_num % EXT2_ICACHE_BUCKETS];
+            while (*link != ci) link = &(*link)->hash_next;
+            *link = ci->hash_next;
+        }
+        ci->inode_num = inode_num;
+        ci->unlinked = 0;
+        ci->hash_next = volume.ihash[inode_num % EXT2_ICACHE_BUCKETS];
+        volume.ihash[inode_num % EXT2_ICACHE_BUCKETS] = ci;
+        if (load) ci->inode = disk_inode;
+        else FastMemset(&ci->inode, 0, sizeof(Ext2Inode));
+    }
+    ci->refcount++;
+    Ext2ITouch(vol, ci);
+    rust_spinlock_unlock(volume.icache_lock);
+    return ci;
+}
+
+static void Ext2IPut(Ext2Volume* vol, Ext2CachedInode* ci) {
+    rust_spinlock_lock(volume.icache_lock);
+    ci->refcount--;
+    rust_spinlock_unlock(volume.icache_lock);
+}
+
+// The inode was freed; open handles keep the entry until they close
+static void Ext2IUnlink(Ext2Volume* vol, uint32_t inode_num) {
+    rust_spinlock_lock(volume.icache_lock);
+    Ext2CachedInode* ci = Ext2IFindLocked(vol, inode_num);
+    if (ci) ci->unlinked = 1;
+    rust_spinlock_unlock(volume.icache_lock);
+}
+
+int Ext2ReadInode(Ext2Volume* vol, uint32_t inode_num, Ext2Inode* inode) {
+    rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
+    Ext2CachedInode* ci = Ext2IGet(vol, inode_num, 1);
+    int result = 0;
+    if (ci) {
+        *inode = ci->inode;
+        Ext2IPut(vol, ci);
+    } else {
+        result = Ext2ReadInodeDisk(vol, inode_num, inode); // Cache full of pinned/dirty entries
+    }
+    rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
+    return result;
+}
+
+// Updates the cached inode; it reaches the inode table on the next
+// Ext2SyncMetadata(), or immediately if it cannot be cached
+static int Ext2WriteInode(Ext2Volume* vol, uint32_t inode_num, Ext2Inode* inode) {
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+    Ext2CachedInode* ci = Ext2IGet(vol, inode_num, 0);
+    int result = 0;
+    if (ci) {
+        ci->inode = *inode;
+        ci->dirty = 1;
+        ci->map_gen++;
+        Ext2IPut(vol, ci);
+    } else {
+        result = Ext2WriteInodeDisk(vol, inode_num, inode);
+    }
+    rust_rwlock_write_unlock(volume.lock);
+    return result;
+}
+
+// Directory index hashes, bit-compatible with ext3/ext4
+
+static uint32_t Ext2DxHackHash(const char* name, uint32_t len, int unsigned_chars) {
+    uint32_t hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+    for (uint32_t i = 0; i < len; i++) {
+        const int c = unsigned_chars ? (int)(uint8_t)name[i] : (int)(int8_t)name[i];
+        uint32_t hash = hash1 + (hash0 ^ (uint32_t)(c * 7152373));
+        if (hash & 0x80000000) hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+// Packs up to num * 4 bytes of the name into words, padded with its length
+static void Ext2DxStr2HashBuf(const char* msg, int len, uint32_t* buf, int num, int unsigned_chars) {
+    uint32_t pad = (uint32_t)len | ((uint32_t)len << 8);
+    pad |= pad << 16;
+    uint32_t val = pad;
+    if (len > num * 4) len = num * 4;
+    for (int i = 0; i < len; i++) {
+        const int c = unsigned_chars ? (int)(uint8_t)msg[i] : (int)(int8_t)msg[i];
+        val = (uint32_t)c + (val << 8);
+        if ((i % 4) == 3) {
+            *buf++ = val;
+            val = pad;
+            num--;
+        }
+    }
+    if (--num >= 0) *buf++ = val;
+    while (--num >= 0) *buf++ = pad;
+}
+
+static inline uint32_t Ext2Rol32(uint32_t x, uint32_t s) {
+    return (x << s) | (x >> (32 - s));
+}
+
+#define MD4_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD4_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define MD4_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD4_ROUND(f, a, b, c, d, x, s) (a += f(b, c, d) + (x), a = Ext2Rol32(a, s))
+#define MD4_K2 013240474631U
+#define MD4_K3 015666365641U
+
+static void Ext2DxHalfMd4(uint32_t buf[4], const uint32_t in[8]) {
+    uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+    MD4_ROUND(MD4_F, a, b, c, d, in[0], 3);
+    MD4_ROUND(MD4_F, d, a, b, c, in[1], 7);
+    MD4_ROUND(MD4_F, c, d, a, b, in[2], 11);
+    MD4_ROUND(MD4_F, b, c, d, a, in[3], 19);
+    MD4_ROUND(MD4_F, a, b, c, d, in[4], 3);
+    MD4_ROUND(MD4_F, d, a, b, c, in[5], 7);
+    MD4_ROUND(MD4_F, c, d, a, b, in[6], 11);
+    MD4_ROUND(MD4_F, b, c, d, a, in[7], 19);
+
+    MD4_ROUND(MD4_G, a, b, c, d, in[1] + MD4_K2, 3);
+    MD4_ROUND(MD4_G, d, a, b, c, in[3] + MD4_K2, 5);
+    MD4_ROUND(MD4_G, c, d, a, b, in[5] + MD4_K2, 9);
+    MD4_ROUND(MD4_G, b, c, d, a, in[7] + MD4_K2, 13);
+    MD4_ROUND(MD4_G, a, b, c, d, in[0] + MD4_K2, 3);
+    MD4_ROUND(MD4_G, d, a, b, c, in[2] + MD4_K2, 5);
+    MD4_ROUND(MD4_G, c, d, a, b, in[4] + MD4_K2, 9);
+    MD4_ROUND(MD4_G, b, c, d, a, in[6] + MD4_K2, 13);
+
+    MD4_ROUND(MD4_H, a, b, c, d, in[3] + MD4_K3, 3);
+    MD4_ROUND(MD4_H, d, a, b, c, in[7] + MD4_K3, 9);
+    MD4_ROUND(MD4_H, c, d, a, b, in[2] + MD4_K3, 11);
+    MD4_ROUND(MD4_H, b, c, d, a, in[6] + MD4_K3, 15);
+    MD4_ROUND(MD4_H, a, b, c, d, in[1] + MD4_K3, 3);
+    MD4_ROUND(MD4_H, d, a, b, c, in[5] + MD4_K3, 9);
+    MD4_ROUND(MD4_H, c, d, a, b, in[0] + MD4_K3, 11);
+    MD4_ROUND(MD4_H, b, c, d, a, in[4] + MD4_K3, 15);
+
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+#undef MD4_F
+#undef MD4_G
+#undef MD4_H
+#undef MD4_ROUND
+#undef MD4_K2
+#undef MD4_K3
+
+static void Ext2DxTea(uint32_t buf[4], const uint32_t in[4]) {
+    uint32_t sum = 0;
+    uint32_t b0 = buf[0], b1 = buf[1];
+    for (int n = 0; n < 16; n++) {
+        sum += 0x9E3779B9;
+        b0 += ((b1 << 4) + in[0]) ^ (b1 + sum) ^ ((b1 >> 5) + in[1]);
+        b1 += ((b0 << 4) + in[2]) ^ (b0 + sum) ^ ((b0 >> 5) + in[3]);
+    }
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
+// Major hash of a name under an index's hash version. The low bit is
+// always clear; index entries use it to flag a collision chain that
+// continues from the previous leaf.
+static uint32_t Ext2DxHash(Ext2Volume* vol, uint32_t version, const char* name, uint32_t len) {
+    uint32_t buf[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    uint32_t in[8];
+    uint32_t seed[4];
+    FastMemcpy(seed, volume.superblock.s_hash_seed, sizeof(seed)); // packed superblock
+    if (seed[0] | seed[1] | seed[2] | seed[3]) FastMemcpy(buf, seed, sizeof(buf));
+    if (version <= EXT2_DX_HASH_TEA && (volume.superblock.s_flags & EXT2_FLAGS_UNSIGNED_HASH)) {
+        version += EXT2_DX_HASH_LEGACY_UNSIGNED;
+    }
+    const int unsigned_chars = version >= EXT2_DX_HASH_LEGACY_UNSIGNED;
+
+    uint32_t hash;
+    switch (version) {
+        case EXT2_DX_HASH_HALF_MD4:
+        case EXT2_DX_HASH_HALF_MD4_UNSIGNED:
+            for (int left = (int)len; left > 0; left -= 32, name += 32) {
+                Ext2DxStr2HashBuf(name, left, in, 8, unsigned_chars);
+                Ext2DxHalfMd4(buf, in);
+            }
+            hash = buf[1];
+            break;
+        case EXT2_DX_HASH_TEA:
+        case EXT2_DX_HASH_TEA_UNSIGNED:
+            for (int left = (int)len; left > 0; left -= 16, name += 16) {
+                Ext2DxStr2HashBuf(name, left, in, 4, unsigned_chars);
+                Ext2DxTea(buf, in);
+            }
+            hash = buf[0];
+            break;
+        default:
+            hash = Ext2DxHackHash(name, len, unsigned_chars);
+            break;
+    }
+    hash &= ~1u;
+    if (hash == 0xFFFFFFFE) hash = 0xFFFFFFFC; // Reserved as the end-of-directory cookie
+    return hash;
+}
+
+// Disk block backing logical block `index` of an inode, 0 for a hole or
+// an unreadable indirect block. Read-only counterpart of Ext2BlockMap for
+// inodes without an open file, such as directories being searched.
+static uint32_t Ext2InodeBlock(Ext2Volume* vol, const Ext2Inode* inode, uint64_t index) {
+    if (index < EXT2_NDIR_BLOCKS) return inode->i_block[index];
+
+    index -= EXT2_NDIR_BLOCKS;
+    uint32_t depth;
+    for (depth = 1; depth <= 3; depth++) {
+        const uint64_t span = Ext2Span(vol, depth);
+        if (index < span) break;
+        index -= span;
+    }
+    if (depth > 3) return 0;
+
+    uint32_t block = inode->i_block[EXT2_IND_BLOCK + depth - 1];
+    if (block == 0) return 0;
+    uint32_t* table = KernelMemoryAlloc(volume.block_size);
+    if (!table) return 0;
+    while (block && depth > 0) {
+        if (Ext2ReadBlock(vol, block, table) != 0) {
+            block = 0;
+            break;
+        }
+        depth--;
+        const uint64_t child_span = Ext2Span(vol, depth);
+        block = table[(index / child_span) % (volume.block_size / 4)];
+    }
+    KernelFree(table);
+    return block;
+}
+
+// Space a directory entry with an n-byte name occupies
+#define EXT2_DIR_REC_LEN(n) ((8 + (uint32_t)(n) + 3) & ~3u)
+
+// Entry `name` in one directory block, or NULL; a malformed rec_len ends the scan
+static Ext2DirEntry* Ext2BlockFindEntry(Ext2Volume* vol, uint8_t* block, const char* name, uint32_t len) {
+    uint32_t offset = 0;
+    while (offset + 8 <= volume.block_size) {
+        Ext2DirEntry* entry = (Ext2DirEntry*)(block + offset);
+        if (entry->rec_len < 8 || offset + entry->rec_len > volume.block_size) break;
+        if (entry->inode != 0 && entry->name_len == len && FastMemcmp(entry->name, name, len) == 0) {
+            return entry;
+        }
+        offset += entry->rec_len;
+    }
+    return NULL;
+}
+
+// Unlinks entry `name` from one directory block by merging its record
+// into the previous one (or, for the first record, marking it unused)
+static int Ext2BlockRemoveEntry(Ext2Volume* vol, uint8_t* block, const char* name, uint32_t len) {
+    Ext2DirEntry* entry = Ext2BlockFindEntry(vol, block, name, len);
+    if (!entry) return 0;
+    Ext2DirEntry* prev = NULL;
+    for (uint32_t offset = 0; block + offset != (uint8_t*)entry; offset += prev->rec_len) {
+        prev = (Ext2DirEntry*)(block + offset);
+    }
+    if (prev) prev->rec_len += entry->rec_len;
+    else entry->inode = 0;
+    return 1;
+}
+
+// Stores a new entry in the first gap of one directory block large enough
+// for it, splitting the record that owns the gap. Returns 0 if the block
+// is full.
+static int Ext2BlockAddEntry(Ext2Volume* vol, uint8_t* block, const char* name, uint32_t len,
+                             uint32_t inode_num, uint8_t file_type) {
+    const uint32_t needed = EXT2_DIR_REC_LEN(len);
+    uint32_t offset = 0;
+    while (offset + 8 <= volume.block_size) {
+        Ext2DirEntry* entry = (Ext2DirEntry*)(block + offset);
+        if (entry->rec_len < 8 || offset + entry->rec_len > volume.block_size) return 0;
+        const uint32_t used = entry->inode ? EXT2_DIR_REC_LEN(entry->name_len) : 0;
+        if (entry->rec_len >= used + needed) {
+            Ext2DirEntry* slot = entry;
+            if (used) {
+                slot = (Ext2DirEntry*)((uint8_t*)entry + used);
+                slot->rec_len = entry->rec_len - used;
+                entry->rec_len = used;
+            }
+            slot->inode = inode_num;
+            slot->name_len = len;
+            slot->file_type = file_type;
+            FastMemcpy(slot->name, name, len);
+            return 1;
+        }
+        offset += entry->rec_len;
+    }
+    return 0;
+}
+
+// An index is only trusted on volumes that advertise dir_index; elsewhere
+// the flag may be stale and the directory is scanned linearly
+static int Ext2DxIndexed(Ext2Volume* vol, const Ext2Inode* dir) {
+    return (volume.superblock.s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX) && (dir->i_flags & EXT2_INDEX_FL);
+}
+
+// One index block on the path from the root to a leaf
+#define EXT2_DX_MAX_LEVELS 3    // the root and up to two interior levels
+#define EXT2_DX_BLOCK(e) ((e)->block & 0x0FFFFFFF)
+
+typedef struct {
+    uint8_t* data;
+    uint32_t block;         // disk block of `data`
+    Ext2DxEntry* entries;   // entries[0] holds the count/limit header
+    Ext2DxEntry* at;        // entry followed towards the leaf
+} Ext2DxFrame;
+
+static inline Ext2DxCountLimit* Ext2DxCount(const Ext2DxFrame* frame) {
+    return (Ext2DxCountLimit*)frame->entries;
+}
+
+static void Ext2DxRelease(Ext2DxFrame* frames, uint32_t levels) {
+    for (uint32_t i = 0; i < levels; i++) KernelFree(frames[i].data);
+}
+
+// Points a frame at the entry array of its freshly read index block,
+// checking the header against the space the block has for entries
+static int Ext2DxFrameInit(Ext2Volume* vol, Ext2DxFrame* frame, uint32_t offset) {
+    frame->entries = (Ext2DxEntry*)(frame->data + offset);
+    frame->at = frame->entries;
+    const Ext2DxCountLimit* cl = Ext2DxCount(frame);
+    if (cl->limit != (volume.block_size - offset) / sizeof(Ext2DxEntry)) return -1;
+    return (cl->count == 0 || cl->count > cl->limit) ? -1 : 0;
+}
+
+// Walks the index from the root to the leaf covering `name`, filling one
+// frame per level, and returns the number of levels with the name's hash
+// in *hash_out. Returns 0 if the index is damaged or unreadable; callers
+// then fall back to treating the directory as linear.
+static uint32_t Ext2DxProbe(Ext2Volume* vol, const Ext2Inode* dir, const char* name, uint32_t len,
+                            uint32_t* hash_out, Ext2DxFrame* frames) {
+    uint32_t levels = 0, depth = 0, hash = 0, logical = 0;
+    for (;;) {
+        Ext2DxFrame* frame = &frames[levels];
+        frame->block = Ext2InodeBlock(vol, dir, logical);
+        if (frame->block == 0 || !(frame->data = KernelMemoryAlloc(volume.block_size))) break;
+        levels++;
+        if (Ext2ReadBlock(vol, frame->block, frame->data) != 0) break;
+
+        uint32_t offset = 8; // Interior nodes start with one empty dirent
+        if (levels == 1) {
+            const Ext2DxRootInfo* info = (const Ext2DxRootInfo*)(frame->data + 24);
+            if (info->reserved_zero != 0 || info->info_length != 8 ||
+                info->hash_version > EXT2_DX_HASH_TEA || info->indirect_levels >= EXT2_DX_MAX_LEVELS) {
+                break;
+            }
+            depth = info->indirect_levels;
+            hash = Ext2DxHash(vol, info->hash_version, name, len);
+            offset = 24 + info->info_length;
+        }
+        if (Ext2DxFrameInit(vol, frame, offset) != 0) break;
+
+        // Last entry whose hash is <= ours; entry 0 covers everything below entry 1
+        uint32_t lo = 1, hi = Ext2DxCount(frame)->count;
+        while (lo < hi) {
+            const uint32_t mid = lo + (hi - lo) / 2;
+            if (frame->entries[mid].hash > hash) hi = mid;
+            else lo = mid + 1;
+        }
+        frame->at = &frame->entries[lo - 1];
+        logical = EXT2_DX_BLOCK(frame->at);
+
+        if (levels > depth) {
+            *hash_out = hash;
+            return levels;
+        }
+    }
+    Ext2DxRelease(frames, levels);
+    return 0;
+}
+
+// Advances the frames to the next leaf when it continues `hash` (a run of
+// colliding names split across leaves). Returns 1 if it did, 0 if the
+// hash ends here and -1 on a read error.
+static int Ext2DxNext(Ext2Volume* vol, const Ext2Inode* dir, Ext2DxFrame* frames, uint32_t levels, uint32_t hash) {
+    int level = (int)levels - 1;
+    while (level >= 0 && frames[level].at + 1 >= frames[level].entries + Ext2DxCount(&frames[level])->count) {
+        level--;
+    }
+    if (level < 0) return 0;
+    frames[level].at++;
+    if ((frames[level].at->hash & ~1u) != hash) return 0;
+
+    for (uint32_t l = level + 1; l < levels; l++) {
+        Ext2DxFrame* frame = &frames[l];
+        frame->block = Ext2InodeBlock(vol, dir, EXT2_DX_BLOCK(frames[l - 1].at));
+        if (frame->block == 0 || Ext2ReadBlock(vol, frame->block, frame->data) != 0) return -1;
+        if (Ext2DxFrameInit(vol, frame, 8) != 0) return -1;
+    }
+    return 1;
+}
+
+// Looks `name` up through the directory's hash index. Returns -1 if the
+// index cannot be used, else 0 with *ino set (0 when absent) and, on a
+// hit, the entry's block left in `buf` and its disk block in *block_out.
+static int Ext2DxLookup(Ext2Volume* vol, const Ext2Inode* dir, const char* name, uint32_t len,
+                        uint8_t* buf, uint32_t* ino, uint32_t* block_out) {
+    Ext2DxFrame frames[EXT2_DX_MAX_LEVELS];
+    uint32_t hash;
+    const uint32_t levels = Ext2DxProbe(vol, dir, name, len, &hash, frames);
+    if (!levels) return -1;
+
+    int result = 0;
+    *ino = 0;
+    for (;;) {
+        const uint32_t block = Ext2InodeBlock(vol, dir, EXT2_DX_BLOCK(frames[levels - 1].at));
+        if (block == 0 || Ext2ReadBlock(vol, block, buf) != 0) {
+            result = -1;
+            break;
+        }
+        const Ext2DirEntry* entry = Ext2BlockFindEntry(vol, buf, name, len);
+        if (entry) {
+            *ino = entry->inode;
+            *block_out = block;
+            break;
+        }
+        const int next = Ext2DxNext(vol, dir, frames, levels, hash);
+        if (next <= 0) {
+            if (next < 0) result = -1;
+            break;
+        }
+    }
+    Ext2DxRelease(frames, levels);
+    return result;
+}
+
+// Finds `name` in a directory, through its hash index when it has a
+// usable one and by scanning every block otherwise. On a hit the block
+// holding the entry is left in `buf` and its disk block in *block_out.
+// *complete is cleared when part of the directory could not be read.
+static uint32_t Ext2DirLookup(Ext2Volume* vol, const Ext2Inode* dir, const char* name, uint32_t len,
+                              uint8_t* buf, uint32_t* block_out, int* complete) {
+    *complete = 1;
+    uint32_t ino;
+    if (Ext2DxIndexed(vol, dir) && Ext2DxLookup(vol, dir, name, len, buf, &ino, block_out) == 0) return ino;
+
+    const uint32_t nblocks = dir->i_size / volume.block_size;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        const uint32_t block = Ext2InodeBlock(vol, dir, i);
+        if (block == 0) continue;
+        if (Ext2ReadBlock(vol, block, buf) != 0) {
+            *complete = 0;
+            continue;
+        }
+        const Ext2DirEntry* entry = Ext2BlockFindEntry(vol, buf, name, len);
+        if (entry) {
+            *block_out = block;
+            return entry->inode;
+        }
+    }
+    return 0;
+}
+
 // Find a directory entry in a directory inode
-uint32_t Ext2FindInDir(Ext2Inode* dir_inode, const char* name) {
+// *complete is cleared when part of the directory could not be read, in
+// which case a 0 result must not be remembered as a negative dentry
+uint32_t Ext2FindInDir(Ext2Volume* vol, Ext2Inode* dir_inode, const char* name, int* complete) {
+    *complete = 1;
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
     if (!S_ISDIR(dir_inode->i_mode)) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
@@ -346,39 +985,20 @@ uint32_t Ext2FindInDir(Ext2Inode* dir_inode, const char* name) {
 
     uint8_t* block_buffer = KernelMemoryAlloc(volume.block_size);
     if (!block_buffer) {
+        *complete = 0;
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return 0;
     }
 
-    for (int i = 0; i < 12; i++) { // Only direct blocks
-        if (dir_inode->i_block[i] == 0) continue;
-
-        if (Ext2ReadBlock(dir_inode->i_block[i], block_buffer) != 0) {
-            continue;
-        }
-
-        Ext2DirEntry* entry = (Ext2DirEntry*)block_buffer;
-        uint32_t offset = 0;
-        while (offset < volume.block_size && entry->rec_len > 0) {
-            if (entry->inode != 0 && entry->name_len == FastStrlen(name, 255)) {
-                if (FastMemcmp(entry->name, name, entry->name_len) == 0) {
-                    uint32_t inode_num = entry->inode;
-                    KernelFree(block_buffer);
-                    rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-                    return inode_num;
-                }
-            }
-            offset += entry->rec_len;
-            entry = (Ext2DirEntry*)((uint8_t*)block_buffer + offset);
-        }
-    }
+    uint32_t block;
+    const uint32_t inode_num = Ext2DirLookup(vol, dir_inode, name, FastStrlen(name, 255), block_buffer, &block, complete);
 
     KernelFree(block_buffer);
     rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-    return 0; // Not found
+    return inode_num;
 }
 
-uint32_t Ext2PathToInode(const char* path) {
+uint32_t Ext2PathToInode(Ext2Volume* vol, const char* path) {
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
 
 
@@ -387,13 +1007,10 @@ uint32_t Ext2PathToInode(const char* path) {
         return 2; // Root directory inode
     }
 
-    // Start from root inode
+    // Start from root inode; it is only read when a component misses the
+    // dentry cache and the directory has to be scanned
     uint32_t current_inode_num = 2;
     Ext2Inode current_inode;
-    if (Ext2ReadInode(current_inode_num, &current_inode) != 0) {
-        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-        return 0;
-    }
 
     char component[256];
     const char* p = path;
@@ -406,188 +1023,109 @@ uint32_t Ext2PathToInode(const char* path) {
             component[i++] = *p++;
         }
         component[i] = '\0';
+        if (*p == '/') p++;
 
-        if (!S_ISDIR(current_inode.i_mode)) {
-            rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-            return 0; // Not a directory, but path continues
+        uint64_t cached;
+        if (DCacheLookup(vol, current_inode_num, component, i, &cached)) {
+            current_inode_num = (uint32_t)cached;
+            if (current_inode_num == 0) break; // Known not to exist
+            continue;
         }
 
-        current_inode_num = Ext2FindInDir(&current_inode, component);
-        if (current_inode_num == 0) {
-            rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-            return 0; // Component not found
+        if (Ext2ReadInode(vol, current_inode_num, &current_inode) != 0) {
+            current_inode_num = 0;
+            break; // Failed to read directory inode
         }
-
-        if (Ext2ReadInode(current_inode_num, &current_inode) != 0) {
-            rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-            return 0; // Failed to read next inode
+        if (!S_ISDIR(current_inode.i_mode)) {
+            current_inode_num = 0;
+            break; // Not a directory, but path continues
         }
 
-        if (*p == '/') p++;
+        int complete;
+        const uint32_t child = Ext2FindInDir(vol, &current_inode, component, &complete);
+        if (child || complete) DCacheInsert(vol, current_inode_num, component, i, child);
+        current_inode_num = child;
+        if (current_inode_num == 0) break; // Component not found
     }
 
     rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
     return current_inode_num;
 }
 
-int Ext2ReadFile(const char* path, void* buffer, uint32_t max_size) {
-    rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
-
-    uint32_t inode_num = Ext2PathToInode(path);
-    if (inode_num == 0) {
-        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-        return -1; // Not found
-    }
-
-    Ext2Inode inode;
-    if (Ext2ReadInode(inode_num, &inode) != 0) {
-        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-        return -1; // Failed to read inode
-    }
-
-    if (!S_ISREG(inode.i_mode)) {
-        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-        return -1; // Not a regular file
-    }
-
-    uint32_t file_size = inode.i_size;
-    uint32_t bytes_to_read = (file_size < max_size) ? file_size : max_size;
-    uint32_t bytes_read = 0;
+// Regular files keep the high half of their size in i_dir_acl
+static uint64_t Ext2InodeSize(const Ext2Inode* inode) {
+    uint64_t size = inode->i_size;
+    if (S_ISREG(inode->i_mode)) size |= (uint64_t)inode->i_dir_acl << 32;
+    return size;
+}
 
-    uint8_t* block_buffer = KernelMemoryAlloc(volume.block_size);
-    if (!block_buffer) {
-        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-        return -1;
+static void Ext2SetFileSize(Ext2Volume* vol, Ext2Inode* inode, uint64_t size) {
+    inode->i_size = (uint32_t)size;
+    inode->i_dir_acl = (uint32_t)(size >> 32);
+    if (size > INT32_MAX && !(volume.superblock.s_feature_ro_compat & EXT2_FEATURE_RO_COMPAT_LARGE_FILE)) {
+        volume.superblock.s_feature_ro_compat |= EXT2_FEATURE_RO_COMPAT_LARGE_FILE;
+        volume.meta_dirty = 1;
     }
+}
 
-    // Only handle direct blocks for now
-    for (int i = 0; i < 12 && bytes_read < bytes_to_read; i++) {
-        if (inode.i_block[i] == 0) continue;
-
-        if (Ext2ReadBlock(inode.i_block[i], block_buffer) != 0) {
-            KernelFree(block_buffer);
-            rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-            return -1;
-        }
-
-        uint32_t remaining_in_block = volume.block_size;
-        uint32_t remaining_in_file = bytes_to_read - bytes_read;
-        uint32_t copy_size = (remaining_in_block < remaining_in_file) ? remaining_in_block : remaining_in_file;
-
-        FastMemcpy((uint8_t*)buffer + bytes_read, block_buffer, copy_size);
-        bytes_read += copy_size;
-    }
+int64_t Ext2ReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size) {
+    Ext2File* file = Ext2Open(fs_data, path, 0);
+    if (!file) return -1; // Not found or not a regular file
 
-    KernelFree(block_buffer);
-    rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
+    int64_t bytes_read = 0;
+    if (max_size > 0 && Ext2InodeSize(file->inode) > 0) bytes_read = Ext2ReadAt(file, 0, buffer, max_size);
+    Ext2Close(file);
     return bytes_read;
 }
 
-int Ext2WriteFile(const char* path, const void* buffer, uint32_t size) {
+// Replaces the file's contents, creating it if needed; blocks past the
+// new end of file are released.
+int64_t Ext2WriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size) {
+    Ext2Volume* vol = fs_data;
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
 
-    uint32_t inode_num = Ext2PathToInode(path);
-
-    // If file doesn't exist, create it automatically
-    if (inode_num == 0) {
-        if (Ext2CreateFile(path) != 0) {
-            PrintKernelF("EXT2: WriteFile: Failed to create file: %s\n", path);
-            rust_rwlock_write_unlock(volume.lock);
-            return -1;
-        }
-        inode_num = Ext2PathToInode(path);
-        if (inode_num == 0) {
-            PrintKernelF("EXT2: WriteFile: Failed to find created file: %s\n", path);
-            rust_rwlock_write_unlock(volume.lock);
-            return -1;
-        }
-    }
-
-    Ext2Inode inode;
-    if (Ext2ReadInode(inode_num, &inode) != 0) {
-        rust_rwlock_write_unlock(volume.lock);
-        return -1;
-    }
-
-    if (!S_ISREG(inode.i_mode)) {
-        rust_rwlock_write_unlock(volume.lock);
-        return -1;
-    }
-
-    int bytes_written = 0;  // Changed from uint32_t to int
-    const uint8_t* data_buffer = (const uint8_t*)buffer;
-
-    uint8_t* block_buffer = KernelMemoryAlloc(volume.block_size);
-    if (!block_buffer) {
+    Ext2File* file = Ext2Open(vol, path, FS_WRITE | FS_CREATE);
+    if (!file) {
+        PrintKernelF("EXT2: WriteFile: Failed to open or create file: %s\n", path);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
 
-    // Write to direct blocks, overwriting existing data
-    for (int i = 0; i < 12; i++) {
-        if (bytes_written >= (int)size) break;
-        if (inode.i_block[i] == 0) {
-            PrintKernelF("EXT2: WriteFile: Reached end of allocated blocks for %s. File extension not yet supported.\n", path);
-            break;
-        }
-
-        uint32_t remaining_to_write = size - bytes_written;
-        uint32_t chunk_size = (remaining_to_write > volume.block_size) ? volume.block_size : remaining_to_write;
-
-        if (chunk_size < volume.block_size) {
-            // Partial block: Read-Modify-Write
-            if (Ext2ReadBlock(inode.i_block[i], block_buffer) != 0) {
-                bytes_written = -1;
-                break;
-            }
-            FastMemcpy(block_buffer, data_buffer + bytes_written, chunk_size);
-            if (Ext2WriteBlock(inode.i_block[i], block_buffer) != 0) {
-                bytes_written = -1;
-                break;
-            }
-        } else {
-            // Full block write
-            if (Ext2WriteBlock(inode.i_block[i], data_buffer + bytes_written) != 0) {
-                bytes_written = -1;
-                break;
-            }
-        }
-        bytes_written += chunk_size;
-    }
-
-    KernelFree(block_buffer);
-
-    if (bytes_written > 0) {
-        if ((uint32_t)bytes_written != inode.i_size) {
-            inode.i_size = bytes_written;
-            if (Ext2WriteInode(inode_num, &inode) != 0) {
-                rust_rwlock_write_unlock(volume.lock);
-                return -1;
-            }
+    int64_t bytes_written = 0;
+    if (size > 0) {
+        bytes_written = Ext2WriteAt(file, 0, buffer, size);
+        if (bytes_written < 0) {
+            Ext2Close(file);
+            rust_rwlock_write_unlock(volume.lock);
+            return -1;
         }
     }
 
-    if (bytes_written <= 0 && size > 0) {
-        rust_rwlock_write_unlock(volume.lock);
-        return -1;
+    if (Ext2InodeSize(file->inode) > (uint64_t)bytes_written) {
+        Ext2FileTruncateBlocks(file, ((uint64_t)bytes_written + volume.block_size - 1) / volume.block_size);
+        Ext2SetFileSize(vol, file->inode, (uint64_t)bytes_written);
+        file->ci->dirty = 1;
+        if (Ext2SyncMetadata(vol) != 0) bytes_written = -1;
     }
 
+    Ext2Close(file);
     rust_rwlock_write_unlock(volume.lock);
     return bytes_written;
 }
 
 
-int Ext2ListDir(const char* path) {
+int Ext2ListDir(void* fs_data, const char* path) {
+    Ext2Volume* vol = fs_data;
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
 
-    uint32_t inode_num = Ext2PathToInode(path);
+    uint32_t inode_num = Ext2PathToInode(vol, path);
     if (inode_num == 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return -1;
     }
 
     Ext2Inode inode;
-    if (Ext2ReadInode(inode_num, &inode) != 0) {
+    if (Ext2ReadInode(vol, inode_num, &inode) != 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return -1;
     }
@@ -603,23 +1141,24 @@ int Ext2ListDir(const char* path) {
         return -1;
     }
 
-    // Direct blocks only
-    for (int i = 0; i < 12; i++) {
-        if (inode.i_block[i] == 0) continue;
-        if (Ext2ReadBlock(inode.i_block[i], block_buffer) != 0) continue;
+    // Index blocks of an htree directory read as single unused records
+    const uint32_t nblocks = inode.i_size / volume.block_size;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        const uint32_t block = Ext2InodeBlock(vol, &inode, i);
+        if (block == 0) continue;
+        if (Ext2ReadBlock(vol, block, block_buffer) != 0) continue;
 
-        Ext2DirEntry* entry = (Ext2DirEntry*)block_buffer;
         uint32_t offset = 0;
-        while (offset < volume.block_size) {
-            if (entry->inode == 0) break;
+        while (offset + 8 <= volume.block_size) {
+            Ext2DirEntry* entry = (Ext2DirEntry*)(block_buffer + offset);
+            if (entry->rec_len < 8 || offset + entry->rec_len > volume.block_size) break;
+            offset += entry->rec_len;
+            if (entry->inode == 0) continue;
 
             char name_buf[256];
             FastMemcpy(name_buf, entry->name, entry->name_len);
             name_buf[entry->name_len] = '\0';
             PrintKernelF("  %s\n", name_buf);
-
-            offset += entry->rec_len;
-            entry = (Ext2DirEntry*)((uint8_t*)entry + entry->rec_len);
         }
     }
 
@@ -629,17 +1168,24 @@ int Ext2ListDir(const char* path) {
 }
 
 
-static int Ext2FindFreeBit(uint8_t* bitmap, uint32_t size_in_bits) {
-    for (uint32_t i = 0; i < size_in_bits; i++) {
-        uint32_t byte_idx = i / 8;
-        uint32_t bit_idx = i % 8;
-        if (!(bitmap[byte_idx] & (1 << bit_idx))) {
-            return i;
+// First clear bit in [start, size_in_bits), skipping full bytes
+static int Ext2FindFreeBit(const uint8_t* bitmap, uint32_t start, uint32_t size_in_bits) {
+    uint32_t i = start;
+    while (i < size_in_bits) {
+        if ((i & 7) == 0 && bitmap[i / 8] == 0xFF) {
+            i += 8;
+            continue;
         }
+        if (!(bitmap[i / 8] & (1 << (i % 8)))) return (int)i;
+        i++;
     }
     return -1;
 }
 
+static int Ext2TestBit(const uint8_t* bitmap, uint32_t bit) {
+    return (bitmap[bit / 8] >> (bit % 8)) & 1;
+}
+
 static void Ext2SetBit(uint8_t* bitmap, uint32_t bit) {
     uint32_t byte_idx = bit / 8;
     uint32_t bit_idx = bit % 8;
@@ -652,178 +1198,524 @@ static void Ext2ClearBit(uint8_t* bitmap, uint32_t bit) {
     bitmap[byte_idx] &= ~(1 << bit_idx);
 }
 
-static uint32_t Ext2AllocateInode() {
+// Returns the cached block or inode bitmap of `group`, reading it on first use
+static uint8_t* Ext2GetBitmap(Ext2Volume* vol, uint32_t group, int inodes) {
+    uint8_t** slot = inodes ? &volume.inode_bitmaps[group] : &volume.block_bitmaps[group];
+    if (*slot) return *slot;
+
+    uint8_t* bitmap = KernelMemoryAlloc(volume.block_size);
+    if (!bitmap) return NULL;
+    const uint32_t block = inodes ? volume.group_descs[group].bg_inode_bitmap
+                                  : volume.group_descs[group].bg_block_bitmap;
+    if (Ext2ReadBlock(vol, block, bitmap) != 0) {
+        KernelFree(bitmap);
+        return NULL;
+    }
+    *slot = bitmap;
+    return bitmap;
+}
+
+static void Ext2FreeBitmaps(Ext2Volume* vol) {
+    for (uint32_t g = 0; g < volume.num_groups; g++) {
+        if (volume.block_bitmaps && volume.block_bitmaps[g]) KernelFree(volume.block_bitmaps[g]);
+        if (volume.inode_bitmaps && volume.inode_bitmaps[g]) KernelFree(volume.inode_bitmaps[g]);
+    }
+    if (volume.block_bitmaps) KernelFree(volume.block_bitmaps);
+    if (volume.inode_bitmaps) KernelFree(volume.inode_bitmaps);
+    if (volume.bitmap_dirty) KernelFree(volume.bitmap_dirty);
+    volume.block_bitmaps = NULL;
+    volume.inode_bitmaps = NULL;
+    volume.bitmap_dirty = NULL;
+}
+
+// Writes back dirty inodes and bitmaps, the group descriptor table and the
+// superblock free counts
+static int Ext2SyncMetadata(Ext2Volume* vol) {
+    if (!volume.bitmap_dirty) return 0;
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
-    uint8_t* bitmap_buffer = KernelMemoryAlloc(volume.block_size);
-    if (!bitmap_buffer) {
-        rust_rwlock_write_unlock(volume.lock);
-        return 0;
-    }
+    int result = 0;
 
-    for (uint32_t group = 0; group < volume.num_groups; group++) {
-        uint32_t inode_bitmap_block = volume.group_descs[group].bg_inode_bitmap;
+    for (int i = 0; volume.icache && i < EXT2_ICACHE_ENTRIES; i++) {
+        Ext2CachedInode* ci = &volume.icache[i];
+        if (!ci->dirty) continue;
+        if (Ext2WriteInodeDisk(vol, ci->inode_num, &ci->inode) != 0) result = -1;
+        else ci->dirty = 0;
+    }
 
-        if (Ext2ReadBlock(inode_bitmap_block, bitmap_buffer) != 0) {
-            continue;
+    for (uint32_t g = 0; g < volume.num_groups; g++) {
+        if (volume.bitmap_dirty[g] & EXT2_BITMAP_BLOCKS_DIRTY) {
+            if (Ext2WriteBlock(vol, volume.group_descs[g].bg_block_bitmap, volume.block_bitmaps[g]) != 0) result = -1;
         }
+        if (volume.bitmap_dirty[g] & EXT2_BITMAP_INODES_DIRTY) {
+            if (Ext2WriteBlock(vol, volume.group_descs[g].bg_inode_bitmap, volume.inode_bitmaps[g]) != 0) result = -1;
+        }
+        if (result == 0) volume.bitmap_dirty[g] = 0;
+    }
 
-        int free_bit = Ext2FindFreeBit(bitmap_buffer, volume.inodes_per_group);
-        if (free_bit != -1) {
-            Ext2SetBit(bitmap_buffer, free_bit);
-            if (Ext2WriteBlock(inode_bitmap_block, bitmap_buffer) == 0) {
-                volume.group_descs[group].bg_free_inodes_count--;
-                uint32_t bgdt_block = (volume.block_size == 1024) ? 2 : 1;
-                Ext2WriteBlock(bgdt_block, volume.group_descs);
-
-                volume.superblock.s_free_inodes_count--;
+    if (volume.meta_dirty) {
+        const uint32_t bgdt_block = (volume.block_size == 1024) ? 2 : 1;
+        if (Ext2WriteBlocks(vol, bgdt_block, volume.gdt_blocks, volume.group_descs) != 0) result = -1;
 
-                KernelFree(bitmap_buffer);
-                rust_rwlock_write_unlock(volume.lock);
-                return group * volume.inodes_per_group + free_bit + 1;
-            }
+        // The superblock sits at byte 1024 whatever the block size; only
+        // the leading fields are kept in memory, so merge them in place
+        uint8_t sb_buffer[1024];
+        if (BlockCacheRead(volume.device->id, 2, 2, sb_buffer) == 0) {
+            FastMemcpy(sb_buffer, &volume.superblock, sizeof(Ext2Superblock));
+            if (BlockCacheWrite(volume.device->id, 2, 2, sb_buffer) != 0) result = -1;
+        } else {
+            result = -1;
         }
+        if (result == 0) volume.meta_dirty = 0;
     }
 
-    KernelFree(bitmap_buffer);
     rust_rwlock_write_unlock(volume.lock);
-    return 0;
+    return result;
 }
 
-static uint32_t Ext2AllocateBlock() {
-    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
-    uint8_t* bitmap_buffer = KernelMemoryAlloc(volume.block_size);
-    if (!bitmap_buffer) {
-        rust_rwlock_write_unlock(volume.lock);
-        return 0;
-    }
+// Blocks actually present in `group` (the last group may be short)
+static uint32_t Ext2GroupBlocks(Ext2Volume* vol, uint32_t group) {
+    const uint32_t first = volume.superblock.s_first_data_block + group * volume.blocks_per_group;
+    const uint32_t left = volume.superblock.s_blocks_count - first;
+    return left < volume.blocks_per_group ? left : volume.blocks_per_group;
+}
 
-    for (uint32_t group = 0; group < volume.num_groups; group++) {
-        uint32_t block_bitmap_block = volume.group_descs[group].bg_block_bitmap;
+// First block of the group holding `inode_num`; the default allocation goal
+static uint32_t Ext2InodeGoal(Ext2Volume* vol, uint32_t inode_num) {
+    const uint32_t group = inode_num ? (inode_num - 1) / volume.inodes_per_group : 0;
+    return volume.superblock.s_first_data_block + group * volume.blocks_per_group;
+}
 
-        if (Ext2ReadBlock(block_bitmap_block, bitmap_buffer) != 0) {
-            continue;
-        }
+// Allocates an inode, preferring `goal_group` and then the groups after it
+static uint32_t Ext2AllocateInode(Ext2Volume* vol, uint32_t goal_group) {
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+    if (goal_group >= volume.num_groups) goal_group = 0;
 
-        int free_bit = Ext2FindFreeBit(bitmap_buffer, volume.blocks_per_group);
-        if (free_bit != -1) {
-            Ext2SetBit(bitmap_buffer, free_bit);
-            if (Ext2WriteBlock(block_bitmap_block, bitmap_buffer) == 0) {
-                volume.group_descs[group].bg_free_blocks_count--;
-                uint32_t bgdt_block = (volume.block_size == 1024) ? 2 : 1;
-                Ext2WriteBlock(bgdt_block, volume.group_descs);
+    for (uint32_t n = 0; n < volume.num_groups; n++) {
+        const uint32_t group = (goal_group + n) % volume.num_groups;
+        if (volume.group_descs[group].bg_free_inodes_count == 0) continue;
+        uint8_t* bitmap = Ext2GetBitmap(vol, group, 1);
+        if (!bitmap) continue;
 
-                volume.superblock.s_free_blocks_count--;
+        int free_bit = Ext2FindFreeBit(bitmap, 0, volume.inodes_per_group);
+        if (free_bit < 0) continue;
 
-                KernelFree(bitmap_buffer);
-                rust_rwlock_write_unlock(volume.lock);
-                return group * volume.blocks_per_group + free_bit + volume.superblock.s_first_data_block;
-            }
-        }
+        Ext2SetBit(bitmap, free_bit);
+        volume.bitmap_dirty[group] |= EXT2_BITMAP_INODES_DIRTY;
+        volume.group_descs[group].bg_free_inodes_count--;
+        volume.superblock.s_free_inodes_count--;
+        volume.meta_dirty = 1;
+
+        rust_rwlock_write_unlock(volume.lock);
+        return group * volume.inodes_per_group + free_bit + 1;
     }
 
-    KernelFree(bitmap_buffer);
     rust_rwlock_write_unlock(volume.lock);
     return 0;
 }
 
-static int Ext2AddDirEntry(uint32_t dir_inode_num, const char* name, uint32_t file_inode_num, uint8_t file_type) {
+// Allocates a block at `goal` if free, else the next free block after it
+// (wrapping around the volume)
+static uint32_t Ext2AllocateBlock(Ext2Volume* vol, uint32_t goal) {
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
-    Ext2Inode dir_inode;
-    if (Ext2ReadInode(dir_inode_num, &dir_inode) != 0) {
-        rust_rwlock_write_unlock(volume.lock);
-        return -1;
-    }
+    const uint32_t first_data = volume.superblock.s_first_data_block;
+    if (goal < first_data || goal >= volume.superblock.s_blocks_count) goal = first_data;
+    const uint32_t goal_group = (goal - first_data) / volume.blocks_per_group;
+    const uint32_t goal_bit = (goal - first_data) % volume.blocks_per_group;
+
+    // One extra pass revisits the goal group below goal_bit
+    for (uint32_t n = 0; n <= volume.num_groups; n++) {
+        const uint32_t group = (goal_group + n) % volume.num_groups;
+        if (volume.group_descs[group].bg_free_blocks_count == 0) continue;
+        uint8_t* bitmap = Ext2GetBitmap(vol, group, 0);
+        if (!bitmap) continue;
+
+        int free_bit = Ext2FindFreeBit(bitmap, n == 0 ? goal_bit : 0, Ext2GroupBlocks(vol, group));
+        if (free_bit < 0) continue;
+
+        Ext2SetBit(bitmap, free_bit);
+        volume.bitmap_dirty[group] |= EXT2_BITMAP_BLOCKS_DIRTY;
+        volume.group_descs[group].bg_free_blocks_count--;
+        volume.superblock.s_free_blocks_count--;
+        volume.meta_dirty = 1;
 
-    if (!S_ISDIR(dir_inode.i_mode)) {
-        rust_rwlock_write_unlock(volume.lock);
-        return -1;
-    }
-
-    uint8_t* block_buffer = KernelMemoryAlloc(volume.block_size);
-    if (!block_buffer) {
         rust_rwlock_write_unlock(volume.lock);
-        return -1;
+        return group * volume.blocks_per_group + free_bit + first_data;
     }
 
-    uint16_t name_len = FastStrlen(name, 255);
-    uint16_t required_len = 8 + name_len;
-    if (required_len % 4 != 0) required_len += 4 - (required_len % 4);
+    rust_rwlock_write_unlock(volume.lock);
+    return 0;
+}
 
-    // Look for space in existing blocks
-    for (int i = 0; i < 12; i++) {
-        if (dir_inode.i_block[i] == 0) continue;
+// Marks up to `max` free blocks from `start` onwards as in use, stopping at
+// the first used block or the end of the group; returns how many
+static uint32_t Ext2ReserveBlocks(Ext2Volume* vol, uint32_t start, uint32_t max) {
+    const uint32_t first_data = volume.superblock.s_first_data_block;
+    if (start < first_data || start >= volume.superblock.s_blocks_count) return 0;
+    const uint32_t group = (start - first_data) / volume.blocks_per_group;
+    const uint32_t bit = (start - first_data) % volume.blocks_per_group;
+    const uint32_t group_blocks = Ext2GroupBlocks(vol, group);
+    uint8_t* bitmap = Ext2GetBitmap(vol, group, 0);
+    if (!bitmap) return 0;
+
+    uint32_t n = 0;
+    while (n < max && bit + n < group_blocks && !Ext2TestBit(bitmap, bit + n)) {
+        Ext2SetBit(bitmap, bit + n);
+        n++;
+    }
+    if (n) {
+        volume.bitmap_dirty[group] |= EXT2_BITMAP_BLOCKS_DIRTY;
+        volume.group_descs[group].bg_free_blocks_count -= n;
+        volume.superblock.s_free_blocks_count -= n;
+        volume.meta_dirty = 1;
+    }
+    return n;
+}
 
-        if (Ext2ReadBlock(dir_inode.i_block[i], block_buffer) != 0) continue;
+// Returns never-written reserved blocks to the free pool
+static void Ext2UnreserveBlocks(Ext2Volume* vol, uint32_t start, uint32_t count) {
+    if (count == 0) return;
+    const uint32_t first_data = volume.superblock.s_first_data_block;
+    const uint32_t group = (start - first_data) / volume.blocks_per_group;
+    const uint32_t bit = (start - first_data) % volume.blocks_per_group;
+    uint8_t* bitmap = Ext2GetBitmap(vol, group, 0);
+    if (!bitmap) return;
+
+    for (uint32_t i = 0; i < count; i++) Ext2ClearBit(bitmap, bit + i);
+    volume.bitmap_dirty[group] |= EXT2_BITMAP_BLOCKS_DIRTY;
+    volume.group_descs[group].bg_free_blocks_count += count;
+    volume.superblock.s_free_blocks_count += count;
+    volume.meta_dirty = 1;
+}
 
-        Ext2DirEntry* entry = (Ext2DirEntry*)block_buffer;
-        uint32_t offset = 0;
-        Ext2DirEntry* last_entry = NULL;
+// Appends a block to directory `dir`, returning its disk block (0 on
+// failure) and its logical number in *logical. The caller fills it in.
+// Indirect blocks are written straight away, since index lookups map
+// directory blocks through the on-disk tree.
+static uint32_t Ext2DirAppendBlock(Ext2File* dir, uint32_t* logical) {
+    Ext2Volume* vol = dir->vol;
+    const uint32_t index = dir->inode->i_size / volume.block_size;
+    uint32_t block;
+    if (Ext2BlockMap(dir, index, 1, &block, NULL) != 0 || block == 0) return 0;
+    if (index >= EXT2_NDIR_BLOCKS && Ext2FileFlush(dir) != 0) return 0;
+    dir->inode->i_size += volume.block_size;
+    dir->ci->dirty = 1;
+    *logical = index;
+    return block;
+}
 
-        while (offset < volume.block_size && entry->rec_len > 0) {
-            last_entry = entry;
-            offset += entry->rec_len;
-            if (offset >= volume.block_size) break;
-            entry = (Ext2DirEntry*)((uint8_t*)block_buffer + offset);
+typedef struct {
+    uint32_t hash;
+    uint32_t offset;
+    uint32_t size;
+} Ext2DxMapEntry;
+
+// Lists the live entries of a directory block from `start` on, sorted by hash
+static uint32_t Ext2DxMapBlock(Ext2Volume* vol, uint32_t version, const uint8_t* block, uint32_t start, Ext2DxMapEntry* map) {
+    uint32_t n = 0;
+    uint32_t offset = start;
+    while (offset + 8 <= volume.block_size) {
+        const Ext2DirEntry* entry = (const Ext2DirEntry*)(block + offset);
+        if (entry->rec_len < 8 || offset + entry->rec_len > volume.block_size) break;
+        if (entry->inode != 0) {
+            Ext2DxMapEntry m = {Ext2DxHash(vol, version, entry->name, entry->name_len), offset,
+                                EXT2_DIR_REC_LEN(entry->name_len)};
+            uint32_t i = n++;
+            while (i > 0 && map[i - 1].hash > m.hash) {
+                map[i] = map[i - 1];
+                i--;
+            }
+            map[i] = m;
         }
+        offset += entry->rec_len;
+    }
+    return n;
+}
 
-        if (last_entry && offset <= volume.block_size) {
-            uint16_t actual_len = 8 + last_entry->name_len;
-            if (actual_len % 4 != 0) actual_len += 4 - (actual_len % 4);
+// Writes map[from, to) from `src` into `out` back to back; the last
+// entry's record absorbs the rest of the block
+static void Ext2DxPack(Ext2Volume* vol, uint8_t* out, const uint8_t* src, const Ext2DxMapEntry* map, uint32_t from, uint32_t to) {
+    FastMemset(out, 0, volume.block_size);
+    Ext2DirEntry* last = (Ext2DirEntry*)out;
+    uint32_t offset = 0;
+    for (uint32_t i = from; i < to; i++) {
+        last = (Ext2DirEntry*)(out + offset);
+        FastMemcpy(last, src + map[i].offset, map[i].size);
+        last->rec_len = map[i].size;
+        offset += map[i].size;
+    }
+    last->rec_len += volume.block_size - offset;
+}
 
-            uint16_t available_space = last_entry->rec_len - actual_len;
+// Inserts (hash, block) after the frame's current entry; the caller has
+// checked there is room
+static void Ext2DxInsertEntry(Ext2DxFrame* frame, uint32_t hash, uint32_t block) {
+    Ext2DxCountLimit* cl = Ext2DxCount(frame);
+    Ext2DxEntry* pos = frame->at + 1;
+    for (Ext2DxEntry* e = frame->entries + cl->count; e > pos; e--) *e = e[-1];
+    pos->hash = hash;
+    pos->block = block;
+    cl->count++;
+}
 
-            if (available_space >= required_len) {
-                last_entry->rec_len = actual_len;
+// Splits the full leaf in `leaf` by hash, moving the upper half to a new
+// block linked into the deepest index node, then stores the new entry in
+// the half its hash belongs to.
+static int Ext2DxSplitLeaf(Ext2File* dir, Ext2DxFrame* frames, uint32_t levels, uint32_t hash, uint8_t* leaf,
+                           uint32_t leaf_block, const char* name, uint32_t len, uint32_t inode_num, uint8_t file_type) {
+    Ext2Volume* vol = dir->vol;
+    const uint32_t bs = volume.block_size;
+    const uint32_t version = ((const Ext2DxRootInfo*)(frames[0].data + 24))->hash_version;
+    Ext2DxFrame* frame = &frames[levels - 1];
+    Ext2DxMapEntry* map = KernelMemoryAlloc((bs / EXT2_DIR_REC_LEN(1)) * sizeof(Ext2DxMapEntry));
+    uint8_t* src = KernelMemoryAlloc(bs);
+    uint8_t* upper = KernelMemoryAlloc(bs);
+    int result = -1;
+    if (!map || !src || !upper) goto out;
+
+    FastMemcpy(src, leaf, bs);
+    const uint32_t n = Ext2DxMapBlock(vol, version, src, 0, map);
+    if (n < 2) goto out;
+
+    // Move about half the bytes, keeping at least one entry on each side
+    uint32_t split = n, moved = 0;
+    while (split > 1 && moved + map[split - 1].size <= bs / 2) moved += map[--split].size;
+    if (split == n) split = n - 1;
+    uint32_t split_hash = map[split].hash;
+    if (split_hash == map[split - 1].hash) split_hash |= 1; // The collision run continues in the new leaf
+
+    uint32_t logical;
+    const uint32_t upper_block = Ext2DirAppendBlock(dir, &logical);
+    if (upper_block == 0) goto out;
+
+    Ext2DxPack(vol, leaf, src, map, 0, split);
+    Ext2DxPack(vol, upper, src, map, split, n);
+    Ext2DxInsertEntry(frame, split_hash, logical);
+    const int added = Ext2BlockAddEntry(vol, hash >= split_hash ? upper : leaf, name, len, inode_num, file_type);
+
+    // The new leaf goes out before anything points at it
+    if (Ext2WriteBlock(vol, upper_block, upper) == 0 && Ext2WriteBlock(vol, leaf_block, leaf) == 0 &&
+        Ext2WriteBlock(vol, frame->block, frame->data) == 0 && added) {
+        result = 0;
+    }
+
+out:
+    if (map) KernelFree(map);
+    if (src) KernelFree(src);
+    if (upper) KernelFree(upper);
+    return result;
+}
 
-                Ext2DirEntry* new_entry = (Ext2DirEntry*)((uint8_t*)last_entry + actual_len);
-                new_entry->inode = file_inode_num;
-                new_entry->rec_len = available_space;
-                new_entry->name_len = name_len;
-                new_entry->file_type = file_type;
-                FastMemcpy(new_entry->name, name, name_len);
+// Makes room in the full deepest index node: a full root pushes its
+// entries down into a new interior node, an interior node is split in
+// two under its parent. Returns -1 if the tree cannot grow further.
+static int Ext2DxGrowIndex(Ext2File* dir, Ext2DxFrame* frames, uint32_t levels) {
+    Ext2Volume* vol = dir->vol;
+    const uint32_t bs = volume.block_size;
+    Ext2DxFrame* frame = &frames[levels - 1];
+    Ext2DxCountLimit* cl = Ext2DxCount(frame);
+    Ext2DxFrame* parent = levels > 1 ? &frames[levels - 2] : NULL;
+    if (parent && Ext2DxCount(parent)->count >= Ext2DxCount(parent)->limit) return -1;
+
+    uint8_t* node = KernelMemoryAlloc(bs);
+    if (!node) return -1;
+    uint32_t logical;
+    const uint32_t node_block = Ext2DirAppendBlock(dir, &logical);
+    if (node_block == 0) {
+        KernelFree(node);
+        return -1;
+    }
 
-                if (Ext2WriteBlock(dir_inode.i_block[i], block_buffer) == 0) {
-                    KernelFree(block_buffer);
-                    rust_rwlock_write_unlock(volume.lock);
-                    return 0;
-                }
-            }
+    FastMemset(node, 0, bs);
+    ((Ext2DirEntry*)node)->rec_len = bs;
+    Ext2DxEntry* entries = (Ext2DxEntry*)(node + 8);
+    const uint16_t limit = (bs - 8) / sizeof(Ext2DxEntry);
+
+    int result = -1;
+    if (!parent) {
+        FastMemcpy(entries, frame->entries, cl->count * sizeof(Ext2DxEntry));
+        ((Ext2DxCountLimit*)entries)->limit = limit;
+        cl->count = 1;
+        frame->entries[0].block = logical;
+        ((Ext2DxRootInfo*)(frame->data + 24))->indirect_levels++;
+        if (Ext2WriteBlock(vol, node_block, node) == 0 && Ext2WriteBlock(vol, frame->block, frame->data) == 0) {
+            result = 0;
+        }
+    } else {
+        const uint32_t keep = cl->count / 2;
+        const uint32_t moved = cl->count - keep;
+        FastMemcpy(entries, frame->entries + keep, moved * sizeof(Ext2DxEntry));
+        const uint32_t split_hash = entries[0].hash;
+        ((Ext2DxCountLimit*)entries)->limit = limit;
+        ((Ext2DxCountLimit*)entries)->count = moved;
+        cl->count = keep;
+        Ext2DxInsertEntry(parent, split_hash, logical);
+        if (Ext2WriteBlock(vol, node_block, node) == 0 && Ext2WriteBlock(vol, frame->block, frame->data) == 0 &&
+            Ext2WriteBlock(vol, parent->block, parent->data) == 0) {
+            result = 0;
         }
     }
+    KernelFree(node);
+    return result;
+}
 
-    // Need to allocate a new block for the directory
-    for (int i = 0; i < 12; i++) {
-        if (dir_inode.i_block[i] == 0) {
-            uint32_t new_block = Ext2AllocateBlock();
-            if (new_block == 0) break;
-
-            dir_inode.i_block[i] = new_block;
-            dir_inode.i_size += volume.block_size;
-
-            FastMemset(block_buffer, 0, volume.block_size);
-            Ext2DirEntry* entry = (Ext2DirEntry*)block_buffer;
-            entry->inode = file_inode_num;
-            entry->rec_len = volume.block_size;
-            entry->name_len = name_len;
-            entry->file_type = file_type;
-            FastMemcpy(entry->name, name, name_len);
-
-            if (Ext2WriteBlock(new_block, block_buffer) == 0 &&
-                Ext2WriteInode(dir_inode_num, &dir_inode) == 0) {
-                KernelFree(block_buffer);
-                rust_rwlock_write_unlock(volume.lock);
-                return 0;
+// Adds an entry to an indexed directory: into the leaf its hash maps to,
+// splitting that leaf (and growing the index first if the node that would
+// take the new leaf is full) when it has no room.
+static int Ext2DxAddEntry(Ext2File* dir, const char* name, uint32_t len, uint32_t inode_num, uint8_t file_type, uint8_t* buf) {
+    Ext2Volume* vol = dir->vol;
+    Ext2DxFrame frames[EXT2_DX_MAX_LEVELS];
+
+    for (int attempt = 0; attempt < EXT2_DX_MAX_LEVELS; attempt++) {
+        uint32_t hash;
+        const uint32_t levels = Ext2DxProbe(vol, dir->inode, name, len, &hash, frames);
+        if (!levels) return -1;
+
+        Ext2DxFrame* frame = &frames[levels - 1];
+        uint32_t leaf_block;
+        int result = -1;
+        if (Ext2BlockMap(dir, EXT2_DX_BLOCK(frame->at), 0, &leaf_block, NULL) == 0 && leaf_block != 0 &&
+            Ext2ReadBlock(vol, leaf_block, buf) == 0) {
+            if (Ext2BlockAddEntry(vol, buf, name, len, inode_num, file_type)) {
+                result = Ext2WriteBlock(vol, leaf_block, buf);
+            } else if (Ext2DxCount(frame)->count < Ext2DxCount(frame)->limit) {
+                result = Ext2DxSplitLeaf(dir, frames, levels, hash, buf, leaf_block, name, len, inode_num, file_type);
+            } else if (Ext2DxGrowIndex(dir, frames, levels) == 0) {
+                Ext2DxRelease(frames, levels);
+                continue; // Probe again through the grown index
             }
-            break;
+        }
+        Ext2DxRelease(frames, levels);
+        return result;
+    }
+    return -1;
+}
+
+// Turns a full single-block directory into an indexed one, as ext3 does:
+// its entries move to a new leaf and block 0 becomes the index root.
+static int Ext2DxMakeIndexed(Ext2File* dir, uint8_t* buf) {
+    Ext2Volume* vol = dir->vol;
+    const uint32_t bs = volume.block_size;
+    uint32_t root_block;
+    if (Ext2BlockMap(dir, 0, 0, &root_block, NULL) != 0 || root_block == 0) return -1;
+    if (Ext2ReadBlock(vol, root_block, buf) != 0) return -1;
+
+    Ext2DirEntry* dot = (Ext2DirEntry*)buf;
+    Ext2DirEntry* dotdot = (Ext2DirEntry*)(buf + 12);
+    if (dot->rec_len != 12 || dot->name_len != 1 || dot->name[0] != '.' ||
+        dotdot->name_len != 2 || FastMemcmp(dotdot->name, "..", 2) != 0 || dotdot->rec_len < 12 ||
+        12u + dotdot->rec_len > bs) {
+        return -1;
+    }
+
+    uint32_t version = volume.superblock.s_def_hash_version;
+    if (version > EXT2_DX_HASH_TEA) version = EXT2_DX_HASH_HALF_MD4;
+
+    Ext2DxMapEntry* map = KernelMemoryAlloc((bs / EXT2_DIR_REC_LEN(1)) * sizeof(Ext2DxMapEntry));
+    uint8_t* leaf = KernelMemoryAlloc(bs);
+    int result = -1;
+    if (!map || !leaf) goto out;
+
+    const uint32_t n = Ext2DxMapBlock(vol, version, buf, 12 + dotdot->rec_len, map);
+    if (n == 0) goto out;
+    uint32_t logical;
+    const uint32_t leaf_block = Ext2DirAppendBlock(dir, &logical);
+    if (leaf_block == 0) goto out;
+    Ext2DxPack(vol, leaf, buf, map, 0, n);
+    if (Ext2WriteBlock(vol, leaf_block, leaf) != 0) goto out;
+
+    dotdot->rec_len = bs - 12;
+    FastMemset(buf + 24, 0, bs - 24);
+    Ext2DxRootInfo* info = (Ext2DxRootInfo*)(buf + 24);
+    info->hash_version = version;
+    info->info_length = 8;
+    Ext2DxEntry* entries = (Ext2DxEntry*)(buf + 32);
+    ((Ext2DxCountLimit*)entries)->limit = (bs - 32) / sizeof(Ext2DxEntry);
+    ((Ext2DxCountLimit*)entries)->count = 1;
+    entries[0].block = logical;
+    if (Ext2WriteBlock(vol, root_block, buf) != 0) {
+        // Block 0 still lists every entry; empty the leaf so none appears twice
+        FastMemset(leaf, 0, bs);
+        ((Ext2DirEntry*)leaf)->rec_len = bs;
+        Ext2WriteBlock(vol, leaf_block, leaf);
+        goto out;
+    }
+
+    dir->inode->i_flags |= EXT2_INDEX_FL;
+    dir->ci->dirty = 1;
+    result = 0;
+
+out:
+    if (map) KernelFree(map);
+    if (leaf) KernelFree(leaf);
+    return result;
+}
+
+// Adds an entry to a directory without a usable index: into the first
+// block with room, else by indexing a full single-block directory (when
+// the volume supports it) or appending a block.
+static int Ext2LinearAddEntry(Ext2File* dir, const char* name, uint32_t len, uint32_t inode_num, uint8_t file_type, uint8_t* buf) {
+    Ext2Volume* vol = dir->vol;
+    const uint32_t nblocks = dir->inode->i_size / volume.block_size;
+    for (uint32_t i = 0; i < nblocks; i++) {
+        uint32_t block;
+        if (Ext2BlockMap(dir, i, 0, &block, NULL) != 0 || block == 0) continue;
+        if (Ext2ReadBlock(vol, block, buf) != 0) continue;
+        if (Ext2BlockAddEntry(vol, buf, name, len, inode_num, file_type)) return Ext2WriteBlock(vol, block, buf);
+    }
+
+    if (nblocks == 1 && (volume.superblock.s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX) &&
+        Ext2DxMakeIndexed(dir, buf) == 0) {
+        if (Ext2DxAddEntry(dir, name, len, inode_num, file_type, buf) == 0) return 0;
+        dir->inode->i_flags &= ~EXT2_INDEX_FL;
+    }
+
+    uint32_t logical;
+    const uint32_t block = Ext2DirAppendBlock(dir, &logical);
+    if (block == 0) return -1;
+    FastMemset(buf, 0, volume.block_size);
+    ((Ext2DirEntry*)buf)->rec_len = volume.block_size;
+    Ext2BlockAddEntry(vol, buf, name, len, inode_num, file_type);
+    return Ext2WriteBlock(vol, block, buf);
+}
+
+static int Ext2AddDirEntry(Ext2Volume* vol, uint32_t dir_inode_num, const char* name, uint32_t file_inode_num, uint8_t file_type) {
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+    Ext2File* dir = Ext2FileGet(vol, dir_inode_num);
+    if (!dir || !S_ISDIR(dir->inode->i_mode)) {
+        if (dir) Ext2Close(dir);
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
+
+    uint8_t* block_buffer = KernelMemoryAlloc(volume.block_size);
+    if (!block_buffer) {
+        Ext2Close(dir);
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
+
+    const uint32_t name_len = FastStrlen(name, 255);
+    int result = -1;
+    if (Ext2DxIndexed(vol, dir->inode)) {
+        result = Ext2DxAddEntry(dir, name, name_len, file_inode_num, file_type, block_buffer);
+        if (result != 0) {
+            // Index full or damaged: drop it, the blocks remain a valid linear directory
+            dir->inode->i_flags &= ~EXT2_INDEX_FL;
+            dir->ci->dirty = 1;
         }
     }
+    if (result != 0) result = Ext2LinearAddEntry(dir, name, name_len, file_inode_num, file_type, block_buffer);
 
+    if (result == 0) DCacheInsert(vol, dir_inode_num, name, name_len, file_inode_num);
+    if (Ext2FileFlush(dir) != 0) result = -1;
     KernelFree(block_buffer);
+    Ext2Close(dir);
     rust_rwlock_write_unlock(volume.lock);
-    return -1;
+    return result;
 }
 
-int Ext2CreateFile(const char* path) {
+int Ext2CreateFile(void* fs_data, const char* path) {
+    Ext2Volume* vol = fs_data;
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
 
     // Extract directory path and filename
@@ -849,13 +1741,13 @@ int Ext2CreateFile(const char* path) {
     }
 
     // Check if file already exists
-    if (Ext2PathToInode(path) != 0) {
+    if (Ext2PathToInode(vol, path) != 0) {
         rust_rwlock_write_unlock(volume.lock);
         return 0; // Success - file exists
     }
 
     // Find parent directory
-    uint32_t parent_inode_num = Ext2PathToInode(dir_path);
+    uint32_t parent_inode_num = Ext2PathToInode(vol, dir_path);
     if (parent_inode_num == 0) {
         PrintKernelF("EXT2: CreateFile: Parent directory not found: %s\n", dir_path);
         rust_rwlock_write_unlock(volume.lock);
@@ -863,7 +1755,8 @@ int Ext2CreateFile(const char* path) {
     }
 
     // Allocate new inode
-    uint32_t new_inode_num = Ext2AllocateInode();
+    // Keep new inodes in their parent directory's group
+    uint32_t new_inode_num = Ext2AllocateInode(vol, (parent_inode_num - 1) / volume.inodes_per_group);
     if (new_inode_num == 0) {
         PrintKernelF("EXT2: CreateFile: Failed to allocate inode\n");
         rust_rwlock_write_unlock(volume.lock);
@@ -871,7 +1764,7 @@ int Ext2CreateFile(const char* path) {
     }
 
     // Allocate first data block
-    uint32_t first_block = Ext2AllocateBlock();
+    uint32_t first_block = Ext2AllocateBlock(vol, Ext2InodeGoal(vol, new_inode_num));
     if (first_block == 0) {
         PrintKernelF("EXT2: CreateFile: Failed to allocate data block\n");
         rust_rwlock_write_unlock(volume.lock);
@@ -893,14 +1786,14 @@ int Ext2CreateFile(const char* path) {
     }
 
     // Write inode
-    if (Ext2WriteInode(new_inode_num, &new_inode) != 0) {
+    if (Ext2WriteInode(vol, new_inode_num, &new_inode) != 0) {
         PrintKernelF("EXT2: CreateFile: Failed to write inode\n");
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
 
     // Add directory entry
-    if (Ext2AddDirEntry(parent_inode_num, filename, new_inode_num, 1) != 0) { // 1 = regular file
+    if (Ext2AddDirEntry(vol, parent_inode_num, filename, new_inode_num, 1) != 0) { // 1 = regular file
         PrintKernelF("EXT2: CreateFile: Failed to add directory entry\n");
         rust_rwlock_write_unlock(volume.lock);
         return -1;
@@ -910,10 +1803,11 @@ int Ext2CreateFile(const char* path) {
     uint8_t* zero_buffer = KernelMemoryAlloc(volume.block_size);
     if (zero_buffer) {
         FastMemset(zero_buffer, 0, volume.block_size);
-        Ext2WriteBlock(first_block, zero_buffer);
+        Ext2WriteBlock(vol, first_block, zero_buffer);
         KernelFree(zero_buffer);
     }
 
+    Ext2SyncMetadata(vol);
     PrintKernelSuccessF("EXT2: Created file: %s (inode %u)\n", path, new_inode_num);
     rust_rwlock_write_unlock(volume.lock);
     return 0;
@@ -921,7 +1815,8 @@ int Ext2CreateFile(const char* path) {
 
 
 
-int Ext2CreateDir(const char* path) {
+int Ext2CreateDir(void* fs_data, const char* path) {
+    Ext2Volume* vol = fs_data;
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
     // Extract directory path and dirname
     char parent_path[256] = "/";
@@ -946,13 +1841,13 @@ int Ext2CreateDir(const char* path) {
     }
 
     // Check if directory already exists
-    if (Ext2PathToInode(path) != 0) {
+    if (Ext2PathToInode(vol, path) != 0) {
         rust_rwlock_write_unlock(volume.lock);
         return 0;
     }
 
     // Find parent directory
-    uint32_t parent_inode_num = Ext2PathToInode(parent_path);
+    uint32_t parent_inode_num = Ext2PathToInode(vol, parent_path);
     if (parent_inode_num == 0) {
         PrintKernelF("EXT2: CreateDir: Parent directory not found: %s\n", parent_path);
         rust_rwlock_write_unlock(volume.lock);
@@ -960,7 +1855,8 @@ int Ext2CreateDir(const char* path) {
     }
 
     // Allocate new inode
-    uint32_t new_inode_num = Ext2AllocateInode();
+    // Keep new inodes in their parent directory's group
+    uint32_t new_inode_num = Ext2AllocateInode(vol, (parent_inode_num - 1) / volume.inodes_per_group);
     if (new_inode_num == 0) {
         PrintKernelF("EXT2: CreateDir: Failed to allocate inode\n");
         rust_rwlock_write_unlock(volume.lock);
@@ -968,7 +1864,7 @@ int Ext2CreateDir(const char* path) {
     }
 
     // Allocate data block for directory entries
-    uint32_t dir_block = Ext2AllocateBlock();
+    uint32_t dir_block = Ext2AllocateBlock(vol, Ext2InodeGoal(vol, new_inode_num));
     if (dir_block == 0) {
         PrintKernelF("EXT2: CreateDir: Failed to allocate data block\n");
         rust_rwlock_write_unlock(volume.lock);
@@ -1016,8 +1912,8 @@ int Ext2CreateDir(const char* path) {
     dotdot_entry->name[1] = '.';
 
     // Write directory block and inode
-    if (Ext2WriteBlock(dir_block, dir_buffer) != 0 ||
-        Ext2WriteInode(new_inode_num, &new_inode) != 0) {
+    if (Ext2WriteBlock(vol, dir_block, dir_buffer) != 0 ||
+        Ext2WriteInode(vol, new_inode_num, &new_inode) != 0) {
         KernelFree(dir_buffer);
         PrintKernelF("EXT2: CreateDir: Failed to write directory data\n");
         rust_rwlock_write_unlock(volume.lock);
@@ -1027,7 +1923,7 @@ int Ext2CreateDir(const char* path) {
     KernelFree(dir_buffer);
 
     // Add directory entry to parent
-    if (Ext2AddDirEntry(parent_inode_num, dirname, new_inode_num, 2) != 0) { // 2 = directory
+    if (Ext2AddDirEntry(vol, parent_inode_num, dirname, new_inode_num, 2) != 0) { // 2 = directory
         PrintKernelF("EXT2: CreateDir: Failed to add directory entry\n");
         rust_rwlock_write_unlock(volume.lock);
         return -1;
@@ -1035,64 +1931,118 @@ int Ext2CreateDir(const char* path) {
 
     // Update parent directory link count
     Ext2Inode parent_inode;
-    if (Ext2ReadInode(parent_inode_num, &parent_inode) == 0) {
+    if (Ext2ReadInode(vol, parent_inode_num, &parent_inode) == 0) {
         parent_inode.i_links_count++;
-        Ext2WriteInode(parent_inode_num, &parent_inode);
+        Ext2WriteInode(vol, parent_inode_num, &parent_inode);
     }
 
+    Ext2SyncMetadata(vol);
     PrintKernelSuccessF("EXT2: Created directory: %s (inode %u)\n", path, new_inode_num);
     rust_rwlock_write_unlock(volume.lock);
     return 0;
 }
 
 
-static void Ext2FreeBlock(uint32_t block_num) {
+static void Ext2FreeBlock(Ext2Volume* vol, uint32_t block_num) {
     if (block_num == 0) return;
 
     uint32_t group = (block_num - volume.superblock.s_first_data_block) / volume.blocks_per_group;
     uint32_t bit = (block_num - volume.superblock.s_first_data_block) % volume.blocks_per_group;
 
-    uint8_t* bitmap_buffer = KernelMemoryAlloc(volume.block_size);
-    if (!bitmap_buffer) return;
+    uint8_t* bitmap = Ext2GetBitmap(vol, group, 0);
+    if (!bitmap || !Ext2TestBit(bitmap, bit)) return;
 
-    uint32_t bitmap_block = volume.group_descs[group].bg_block_bitmap;
-    if (Ext2ReadBlock(bitmap_block, bitmap_buffer) == 0) {
-        Ext2ClearBit(bitmap_buffer, bit);
-        if (Ext2WriteBlock(bitmap_block, bitmap_buffer) == 0) {
-            volume.group_descs[group].bg_free_blocks_count++;
-            volume.superblock.s_free_blocks_count++;
-        }
-    }
-
-    KernelFree(bitmap_buffer);
+    Ext2ClearBit(bitmap, bit);
+    volume.bitmap_dirty[group] |= EXT2_BITMAP_BLOCKS_DIRTY;
+    volume.group_descs[group].bg_free_blocks_count++;
+    volume.superblock.s_free_blocks_count++;
+    volume.meta_dirty = 1;
+    const uint32_t num_sectors = volume.block_size / 512;
+    BlockCacheDiscard(volume.device->id, (uint64_t)block_num * num_sectors, num_sectors);
 }
 
-static void Ext2FreeInode(uint32_t inode_num) {
+static void Ext2FreeInode(Ext2Volume* vol, uint32_t inode_num) {
     if (inode_num < 2) return;
 
     uint32_t group = (inode_num - 1) / volume.inodes_per_group;
     uint32_t bit = (inode_num - 1) % volume.inodes_per_group;
 
-    uint8_t* bitmap_buffer = KernelMemoryAlloc(volume.block_size);
-    if (!bitmap_buffer) return;
+    uint8_t* bitmap = Ext2GetBitmap(vol, group, 1);
+    if (!bitmap || !Ext2TestBit(bitmap, bit)) return;
+
+    Ext2ClearBit(bitmap, bit);
+    volume.bitmap_dirty[group] |= EXT2_BITMAP_INODES_DIRTY;
+    volume.group_descs[group].bg_free_inodes_count++;
+    volume.superblock.s_free_inodes_count++;
+    volume.meta_dirty = 1;
+}
+
+// Number of file blocks mapped by one entry at `depth` (0: a data block)
+static uint64_t Ext2Span(Ext2Volume* vol, uint32_t depth) {
+    uint64_t span = 1;
+    while (depth--) span *= volume.block_size / 4;
+    return span;
+}
 
-    uint32_t bitmap_block = volume.group_descs[group].bg_inode_bitmap;
-    if (Ext2ReadBlock(bitmap_block, bitmap_buffer) == 0) {
-        Ext2ClearBit(bitmap_buffer, bit);
-        if (Ext2WriteBlock(bitmap_block, bitmap_buffer) == 0) {
-            volume.group_descs[group].bg_free_inodes_count++;
-            volume.superblock.s_free_inodes_count++;
+// Frees everything mapped through *entry, a block at `depth` in the
+// indirect tree whose first file block is `base`, from file block `first`
+// onwards. Indirect blocks left with no entries are freed as well.
+static void Ext2FreeTree(Ext2Volume* vol, Ext2Inode* inode, uint32_t* entry, uint32_t depth, uint64_t base, uint64_t first) {
+    if (*entry == 0) return;
+    const uint64_t span = Ext2Span(vol, depth);
+    if (base + span <= first) return; // Entirely before the cut
+
+    if (depth > 0) {
+        const uint32_t per_block = volume.block_size / 4;
+        uint32_t* table = KernelMemoryAlloc(volume.block_size);
+        if (!table) return;
+        if (Ext2ReadBlock(vol, *entry, table) != 0) {
+            KernelFree(table);
+            return;
         }
+
+        const uint64_t child_span = span / per_block;
+        int in_use = 0;
+        for (uint32_t i = 0; i < per_block; i++) {
+            Ext2FreeTree(vol, inode, &table[i], depth - 1, base + i * child_span, first);
+            if (table[i]) in_use = 1;
+        }
+        if (in_use) {
+            Ext2WriteBlock(vol, *entry, table);
+            KernelFree(table);
+            return;
+        }
+        KernelFree(table);
     }
 
-    KernelFree(bitmap_buffer);
+    Ext2FreeBlock(vol, *entry);
+    inode->i_blocks -= volume.block_size / 512;
+    *entry = 0;
 }
 
+// Releases every block mapping file block `first_index` or later
+static void Ext2TruncateBlocks(Ext2Volume* vol, Ext2Inode* inode, uint64_t first_index) {
+    // i_block sits in a packed struct, so each root goes through a local
+    for (uint32_t i = 0; i < EXT2_NDIR_BLOCKS; i++) {
+        uint32_t root = inode->i_block[i];
+        Ext2FreeTree(vol, inode, &root, 0, i, first_index);
+        inode->i_block[i] = root;
+    }
+    uint64_t base = EXT2_NDIR_BLOCKS;
+    for (uint32_t depth = 1; depth <= 3; depth++) {
+        uint32_t root = inode->i_block[EXT2_IND_BLOCK + depth - 1];
+        Ext2FreeTree(vol, inode, &root, depth, base, first_index);
+        inode->i_block[EXT2_IND_BLOCK + depth - 1] = root;
+        base += Ext2Span(vol, depth);
+    }
+}
 
-int Ext2Delete(const char* path) {
+int Ext2Delete(void* fs_data, const char* path, int recursive) {
+    (void)recursive;
+    Ext2Volume* vol = fs_data;
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
 
-    uint32_t inode_num = Ext2PathToInode(path);
+    uint32_t inode_num = Ext2PathToInode(vol, path);
     if (inode_num == 0) {
         PrintKernelF("EXT2: Delete: File not found: %s\n", path);
         rust_rwlock_write_unlock(volume.lock);
@@ -1100,29 +2050,24 @@ int Ext2Delete(const char* path) {
     }
 
     Ext2Inode inode;
-    if (Ext2ReadInode(inode_num, &inode) != 0) {
+    if (Ext2ReadInode(vol, inode_num, &inode) != 0) {
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
 
-    // Free all data blocks
-    for (int i = 0; i < 12; i++) {
-        if (inode.i_block[i] != 0) {
-            Ext2FreeBlock(inode.i_block[i]);
-            inode.i_block[i] = 0;
-        }
-    }
-    // TODO: Handle indirect blocks
+    // Free all data and indirect blocks
+    Ext2TruncateBlocks(vol, &inode, 0);
 
     // Mark inode as deleted
     inode.i_dtime = RtcGetUnixTime();
     inode.i_links_count = 0;
-    if (Ext2WriteInode(inode_num, &inode) != 0) {
+    if (Ext2WriteInode(vol, inode_num, &inode) != 0) {
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
 
-    Ext2FreeInode(inode_num);
+    Ext2FreeInode(vol, inode_num);
+    Ext2IUnlink(vol, inode_num);
 
     // Remove directory entry
     char dir_path[256] = "/";
@@ -1139,14 +2084,14 @@ int Ext2Delete(const char* path) {
         }
     }
 
-    uint32_t parent_inode_num = Ext2PathToInode(dir_path);
+    uint32_t parent_inode_num = Ext2PathToInode(vol, dir_path);
     if (parent_inode_num == 0) {
         rust_rwlock_write_unlock(volume.lock);
         return -1; // Should not happen
     }
 
     Ext2Inode parent_inode;
-    if (Ext2ReadInode(parent_inode_num, &parent_inode) != 0) {
+    if (Ext2ReadInode(vol, parent_inode_num, &parent_inode) != 0) {
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
@@ -1157,50 +2102,36 @@ int Ext2Delete(const char* path) {
         return -1;
     }
 
+    const char* name = last_slash ? last_slash + 1 : path;
+    const uint32_t name_len = FastStrlen(name, 255);
     int res = -1;
-    for (int i = 0; i < 12; i++) {
-        if (parent_inode.i_block[i] == 0) continue;
-        if (Ext2ReadBlock(parent_inode.i_block[i], block_buffer) != 0) continue;
-
-        Ext2DirEntry* entry = (Ext2DirEntry*)block_buffer;
-        Ext2DirEntry* prev_entry = NULL;
-        uint32_t offset = 0;
-
-        while (offset < volume.block_size && entry->rec_len > 0) {
-            if (entry->inode == inode_num) {
-                if (prev_entry) {
-                    prev_entry->rec_len += entry->rec_len;
-                } else {
-                    entry->inode = 0; // First entry in block
-                }
-                if (Ext2WriteBlock(parent_inode.i_block[i], block_buffer) == 0) {
-                    res = 0;
-                }
-                goto end_delete_loop;
-            }
-            prev_entry = entry;
-            offset += entry->rec_len;
-            entry = (Ext2DirEntry*)((uint8_t*)block_buffer + offset);
-        }
+    int complete;
+    uint32_t block;
+    if (Ext2DirLookup(vol, &parent_inode, name, name_len, block_buffer, &block, &complete) == inode_num &&
+        Ext2BlockRemoveEntry(vol, block_buffer, name, name_len) && Ext2WriteBlock(vol, block, block_buffer) == 0) {
+        res = 0;
     }
 
-end_delete_loop:
     KernelFree(block_buffer);
+    DCacheInvalidate(vol, parent_inode_num, name, name_len);
+    DCacheInvalidateDir(vol, inode_num);
+    if (Ext2SyncMetadata(vol) != 0) res = -1;
     rust_rwlock_write_unlock(volume.lock);
     return res;
 }
 
 
-int Ext2IsFile(const char* path) {
+int Ext2IsFile(void* fs_data, const char* path) {
+    Ext2Volume* vol = fs_data;
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
-    uint32_t inode_num = Ext2PathToInode(path);
+    uint32_t inode_num = Ext2PathToInode(vol, path);
     if (inode_num == 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return 0;
     }
 
     Ext2Inode inode;
-    if (Ext2ReadInode(inode_num, &inode) != 0) {
+    if (Ext2ReadInode(vol, inode_num, &inode) != 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return 0;
     }
@@ -1210,16 +2141,17 @@ int Ext2IsFile(const char* path) {
     return result;
 }
 
-int Ext2IsDir(const char* path) {
+int Ext2IsDir(void* fs_data, const char* path) {
+    Ext2Volume* vol = fs_data;
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
-    uint32_t inode_num = Ext2PathToInode(path);
+    uint32_t inode_num = Ext2PathToInode(vol, path);
     if (inode_num == 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return 0;
     }
 
     Ext2Inode inode;
-    if (Ext2ReadInode(inode_num, &inode) != 0) {
+    if (Ext2ReadInode(vol, inode_num, &inode) != 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return 0;
     }
@@ -1229,21 +2161,425 @@ int Ext2IsDir(const char* path) {
     return result;
 }
 
-uint64_t Ext2GetFileSize(const char* path) {
+uint64_t Ext2GetFileSize(void* fs_data, const char* path) {
+    Ext2Volume* vol = fs_data;
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
-    uint32_t inode_num = Ext2PathToInode(path);
+    uint32_t inode_num = Ext2PathToInode(vol, path);
     if (inode_num == 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return 0;
     }
 
     Ext2Inode inode;
-    if (Ext2ReadInode(inode_num, &inode) != 0) {
+    if (Ext2ReadInode(vol, inode_num, &inode) != 0) {
         rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
         return 0;
     }
 
-    uint64_t size = inode.i_size;
+    uint64_t size = Ext2InodeSize(&inode);
     rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
     return size;
-}
\ No newline at end of file
+}
+// Open-file objects: the path is resolved and the inode read once at open
+// time, so positioned reads and writes only touch the blocks they cover.
+// Returns the cached copy of indirect block `block`, reading it in (or,
+// for a block just allocated, zero-filling it) on a miss. The least
+// recently used slot is written back if dirty and reused.
+static Ext2IndSlot* Ext2IndGet(Ext2File* file, uint32_t block, int fresh) {
+    Ext2Volume* vol = file->vol;
+    Ext2IndSlot* victim = &file->ind[0];
+    for (int i = 0; i < EXT2_IND_CACHE_SLOTS; i++) {
+        Ext2IndSlot* slot = &file->ind[i];
+        if (slot->block == block) {
+            slot->last_use = ++file->ind_tick;
+            return slot;
+        }
+        if (slot->block == 0) {
+            if (victim->block != 0) victim = slot;
+        } else if (victim->block != 0 && slot->last_use < victim->last_use) {
+            victim = slot;
+        }
+    }
+
+    if (victim->block != 0 && victim->dirty) {
+        if (Ext2WriteBlock(vol, victim->block, victim->table) != 0) return NULL;
+    }
+    victim->block = 0;
+    victim->dirty = 0;
+    if (!victim->table && !(victim->table = KernelMemoryAlloc(volume.block_size))) return NULL;
+
+    if (fresh) {
+        FastMemset(victim->table, 0, volume.block_size);
+        victim->dirty = 1;
+    } else if (Ext2ReadBlock(vol, block, victim->table) != 0) {
+        return NULL;
+    }
+    victim->block = block;
+    victim->last_use = ++file->ind_tick;
+    return victim;
+}
+
+// Forgets the cached indirect blocks if the block map changed through
+// another file object since they were read. Writers flush before dropping
+// the volume lock, so anything dropped here is clean.
+static void Ext2IndValidate(Ext2File* file) {
+    if (file->ind_gen == file->ci->map_gen) return;
+    for (int i = 0; i < EXT2_IND_CACHE_SLOTS; i++) {
+        file->ind[i].block = 0;
+        file->ind[i].dirty = 0;
+    }
+    file->ind_gen = file->ci->map_gen;
+}
+
+// Writes back the dirty cached indirect blocks, then the inode and
+// allocation metadata
+static int Ext2FileFlush(Ext2File* file) {
+    Ext2Volume* vol = file->vol;
+    int result = 0;
+    for (int i = 0; i < EXT2_IND_CACHE_SLOTS; i++) {
+        Ext2IndSlot* slot = &file->ind[i];
+        if (slot->block == 0 || !slot->dirty) continue;
+        if (Ext2WriteBlock(vol, slot->block, slot->table) != 0) result = -1;
+        else slot->dirty = 0;
+    }
+    if (Ext2SyncMetadata(vol) != 0) result = -1;
+    return result;
+}
+
+// Allocates the file's next block: from its preallocation window if any,
+// else next to its previous allocation (or in its inode's group), then
+// reserves the blocks following it as the new window.
+static uint32_t Ext2FileAllocBlock(Ext2File* file) {
+    Ext2Volume* vol = file->vol;
+    uint32_t block;
+    if (file->prealloc_count) {
+        block = file->prealloc_start++;
+        file->prealloc_count--;
+    } else {
+        const uint32_t goal = file->alloc_goal ? file->alloc_goal : Ext2InodeGoal(vol, file->inode_num);
+        block = Ext2AllocateBlock(vol, goal);
+        if (block == 0) return 0;
+        file->prealloc_start = block + 1;
+        file->prealloc_count = Ext2ReserveBlocks(vol, block + 1, EXT2_PREALLOC_BLOCKS);
+    }
+    file->alloc_goal = block + 1;
+    return block;
+}
+
+// Maps file block `index` to its disk block through the direct, single,
+// double and triple indirect pointers. *out is 0 for a hole unless
+// `create` is set, in which case missing data and indirect blocks are
+// allocated and *fresh reports a newly allocated data block.
+static int Ext2BlockMap(Ext2File* file, uint64_t index, int create, uint32_t* out, int* fresh) {
+    Ext2Volume* vol = file->vol;
+    const uint32_t per_block = volume.block_size / 4;
+    if (fresh) *fresh = 0;
+    *out = 0;
+    Ext2IndValidate(file);
+
+    uint32_t root; // i_block slot the walk starts from
+    uint32_t depth;
+    if (index < EXT2_NDIR_BLOCKS) {
+        root = (uint32_t)index;
+        depth = 0;
+    } else {
+        index -= EXT2_NDIR_BLOCKS;
+        for (depth = 1; depth <= 3; depth++) {
+            const uint64_t span = Ext2Span(vol, depth);
+            if (index < span) break;
+            index -= span;
+        }
+        if (depth > 3) return -1; // Past the largest file ext2 can map
+        root = EXT2_IND_BLOCK + depth - 1;
+    }
+
+    // `entry` is a copy of the inode's i_block[root] (the inode is packed)
+    // or lives in `owner`; whichever must be updated or marked dirty when a
+    // block is allocated into it.
+    uint32_t root_entry = file->inode->i_block[root];
+    uint32_t* entry = &root_entry;
+    Ext2IndSlot* owner = NULL;
+    for (;;) {
+        int allocated = 0;
+        if (*entry == 0) {
+            if (!create) return 0; // Hole
+            const uint32_t block = Ext2FileAllocBlock(file);
+            if (block == 0) return -1;
+            *entry = block;
+            file->inode->i_blocks += volume.block_size / 512;
+            file->ci->dirty = 1;
+            file->ind_gen = ++file->ci->map_gen;
+            if (owner) owner->dirty = 1;
+            else file->inode->i_block[root] = block;
+            allocated = 1;
+        }
+
+        if (depth == 0) {
+            *out = *entry;
+            if (fresh) *fresh = allocated;
+            return 0;
+        }
+
+        Ext2IndSlot* slot = Ext2IndGet(file, *entry, allocated);
+        if (!slot) return -1;
+        depth--;
+        const uint64_t child_span = Ext2Span(vol, depth);
+        entry = &slot->table[(index / child_span) % per_block];
+        owner = slot;
+    }
+}
+
+// Releases the file's blocks from `first_index` on. Its cached indirect
+// blocks may be among them, and other files open on the inode must re-read
+// theirs.
+static void Ext2FileTruncateBlocks(Ext2File* file, uint64_t first_index) {
+    for (int i = 0; i < EXT2_IND_CACHE_SLOTS; i++) {
+        file->ind[i].block = 0;
+        file->ind[i].dirty = 0;
+    }
+    Ext2TruncateBlocks(file->vol, file->inode, first_index);
+    file->ind_gen = ++file->ci->map_gen;
+}
+
+// File object for any inode; directories use one internally so that they
+// grow through the same block mapping as regular files
+static Ext2File* Ext2FileGet(Ext2Volume* vol, uint32_t inode_num) {
+    Ext2File* file = KernelMemoryAlloc(sizeof(Ext2File));
+    if (!file) return NULL;
+    FastMemset(file, 0, sizeof(Ext2File));
+    file->ci = Ext2IGet(vol, inode_num, 1);
+    if (!file->ci) {
+        KernelFree(file);
+        return NULL;
+    }
+    file->inode = &file->ci->inode;
+    file->ind_gen = file->ci->map_gen;
+    file->vol = vol;
+    file->inode_num = inode_num;
+    return file;
+}
+
+void* Ext2Open(void* fs_data, const char* path, int flags) {
+    Ext2Volume* vol = fs_data;
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+
+    uint32_t inode_num = Ext2PathToInode(vol, path);
+    if (inode_num == 0 && (flags & FS_CREATE)) {
+        if (Ext2CreateFile(vol, path) == 0) inode_num = Ext2PathToInode(vol, path);
+    }
+    if (inode_num == 0) {
+        rust_rwlock_write_unlock(volume.lock);
+        return NULL;
+    }
+
+    Ext2File* file = Ext2FileGet(vol, inode_num);
+    if (file && !S_ISREG(file->inode->i_mode)) {
+        Ext2Close(file);
+        file = NULL;
+    }
+
+    rust_rwlock_write_unlock(volume.lock);
+    return file;
+}
+
+int64_t Ext2ReadAt(void* handle, uint64_t offset, void* buffer, uint64_t count) {
+    Ext2File* file = handle;
+    if (!file || !buffer) return -1;
+    Ext2Volume* vol = file->vol;
+    rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
+    if (file->ci->unlinked) {
+        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
+        return -1;
+    }
+
+    const uint64_t size = Ext2InodeSize(file->inode);
+    if (offset >= size) {
+        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
+        return 0;
+    }
+    if (count > size - offset) count = size - offset;
+
+    const uint32_t bs = volume.block_size;
+    uint8_t* out = (uint8_t*)buffer;
+    uint8_t* block_buffer = NULL;
+    uint64_t done = 0;
+
+    while (done < count) {
+        const uint64_t pos = offset + done;
+        const uint64_t index = pos / bs;
+        const uint32_t in_block = (uint32_t)(pos % bs);
+        uint64_t chunk = bs - in_block;
+        if (chunk > count - done) chunk = count - done;
+
+        uint32_t block;
+        if (Ext2BlockMap(file, index, 0, &block, NULL) != 0) break;
+        if (block == 0) {
+            FastMemset(out + done, 0, chunk); // Hole
+        } else if (chunk == bs) {
+            // Coalesce physically contiguous whole blocks into one read
+            uint32_t run = 1;
+            while (done + (uint64_t)(run + 1) * bs <= count) {
+                uint32_t next;
+                if (Ext2BlockMap(file, index + run, 0, &next, NULL) != 0 || next != block + run) break;
+                run++;
+            }
+            if (Ext2ReadBlocks(vol, block, run, out + done) != 0) break;
+            chunk = (uint64_t)run * bs;
+        } else {
+            if (!block_buffer && !(block_buffer = KernelMemoryAlloc(bs))) break;
+            if (Ext2ReadBlock(vol, block, block_buffer) != 0) break;
+            FastMemcpy(out + done, block_buffer + in_block, chunk);
+        }
+        done += chunk;
+    }
+
+    if (block_buffer) KernelFree(block_buffer);
+    rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
+    return (done == 0 && count > 0) ? -1 : (int64_t)done;
+}
+
+int64_t Ext2WriteAt(void* handle, uint64_t offset, const void* buffer, uint64_t count) {
+    Ext2File* file = handle;
+    if (!file || !buffer) return -1;
+    Ext2Volume* vol = file->vol;
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+    if (file->ci->unlinked) {
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
+
+    const uint32_t bs = volume.block_size;
+    const uint8_t* in = (const uint8_t*)buffer;
+    uint8_t* block_buffer = NULL;
+    uint64_t done = 0;
+
+    while (done < count) {
+        const uint64_t pos = offset + done;
+        const uint64_t index = pos / bs;
+        const uint32_t in_block = (uint32_t)(pos % bs);
+        uint64_t chunk = bs - in_block;
+        if (chunk > count - done) chunk = count - done;
+
+        uint32_t block;
+        int fresh;
+        if (Ext2BlockMap(file, index, 1, &block, &fresh) != 0) break;
+
+        if (chunk == bs) {
+            // Coalesce physically contiguous whole blocks into one write
+            uint32_t run = 1;
+            while (done + (uint64_t)(run + 1) * bs <= count) {
+                uint32_t next;
+                if (Ext2BlockMap(file, index + run, 1, &next, NULL) != 0 || next != block + run) break;
+                run++;
+            }
+            if (Ext2WriteBlocks(vol, block, run, in + done) != 0) break;
+            chunk = (uint64_t)run * bs;
+        } else {
+            if (!block_buffer && !(block_buffer = KernelMemoryAlloc(bs))) break;
+            if (fresh) FastMemset(block_buffer, 0, bs);
+            else if (Ext2ReadBlock(vol, block, block_buffer) != 0) break;
+            FastMemcpy(block_buffer + in_block, in + done, chunk);
+            if (Ext2WriteBlock(vol, block, block_buffer) != 0) break;
+        }
+        done += chunk;
+    }
+
+    if (offset + done > Ext2InodeSize(file->inode)) {
+        Ext2SetFileSize(vol, file->inode, offset + done);
+        file->ci->dirty = 1;
+    }
+    if (Ext2FileFlush(file) != 0) done = 0;
+
+    if (block_buffer) KernelFree(block_buffer);
+    rust_rwlock_write_unlock(volume.lock);
+    return (done == 0 && count > 0) ? -1 : (int64_t)done;
+}
+
+uint64_t Ext2FileSize(void* handle) {
+    Ext2File* file = handle;
+    return file ? Ext2InodeSize(file->inode) : 0;
+}
+
+// Shortens the file to `size` bytes. The blocks past it are released and
+// the tail of the new last block is zeroed, so a later extension reads
+// zeros there rather than the old contents.
+int Ext2Truncate(void* handle, uint64_t size) {
+    Ext2File* file = handle;
+    if (!file) return -1;
+    Ext2Volume* vol = file->vol;
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+    if (file->ci->unlinked) {
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
+
+    if (size >= Ext2InodeSize(file->inode)) {
+        rust_rwlock_write_unlock(volume.lock);
+        return 0;
+    }
+
+    const uint32_t bs = volume.block_size;
+    int result = Ext2FileFlush(file);
+
+    uint32_t in_block = (uint32_t)(size % bs);
+    uint32_t block;
+    if (result == 0 && in_block && Ext2BlockMap(file, size / bs, 0, &block, NULL) == 0 && block) {
+        uint8_t* block_buffer = KernelMemoryAlloc(bs);
+        if (!block_buffer || Ext2ReadBlock(vol, block, block_buffer) != 0) {
+            result = -1;
+        } else {
+            FastMemset(block_buffer + in_block, 0, bs - in_block);
+            if (Ext2WriteBlock(vol, block, block_buffer) != 0) result = -1;
+        }
+        if (block_buffer) KernelFree(block_buffer);
+    }
+
+    if (result == 0) {
+        Ext2FileTruncateBlocks(file, (size + bs - 1) / bs);
+        Ext2SetFileSize(vol, file->inode, size);
+        file->ci->dirty = 1;
+        if (Ext2SyncMetadata(vol) != 0) result = -1;
+    }
+
+    rust_rwlock_write_unlock(volume.lock);
+    return result;
+}
+
+void Ext2Close(void* handle) {
+    Ext2File* file = handle;
+    if (!file) return;
+    if (file->prealloc_count) {
+        Ext2Volume* vol = file->vol;
+        rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+        Ext2UnreserveBlocks(vol, file->prealloc_start, file->prealloc_count);
+        Ext2SyncMetadata(vol);
+        rust_rwlock_write_unlock(volume.lock);
+    }
+    for (int i = 0; i < EXT2_IND_CACHE_SLOTS; i++) {
+        if (file->ind[i].table) KernelFree(file->ind[i].table);
+    }
+    Ext2IPut(file->vol, file->ci);
+    KernelFree(file);
+}
+
+FileSystemDriver g_ext2_driver = {
+    .name = "EXT2",
+    .detect = Ext2Detect,
+    .mount = Ext2Mount,
+    .unmount = Ext2Unmount,
+    .read_file = Ext2ReadFile,
+    .write_file = Ext2WriteFile,
+    .list_dir = Ext2ListDir,
+    .create_file = Ext2CreateFile,
+    .create_dir = Ext2CreateDir,
+    .remove = Ext2Delete,
+    .is_dir = Ext2IsDir,
+    .is_file = Ext2IsFile,
+    .get_size = Ext2GetFileSize,
+    .open = Ext2Open,
+    .read_at = Ext2ReadAt,
+    .write_at = Ext2WriteAt,
+    .file_size = Ext2FileSize,
+    .truncate = Ext2Truncate,
+    .close = Ext2Close,
+};
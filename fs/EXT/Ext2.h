@@ -1,9 +1,8 @@
 #pragma once
 #include <BlockDevice.h>
+#include <FileSystem.h>
 #include <stdint.h>
 
-#include <BlockDevice.h>
-
 // Minimal EXT2 data structures
 
 // ext2_super_block structure
@@ -45,9 +44,34 @@ typedef struct {
     char     s_volume_name[16];
     char     s_last_mounted[64];
     uint32_t s_algo_bitmap;
+    uint8_t  s_prealloc_blocks;
+    uint8_t  s_prealloc_dir_blocks;
+    uint16_t s_reserved_gdt_blocks;
+    uint8_t  s_journal_uuid[16];
+    uint32_t s_journal_inum;
+    uint32_t s_journal_dev;
+    uint32_t s_last_orphan;
+    uint32_t s_hash_seed[4];        // dir_index hash seed
+    uint8_t  s_def_hash_version;    // hash for newly indexed directories
+    uint8_t  s_jnl_backup_type;
+    uint16_t s_desc_size;
+    uint32_t s_default_mount_opts;
+    uint32_t s_first_meta_bg;
+    uint32_t s_mkfs_time;
+    uint32_t s_jnl_blocks[17];
+    uint32_t s_blocks_count_hi;
+    uint32_t s_r_blocks_count_hi;
+    uint32_t s_free_blocks_count_hi;
+    uint16_t s_min_extra_isize;
+    uint16_t s_want_extra_isize;
+    uint32_t s_flags;
     // ... other fields omitted for simplicity
 } __attribute__((packed)) Ext2Superblock;
 
+#define EXT2_FEATURE_COMPAT_DIR_INDEX   0x0020
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE 0x0002 // files may be 2 GiB or larger
+#define EXT2_FLAGS_UNSIGNED_HASH        0x0002  // s_flags: hash names as unsigned chars
+
 // Block Group Descriptor
 typedef struct {
     uint32_t bg_block_bitmap;
@@ -61,7 +85,11 @@ typedef struct {
 } __attribute__((packed)) Ext2GroupDesc;
 
 // Inode structure
-#define EXT2_N_BLOCKS 15
+#define EXT2_NDIR_BLOCKS 12  // i_block[0..11] map file blocks directly
+#define EXT2_IND_BLOCK   12  // single indirect
+#define EXT2_DIND_BLOCK  13  // double indirect
+#define EXT2_TIND_BLOCK  14  // triple indirect
+#define EXT2_N_BLOCKS    15
 typedef struct {
     uint16_t i_mode;
     uint16_t i_uid;
@@ -78,7 +106,7 @@ typedef struct {
     uint32_t i_block[EXT2_N_BLOCKS];
     uint32_t i_generation;
     uint32_t i_file_acl;
-    uint32_t i_dir_acl;
+    uint32_t i_dir_acl;         // high 32 bits of i_size for regular files
     uint32_t i_faddr;
     uint8_t  i_osd2[12];
 } __attribute__((packed)) Ext2Inode;
@@ -90,6 +118,9 @@ typedef struct {
 #define S_ISDIR(m)  (((m) & 0xF000) == EXT2_S_IFDIR)
 #define S_ISREG(m)  (((m) & 0xF000) == EXT2_S_IFREG)
 
+// Inode flags (in i_flags)
+#define EXT2_INDEX_FL 0x00001000 // Directory has a hashed (htree) index
+
 // Directory entry
 typedef struct {
     uint32_t inode;
@@ -99,21 +130,65 @@ typedef struct {
     char     name[];
 } __attribute__((packed)) Ext2DirEntry;
 
+// Hashed directory index (htree), as written by ext3/ext4. Block 0 of an
+// indexed directory holds "." and "..", whose rec_len covers the rest of
+// the block, followed by Ext2DxRootInfo and an Ext2DxEntry array; interior
+// index blocks are a single empty dirent followed by an entry array. The
+// first entry of each array stores an Ext2DxCountLimit in place of its
+// hash, which is implicitly 0. Leaves are ordinary directory blocks, so
+// code unaware of the index still sees a valid linear directory.
+#define EXT2_DX_HASH_LEGACY             0
+#define EXT2_DX_HASH_HALF_MD4           1
+#define EXT2_DX_HASH_TEA                2
+#define EXT2_DX_HASH_LEGACY_UNSIGNED    3
+#define EXT2_DX_HASH_HALF_MD4_UNSIGNED  4
+#define EXT2_DX_HASH_TEA_UNSIGNED       5
+
+typedef struct {
+    uint32_t reserved_zero;
+    uint8_t  hash_version;
+    uint8_t  info_length;       // 8
+    uint8_t  indirect_levels;   // interior index levels below the root
+    uint8_t  unused_flags;
+} __attribute__((packed)) Ext2DxRootInfo;
+
+typedef struct {
+    uint16_t limit;
+    uint16_t count;
+} __attribute__((packed)) Ext2DxCountLimit;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t block;             // logical block within the directory
+} __attribute__((packed)) Ext2DxEntry;
+
+// Per-mount volume state, passed to every operation as fs_data
+typedef struct Ext2Volume Ext2Volume;
+
+extern FileSystemDriver g_ext2_driver;
+
 // Function prototypes for VFS integration
 int Ext2Mount(BlockDevice* device, const char* mount_point);
 int Ext2Unmount(BlockDevice* device);
 int Ext2Detect(BlockDevice* device);
-void Ext2SetActive(BlockDevice* device);
-int Ext2ReadFile(const char* path, void* buffer, uint32_t max_size);
-int Ext2WriteFile(const char* path, const void* buffer, uint32_t size);
-int Ext2ListDir(const char* path);
-int Ext2CreateFile(const char* path);
-int Ext2CreateDir(const char* path);
-int Ext2Delete(const char* path);
-int Ext2IsFile(const char* path);
-int Ext2IsDir(const char* path);
-uint64_t Ext2GetFileSize(const char* path);
+int64_t Ext2ReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size);
+int64_t Ext2WriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size);
+int Ext2ListDir(void* fs_data, const char* path);
+int Ext2CreateFile(void* fs_data, const char* path);
+int Ext2CreateDir(void* fs_data, const char* path);
+int Ext2Delete(void* fs_data, const char* path, int recursive);
+int Ext2IsFile(void* fs_data, const char* path);
+int Ext2IsDir(void* fs_data, const char* path);
+uint64_t Ext2GetFileSize(void* fs_data, const char* path);
+
+// Open-file objects for positioned I/O; FS_CREATE creates a missing file
+void* Ext2Open(void* fs_data, const char* path, int flags);
+int64_t Ext2ReadAt(void* handle, uint64_t offset, void* buffer, uint64_t count);
+int64_t Ext2WriteAt(void* handle, uint64_t offset, const void* buffer, uint64_t count);
+uint64_t Ext2FileSize(void* handle);
+int Ext2Truncate(void* handle, uint64_t size);
+void Ext2Close(void* handle);
 
 // Internal helpers
-int Ext2ReadInode(uint32_t inode_num, Ext2Inode* inode);
-uint32_t Ext2PathToInode(const char* path);
\ No newline at end of file
+int Ext2ReadInode(Ext2Volume* vol, uint32_t inode_num, Ext2Inode* inode);
+uint32_t Ext2PathToInode(Ext2Volume* vol, const char* path);
@@ -1,29 +1,30 @@
 #include <FAT1x.h>
 
+#include <BlockCache.h>
+#include <DCache.h>
 #include <Console.h>
 #include <FileSystem.h>
 #include <KernelHeap.h>
 #include <MemOps.h>
 #include <MemPool.h>
 #include <StringOps.h>
+#include <TSC.h>
+#include <VFRFS.h>
 #include <VFS.h>
 
-// Per-device volume registry and active context
+// Per-device volume registry; each mount passes its volume as fs_data
 static Fat1xVolume* g_fat1x_by_dev[MAX_BLOCK_DEVICES] = {0};
-static Fat1xVolume* g_fat1x_active = NULL;
-#define volume (*g_fat1x_active)
-static uint8_t* sector_buffer = NULL;
+#define volume (*vol)
 
-void Fat1xSetActive(BlockDevice* device) {
-    if (!device) { g_fat1x_active = NULL; return; }
-    int id = device->id;
-    if (id < 0 || id >= MAX_BLOCK_DEVICES) { g_fat1x_active = NULL; return; }
-    g_fat1x_active = g_fat1x_by_dev[id];
-}
+static void Fat1xLoadFreeInfo(Fat1xVolume* vol);
+static int Fat1xFlushFat(Fat1xVolume* vol);
+static void Fat1xOpenReload(Fat1xVolume* vol, uint32_t entry_sector, int entry_offset);
+static void Fat1xOpenDrop(Fat1xVolume* vol, uint32_t entry_sector, int entry_offset, int unlink);
 
 int Fat1xDetect(BlockDevice* device) {
+    if (device->block_size != 512) return 0; // boot sector is read as one block
     uint8_t boot_sector[512];
-    if (BlockDeviceRead(device->id, 0, 1, boot_sector) != 0) {
+    if (BlockCacheRead(device->id, 0, 1, boot_sector) != 0) {
         PrintKernel("Failed to read boot sector\n");
         return 0;
     }
@@ -41,8 +42,6 @@ int Fat1xDetect(BlockDevice* device) {
     return 1;
 }
 
-static FileSystemDriver fat_driver = {"FAT1x", Fat1xDetect, Fat1xMount, Fat1xUnmount};
-
 int Fat1xMount(BlockDevice* device, const char* mount_point) {
     if (!device) return -1;
     if (device->id < 0 || device->id >= MAX_BLOCK_DEVICES) return -1;
@@ -53,12 +52,11 @@ int Fat1xMount(BlockDevice* device, const char* mount_point) {
         FastMemset(vol, 0, sizeof(Fat1xVolume));
         g_fat1x_by_dev[device->id] = vol;
     }
-    g_fat1x_active = vol;
     volume.device = device;
 
     // Read boot sector
     uint8_t boot_sector[512];
-    if (BlockDeviceRead(device->id, 0, 1, boot_sector) != 0) {
+    if (BlockCacheRead(device->id, 0, 1, boot_sector) != 0) {
         g_fat1x_by_dev[device->id] = NULL; // Critical: Free volume if read fails
         KernelFree(vol);
         return -1;
@@ -71,37 +69,94 @@ int Fat1xMount(BlockDevice* device, const char* mount_point) {
         return -1;
     }
 
-    sector_buffer = KernelMemoryAlloc(POOL_SIZE_512);
-    if (!sector_buffer) {
-        g_fat1x_by_dev[device->id] = NULL; // Critical: Free volume if read fails
+    // Geometry, and the FAT type from the data cluster count
+    const Fat32BootSectorExt* ext = (const Fat32BootSectorExt*)(boot_sector + sizeof(Fat1xBootSector));
+    const uint32_t spc = volume.boot.sectors_per_cluster;
+    const uint32_t spf = volume.boot.sectors_per_fat ? volume.boot.sectors_per_fat : ext->sectors_per_fat_32;
+    const uint32_t total_sectors = volume.boot.total_sectors_16 ? volume.boot.total_sectors_16 : volume.boot.total_sectors_32;
+    const uint32_t root_sectors = (volume.boot.root_entries * 32 + 511) / 512;
+    const uint32_t meta_sectors = volume.boot.reserved_sectors + volume.boot.fat_count * spf + root_sectors;
+    if (spc == 0 || (spc & (spc - 1)) || volume.boot.fat_count == 0 || spf == 0 || total_sectors <= meta_sectors) {
+        g_fat1x_by_dev[device->id] = NULL;
         KernelFree(vol);
         return -1;
     }
+    volume.sectors_per_fat = spf;
+    volume.total_clusters = (total_sectors - meta_sectors) / spc;
+    volume.fat_type = volume.total_clusters <= FAT12_MAX_CLUSTERS ? FAT1X_TYPE_12
+                    : volume.total_clusters <= FAT16_MAX_CLUSTERS ? FAT1X_TYPE_16 : FAT1X_TYPE_32;
 
     volume.fat_sector = volume.boot.reserved_sectors;
-    volume.root_sector = volume.fat_sector + (volume.boot.fat_count * volume.boot.sectors_per_fat);
-    uint32_t root_sectors = (volume.boot.root_entries * 32 + volume.boot.bytes_per_sector - 1) / volume.boot.bytes_per_sector;
+    volume.fat_mirror = 1;
+    if (volume.fat_type == FAT1X_TYPE_32) {
+        volume.root_cluster = ext->root_cluster;
+        if (volume.boot.root_entries != 0 || volume.root_cluster < 2 ||
+            volume.root_cluster >= volume.total_clusters + 2) {
+            g_fat1x_by_dev[device->id] = NULL;
+            KernelFree(vol);
+            return -1;
+        }
+        // Without mirroring only the active copy is maintained
+        if (ext->ext_flags & 0x80) {
+            volume.fat_mirror = 0;
+            volume.fat_sector += (ext->ext_flags & 0xF) * spf;
+        }
+        if (ext->fs_info && ext->fs_info < volume.boot.reserved_sectors) volume.fsinfo_sector = ext->fs_info;
+    }
+    volume.root_sector = volume.boot.reserved_sectors + (volume.boot.fat_count * spf);
     volume.data_sector = volume.root_sector + root_sectors;
 
-    uint32_t fat_size = volume.boot.sectors_per_fat * 512;
-    volume.fat_table = KernelMemoryAlloc(fat_size);
+    volume.sector_buffer = KernelMemoryAlloc(POOL_SIZE_512);
+    if (!volume.sector_buffer) {
+        g_fat1x_by_dev[device->id] = NULL; // Critical: Free volume if read fails
+        KernelFree(vol);
+        return -1;
+    }
+
+    // Only the part of the FAT that maps real clusters is cached
+    const uint32_t entries = volume.total_clusters + 2;
+    const uint32_t fat_bytes = volume.fat_type == FAT1X_TYPE_12 ? entries + (entries + 1) / 2
+                             : entries * (volume.fat_type / 8);
+    volume.fat_sectors = (fat_bytes + 511) / 512;
+    if (volume.fat_sectors > spf) volume.fat_sectors = spf;
+
+    volume.fat_table = KernelMemoryAlloc(volume.fat_sectors * 512);
     if (!volume.fat_table) {
-        KernelFree(sector_buffer);
-        sector_buffer = NULL;
+        KernelFree(volume.sector_buffer);
+        volume.sector_buffer = NULL;
         return -1;
     }
 
-    for (int i = 0; i < volume.boot.sectors_per_fat; i++) {
-        if (BlockDeviceRead(device->id, volume.fat_sector + i, 1, volume.fat_table + (i * 512)) != 0) {
-            KernelFree(volume.fat_table);
-            volume.fat_table = NULL;
-            KernelFree(sector_buffer);
-            sector_buffer = NULL;
-            return -1;
-        }
+    volume.fat_dirty = KernelMemoryAlloc((volume.fat_sectors + 7) / 8);
+    volume.fat_flushing = volume.fat_dirty ? KernelMemoryAlloc((volume.fat_sectors + 7) / 8) : NULL;
+    if (!volume.fat_flushing) {
+        if (volume.fat_dirty) KernelFree(volume.fat_dirty);
+        volume.fat_dirty = NULL;
+        KernelFree(volume.fat_table);
+        volume.fat_table = NULL;
+        KernelFree(volume.sector_buffer);
+        volume.sector_buffer = NULL;
+        return -1;
     }
+    FastMemset(volume.fat_dirty, 0, (volume.fat_sectors + 7) / 8);
+    volume.fat_dirty_count = 0;
+    volume.discard_count = 0;
+
+    if (BlockCacheRead(device->id, volume.fat_sector, volume.fat_sectors, volume.fat_table) != 0) {
+        KernelFree(volume.fat_flushing);
+        volume.fat_flushing = NULL;
+        KernelFree(volume.fat_dirty);
+        volume.fat_dirty = NULL;
+        KernelFree(volume.fat_table);
+        volume.fat_table = NULL;
+        KernelFree(volume.sector_buffer);
+        volume.sector_buffer = NULL;
+        return -1;
+    }
+
+    Fat1xLoadFreeInfo(vol);
 
-    VfsMount(mount_point, device, &fat_driver);
+    VfsMount(mount_point, device, &g_fat1x_driver, vol);
     return 0;
 }
 
@@ -113,32 +168,21 @@ int Fat1xUnmount(BlockDevice* device) {
     Fat1xVolume* vol = g_fat1x_by_dev[id];
     if (!vol) return -1; // Not mounted
 
-    if (g_fat1x_active == vol) {
-        g_fat1x_active = NULL;
-    }
-
     // if (vol->fat_table) {
     //     KernelFree(vol->fat_table);
     //     vol->fat_table = NULL;
     // }
 
+    if (Fat1xSync(vol) != 0) {
+        PrintKernelWarning("FAT1x: FAT write-back failed at unmount\n");
+    }
+    DCachePurge(vol);
+    if (vol->fat_dirty) KernelFree(vol->fat_dirty);
+    if (vol->fat_flushing) KernelFree(vol->fat_flushing);
+    if (vol->sector_buffer) KernelFree(vol->sector_buffer);
     KernelFree(vol);
     g_fat1x_by_dev[id] = NULL;
 
-    // If no other FAT volumes are active, free the shared sector buffer
-    bool any_active = false;
-    for (int i = 0; i < MAX_BLOCK_DEVICES; i++) {
-        if (g_fat1x_by_dev[i]) {
-            any_active = true;
-            break;
-        }
-    }
-
-    if (!any_active && sector_buffer) {
-        KernelFree(sector_buffer);
-        sector_buffer = NULL;
-    }
-
     return 0;
 }
 
@@ -158,9 +202,45 @@ void Fat12ConvertFilename(const char* filename, char* fat_name) {
     }
 }
 
+static inline int Fat1xValidCluster(const Fat1xVolume* vol, uint32_t cluster) {
+    return cluster >= 2 && cluster < volume.total_clusters + 2;
+}
+
+static inline uint32_t Fat1xClusterLba(const Fat1xVolume* vol, uint32_t cluster) {
+    return volume.data_sector + (cluster - 2) * volume.boot.sectors_per_cluster;
+}
+
+// First cluster of a directory's chain; 0 names the root directory
+static inline uint32_t Fat1xDirCluster(const Fat1xVolume* vol, uint32_t cluster) {
+    return cluster ? cluster : volume.root_cluster;
+}
+
+// FAT12/16 keep the root directory in a fixed region instead of a chain
+static inline int Fat1xFixedRoot(const Fat1xVolume* vol, uint32_t cluster) {
+    return cluster == 0 && volume.fat_type != FAT1X_TYPE_32;
+}
+
+static uint32_t Fat1xEntryCluster(const Fat1xVolume* vol, const Fat1xDirEntry* entry) {
+    uint32_t cluster = entry->cluster_low;
+    if (volume.fat_type == FAT1X_TYPE_32) cluster |= (uint32_t)entry->cluster_high << 16;
+    return cluster;
+}
+
+static void Fat1xSetEntryCluster(const Fat1xVolume* vol, Fat1xDirEntry* entry, uint32_t cluster) {
+    entry->cluster_low = (uint16_t)cluster;
+    entry->cluster_high = volume.fat_type == FAT1X_TYPE_32 ? (uint16_t)(cluster >> 16) : 0;
+}
+
 // Get next cluster from FAT table
-static uint16_t Fat12GetNextCluster(uint16_t cluster) {
-    if (cluster >= 0xFF8) return FAT12_CLUSTER_EOF;
+static uint32_t Fat1xGetNextCluster(Fat1xVolume* vol, uint32_t cluster) {
+    if (!Fat1xValidCluster(vol, cluster)) return FAT1X_CLUSTER_EOC;
+
+    if (volume.fat_type == FAT1X_TYPE_32) {
+        return ((uint32_t*)volume.fat_table)[cluster] & 0x0FFFFFFF;
+    }
+    if (volume.fat_type == FAT1X_TYPE_16) {
+        return ((uint16_t*)volume.fat_table)[cluster];
+    }
 
     uint32_t fat_offset = cluster + (cluster / 2); // cluster * 1.5
     uint16_t fat_value = *(uint16_t*)&volume.fat_table[fat_offset];
@@ -174,8 +254,74 @@ static uint16_t Fat12GetNextCluster(uint16_t cluster) {
     return fat_value;
 }
 
-static void Fat12SetFatEntry(uint16_t cluster, uint16_t value) {
+#define FAT_SECTOR_SET(map, s) ((map)[(s) / 8] & (1u << ((s) & 7)))
+
+static void Fat1xMarkFatDirty(Fat1xVolume* vol, uint32_t fat_offset) {
+    const uint32_t sector = fat_offset / 512;
+    if (sector >= volume.fat_sectors) return;
+    const uint8_t bit = (uint8_t)(1u << (sector & 7));
+    if (volume.fat_dirty[sector / 8] & bit) return;
+    if (volume.fat_dirty_count++ == 0) volume.fat_dirty_since = GetTimeInMs();
+    volume.fat_dirty[sector / 8] |= bit;
+}
+
+// Byte offset of a cluster's entry in the FAT
+static uint32_t Fat1xEntryOffset(Fat1xVolume* vol, uint32_t cluster) {
+    if (volume.fat_type == FAT1X_TYPE_32) return cluster * 4;
+    if (volume.fat_type == FAT1X_TYPE_16) return cluster * 2;
+    return cluster + (cluster / 2);
+}
+
+// A cluster allocated again must not be discarded later; without a free
+// slot to split into, the tail of its extent just isn't discarded
+static void Fat1xDiscardCancel(Fat1xVolume* vol, uint32_t cluster) {
+    for (uint32_t i = 0; i < volume.discard_count; i++) {
+        Fat1xFreeRun* ext = &volume.discards[i];
+        const uint32_t end = ext->first + ext->count;
+        if (cluster < ext->first || cluster >= end) continue;
+        if (cluster == ext->first) {
+            ext->first++;
+            ext->count--;
+        } else {
+            ext->count = cluster - ext->first;
+            if (cluster + 1 < end && volume.discard_count < FAT1X_DISCARD_EXTENTS) {
+                volume.discards[volume.discard_count++] = (Fat1xFreeRun){cluster + 1, end - cluster - 1};
+            }
+        }
+        if (ext->count == 0) *ext = volume.discards[--volume.discard_count];
+        return;
+    }
+}
+
+static void Fat1xSetFatEntry(Fat1xVolume* vol, uint32_t cluster, uint32_t value) {
+    if (!Fat1xValidCluster(vol, cluster)) return;
+
+    const uint32_t old_value = Fat1xGetNextCluster(vol, cluster);
+    if (old_value == FAT1X_CLUSTER_FREE && value != FAT1X_CLUSTER_FREE) {
+        volume.free_count--;
+        volume.fsinfo_dirty = 1;
+        Fat1xDiscardCancel(vol, cluster);
+    } else if (old_value != FAT1X_CLUSTER_FREE && value == FAT1X_CLUSTER_FREE) {
+        volume.free_count++;
+        volume.fsinfo_dirty = 1;
+    }
+
+    if (volume.fat_type == FAT1X_TYPE_32) {
+        uint32_t* entry = &((uint32_t*)volume.fat_table)[cluster];
+        *entry = (*entry & 0xF0000000) | (value & 0x0FFFFFFF); // top bits are reserved
+        Fat1xMarkFatDirty(vol, cluster * 4);
+        return;
+    }
+    if (volume.fat_type == FAT1X_TYPE_16) {
+        ((uint16_t*)volume.fat_table)[cluster] = (uint16_t)value;
+        Fat1xMarkFatDirty(vol, cluster * 2);
+        return;
+    }
+
     uint32_t fat_offset = cluster + (cluster / 2);
+    // A 12-bit entry may straddle two FAT sectors
+    Fat1xMarkFatDirty(vol, fat_offset);
+    Fat1xMarkFatDirty(vol, fat_offset + 1);
     uint16_t* entry = (uint16_t*)&volume.fat_table[fat_offset];
 
     if (cluster & 1) { // Odd cluster
@@ -185,53 +331,228 @@ static void Fat12SetFatEntry(uint16_t cluster, uint16_t value) {
     }
 }
 
-// Writes the in-memory FAT cache back to all FAT copies on disk
-static int Fat12WriteFat() {
+// Queues freed clusters for discard. The FAT change freeing them may sit in
+// fat_table for a while, and discarding first could leave a chain on disk
+// pointing at zeroed blocks; a full queue forces the FAT write early.
+static void Fat1xDiscardClusters(Fat1xVolume* vol, uint32_t first, uint32_t count) {
+    if (volume.discard_count) {
+        Fat1xFreeRun* last = &volume.discards[volume.discard_count - 1];
+        if (last->first + last->count == first) {
+            last->count += count;
+            return;
+        }
+    }
+    if (volume.discard_count == FAT1X_DISCARD_EXTENTS) Fat1xFlushFat(vol);
+    if (volume.discard_count == FAT1X_DISCARD_EXTENTS) return; // Skipping a discard is always safe
+    volume.discards[volume.discard_count++] = (Fat1xFreeRun){first, count};
+}
+
+// Sends the queued discards whose clusters are now free on disk, i.e. none
+// of the FAT sectors mapping them is dirty again since the flush began
+static void Fat1xIssueDiscards(Fat1xVolume* vol) {
+    const uint32_t spc = volume.boot.sectors_per_cluster;
+    const uint32_t width = volume.fat_type == FAT1X_TYPE_32 ? 4 : 2;
+    uint32_t i = 0;
+    while (i < volume.discard_count) {
+        const Fat1xFreeRun ext = volume.discards[i];
+        uint32_t sector = Fat1xEntryOffset(vol, ext.first) / 512;
+        uint32_t last = (Fat1xEntryOffset(vol, ext.first + ext.count - 1) + width - 1) / 512;
+        if (last >= volume.fat_sectors) last = volume.fat_sectors - 1;
+        while (sector <= last && !FAT_SECTOR_SET(volume.fat_dirty, sector)) sector++;
+        if (sector <= last) {
+            i++;
+            continue;
+        }
+        volume.discards[i] = volume.discards[--volume.discard_count];
+        BlockCacheDiscard(volume.device->id, volume.data_sector + (uint64_t)(ext.first - 2) * spc,
+                          (uint64_t)ext.count * spc);
+    }
+}
+
+// Releases a cluster chain in the cached FAT and queues its data for
+// discard, one extent per run of consecutive clusters
+static void Fat1xFreeChain(Fat1xVolume* vol, uint32_t cluster) {
+    uint32_t run_start = 0;
+    uint32_t run_len = 0;
+    uint32_t guard = 0;
+    while (Fat1xValidCluster(vol, cluster) && guard++ < volume.total_clusters) {
+        uint32_t next_cluster = Fat1xGetNextCluster(vol, cluster);
+        Fat1xSetFatEntry(vol, cluster, FAT1X_CLUSTER_FREE);
+        if (run_len && cluster == run_start + run_len) {
+            run_len++;
+        } else {
+            if (run_len) Fat1xDiscardClusters(vol, run_start, run_len);
+            run_start = cluster;
+            run_len = 1;
+        }
+        cluster = next_cluster;
+    }
+    if (run_len) Fat1xDiscardClusters(vol, run_start, run_len);
+}
+
+// Free-cluster accounting: FAT32 keeps it in FSInfo, which is only a hint
+// and is recounted when missing or implausible; FAT12/16 always count.
+static void Fat1xLoadFreeInfo(Fat1xVolume* vol) {
+    volume.free_count = FAT32_FSINFO_UNKNOWN;
+    volume.next_free = 2;
+
+    if (volume.fsinfo_sector &&
+        BlockCacheRead(volume.device->id, volume.fsinfo_sector, 1, volume.sector_buffer) == 0 &&
+        *(uint32_t*)volume.sector_buffer == FAT32_FSINFO_LEAD_SIG &&
+        *(uint32_t*)(volume.sector_buffer + FAT32_FSINFO_STRUC_OFFSET) == FAT32_FSINFO_STRUC_SIG) {
+        volume.free_count = *(uint32_t*)(volume.sector_buffer + FAT32_FSINFO_FREE_OFFSET);
+        volume.next_free = *(uint32_t*)(volume.sector_buffer + FAT32_FSINFO_NEXT_OFFSET);
+        if (!Fat1xValidCluster(vol, volume.next_free)) volume.next_free = 2;
+    }
+
+    if (volume.free_count > volume.total_clusters) {
+        volume.free_count = 0;
+        for (uint32_t c = 2; c < volume.total_clusters + 2; c++) {
+            if (Fat1xGetNextCluster(vol, c) == FAT1X_CLUSTER_FREE) volume.free_count++;
+        }
+        volume.fsinfo_dirty = 1;
+    }
+}
+
+static int Fat1xWriteFsInfo(Fat1xVolume* vol) {
+    if (!volume.fsinfo_dirty || !volume.fsinfo_sector) return 0;
+    uint8_t sector[512];
+    if (BlockCacheRead(volume.device->id, volume.fsinfo_sector, 1, sector) != 0) return -1;
+    if (*(uint32_t*)sector != FAT32_FSINFO_LEAD_SIG ||
+        *(uint32_t*)(sector + FAT32_FSINFO_STRUC_OFFSET) != FAT32_FSINFO_STRUC_SIG) {
+        volume.fsinfo_dirty = 0; // Not a valid FSInfo; leave it alone
+        return 0;
+    }
+    *(uint32_t*)(sector + FAT32_FSINFO_FREE_OFFSET) = volume.free_count;
+    *(uint32_t*)(sector + FAT32_FSINFO_NEXT_OFFSET) = volume.next_free;
+    if (BlockCacheWrite(volume.device->id, volume.fsinfo_sector, 1, sector) != 0) return -1;
+    volume.fsinfo_dirty = 0;
+    return 0;
+}
+
+// Writes the dirty sectors of the in-memory FAT back to every FAT copy. Each
+// run of consecutive dirty sectors is one multi-sector write, and the copies
+// are written one after another so the whole pass moves forward on disk.
+// The dirty set is taken before the writes start, so sectors changed while
+// they are in flight (the idle loop flushes too) stay marked for next time.
+static int Fat1xFlushFat(Fat1xVolume* vol) {
+    if (volume.fat_dirty_count == 0) return Fat1xWriteFsInfo(vol);
+    const uint32_t spf = volume.sectors_per_fat;
+    const uint32_t map_bytes = (volume.fat_sectors + 7) / 8;
+    FastMemcpy(volume.fat_flushing, volume.fat_dirty, map_bytes);
+    FastMemset(volume.fat_dirty, 0, map_bytes);
+    volume.fat_dirty_count = 0;
+
     for (int i = 0; i < volume.boot.fat_count; i++) {
-        uint32_t fat_start = volume.boot.reserved_sectors + (i * volume.boot.sectors_per_fat);
-        for (int j = 0; j < volume.boot.sectors_per_fat; j++) {
-            if (BlockDeviceWrite(volume.device->id, fat_start + j, 1, volume.fat_table + (j * 512)) != 0) {
+        const uint32_t fat_start = volume.boot.reserved_sectors + (i * spf);
+        if (!volume.fat_mirror && fat_start != volume.fat_sector) continue;
+        uint32_t j = 0;
+        while (j < volume.fat_sectors) {
+            if (!FAT_SECTOR_SET(volume.fat_flushing, j)) {
+                j++;
+                continue;
+            }
+            uint32_t run = 1;
+            while (j + run < volume.fat_sectors && FAT_SECTOR_SET(volume.fat_flushing, j + run)) run++;
+            if (BlockCacheWrite(volume.device->id, fat_start + j, run, volume.fat_table + (j * 512)) != 0) {
+                // Mark the whole set dirty again; the next flush retries
+                for (uint32_t k = 0; k < volume.fat_sectors; k++) {
+                    if (FAT_SECTOR_SET(volume.fat_flushing, k)) Fat1xMarkFatDirty(vol, k * 512);
+                }
                 return -1;
             }
+            j += run;
         }
     }
-    return 0;
+    Fat1xIssueDiscards(vol);
+    return Fat1xWriteFsInfo(vol);
 }
 
-static uint16_t Fat12FindFreeCluster() {
-    uint32_t total_data_sectors = volume.boot.total_sectors_16 - volume.data_sector;
-    if (volume.boot.total_sectors_16 == 0) {
-        total_data_sectors = volume.boot.total_sectors_32 - volume.data_sector;
+// Called after each FAT-changing operation: writes back only once the
+// changes are old enough or numerous enough, otherwise leaves them batched
+static int Fat1xMaybeFlushFat(Fat1xVolume* vol) {
+    if (volume.fat_dirty_count == 0) return 0;
+    if (volume.fat_dirty_count < FAT1X_FAT_DIRTY_HIGH &&
+        GetTimeInMs() - volume.fat_dirty_since < FAT1X_FAT_WRITEBACK_MS) {
+        return 0;
     }
-    uint32_t total_clusters = total_data_sectors / volume.boot.sectors_per_cluster;
+    return Fat1xFlushFat(vol);
+}
 
-    // Start search from cluster 2
-    for (uint16_t i = 2; i < (uint16_t)(2 + total_clusters); i++) {
-        if (Fat12GetNextCluster(i) == FAT12_CLUSTER_FREE) {
+int Fat1xSync(void* fs_data) {
+    Fat1xVolume* vol = fs_data;
+    if (!vol || !vol->fat_dirty) return -1;
+    return Fat1xFlushFat(vol);
+}
+
+// Idle-time write-back: the age limit also holds when no further FAT
+// change comes along to trigger it
+int Fat1xWriteback(void* fs_data) {
+    Fat1xVolume* vol = fs_data;
+    if (!vol || !vol->fat_dirty) return -1;
+    return Fat1xMaybeFlushFat(vol);
+}
+
+// Next-fit allocation: the search resumes after the last cluster handed
+// out, so files written back to back get consecutive clusters
+static uint32_t Fat1xFindFreeCluster(Fat1xVolume* vol) {
+    if (volume.free_count == 0) return 0;
+    const uint32_t end = volume.total_clusters + 2;
+    uint32_t start = Fat1xValidCluster(vol, volume.next_free) ? volume.next_free : 2;
+
+    for (uint32_t n = 0, i = start; n < volume.total_clusters; n++) {
+        if (Fat1xGetNextCluster(vol, i) == FAT1X_CLUSTER_FREE) {
+            volume.next_free = i + 1 < end ? i + 1 : 2;
+            volume.fsinfo_dirty = 1;
             return i;
         }
+        if (++i == end) i = 2;
     }
     return 0; // Invalid cluster number indicates failure
 }
 
-int Fat1xGetCluster(uint16_t cluster, uint8_t* buffer) {
-    if (volume.boot.sectors_per_cluster == 0 || volume.boot.sectors_per_cluster > 8) return -1;
+int Fat1xGetCluster(Fat1xVolume* vol, uint32_t cluster, uint8_t* buffer) {
+    if (!Fat1xValidCluster(vol, cluster)) return -1;
 
-    uint32_t sector = volume.data_sector + ((cluster - 2) * volume.boot.sectors_per_cluster);
-
-    if (BlockDeviceRead(volume.device->id, sector, volume.boot.sectors_per_cluster, buffer) != 0) {
+    if (BlockCacheRead(volume.device->id, Fat1xClusterLba(vol, cluster), volume.boot.sectors_per_cluster, buffer) != 0) {
         return -1;
     }
 
     return 0;
 }
 
+// Writes `count` consecutive clusters from `data`, zero-filling past `bytes`
+// (or entirely when data is NULL). Whole clusters go out as one request.
+static int Fat1xWriteClusters(Fat1xVolume* vol, uint32_t first, uint32_t count, const uint8_t* data, uint32_t bytes) {
+    const uint32_t spc = volume.boot.sectors_per_cluster;
+    const uint32_t cluster_bytes = spc * 512;
+    uint32_t whole = data ? bytes / cluster_bytes : 0;
+    if (whole > count) whole = count;
+    if (whole && BlockCacheWrite(volume.device->id, Fat1xClusterLba(vol, first), whole * spc, data) != 0) {
+        return -1;
+    }
+    if (whole == count) return 0;
+
+    uint8_t* cluster_buffer = KernelMemoryAlloc(cluster_bytes);
+    if (!cluster_buffer) return -1;
+    int result = 0;
+    for (uint32_t i = whole; i < count && result == 0; i++) {
+        const uint32_t offset = i * cluster_bytes;
+        FastMemset(cluster_buffer, 0, cluster_bytes);
+        if (data && bytes > offset) {
+            FastMemcpy(cluster_buffer, data + offset, bytes - offset < cluster_bytes ? bytes - offset : cluster_bytes);
+        }
+        result = BlockCacheWrite(volume.device->id, Fat1xClusterLba(vol, first + i), spc, cluster_buffer);
+    }
+    KernelFree(cluster_buffer);
+    return result;
+}
 
-static Fat1xDirEntry* Fat12FindEntry(const char* path, uint16_t* parent_cluster, uint32_t* entry_sector, int* entry_offset) {
+static Fat1xDirEntry* Fat1xFindEntry(Fat1xVolume* vol, const char* path, uint32_t* parent_cluster, uint32_t* entry_sector, int* entry_offset) {
     if (!path || path[0] != '/') return NULL;
 
     // Start at root directory
-    uint16_t current_cluster = 0; // 0 = root directory
+    uint32_t current_cluster = 0; // 0 = root directory
 
     // Handle root directory case
     if (FastStrlen(path, 256) == 1) { // path == "/"
@@ -261,15 +582,34 @@ static Fat1xDirEntry* Fat12FindEntry(const char* path, uint16_t* parent_cluster,
         uint32_t found_sector = 0;
         int found_offset = -1;
 
-        if (current_cluster == 0) {
+        // Dentry cache values are the entry location, (sector << 4) | slot.
+        // The slot is re-read and its name checked, so an entry deleted or
+        // reused behind the cache's back just falls through to the scan.
+        uint64_t cached;
+        if (DCacheLookup(vol, current_cluster, fat_name, 11, &cached)) {
+            if (cached == 0) return NULL; // Known not to exist
+            found_sector = (uint32_t)(cached >> 4);
+            found_offset = (int)(cached & 0xF);
+            if (BlockCacheRead(volume.device->id, found_sector, 1, volume.sector_buffer) != 0) {
+                return NULL;
+            }
+            found = &((Fat1xDirEntry*)volume.sector_buffer)[found_offset];
+            if (FastMemcmp(found->name, fat_name, 11) != 0) {
+                DCacheInvalidate(vol, current_cluster, fat_name, 11);
+                found = NULL;
+            }
+        }
+
+        const int cache_hit = found != NULL;
+        if (!cache_hit && Fat1xFixedRoot(vol, current_cluster)) {
             // Search root directory
             uint32_t root_sectors = (volume.boot.root_entries * 32 + 511) / 512;
             for (uint32_t sector = 0; sector < root_sectors; sector++) {
-                if (BlockDeviceRead(volume.device->id, volume.root_sector + sector, 1, sector_buffer) != 0) {
+                if (BlockCacheRead(volume.device->id, volume.root_sector + sector, 1, volume.sector_buffer) != 0) {
                     return NULL;
                 }
 
-                Fat1xDirEntry* entries = (Fat1xDirEntry*)sector_buffer;
+                Fat1xDirEntry* entries = (Fat1xDirEntry*)volume.sector_buffer;
                 for (int i = 0; i < 16; i++) {
                     if ((uint8_t)entries[i].name[0] == 0x00) break;
                     if ((uint8_t)entries[i].name[0] == 0xE5) continue;
@@ -284,15 +624,15 @@ static Fat1xDirEntry* Fat12FindEntry(const char* path, uint16_t* parent_cluster,
                 }
                 if (found) break;
             }
-        } else {
+        } else if (!cache_hit) {
             // Search cluster-based directory
-            uint16_t cluster = current_cluster;
+            uint32_t cluster = Fat1xDirCluster(vol, current_cluster);
             uint32_t cluster_bytes = volume.boot.sectors_per_cluster * 512;
             uint8_t* cluster_buffer = KernelMemoryAlloc(cluster_bytes);
             if (!cluster_buffer) return NULL; // Critical: Check allocation
 
-            while (cluster < 0xFF8 && !found) {
-                if (Fat1xGetCluster(cluster, cluster_buffer) != 0) {
+            while (Fat1xValidCluster(vol, cluster) && !found) {
+                if (Fat1xGetCluster(vol, cluster, cluster_buffer) != 0) {
                     KernelFree(cluster_buffer);
                     return NULL;
                 }
@@ -314,52 +654,61 @@ static Fat1xDirEntry* Fat12FindEntry(const char* path, uint16_t* parent_cluster,
                     }
                 }
                 if (!found) {
-                    cluster = Fat12GetNextCluster(cluster);
+                    cluster = Fat1xGetNextCluster(vol, cluster);
                 }
             }
             KernelFree(cluster_buffer);
         }
 
-        if (!found) return NULL;
+        if (!cache_hit) {
+            if (!found) {
+                DCacheInsert(vol, current_cluster, fat_name, 11, 0);
+                return NULL;
+            }
+            DCacheInsert(vol, current_cluster, fat_name, 11, ((uint64_t)found_sector << 4) | (uint32_t)found_offset);
+
+            // Re-read the sector so `found` points at valid data: a match in a
+            // subdirectory lives in a cluster buffer that has been freed already
+            if (BlockCacheRead(volume.device->id, found_sector, 1, volume.sector_buffer) != 0) {
+                return NULL;
+            }
+            found = &((Fat1xDirEntry*)volume.sector_buffer)[found_offset];
+        }
 
         // If this is the last component, return it
         if (!*p) {
             *parent_cluster = current_cluster;
             *entry_sector = found_sector;
             *entry_offset = found_offset;
-
-            // CRITICAL: Re-read the sector to return a valid pointer
-            // This ensures sector_buffer contains the correct data
-            if (BlockDeviceRead(volume.device->id, found_sector, 1, sector_buffer) != 0) {
-                return NULL;
-            }
-            return &((Fat1xDirEntry*)sector_buffer)[found_offset];
+            return found;
         }
 
         // Must be a directory to continue
         if (!(found->attr & FAT12_ATTR_DIRECTORY)) return NULL;
 
-        current_cluster = found->cluster_low;
+        current_cluster = Fat1xEntryCluster(vol, found);
     }
 
     return NULL;
 }
 
-static int Fat12FindDirectoryEntry(uint16_t parent_cluster, const char* fat_name, uint32_t* out_sector, int* out_offset) {
+static int Fat1xFindDirectoryEntry(Fat1xVolume* vol, uint32_t parent_cluster, const char* fat_name, uint32_t* out_sector, int* out_offset) {
     *out_sector = 0;
     *out_offset = -1;
+    // The name is about to be created; drop any negative dentry for it
+    DCacheInvalidate(vol, parent_cluster, fat_name, 11);
 
     // First check if file already exists (name collision)
-    if (parent_cluster == 0) {
+    if (Fat1xFixedRoot(vol, parent_cluster)) {
         // Search root directory for existing file
         uint32_t root_sectors = (volume.boot.root_entries * 32 + 511) / 512;
         for (uint32_t sector_idx = 0; sector_idx < root_sectors; sector_idx++) {
             uint32_t current_lba = volume.root_sector + sector_idx;
-            if (BlockDeviceRead(volume.device->id, current_lba, 1, sector_buffer) != 0) {
+            if (BlockCacheRead(volume.device->id, current_lba, 1, volume.sector_buffer) != 0) {
                 return -1;
             }
 
-            Fat1xDirEntry* entries = (Fat1xDirEntry*)sector_buffer;
+            Fat1xDirEntry* entries = (Fat1xDirEntry*)volume.sector_buffer;
             for (int i = 0; i < 16; i++) {
                 uint8_t first_char = entries[i].name[0];
                 if (first_char == 0x00) {
@@ -390,14 +739,14 @@ static int Fat12FindDirectoryEntry(uint16_t parent_cluster, const char* fat_name
     }
 
     // Search subdirectory
-    uint16_t current_cluster = parent_cluster;
-    uint16_t last_cluster = 0;
+    uint32_t current_cluster = Fat1xDirCluster(vol, parent_cluster);
+    uint32_t last_cluster = 0;
     uint32_t cluster_bytes = volume.boot.sectors_per_cluster * 512;
     uint8_t* cluster_buffer = KernelMemoryAlloc(cluster_bytes);
     if (!cluster_buffer) return -1;
 
-    while (current_cluster < 0xFF8) {
-        if (Fat1xGetCluster(current_cluster, cluster_buffer) != 0) {
+    while (Fat1xValidCluster(vol, current_cluster)) {
+        if (Fat1xGetCluster(vol, current_cluster, cluster_buffer) != 0) {
             KernelFree(cluster_buffer);
             return -1;
         }
@@ -436,7 +785,7 @@ static int Fat12FindDirectoryEntry(uint16_t parent_cluster, const char* fat_name
         }
 
         last_cluster = current_cluster;
-        current_cluster = Fat12GetNextCluster(current_cluster);
+        current_cluster = Fat1xGetNextCluster(vol, current_cluster);
     }
 
     // If we found a free slot, use it
@@ -446,20 +795,20 @@ static int Fat12FindDirectoryEntry(uint16_t parent_cluster, const char* fat_name
     }
 
     // Directory is full - need to allocate new cluster
-    uint16_t new_cluster = Fat12FindFreeCluster();
+    uint32_t new_cluster = Fat1xFindFreeCluster(vol);
     if (new_cluster == 0) {
         KernelFree(cluster_buffer);
         return -1; // No free clusters
     }
 
     // Link the new cluster
-    Fat12SetFatEntry(last_cluster, new_cluster);
-    Fat12SetFatEntry(new_cluster, FAT12_CLUSTER_EOF);
+    Fat1xSetFatEntry(vol, last_cluster, new_cluster);
+    Fat1xSetFatEntry(vol, new_cluster, FAT1X_CLUSTER_EOC);
 
     // Clear the new cluster
     FastMemset(cluster_buffer, 0, cluster_bytes);
     uint32_t new_cluster_lba = volume.data_sector + ((new_cluster - 2) * volume.boot.sectors_per_cluster);
-    if (BlockDeviceWrite(volume.device->id, new_cluster_lba, volume.boot.sectors_per_cluster, cluster_buffer) != 0) {
+    if (BlockCacheWrite(volume.device->id, new_cluster_lba, volume.boot.sectors_per_cluster, cluster_buffer) != 0) {
         KernelFree(cluster_buffer);
         return -1;
     }
@@ -473,42 +822,58 @@ static int Fat12FindDirectoryEntry(uint16_t parent_cluster, const char* fat_name
 }
 
 // NEW: Check if a path is a directory
-int Fat1xIsDirectory(const char* path) {
+int Fat1xIsDirectory(void* fs_data, const char* path) {
+    Fat1xVolume* vol = fs_data;
     if (!path) return 0;
 
     // Root is always a directory
     if (FastStrCmp(path, "/") == 0) return 1;
 
-    uint16_t parent_cluster;
+    uint32_t parent_cluster;
     uint32_t entry_sector;
     int entry_offset;
 
-    Fat1xDirEntry* entry = Fat12FindEntry(path, &parent_cluster, &entry_sector, &entry_offset);
+    Fat1xDirEntry* entry = Fat1xFindEntry(vol, path, &parent_cluster, &entry_sector, &entry_offset);
     if (!entry) return 0;
 
     return (entry->attr & FAT12_ATTR_DIRECTORY) ? 1 : 0;
 }
 
-int Fat1xListDirectory(const char* path) {
-    if (!path) return -1;
-
-    // If the path is the root, call the dedicated root listing function
-    if (FastStrCmp(path, "/") == 0) {
-        return Fat1xListRoot();
-    }
+int Fat1xIsFile(void* fs_data, const char* path) {
+    Fat1xVolume* vol = fs_data;
+    if (!path) return 0;
 
-    // If we are here, we are listing a subdirectory, not the root.
-    uint16_t parent_cluster;
+    uint32_t parent_cluster;
     uint32_t entry_sector;
     int entry_offset;
 
-    Fat1xDirEntry* entry = Fat12FindEntry(path, &parent_cluster, &entry_sector, &entry_offset);
-    if (!entry || !(entry->attr & FAT12_ATTR_DIRECTORY)) {
-        // Path is not a valid directory
-        return -1;
-    }
+    Fat1xDirEntry* entry = Fat1xFindEntry(vol, path, &parent_cluster, &entry_sector, &entry_offset);
+    if (!entry) return 0;
 
-    uint16_t cluster = entry->cluster_low;
+    return (entry->attr & (FAT12_ATTR_DIRECTORY | FAT12_ATTR_VOLUME_ID)) ? 0 : 1;
+}
+
+int Fat1xListDirectory(void* fs_data, const char* path) {
+    Fat1xVolume* vol = fs_data;
+    if (!path) return -1;
+
+    uint32_t cluster;
+    if (FastStrCmp(path, "/") == 0) {
+        // The FAT12/16 root has its own listing function; the FAT32 one is a chain
+        if (volume.fat_type != FAT1X_TYPE_32) return Fat1xListRoot(vol);
+        cluster = volume.root_cluster;
+    } else {
+        uint32_t parent_cluster;
+        uint32_t entry_sector;
+        int entry_offset;
+
+        Fat1xDirEntry* entry = Fat1xFindEntry(vol, path, &parent_cluster, &entry_sector, &entry_offset);
+        if (!entry || !(entry->attr & FAT12_ATTR_DIRECTORY)) {
+            // Path is not a valid directory
+            return -1;
+        }
+        cluster = Fat1xEntryCluster(vol, entry);
+    }
 
     // --- The rest of the function remains the same ---
     // (The part that allocates cluster_buffer and loops through cluster chains)
@@ -516,9 +881,9 @@ int Fat1xListDirectory(const char* path) {
     uint8_t* cluster_buffer = KernelMemoryAlloc(cluster_bytes);
     if (!cluster_buffer) return -1;
 
-    uint16_t current_cluster = cluster;
-    while (current_cluster < 0xFF8) {
-        if (Fat1xGetCluster(current_cluster, cluster_buffer) != 0) {
+    uint32_t current_cluster = cluster;
+    while (Fat1xValidCluster(vol, current_cluster)) {
+        if (Fat1xGetCluster(vol, current_cluster, cluster_buffer) != 0) {
             KernelFree(cluster_buffer);
             return -1;
         }
@@ -555,14 +920,15 @@ int Fat1xListDirectory(const char* path) {
             PrintKernel("\n");
         }
 
-        current_cluster = Fat12GetNextCluster(current_cluster);
+        current_cluster = Fat1xGetNextCluster(vol, current_cluster);
     }
 
     KernelFree(cluster_buffer);
     return 0;
 }
 
-int Fat1xCreateDir(const char* path) {
+int Fat1xCreateDir(void* fs_data, const char* path) {
+    Fat1xVolume* vol = fs_data;
     if (!path || path[0] != '/') return -1;
 
     char parent_path[256];
@@ -591,32 +957,32 @@ int Fat1xCreateDir(const char* path) {
     Fat12ConvertFilename(dir_name, fat_name);
 
     // Find parent directory to get its starting cluster
-    uint16_t parent_cluster = 0; // Default to root
+    uint32_t parent_cluster = 0; // Default to root
     if (FastStrCmp(parent_path, "/") != 0) {
-        uint16_t temp_parent_cluster;
+        uint32_t temp_parent_cluster;
         uint32_t temp_entry_sector;
         int temp_entry_offset;
-        Fat1xDirEntry* parent_entry = Fat12FindEntry(parent_path, &temp_parent_cluster, &temp_entry_sector, &temp_entry_offset);
+        Fat1xDirEntry* parent_entry = Fat1xFindEntry(vol, parent_path, &temp_parent_cluster, &temp_entry_sector, &temp_entry_offset);
         if (!parent_entry || !(parent_entry->attr & FAT12_ATTR_DIRECTORY)) {
             return -1; // Parent not found or is not a directory
         }
-        parent_cluster = parent_entry->cluster_low;
+        parent_cluster = Fat1xEntryCluster(vol, parent_entry);
     }
 
     // ---- THIS IS THE REPLACEMENT LOGIC ----
     // Use our new helper to find a free spot in the parent (root or subdir)
     uint32_t entry_sector_lba;
     int entry_offset;
-    if (Fat12FindDirectoryEntry(parent_cluster, fat_name, &entry_sector_lba, &entry_offset) != 0) {
+    if (Fat1xFindDirectoryEntry(vol, parent_cluster, fat_name, &entry_sector_lba, &entry_offset) != 0) {
         return -1; // Parent directory is full or name already exists
     }
     // ---- END REPLACEMENT LOGIC ----
 
     // Allocate a cluster for the new directory's data
-    uint16_t new_cluster = Fat12FindFreeCluster();
+    uint32_t new_cluster = Fat1xFindFreeCluster(vol);
     if (new_cluster == 0) return -1;
 
-    Fat12SetFatEntry(new_cluster, FAT12_CLUSTER_EOF);
+    Fat1xSetFatEntry(vol, new_cluster, FAT1X_CLUSTER_EOC);
 
     // Create '.' and '..' entries and write to the new cluster
     uint32_t cluster_size_bytes = volume.boot.sectors_per_cluster * 512;
@@ -628,90 +994,63 @@ int Fat1xCreateDir(const char* path) {
     Fat1xDirEntry* dot_entry = (Fat1xDirEntry*)cluster_buffer;
     FastMemcpy(dot_entry->name, ".          ", 11);
     dot_entry->attr = FAT12_ATTR_DIRECTORY;
-    dot_entry->cluster_low = new_cluster;
+    Fat1xSetEntryCluster(vol, dot_entry, new_cluster);
     dot_entry->file_size = 0;
 
     // Create the '..' entry (points to parent)
     Fat1xDirEntry* dotdot_entry = dot_entry + 1;
     FastMemcpy(dotdot_entry->name, "..         ", 11);
     dotdot_entry->attr = FAT12_ATTR_DIRECTORY;
-    dotdot_entry->cluster_low = parent_cluster; // <-- This now correctly points to the real parent cluster
+    Fat1xSetEntryCluster(vol, dotdot_entry, parent_cluster); // 0 when the parent is the root
     dotdot_entry->file_size = 0;
 
     // --- (The rest of the function remains the same) ---
     // Write the new directory's data cluster to disk
     uint32_t data_lba = volume.data_sector + ((new_cluster - 2) * volume.boot.sectors_per_cluster);
-    if (BlockDeviceWrite(volume.device->id, data_lba, volume.boot.sectors_per_cluster, cluster_buffer) != 0) {
+    if (BlockCacheWrite(volume.device->id, data_lba, volume.boot.sectors_per_cluster, cluster_buffer) != 0) {
         KernelFree(cluster_buffer);
         return -1;
     }
     // KernelFree(cluster_buffer); - double free?
 
     // Update the entry in the parent directory
-    if (BlockDeviceRead(volume.device->id, entry_sector_lba, 1, sector_buffer) != 0) return -1;
+    if (BlockCacheRead(volume.device->id, entry_sector_lba, 1, volume.sector_buffer) != 0) return -1;
 
-    Fat1xDirEntry* new_dir_entry = &((Fat1xDirEntry*)sector_buffer)[entry_offset];
+    Fat1xDirEntry* new_dir_entry = &((Fat1xDirEntry*)volume.sector_buffer)[entry_offset];
     FastMemcpy(new_dir_entry->name, fat_name, 11);
     new_dir_entry->attr = FAT12_ATTR_DIRECTORY;
-    new_dir_entry->cluster_low = new_cluster;
+    Fat1xSetEntryCluster(vol, new_dir_entry, new_cluster);
     new_dir_entry->file_size = 0;
 
     // Write changes back to disk
-    if (BlockDeviceWrite(volume.device->id, entry_sector_lba, 1, sector_buffer) != 0) return -1;
-    if (Fat12WriteFat() != 0) return -1;
+    if (BlockCacheWrite(volume.device->id, entry_sector_lba, 1, volume.sector_buffer) != 0) return -1;
+    if (Fat1xMaybeFlushFat(vol) != 0) return -1;
 
     return 0;
 }
 
 // NEW: Enhanced file operations with path support
-int Fat1xReadFile(const char* path, void* buffer, uint32_t max_size) {
+int64_t Fat1xReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size) {
     if (!path) return -1;
 
-    uint16_t parent_cluster;
-    uint32_t entry_sector;
-    int entry_offset;
-
-    Fat1xDirEntry* entry = Fat12FindEntry(path, &parent_cluster, &entry_sector, &entry_offset);
-    if (!entry || (entry->attr & FAT12_ATTR_DIRECTORY)) return -1;
-
-    uint16_t cluster = entry->cluster_low;
-    uint32_t bytes_read = 0;
-    uint32_t file_size = entry->file_size;
-
-    if (file_size == 0) return 0;
-
-    uint32_t cluster_bytes = volume.boot.sectors_per_cluster * 512;
-    if (cluster_bytes == 0) return -1;
-
-    while (cluster < 0xFF8 && bytes_read < max_size) {
-        uint8_t* cluster_buffer = KernelMemoryAlloc(cluster_bytes);
-        if (!cluster_buffer) return -1;
-
-        if (Fat1xGetCluster(cluster, cluster_buffer) != 0) {
-            KernelFree(cluster_buffer);
-            return -1;
-        }
-
-        uint32_t remaining_in_file = file_size - bytes_read;
-        uint32_t copy_size = (cluster_bytes < remaining_in_file) ? cluster_bytes : remaining_in_file;
-        if (bytes_read + copy_size > max_size) copy_size = max_size - bytes_read;
-
-        FastMemcpy((uint8_t*)buffer + bytes_read, cluster_buffer, copy_size);
-        bytes_read += copy_size;
-
-        KernelFree(cluster_buffer);
-        cluster = Fat12GetNextCluster(cluster);
-    }
+    // Whole-file reads go through an open-file object for its extent map
+    void* file = Fat1xOpen(fs_data, path, 0);
+    if (!file) return -1;
+    const int64_t bytes_read = max_size ? Fat1xReadAt(file, 0, buffer, max_size) : 0;
+    Fat1xClose(file);
     return bytes_read;
 }
 
-int Fat1xCreateFile(const char* filename) {
+int Fat1xCreateFile(void* fs_data, const char* filename) {
+    Fat1xVolume* vol = fs_data;
     if (!filename) return -1;
-    return Fat1xWriteFile(filename, "", 0);
+    return Fat1xWriteFile(vol, filename, "", 0);
 }
 
-int Fat1xWriteFile(const char* path, const void* buffer, uint32_t size) {
+int64_t Fat1xWriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size) {
+    Fat1xVolume* vol = fs_data;
     if (!path) return -1;
+    if (size > 0xFFFFFFFFull) return -1; // FAT file sizes are 32-bit
 
     // Parse path to get parent and filename
     char parent_path[256];
@@ -742,27 +1081,27 @@ int Fat1xWriteFile(const char* path, const void* buffer, uint32_t size) {
     Fat12ConvertFilename(filename, fat_name);
 
     // Find parent directory cluster
-    uint16_t parent_cluster = 0; // Root by default
+    uint32_t parent_cluster = 0; // Root by default
     if (FastStrCmp(parent_path, "/") != 0) {
-        uint16_t temp_parent;
+        uint32_t temp_parent;
         uint32_t temp_entry_sector;
         int temp_entry_offset;
-        Fat1xDirEntry* parent_entry = Fat12FindEntry(parent_path, &temp_parent, &temp_entry_sector, &temp_entry_offset);
+        Fat1xDirEntry* parent_entry = Fat1xFindEntry(vol, parent_path, &temp_parent, &temp_entry_sector, &temp_entry_offset);
         if (!parent_entry || !(parent_entry->attr & FAT12_ATTR_DIRECTORY)) {
             return -1; // Parent doesn't exist or isn't a directory
         }
-        parent_cluster = parent_entry->cluster_low;
+        parent_cluster = Fat1xEntryCluster(vol, parent_entry);
     }
 
     // Check if file already exists
-    uint16_t existing_parent;
+    uint32_t existing_parent;
     uint32_t existing_sector;
     int existing_offset;
-    Fat1xDirEntry* existing_entry = Fat12FindEntry(path, &existing_parent, &existing_sector, &existing_offset);
+    Fat1xDirEntry* existing_entry = Fat1xFindEntry(vol, path, &existing_parent, &existing_sector, &existing_offset);
 
     uint32_t entry_sector;
     int entry_offset;
-    uint16_t old_cluster = 0;
+    uint32_t old_cluster = 0;
 
     if (existing_entry) {
         // File exists - overwrite it
@@ -771,12 +1110,12 @@ int Fat1xWriteFile(const char* path, const void* buffer, uint32_t size) {
         }
         entry_sector = existing_sector;
         entry_offset = existing_offset;
-        old_cluster = existing_entry->cluster_low;
+        old_cluster = Fat1xEntryCluster(vol, existing_entry);
     } else {
         // File doesn't exist - find free directory entry
-        int result = Fat12FindDirectoryEntry(parent_cluster, fat_name, &entry_sector, &entry_offset);
+        int result = Fat1xFindDirectoryEntry(vol, parent_cluster, fat_name, &entry_sector, &entry_offset);
         if (result == -2) {
-            return -1; // This shouldn't happen since Fat12FindEntry didn't find it
+            return -1; // This shouldn't happen since Fat1xFindEntry didn't find it
         }
         if (result != 0) {
             return -1; // Error finding free entry
@@ -784,94 +1123,83 @@ int Fat1xWriteFile(const char* path, const void* buffer, uint32_t size) {
     }
 
     // Clear old cluster chain if overwriting
-    if (old_cluster >= 2 && old_cluster < 0xFF8) {
-        uint16_t cluster = old_cluster;
-        while (cluster >= 2 && cluster < 0xFF8) {
-            uint16_t next_cluster = Fat12GetNextCluster(cluster);
-            Fat12SetFatEntry(cluster, FAT12_CLUSTER_FREE);
-            cluster = next_cluster;
-        }
-    }
+    Fat1xFreeChain(vol, old_cluster);
+    if (existing_entry) Fat1xOpenDrop(vol, entry_sector, entry_offset, 0);
 
-    // Allocate clusters for new file data
-    uint16_t start_cluster = 0;
+    // Allocate clusters for new file data; each run of consecutive clusters
+    // is written with one request straight from the caller's buffer
+    uint32_t start_cluster = 0;
     if (size > 0) {
-        uint32_t cluster_bytes = volume.boot.sectors_per_cluster * 512;
-        uint32_t clusters_needed = (size + cluster_bytes - 1) / cluster_bytes;
-
-        uint16_t current_cluster = Fat12FindFreeCluster();
-        if (current_cluster == 0) return -1; // No free clusters
-
-        start_cluster = current_cluster;
-        uint32_t bytes_written = 0;
+        const uint32_t cluster_bytes = volume.boot.sectors_per_cluster * 512;
+        const uint32_t clusters_needed = (size + cluster_bytes - 1) / cluster_bytes;
         const uint8_t* buf_ptr = (const uint8_t*)buffer;
-
-        for (uint32_t cluster_idx = 0; cluster_idx < clusters_needed; cluster_idx++) {
-            // Prepare cluster data
-            uint8_t* cluster_buf = KernelMemoryAlloc(cluster_bytes);
-            if (!cluster_buf) return -1;
-
-            FastMemset(cluster_buf, 0, cluster_bytes);
-            uint32_t to_write = (size - bytes_written > cluster_bytes) ? cluster_bytes : size - bytes_written;
-            if (buffer && to_write > 0) {
-                FastMemcpy(cluster_buf, buf_ptr + bytes_written, to_write);
+        uint32_t prev_cluster = 0;
+        uint32_t run_start = 0;
+        uint32_t run_len = 0;
+        uint32_t run_offset = 0;
+
+        for (uint32_t cluster_idx = 0; cluster_idx <= clusters_needed; cluster_idx++) {
+            uint32_t cluster = 0;
+            if (cluster_idx < clusters_needed) {
+                cluster = Fat1xFindFreeCluster(vol);
+                if (cluster == 0) {
+                    Fat1xFreeChain(vol, start_cluster);
+                    return -1; // No free clusters
+                }
+                Fat1xSetFatEntry(vol, cluster, FAT1X_CLUSTER_EOC);
+                if (prev_cluster) Fat1xSetFatEntry(vol, prev_cluster, cluster);
+                else start_cluster = cluster;
+                prev_cluster = cluster;
+                if (run_len && cluster == run_start + run_len) {
+                    run_len++;
+                    continue;
+                }
             }
-
-            // Write cluster to disk
-            uint32_t cluster_lba = volume.data_sector + ((current_cluster - 2) * volume.boot.sectors_per_cluster);
-            if (BlockDeviceWrite(volume.device->id, cluster_lba, volume.boot.sectors_per_cluster, cluster_buf) != 0) {
-                KernelFree(cluster_buf);
+            if (run_len && Fat1xWriteClusters(vol, run_start, run_len, buf_ptr ? buf_ptr + run_offset : NULL,
+                                              size - run_offset) != 0) {
+                Fat1xFreeChain(vol, start_cluster);
                 return -1;
             }
-            KernelFree(cluster_buf);
-            bytes_written += to_write;
-
-            // Link to next cluster or mark as EOF
-            if (cluster_idx < clusters_needed - 1) {
-                uint16_t next_cluster = Fat12FindFreeCluster();
-                if (next_cluster == 0) return -1;
-                Fat12SetFatEntry(current_cluster, next_cluster);
-                current_cluster = next_cluster;
-            } else {
-                Fat12SetFatEntry(current_cluster, FAT12_CLUSTER_EOF);
-            }
+            run_offset += run_len * cluster_bytes;
+            run_start = cluster;
+            run_len = 1;
         }
     }
 
     // Update directory entry
-    if (BlockDeviceRead(volume.device->id, entry_sector, 1, sector_buffer) != 0) {
+    if (BlockCacheRead(volume.device->id, entry_sector, 1, volume.sector_buffer) != 0) {
         return -1;
     }
 
-    Fat1xDirEntry* dir_entry = &((Fat1xDirEntry*)sector_buffer)[entry_offset];
+    Fat1xDirEntry* dir_entry = &((Fat1xDirEntry*)volume.sector_buffer)[entry_offset];
     FastMemcpy(dir_entry->name, fat_name, 11);
     dir_entry->attr = FAT12_ATTR_ARCHIVE;
-    dir_entry->file_size = size;
-    dir_entry->cluster_low = start_cluster;
-    dir_entry->cluster_high = 0;
+    dir_entry->file_size = (uint32_t)size;
+    Fat1xSetEntryCluster(vol, dir_entry, start_cluster);
 
     // Write directory entry back
-    if (BlockDeviceWrite(volume.device->id, entry_sector, 1, sector_buffer) != 0) {
+    if (BlockCacheWrite(volume.device->id, entry_sector, 1, volume.sector_buffer) != 0) {
         return -1;
     }
+    if (existing_entry) Fat1xOpenReload(vol, entry_sector, entry_offset);
 
-    // Write FAT table
-    if (Fat12WriteFat() != 0) {
+    // FAT changes are written back in batches
+    if (Fat1xMaybeFlushFat(vol) != 0) {
         return -1;
     }
 
     return size;
 }
 
-int Fat1xDeleteRecursive(const char* path) {
+int Fat1xDeleteRecursive(Fat1xVolume* vol, const char* path) {
     if (!path) return -1;
 
     // Check if the path exists
-    uint16_t parent_cluster;
+    uint32_t parent_cluster;
     uint32_t entry_sector;
     int entry_offset;
 
-    Fat1xDirEntry* entry = Fat12FindEntry(path, &parent_cluster, &entry_sector, &entry_offset);
+    Fat1xDirEntry* entry = Fat1xFindEntry(vol, path, &parent_cluster, &entry_sector, &entry_offset);
     if (!entry) {
         PrintKernel("Error: Path not found: ");
         PrintKernel(path);
@@ -884,7 +1212,7 @@ int Fat1xDeleteRecursive(const char* path) {
         PrintKernel("Deleting file: ");
         PrintKernel(path);
         PrintKernel("\n");
-        return Fat1xDeleteFile(path);
+        return Fat1xDeleteFile(vol, path);
     }
 
     // It's a directory - we need to recursively delete its contents
@@ -892,7 +1220,7 @@ int Fat1xDeleteRecursive(const char* path) {
     PrintKernel(path);
     PrintKernel("\n");
 
-    uint16_t dir_cluster = entry->cluster_low;
+    uint32_t dir_cluster = Fat1xEntryCluster(vol, entry);
 
     // Handle root directory (cannot be deleted)
     if (dir_cluster == 0 || FastStrCmp(path, "/") == 0) {
@@ -908,12 +1236,12 @@ int Fat1xDeleteRecursive(const char* path) {
         return -1;
     }
 
-    uint16_t visited_clusters[256];
+    uint32_t visited_clusters[256];
     int visited_count = 0;
 
     // Walk through all clusters of this directory
-    uint16_t current_cluster = dir_cluster;
-    while (current_cluster >= 2 && current_cluster < 0xFF8) {
+    uint32_t current_cluster = dir_cluster;
+    while (Fat1xValidCluster(vol, current_cluster)) {
         // Check for cycle
         for (int v = 0; v < visited_count; v++) {
             if (visited_clusters[v] == current_cluster) {
@@ -925,7 +1253,7 @@ int Fat1xDeleteRecursive(const char* path) {
         if (visited_count < 256) {
             visited_clusters[visited_count++] = current_cluster;
         }
-        if (Fat1xGetCluster(current_cluster, cluster_buffer) != 0) {
+        if (Fat1xGetCluster(vol, current_cluster, cluster_buffer) != 0) {
             KernelFree(cluster_buffer);
             PrintKernel("Error: Failed to read directory cluster\n");
             return -1;
@@ -988,7 +1316,7 @@ int Fat1xDeleteRecursive(const char* path) {
             }
 
             // Recursively delete this entry
-            if (Fat1xDeleteRecursive(child_path) != 0) {
+            if (Fat1xDeleteRecursive(vol, child_path) != 0) {
                 KernelFree(cluster_buffer);
                 PrintKernel("Error: Failed to delete child: ");
                 PrintKernel(child_path);
@@ -996,35 +1324,35 @@ int Fat1xDeleteRecursive(const char* path) {
                 return -1;
             }
         }
-        current_cluster = Fat12GetNextCluster(current_cluster);
+        current_cluster = Fat1xGetNextCluster(vol, current_cluster);
     }
 
     KernelFree(cluster_buffer);
     PrintKernel(".");
-    return Fat1xDeleteFile(path);
+    return Fat1xDeleteFile(vol, path);
 }
 
 // Enhanced file/directory deletion with path support
-int Fat1xDeleteFile(const char* path) {
+int Fat1xDeleteFile(Fat1xVolume* vol, const char* path) {
     if (!path) return -1;
 
-    uint16_t parent_cluster;
+    uint32_t parent_cluster;
     uint32_t entry_sector;
     int entry_offset;
 
-    Fat1xDirEntry* entry = Fat12FindEntry(path, &parent_cluster, &entry_sector, &entry_offset);
+    Fat1xDirEntry* entry = Fat1xFindEntry(vol, path, &parent_cluster, &entry_sector, &entry_offset);
     if (!entry) return -1;
 
     // If it's a directory, check if it's empty (only . and .. entries)
     if (entry->attr & FAT12_ATTR_DIRECTORY) {
-        uint16_t dir_cluster = entry->cluster_low;
+        uint32_t dir_cluster = Fat1xEntryCluster(vol, entry);
         if (dir_cluster >= 2) {
             uint32_t cluster_bytes = volume.boot.sectors_per_cluster * 512;
             uint8_t* cluster_buffer = KernelMemoryAlloc(cluster_bytes);
             if (!cluster_buffer) return -1;
 
             // Check if directory is empty (only . and .. entries)
-            if (Fat1xGetCluster(dir_cluster, cluster_buffer) != 0) {
+            if (Fat1xGetCluster(vol, dir_cluster, cluster_buffer) != 0) {
                 KernelFree(cluster_buffer);
                 return -1;
             }
@@ -1053,57 +1381,62 @@ int Fat1xDeleteFile(const char* path) {
         }
     }
 
+    char fat_name[11];
+    FastMemcpy(fat_name, entry->name, 11);
+    const uint32_t first_cluster = Fat1xEntryCluster(vol, entry);
+    const int is_dir = (entry->attr & FAT12_ATTR_DIRECTORY) != 0;
+
     // Free the cluster chain
-    uint16_t cluster = entry->cluster_low;
-    while (cluster >= 2 && cluster < 0xFF8) {
-        uint16_t next_cluster = Fat12GetNextCluster(cluster);
-        Fat12SetFatEntry(cluster, FAT12_CLUSTER_FREE);
-        cluster = next_cluster;
-    }
+    Fat1xFreeChain(vol, first_cluster);
 
     // Mark directory entry as deleted
-    if (BlockDeviceRead(volume.device->id, entry_sector, 1, sector_buffer) != 0) {
+    if (BlockCacheRead(volume.device->id, entry_sector, 1, volume.sector_buffer) != 0) {
         return -1;
     }
 
-    Fat1xDirEntry* target_entry = &((Fat1xDirEntry*)sector_buffer)[entry_offset];
+    Fat1xDirEntry* target_entry = &((Fat1xDirEntry*)volume.sector_buffer)[entry_offset];
     target_entry->name[0] = 0xE5;
 
     // Write changes back to disk
-    if (BlockDeviceWrite(volume.device->id, entry_sector, 1, sector_buffer) != 0) {
+    if (BlockCacheWrite(volume.device->id, entry_sector, 1, volume.sector_buffer) != 0) {
         return -1;
     }
+    if (!is_dir) Fat1xOpenDrop(vol, entry_sector, entry_offset, 1);
+    DCacheInvalidate(vol, parent_cluster, fat_name, 11);
+    if (is_dir) DCacheInvalidateDir(vol, first_cluster);
 
-    if (Fat12WriteFat() != 0) {
+    if (Fat1xMaybeFlushFat(vol) != 0) {
         return -1;
     }
 
     return 0;
 }
 
-uint64_t Fat1xGetFileSize(const char* path) {
+uint64_t Fat1xGetFileSize(void* fs_data, const char* path) {
+    Fat1xVolume* vol = fs_data;
     if (!path) return 0;
 
-    uint16_t parent_cluster;
+    uint32_t parent_cluster;
     uint32_t entry_sector;
     int entry_offset;
 
-    Fat1xDirEntry* entry = Fat12FindEntry(path, &parent_cluster, &entry_sector, &entry_offset);
+    Fat1xDirEntry* entry = Fat1xFindEntry(vol, path, &parent_cluster, &entry_sector, &entry_offset);
     if (!entry || (entry->attr & FAT12_ATTR_DIRECTORY)) return 0;
 
     return entry->file_size;
 }
 
-int Fat1xListRoot(void) {
+int Fat1xListRoot(Fat1xVolume* vol) {
+    if (volume.fat_type == FAT1X_TYPE_32) return Fat1xListDirectory(vol, "/");
     uint32_t root_sectors = (volume.boot.root_entries * 32 + 511) / 512;
 
     for (uint32_t sector = 0; sector < root_sectors; sector++) {
-        if (BlockDeviceRead(volume.device->id, volume.root_sector + sector, 1, sector_buffer) != 0) {
+        if (BlockCacheRead(volume.device->id, volume.root_sector + sector, 1, volume.sector_buffer) != 0) {
             PrintKernel("Error reading root directory sector.\n");
             return -1;
         }
 
-        Fat1xDirEntry* entries = (Fat1xDirEntry*)sector_buffer;
+        Fat1xDirEntry* entries = (Fat1xDirEntry*)volume.sector_buffer;
         // The root directory has 16 entries per 512-byte sector
         for (int i = 0; i < 16; i++) {
             Fat1xDirEntry* entry = &entries[i];
@@ -1141,4 +1474,404 @@ int Fat1xListRoot(void) {
         }
     }
     return 0;
-}
\ No newline at end of file
+}
+// Open-file objects: the directory entry location and the cluster chain are
+// resolved once at open. The chain is kept as extents of consecutive
+// clusters, so positioned I/O maps an offset with a binary search and moves
+// whole runs of clusters per request. There is one object per directory
+// entry, shared by every handle open on it, so a size or chain change made
+// through one handle (or by a path-based write or delete) is seen by all.
+typedef struct {
+    uint32_t index;         // first file cluster covered
+    uint32_t cluster;       // its cluster on disk; the rest follow in order
+    uint32_t count;
+} Fat1xExtent;
+
+typedef struct Fat1xFile {
+    Fat1xVolume* vol;
+    uint32_t entry_sector;  // directory entry, rewritten when size changes
+    int entry_offset;
+    uint32_t size;
+    Fat1xExtent* extents;
+    uint32_t extent_count;
+    uint32_t extent_cap;
+    uint32_t clusters;      // chain length
+    uint32_t last;          // extent of the previous lookup
+    uint32_t refs;          // handles open on this object
+    int unlinked;           // entry deleted; I/O through the handles fails
+    struct Fat1xFile* next; // volume's open_files list
+} Fat1xFile;
+
+static int Fat1xFileAppend(Fat1xFile* file, uint32_t cluster) {
+    if (file->extent_count) {
+        Fat1xExtent* tail = &file->extents[file->extent_count - 1];
+        if (tail->cluster + tail->count == cluster) {
+            tail->count++;
+            file->clusters++;
+            return 0;
+        }
+    }
+    if (file->extent_count == file->extent_cap) {
+        uint32_t cap = file->extent_cap ? file->extent_cap * 2 : 4;
+        Fat1xExtent* extents = KernelMemoryAlloc(cap * sizeof(Fat1xExtent));
+        if (!extents) return -1;
+        if (file->extents) {
+            FastMemcpy(extents, file->extents, file->extent_count * sizeof(Fat1xExtent));
+            KernelFree(file->extents);
+        }
+        file->extents = extents;
+        file->extent_cap = cap;
+    }
+    Fat1xExtent* ext = &file->extents[file->extent_count++];
+    ext->index = file->clusters++;
+    ext->cluster = cluster;
+    ext->count = 1;
+    return 0;
+}
+
+static uint32_t Fat1xFileLastCluster(const Fat1xFile* file) {
+    const Fat1xExtent* tail = &file->extents[file->extent_count - 1];
+    return tail->cluster + tail->count - 1;
+}
+
+// Extent holding file cluster `index`, or NULL past the end of the chain
+static const Fat1xExtent* Fat1xFileExtent(Fat1xFile* file, uint32_t index) {
+    if (index >= file->clusters) return NULL;
+    const Fat1xExtent* ext = &file->extents[file->last];
+    if (file->last < file->extent_count && index >= ext->index && index - ext->index < ext->count) return ext;
+
+    uint32_t lo = 0, hi = file->extent_count - 1;
+    while (lo < hi) {
+        const uint32_t mid = (lo + hi + 1) / 2;
+        if (file->extents[mid].index <= index) lo = mid;
+        else hi = mid - 1;
+    }
+    file->last = lo;
+    return &file->extents[lo];
+}
+
+// (Re)reads the size and cluster chain from the directory entry
+static int Fat1xFileLoad(Fat1xFile* file, const Fat1xDirEntry* entry) {
+    Fat1xVolume* vol = file->vol;
+    file->size = entry->file_size;
+    file->extent_count = 0;
+    file->clusters = 0;
+    file->last = 0;
+
+    uint32_t cluster = Fat1xEntryCluster(vol, entry);
+    uint32_t guard = 0;
+    while (Fat1xValidCluster(vol, cluster) && guard++ < volume.total_clusters) {
+        if (Fat1xFileAppend(file, cluster) != 0) return -1;
+        cluster = Fat1xGetNextCluster(vol, cluster);
+    }
+    return 0;
+}
+
+static Fat1xFile* Fat1xFindOpen(Fat1xVolume* vol, uint32_t entry_sector, int entry_offset) {
+    for (Fat1xFile* file = volume.open_files; file; file = file->next) {
+        if (file->entry_sector == entry_sector && file->entry_offset == entry_offset) return file;
+    }
+    return NULL;
+}
+
+// A path-based write replaced the chain of an entry that may be open
+static void Fat1xOpenReload(Fat1xVolume* vol, uint32_t entry_sector, int entry_offset) {
+    Fat1xFile* file = Fat1xFindOpen(vol, entry_sector, entry_offset);
+    if (!file) return;
+    if (BlockCacheRead(volume.device->id, entry_sector, 1, volume.sector_buffer) != 0 ||
+        Fat1xFileLoad(file, &((Fat1xDirEntry*)volume.sector_buffer)[entry_offset]) != 0) {
+        file->unlinked = 1;
+    }
+}
+
+// The entry's clusters were freed behind the open object. On delete the
+// handles keep it until they close, but it leaves the list so the slot can
+// be reused by another file.
+static void Fat1xOpenDrop(Fat1xVolume* vol, uint32_t entry_sector, int entry_offset, int unlink) {
+    for (Fat1xFile** link = &volume.open_files; *link; link = &(*link)->next) {
+        Fat1xFile* file = *link;
+        if (file->entry_sector != entry_sector || file->entry_offset != entry_offset) continue;
+        file->size = 0;
+        file->extent_count = 0;
+        file->clusters = 0;
+        file->last = 0;
+        if (unlink) {
+            *link = file->next;
+            file->next = NULL;
+            file->unlinked = 1;
+        }
+        return;
+    }
+}
+
+void* Fat1xOpen(void* fs_data, const char* path, int flags) {
+    Fat1xVolume* vol = fs_data;
+    if (!path) return NULL;
+
+    uint32_t parent_cluster;
+    uint32_t entry_sector;
+    int entry_offset;
+
+    Fat1xDirEntry* entry = Fat1xFindEntry(vol, path, &parent_cluster, &entry_sector, &entry_offset);
+    if (!entry && (flags & FS_CREATE)) {
+        if (Fat1xCreateFile(vol, path) < 0) return NULL;
+        entry = Fat1xFindEntry(vol, path, &parent_cluster, &entry_sector, &entry_offset);
+    }
+    if (!entry || (entry->attr & FAT12_ATTR_DIRECTORY)) return NULL;
+
+    Fat1xFile* file = Fat1xFindOpen(vol, entry_sector, entry_offset);
+    if (file) {
+        file->refs++;
+        return file;
+    }
+
+    file = KernelMemoryAlloc(sizeof(Fat1xFile));
+    if (!file) return NULL;
+    FastMemset(file, 0, sizeof(Fat1xFile));
+    file->vol = vol;
+    file->entry_sector = entry_sector;
+    file->entry_offset = entry_offset;
+    file->refs = 1;
+    if (Fat1xFileLoad(file, entry) != 0) {
+        Fat1xClose(file);
+        return NULL;
+    }
+    file->next = volume.open_files;
+    volume.open_files = file;
+    return file;
+}
+
+int64_t Fat1xReadAt(void* handle, uint64_t offset, void* buffer, uint64_t count) {
+    Fat1xFile* file = handle;
+    if (!file || !buffer || file->unlinked) return -1;
+    Fat1xVolume* vol = file->vol;
+    if (offset >= file->size) return 0;
+    if (count > file->size - offset) count = file->size - offset;
+
+    const uint32_t spc = volume.boot.sectors_per_cluster;
+    const uint32_t cluster_bytes = spc * 512;
+    if (cluster_bytes == 0) return -1;
+
+    uint8_t* out = (uint8_t*)buffer;
+    uint8_t* cluster_buffer = NULL;
+    uint32_t done = 0;
+
+    while (done < count) {
+        const uint64_t pos = offset + done;
+        const uint32_t index = (uint32_t)(pos / cluster_bytes);
+        const uint32_t in_cluster = (uint32_t)(pos % cluster_bytes);
+        const Fat1xExtent* ext = Fat1xFileExtent(file, index);
+        if (!ext) break; // Chain shorter than the size claims
+
+        const uint32_t lba = Fat1xClusterLba(vol, ext->cluster + (index - ext->index));
+        if (in_cluster == 0 && count - done >= cluster_bytes) {
+            // As many whole clusters as the extent and the request cover
+            uint32_t n = ext->index + ext->count - index;
+            if (n > (count - done) / cluster_bytes) n = (count - done) / cluster_bytes;
+            if (BlockCacheRead(volume.device->id, lba, n * spc, out + done) != 0) break;
+            done += n * cluster_bytes;
+            continue;
+        }
+
+        uint32_t chunk = cluster_bytes - in_cluster;
+        if (chunk > count - done) chunk = count - done;
+        if (!cluster_buffer && !(cluster_buffer = KernelMemoryAlloc(cluster_bytes))) break;
+        if (BlockCacheRead(volume.device->id, lba, spc, cluster_buffer) != 0) break;
+        FastMemcpy(out + done, cluster_buffer + in_cluster, chunk);
+        done += chunk;
+    }
+
+    if (cluster_buffer) KernelFree(cluster_buffer);
+    return (done == 0 && count > 0) ? -1 : (int64_t)done;
+}
+
+int64_t Fat1xWriteAt(void* handle, uint64_t offset, const void* buffer, uint64_t count) {
+    Fat1xFile* file = handle;
+    if (!file || !buffer || file->unlinked) return -1;
+    Fat1xVolume* vol = file->vol;
+
+    // FAT file sizes are 32-bit
+    if (offset >= 0xFFFFFFFFull) return -1;
+    if (count > 0xFFFFFFFFull - offset) count = 0xFFFFFFFFull - offset;
+
+    const uint32_t spc = volume.boot.sectors_per_cluster;
+    const uint32_t cluster_bytes = spc * 512;
+    if (cluster_bytes == 0) return -1;
+
+    // Grow the chain to cover the write. Clusters that are new are zeroed
+    // where the write doesn't reach: gaps wholesale here, partial clusters
+    // in the copy loop below.
+    const uint32_t old_clusters = file->clusters;
+    const uint64_t needed = (offset + count + cluster_bytes - 1) / cluster_bytes;
+    int fat_dirty = 0;
+    while (file->clusters < needed) {
+        uint32_t cluster = Fat1xFindFreeCluster(vol);
+        if (cluster == 0) break;
+        const uint32_t prev = file->clusters ? Fat1xFileLastCluster(file) : 0;
+        Fat1xSetFatEntry(vol, cluster, FAT1X_CLUSTER_EOC);
+        if (prev) Fat1xSetFatEntry(vol, prev, cluster);
+        if (Fat1xFileAppend(file, cluster) != 0) {
+            Fat1xSetFatEntry(vol, cluster, FAT1X_CLUSTER_FREE);
+            if (prev) Fat1xSetFatEntry(vol, prev, FAT1X_CLUSTER_EOC);
+            break;
+        }
+        fat_dirty = 1;
+    }
+    const uint32_t first_written = (uint32_t)(offset / cluster_bytes);
+    for (uint32_t index = old_clusters; index < first_written && index < file->clusters;) {
+        const Fat1xExtent* ext = Fat1xFileExtent(file, index);
+        uint32_t n = ext->index + ext->count - index;
+        if (n > first_written - index) n = first_written - index;
+        Fat1xWriteClusters(vol, ext->cluster + (index - ext->index), n, NULL, 0);
+        index += n;
+    }
+
+    const uint8_t* in = (const uint8_t*)buffer;
+    uint8_t* cluster_buffer = NULL;
+    uint32_t done = 0;
+
+    while (done < count) {
+        const uint64_t pos = offset + done;
+        const uint32_t index = (uint32_t)(pos / cluster_bytes);
+        const uint32_t in_cluster = (uint32_t)(pos % cluster_bytes);
+        const Fat1xExtent* ext = Fat1xFileExtent(file, index);
+        if (!ext) break; // Volume full
+
+        const uint32_t lba = Fat1xClusterLba(vol, ext->cluster + (index - ext->index));
+        if (in_cluster == 0 && count - done >= cluster_bytes) {
+            uint32_t n = ext->index + ext->count - index;
+            if (n > (count - done) / cluster_bytes) n = (count - done) / cluster_bytes;
+            if (BlockCacheWrite(volume.device->id, lba, n * spc, in + done) != 0) break;
+            done += n * cluster_bytes;
+            continue;
+        }
+
+        uint32_t chunk = cluster_bytes - in_cluster;
+        if (chunk > count - done) chunk = count - done;
+        if (!cluster_buffer && !(cluster_buffer = KernelMemoryAlloc(cluster_bytes))) break;
+        if (index >= old_clusters) FastMemset(cluster_buffer, 0, cluster_bytes);
+        else if (BlockCacheRead(volume.device->id, lba, spc, cluster_buffer) != 0) break;
+        FastMemcpy(cluster_buffer + in_cluster, in + done, chunk);
+        if (BlockCacheWrite(volume.device->id, lba, spc, cluster_buffer) != 0) break;
+        done += chunk;
+    }
+    if (cluster_buffer) KernelFree(cluster_buffer);
+
+    if (fat_dirty && Fat1xMaybeFlushFat(vol) != 0) return -1;
+
+    if (offset + done > file->size || fat_dirty) {
+        if (offset + done > file->size) file->size = (uint32_t)(offset + done);
+        if (BlockCacheRead(volume.device->id, file->entry_sector, 1, volume.sector_buffer) != 0) return -1;
+        Fat1xDirEntry* dir_entry = &((Fat1xDirEntry*)volume.sector_buffer)[file->entry_offset];
+        dir_entry->file_size = file->size;
+        Fat1xSetEntryCluster(vol, dir_entry, file->clusters ? file->extents[0].cluster : 0);
+        if (BlockCacheWrite(volume.device->id, file->entry_sector, 1, volume.sector_buffer) != 0) return -1;
+    }
+
+    return (done == 0 && count > 0) ? -1 : (int64_t)done;
+}
+
+uint64_t Fat1xFileSize(void* handle) {
+    Fat1xFile* file = handle;
+    return file ? file->size : 0;
+}
+
+// Shortens the file to `size` bytes, freeing the clusters past it. The
+// tail of the new last cluster is zeroed so a later extension reads zeros.
+int Fat1xTruncate(void* handle, uint64_t size) {
+    Fat1xFile* file = handle;
+    if (!file || file->unlinked) return -1;
+    Fat1xVolume* vol = file->vol;
+    if (size >= file->size) return 0;
+
+    const uint32_t spc = volume.boot.sectors_per_cluster;
+    const uint32_t cluster_bytes = spc * 512;
+    if (cluster_bytes == 0) return -1;
+
+    const uint32_t keep = (uint32_t)((size + cluster_bytes - 1) / cluster_bytes);
+    const uint32_t in_cluster = (uint32_t)(size % cluster_bytes);
+    if (in_cluster) {
+        const Fat1xExtent* ext = Fat1xFileExtent(file, keep - 1);
+        if (ext) {
+            uint8_t* cluster_buffer = KernelMemoryAlloc(cluster_bytes);
+            if (!cluster_buffer) return -1;
+            const uint32_t lba = Fat1xClusterLba(vol, ext->cluster + (keep - 1 - ext->index));
+            int rc = BlockCacheRead(volume.device->id, lba, spc, cluster_buffer);
+            if (rc == 0) {
+                FastMemset(cluster_buffer + in_cluster, 0, cluster_bytes - in_cluster);
+                rc = BlockCacheWrite(volume.device->id, lba, spc, cluster_buffer);
+            }
+            KernelFree(cluster_buffer);
+            if (rc != 0) return -1;
+        }
+    }
+
+    if (keep < file->clusters) {
+        const Fat1xExtent* ext = Fat1xFileExtent(file, keep);
+        Fat1xFreeChain(vol, ext->cluster + (keep - ext->index));
+
+        // Drop the released clusters from the extent list
+        uint32_t n = (uint32_t)(ext - file->extents);
+        if (keep > ext->index) file->extents[n++].count = keep - ext->index;
+        file->extent_count = n;
+        file->clusters = keep;
+        file->last = 0;
+        if (keep) Fat1xSetFatEntry(vol, Fat1xFileLastCluster(file), FAT1X_CLUSTER_EOC);
+        if (Fat1xMaybeFlushFat(vol) != 0) return -1;
+    }
+
+    file->size = (uint32_t)size;
+    if (BlockCacheRead(volume.device->id, file->entry_sector, 1, volume.sector_buffer) != 0) return -1;
+    Fat1xDirEntry* dir_entry = &((Fat1xDirEntry*)volume.sector_buffer)[file->entry_offset];
+    dir_entry->file_size = file->size;
+    Fat1xSetEntryCluster(vol, dir_entry, file->clusters ? file->extents[0].cluster : 0);
+    if (BlockCacheWrite(volume.device->id, file->entry_sector, 1, volume.sector_buffer) != 0) return -1;
+    return 0;
+}
+
+void Fat1xClose(void* handle) {
+    Fat1xFile* file = handle;
+    if (!file) return;
+    if (file->refs > 1) {
+        file->refs--;
+        return;
+    }
+    for (Fat1xFile** link = &file->vol->open_files; *link; link = &(*link)->next) {
+        if (*link == file) {
+            *link = file->next;
+            break;
+        }
+    }
+    if (file->extents) KernelFree(file->extents);
+    KernelFree(file);
+}
+
+int Fat1xDelete(void* fs_data, const char* path, int recursive) {
+    Fat1xVolume* vol = fs_data;
+    if (recursive) return Fat1xDeleteRecursive(vol, path);
+    return Fat1xDeleteFile(vol, path);
+}
+
+FileSystemDriver g_fat1x_driver = {
+    .name = "FAT1x",
+    .detect = Fat1xDetect,
+    .mount = Fat1xMount,
+    .unmount = Fat1xUnmount,
+    .read_file = Fat1xReadFile,
+    .write_file = Fat1xWriteFile,
+    .list_dir = Fat1xListDirectory,
+    .create_file = Fat1xCreateFile,
+    .create_dir = Fat1xCreateDir,
+    .remove = Fat1xDelete,
+    .is_dir = Fat1xIsDirectory,
+    .is_file = Fat1xIsFile,
+    .get_size = Fat1xGetFileSize,
+    .open = Fat1xOpen,
+    .read_at = Fat1xReadAt,
+    .write_at = Fat1xWriteAt,
+    .file_size = Fat1xFileSize,
+    .truncate = Fat1xTruncate,
+    .close = Fat1xClose,
+    .sync = Fat1xSync,
+    .writeback = Fat1xWriteback,
+};
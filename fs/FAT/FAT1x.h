@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include <BlockDevice.h>
+#include <FileSystem.h>
 
 // FAT12 Boot Sector Structure
 typedef struct __attribute__((packed)) {
@@ -22,6 +23,25 @@ typedef struct __attribute__((packed)) {
     uint32_t total_sectors_32;
 } Fat1xBootSector;
 
+// FAT32 extension of the BPB, following Fat1xBootSector in sector 0
+typedef struct __attribute__((packed)) {
+    uint32_t sectors_per_fat_32;
+    uint16_t ext_flags;         // bit 7: mirroring off, bits 0-3: active FAT
+    uint16_t fs_version;
+    uint32_t root_cluster;
+    uint16_t fs_info;           // sector of the FSInfo structure
+    uint16_t backup_boot;
+    uint8_t  reserved[12];
+} Fat32BootSectorExt;
+
+// FAT32 FSInfo sector fields (byte offsets) and signatures
+#define FAT32_FSINFO_LEAD_SIG       0x41615252
+#define FAT32_FSINFO_STRUC_SIG      0x61417272
+#define FAT32_FSINFO_STRUC_OFFSET   484
+#define FAT32_FSINFO_FREE_OFFSET    488
+#define FAT32_FSINFO_NEXT_OFFSET    492
+#define FAT32_FSINFO_UNKNOWN        0xFFFFFFFF
+
 // FAT12 Directory Entry
 typedef struct __attribute__((packed)) {
     char     name[8];
@@ -47,33 +67,85 @@ typedef struct __attribute__((packed)) {
 #define FAT12_ATTR_DIRECTORY  0x10
 #define FAT12_ATTR_ARCHIVE    0x20
 
-// Special cluster values
-#define FAT12_CLUSTER_FREE    0x000
-#define FAT12_CLUSTER_EOF     0xFF8
+// FAT variants, told apart by the data cluster count
+#define FAT1X_TYPE_12         12
+#define FAT1X_TYPE_16         16
+#define FAT1X_TYPE_32         32
+#define FAT12_MAX_CLUSTERS    4084
+#define FAT16_MAX_CLUSTERS    65524
+
+// Special cluster values; end-of-chain is truncated to the entry width
+#define FAT1X_CLUSTER_FREE    0x00000000
+#define FAT1X_CLUSTER_EOC     0x0FFFFFF8
+
+// FAT changes stay in fat_table until sync/unmount, until the oldest one is
+// this old, or until this many sectors are dirty, whichever comes first
+#define FAT1X_FAT_WRITEBACK_MS  5000
+#define FAT1X_FAT_DIRTY_HIGH    32
+
+// Freed clusters are discarded only after the FAT sectors freeing them are
+// written; until then they wait in a per-volume queue of this many extents
+#define FAT1X_DISCARD_EXTENTS   32
+
+typedef struct {
+    uint32_t first;             // first cluster
+    uint32_t count;
+} Fat1xFreeRun;
 
 typedef struct {
     BlockDevice* device;
     Fat1xBootSector boot;
-    uint8_t* fat_table;
-    uint32_t fat_sector;
+    uint8_t fat_type;           // FAT1X_TYPE_*
+    uint8_t fat_mirror;         // write every FAT copy, not just the active one
+    uint8_t fsinfo_dirty;
+    uint16_t fsinfo_sector;     // FAT32 FSInfo, 0 if absent
+    uint32_t sectors_per_fat;   // size of one on-disk FAT copy
+    uint32_t fat_sectors;       // leading FAT sectors that map real clusters
+    uint32_t total_clusters;    // data clusters are 2 .. total_clusters + 1
+    uint32_t root_cluster;      // FAT32 root directory; 0 for the fixed root
+    uint32_t free_count;
+    uint32_t next_free;         // where the free-cluster search starts
+    uint8_t* fat_table;         // the first fat_sectors sectors of the FAT
+    uint8_t* fat_dirty;         // one bit per FAT sector not yet written back
+    uint8_t* fat_flushing;      // the fat_dirty bits a flush is writing
+    uint32_t fat_dirty_count;
+    uint64_t fat_dirty_since;   // GetTimeInMs() of the oldest unwritten change
+    Fat1xFreeRun discards[FAT1X_DISCARD_EXTENTS]; // freed, not yet discarded
+    uint32_t discard_count;
+    uint32_t fat_sector;        // FAT copy read at mount
     uint32_t root_sector;
     uint32_t data_sector;
+    uint8_t* sector_buffer;     // scratch for directory-entry updates
+    struct Fat1xFile* open_files; // one per open file, shared by its handles
 } Fat1xVolume;
 
-// Core Functions
+extern FileSystemDriver g_fat1x_driver;
+
+// Core Functions; fs_data is the mount's Fat1xVolume
 int Fat1xMount(BlockDevice* device, const char* mount_point);
 int Fat1xUnmount(BlockDevice* device);
 int Fat1xDetect(BlockDevice* device);
-// Set the active FAT1x volume context for subsequent FAT operations
-void Fat1xSetActive(BlockDevice* device);
-int Fat1xReadFile(const char* filename, void* buffer, uint32_t max_size);
-int Fat1xWriteFile(const char* filename, const void* buffer, uint32_t size);
-int Fat1xDeleteFile(const char* filename);
-int Fat1xCreateFile(const char* filename);
-int Fat1xDeleteRecursive(const char* path);
-int Fat1xCreateDir(const char* dirname);
-int Fat1xListRoot(void);
-int Fat1xGetCluster(uint16_t cluster, uint8_t* buffer);
-int Fat1xIsDirectory(const char* path);
-int Fat1xListDirectory(const char* path);
-uint64_t Fat1xGetFileSize(const char* path);
\ No newline at end of file
+int64_t Fat1xReadFile(void* fs_data, const char* filename, void* buffer, uint64_t max_size);
+int64_t Fat1xWriteFile(void* fs_data, const char* filename, const void* buffer, uint64_t size);
+int Fat1xCreateFile(void* fs_data, const char* filename);
+int Fat1xCreateDir(void* fs_data, const char* dirname);
+int Fat1xDelete(void* fs_data, const char* path, int recursive);
+int Fat1xIsDirectory(void* fs_data, const char* path);
+int Fat1xIsFile(void* fs_data, const char* path);
+int Fat1xListDirectory(void* fs_data, const char* path);
+uint64_t Fat1xGetFileSize(void* fs_data, const char* path);
+int Fat1xSync(void* fs_data);
+int Fat1xWriteback(void* fs_data);
+
+int Fat1xDeleteFile(Fat1xVolume* vol, const char* filename);
+int Fat1xDeleteRecursive(Fat1xVolume* vol, const char* path);
+int Fat1xListRoot(Fat1xVolume* vol);
+int Fat1xGetCluster(Fat1xVolume* vol, uint32_t cluster, uint8_t* buffer);
+
+// Open-file objects for positioned I/O; FS_CREATE creates a missing file
+void* Fat1xOpen(void* fs_data, const char* path, int flags);
+int64_t Fat1xReadAt(void* handle, uint64_t offset, void* buffer, uint64_t count);
+int64_t Fat1xWriteAt(void* handle, uint64_t offset, const void* buffer, uint64_t count);
+uint64_t Fat1xFileSize(void* handle);
+int Fat1xTruncate(void* handle, uint64_t size);
+void Fat1xClose(void* handle);
@@ -64,6 +64,7 @@ void FileSystemAutoMount() {
             
             for (int j = 0; j < g_num_fs_drivers; j++) {
                 FileSystemDriver* driver = g_fs_drivers[j];
+                if (!driver->detect) continue; // Virtual filesystems
                 PrintKernel("FS: Trying ");
                 PrintKernel(driver->name);
                 PrintKernel(" on ");
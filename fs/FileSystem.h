@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 
 struct BlockDevice;
 
@@ -10,11 +11,41 @@ typedef int (*DetectFunc)(struct BlockDevice* device);
 typedef int (*MountFunc)(struct BlockDevice* device, const char* mount_point);
 typedef int (*UnmountFunc)(struct BlockDevice* device);
 
+// Per-mount operations. fs_data is the private context the driver handed to
+// VfsMount (its volume); paths are relative to the mount point. A file
+// handle comes from open and carries its own volume. NULL entries are
+// unsupported operations. Sizes and offsets are 64-bit; transfers return
+// the byte count or -1.
 typedef struct FileSystemDriver {
     const char* name;
     DetectFunc detect;
     MountFunc mount;
     UnmountFunc unmount;
+
+    int64_t (*read_file)(void* fs_data, const char* path, void* buffer, uint64_t max_size);
+    int64_t (*write_file)(void* fs_data, const char* path, const void* buffer, uint64_t size);
+    int (*list_dir)(void* fs_data, const char* path);
+    int (*create_file)(void* fs_data, const char* path);
+    int (*create_dir)(void* fs_data, const char* path);
+    int (*remove)(void* fs_data, const char* path, int recursive);
+    int (*is_dir)(void* fs_data, const char* path);
+    int (*is_file)(void* fs_data, const char* path);
+    uint64_t (*get_size)(void* fs_data, const char* path);
+
+    void* (*open)(void* fs_data, const char* path, int flags);
+    int64_t (*read_at)(void* handle, uint64_t offset, void* buffer, uint64_t count);
+    int64_t (*write_at)(void* handle, uint64_t offset, const void* buffer, uint64_t count);
+    uint64_t (*file_size)(void* handle);
+    // Shortens an open file, releasing its storage past the new end
+    int (*truncate)(void* handle, uint64_t size);
+    void (*close)(void* handle);
+
+    // Writes back metadata the driver holds in memory, ahead of a block
+    // cache sync
+    int (*sync)(void* fs_data);
+    // Writes back in-memory metadata that has waited past the driver's own
+    // limit; called from the idle loop ahead of the block cache's write-back
+    int (*writeback)(void* fs_data);
 } FileSystemDriver;
 
 void FileSystemInit();
@@ -0,0 +1,322 @@
+#include <IoScheduler.h>
+#include <Console.h>
+#include <Io.h>
+#include <KernelHeap.h>
+#include <MemOps.h>
+#include <Scheduler.h>
+#include <StringOps.h>
+#include <TSC.h>
+
+static IoQueue g_queues[MAX_BLOCK_DEVICES];
+
+// Unlinks rq from the queue list
+static void QueueRemove(IoQueue* q, BlockRequest* rq) {
+    BlockRequest** link = &q->head;
+    while (*link) {
+        if (*link == rq) {
+            *link = rq->next;
+            rq->next = NULL;
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
+
+// noop: FIFO, merging only
+
+static void NoopAdd(IoQueue* q, BlockRequest* rq) {
+    BlockRequest** link = &q->head;
+    while (*link) link = &(*link)->next;
+    *link = rq;
+}
+
+static BlockRequest* NoopNext(IoQueue* q) {
+    BlockRequest* rq = q->head;
+    if (rq) QueueRemove(q, rq);
+    return rq;
+}
+
+// deadline: the queue is kept sorted by LBA and served as a one-way
+// elevator (C-SCAN) within the most urgent priority class, except that a
+// request whose deadline has passed is always served first.
+
+static void DeadlineAdd(IoQueue* q, BlockRequest* rq) {
+    BlockRequest** link = &q->head;
+    while (*link && (*link)->lba <= rq->lba) link = &(*link)->next;
+    rq->next = *link;
+    *link = rq;
+}
+
+static BlockRequest* DeadlineNext(IoQueue* q) {
+    if (!q->head) return NULL;
+
+    const uint64_t now = GetTimeInMs();
+    BlockRequest* pick = NULL;
+    uint8_t best_class = IOPRIO_CLASS_IDLE;
+
+    for (BlockRequest* rq = q->head; rq; rq = rq->next) {
+        if (rq->deadline <= now && (!pick || rq->deadline < pick->deadline)) pick = rq;
+        if (rq->priority < best_class) best_class = rq->priority;
+    }
+    if (pick) {
+        q->expired++;
+        QueueRemove(q, pick);
+        return pick;
+    }
+
+    BlockRequest* first = NULL;
+    for (BlockRequest* rq = q->head; rq; rq = rq->next) {
+        if (rq->priority != best_class) continue;
+        if (!first) first = rq;
+        if (rq->lba >= q->last_lba) {
+            pick = rq;
+            break;
+        }
+    }
+    if (!pick) pick = first; // wrap the elevator around
+    QueueRemove(q, pick);
+    return pick;
+}
+
+static const IoSchedulerOps g_noop_ops = {"noop", NoopAdd, NoopNext};
+static const IoSchedulerOps g_deadline_ops = {"deadline", DeadlineAdd, DeadlineNext};
+
+static const IoSchedulerOps* const g_policies[] = {&g_noop_ops, &g_deadline_ops};
+
+static int DriverTransfer(BlockDevice* dev, BlockIoOp op, uint64_t lba, uint32_t count, void* buffer, uint32_t merges) {
+    const uint64_t start = BlockDeviceIoStart(dev);
+    int result;
+    if (op == BIO_READ) {
+        result = dev->read_blocks ? dev->read_blocks(dev, lba, count, buffer) : -1;
+    } else {
+        result = dev->write_blocks ? dev->write_blocks(dev, lba, count, buffer) : -1;
+    }
+    BlockDeviceIoDone(dev, op, count, merges, start, result);
+    return result;
+}
+
+// Issues a run of LBA-contiguous requests as one driver call, bouncing
+// through a single buffer when more than one caller buffer is involved.
+static void IoExecute(BlockDevice* dev, BlockRequest** group, uint32_t n) {
+    if (n == 1) {
+        BlockRequest* rq = group[0];
+        rq->status = DriverTransfer(dev, rq->op, rq->lba, rq->count, rq->buffer, 0) == 0 ? 0 : -1;
+        return;
+    }
+
+    const BlockIoOp op = group[0]->op;
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < n; i++) total += group[i]->count;
+
+    uint8_t* bounce = KernelMemoryAlloc((uint64_t)total * dev->block_size);
+    if (!bounce) {
+        for (uint32_t i = 0; i < n; i++) IoExecute(dev, &group[i], 1);
+        return;
+    }
+
+    if (op == BIO_WRITE) {
+        uint8_t* p = bounce;
+        for (uint32_t i = 0; i < n; i++) {
+            FastMemcpy(p, group[i]->buffer, (uint64_t)group[i]->count * dev->block_size);
+            p += (uint64_t)group[i]->count * dev->block_size;
+        }
+    }
+
+    const int result = DriverTransfer(dev, op, group[0]->lba, total, bounce, n - 1) == 0 ? 0 : -1;
+
+    uint8_t* p = bounce;
+    for (uint32_t i = 0; i < n; i++) {
+        const uint64_t bytes = (uint64_t)group[i]->count * dev->block_size;
+        if (op == BIO_READ && result == 0) FastMemcpy(group[i]->buffer, p, bytes);
+        p += bytes;
+        group[i]->status = result;
+    }
+    KernelFree(bounce);
+}
+
+// Called with q->lock held and q->dispatching set; drops the lock around
+// each driver call so new requests can queue up (and merge) meanwhile.
+static void IoDispatchLocked(IoQueue* q) {
+    const uint32_t bs = q->device->block_size ? q->device->block_size : 512;
+
+    while (q->head) {
+        BlockRequest* group[IO_MERGE_MAX_REQS];
+        BlockRequest* rq = q->ops->next(q);
+        uint32_t n = 1;
+        uint64_t start = rq->lba;
+        uint64_t end = rq->lba + rq->count;
+        group[0] = rq;
+
+        int merged = 1;
+        while (merged && n < IO_MERGE_MAX_REQS) {
+            merged = 0;
+            for (BlockRequest* r = q->head; r; r = r->next) {
+                if (r->op != rq->op) continue;
+                if ((end - start + r->count) * bs > IO_MERGE_MAX_BYTES) continue;
+                if (r->lba == end) {
+                    QueueRemove(q, r);
+                    group[n++] = r;
+                    end += r->count;
+                } else if (r->lba + r->count == start) {
+                    QueueRemove(q, r);
+                    for (uint32_t k = n; k > 0; k--) group[k] = group[k - 1];
+                    group[0] = r;
+                    n++;
+                    start = r->lba;
+                } else {
+                    continue;
+                }
+                merged = 1;
+                break;
+            }
+        }
+
+        q->depth -= n;
+        q->dispatched++;
+        q->merged += n - 1;
+        q->last_lba = end;
+
+        rust_spinlock_unlock(q->lock);
+        IoExecute(q->device, group, n);
+        rust_spinlock_lock(q->lock);
+    }
+}
+
+uint8_t IoPriorityCurrent(void) {
+#if defined(VF_CONFIG_SCHED_MLFQ) || defined(VF_CONFIG_SCHED_EEVDF)
+    CurrentProcessControlBlock* proc = GetCurrentProcess();
+    if (!proc) return IOPRIO_CLASS_RT;
+    if (proc->privilege_level == PROC_PRIV_SYSTEM) return IOPRIO_CLASS_RT;
+    if (proc->privilege_level == PROC_PRIV_RESTRICTED) return IOPRIO_CLASS_IDLE;
+#if defined(VF_CONFIG_SCHED_EEVDF)
+    if (proc->nice < 0) return IOPRIO_CLASS_RT;
+    if (proc->nice >= 10) return IOPRIO_CLASS_IDLE;
+#endif
+#endif
+    return IOPRIO_CLASS_BE;
+}
+
+static uint64_t IoDeadline(const BlockRequest* rq, uint64_t now) {
+    uint64_t window = rq->op == BIO_READ ? IO_READ_DEADLINE_MS : IO_WRITE_DEADLINE_MS;
+    if (rq->priority == IOPRIO_CLASS_RT) window /= 4;
+    else if (rq->priority == IOPRIO_CLASS_IDLE) window *= 4;
+    return now + window;
+}
+
+void IoQueueAttach(BlockDevice* device) {
+    if (!device || device->id < 0 || device->id >= MAX_BLOCK_DEVICES) return;
+    IoQueue* q = &g_queues[device->id];
+
+    FastMemset(q, 0, sizeof(*q));
+    q->device = device;
+    // Seek-free devices gain nothing from sorting
+    q->ops = (device->type == DEVICE_TYPE_NVME || device->type == DEVICE_TYPE_VIRTIO ||
+              device->type == DEVICE_TYPE_RAMDISK)
+                 ? &g_noop_ops : &g_deadline_ops;
+    q->lock = rust_spinlock_new();
+    if (!q->lock) {
+        PrintKernelWarningF("IoSched: no lock for %s, requests bypass the queue\n", device->name);
+    }
+}
+
+// Gives the CPU away while another context completes our requests. The
+// caller holds no spinlock (see IoSubmit), so halting until the next
+// interrupt is safe whenever interrupts are on.
+static void IoWaitIdle(void) {
+    Yield();
+    if (save_irq_flags() & (1 << 9)) __asm__ volatile("hlt");
+    else __asm__ volatile("pause");
+}
+
+int IoSubmit(BlockDevice* device, BlockRequest* requests, uint32_t count) {
+    if (!device || !requests) return -1;
+    if (count == 0) return 0;
+
+    IoQueue* q = &g_queues[device->id];
+    if (!q->lock || q->device != device) {
+        int result = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            BlockRequest* rq = &requests[i];
+            rq->status = DriverTransfer(device, rq->op, rq->lba, rq->count, rq->buffer, 0) == 0 ? 0 : -1;
+            if (rq->status) result = -1;
+        }
+        return result;
+    }
+
+    const uint8_t prio = IoPriorityCurrent();
+    const uint64_t now = GetTimeInMs();
+#if defined(VF_CONFIG_SCHED_MLFQ) || defined(VF_CONFIG_SCHED_EEVDF)
+    CurrentProcessControlBlock* proc = GetCurrentProcess();
+    if (proc) proc->io_operations += count;
+#endif
+
+    rust_spinlock_lock(q->lock);
+    for (uint32_t i = 0; i < count; i++) {
+        BlockRequest* rq = &requests[i];
+        rq->status = BIO_STATUS_PENDING;
+        rq->priority = prio;
+        rq->deadline = IoDeadline(rq, now);
+        rq->next = NULL;
+        q->ops->add(q, rq);
+    }
+    q->depth += count;
+
+    if (!q->dispatching) {
+        q->dispatching = 1;
+        IoDispatchLocked(q);
+        q->dispatching = 0;
+    }
+    rust_spinlock_unlock(q->lock);
+
+    // Another context may own the dispatcher; wait for it to finish ours
+    int result = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        while (requests[i].status == BIO_STATUS_PENDING) IoWaitIdle();
+        if (requests[i].status != 0) result = -1;
+    }
+    return result;
+}
+
+int IoSchedulerSet(int device_id, const char* name) {
+    BlockDevice* dev = BlockDeviceGet(device_id);
+    if (!dev || !name) return -1;
+    IoQueue* q = &g_queues[device_id];
+
+    for (uint32_t i = 0; i < sizeof(g_policies) / sizeof(g_policies[0]); i++) {
+        if (FastStrCmp(g_policies[i]->name, name) != 0) continue;
+        if (!q->lock) return -1;
+        rust_spinlock_lock(q->lock);
+        // Re-queue anything pending under the new policy's ordering
+        BlockRequest* pending = q->head;
+        q->head = NULL;
+        q->ops = g_policies[i];
+        while (pending) {
+            BlockRequest* next = pending->next;
+            pending->next = NULL;
+            q->ops->add(q, pending);
+            pending = next;
+        }
+        rust_spinlock_unlock(q->lock);
+        return 0;
+    }
+    return -1;
+}
+
+const char* IoSchedulerGet(int device_id) {
+    if (!BlockDeviceGet(device_id)) return NULL;
+    const IoQueue* q = &g_queues[device_id];
+    return q->ops ? q->ops->name : "none";
+}
+
+void IoSchedulerPrint(void) {
+    PrintKernel("IoSched: available policies: noop deadline\n");
+    for (int i = 0; i < MAX_BLOCK_DEVICES; i++) {
+        BlockDevice* dev = BlockDeviceGet(i);
+        if (!dev) continue;
+        const IoQueue* q = &g_queues[i];
+        PrintKernelF("  %s: [%s] depth=%u dispatched=%llu merged=%llu expired=%llu\n",
+                     dev->name, q->ops ? q->ops->name : "none", q->depth,
+                     (unsigned long long)q->dispatched, (unsigned long long)q->merged,
+                     (unsigned long long)q->expired);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <BlockDevice.h>
+#include <SpinlockRust.h>
+#include <stdint.h>
+
+// Block-layer request queue that sits between BlockDeviceRead/Write and the
+// driver's read_blocks/write_blocks. Every device owns one queue with a
+// pluggable policy; contiguous requests of the same direction are merged
+// into a single driver call before dispatch.
+
+#define IO_MERGE_MAX_BYTES      (128 * 1024)
+#define IO_MERGE_MAX_REQS       32
+#define IO_READ_DEADLINE_MS     500
+#define IO_WRITE_DEADLINE_MS    5000
+
+// I/O priority classes, lower is more urgent
+#define IOPRIO_CLASS_RT     0
+#define IOPRIO_CLASS_BE     1
+#define IOPRIO_CLASS_IDLE   2
+
+#define BIO_STATUS_PENDING  1
+
+typedef struct BlockRequest {
+    BlockIoOp op;
+    uint64_t lba;
+    uint32_t count;
+    void* buffer;
+    uint8_t priority;           // IOPRIO_CLASS_*
+    uint64_t deadline;          // GetTimeInMs() value after which it must go next
+    volatile int status;        // BIO_STATUS_PENDING, then 0 or -1
+    struct BlockRequest* next;  // queue link, owned by the policy
+} BlockRequest;
+
+typedef struct IoQueue IoQueue;
+
+typedef struct {
+    const char* name;
+    void (*add)(IoQueue* q, BlockRequest* rq);  // insert into q->head
+    BlockRequest* (*next)(IoQueue* q);          // unlink and return the next request
+} IoSchedulerOps;
+
+struct IoQueue {
+    BlockDevice* device;
+    const IoSchedulerOps* ops;
+    RustSpinLock* lock;
+    BlockRequest* head;
+    uint32_t depth;
+    uint64_t last_lba;          // elevator position: end of the last dispatch
+    int dispatching;
+    uint64_t dispatched;
+    uint64_t merged;
+    uint64_t expired;
+};
+
+void IoQueueAttach(BlockDevice* device);
+// Queues the requests, dispatches if no other context is, and waits until
+// all of them completed; returns -1 if any failed. The wait gives up the CPU,
+// so callers must not hold a spinlock (BlockCache drops g_cache_lock first).
+int IoSubmit(BlockDevice* device, BlockRequest* requests, uint32_t count);
+int IoSchedulerSet(int device_id, const char* name);
+const char* IoSchedulerGet(int device_id);
+uint8_t IoPriorityCurrent(void);
+void IoSchedulerPrint(void);
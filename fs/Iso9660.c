@@ -1,440 +1,845 @@
 #include <Iso9660.h>
 
-#include <drivers/storage/Ide.h>
+#include <BlockCache.h>
 #include <kernel/etc/StringOps.h>
 #include <mm/KernelHeap.h>
 #include <Console.h>
 #include <Format.h>
 #include <MemOps.h>
+#include <SpinlockRust.h>
+#include <VFRFS.h>
 #include <VFS.h>
 
-#define ISO9660_SECTOR_SIZE 2048
+#define ISO9660_VD_MAX              32      // descriptors scanned before giving up
+#define ISO9660_RECORD_MIN          33      // directory record up to file_id
+#define ISO9660_NAME_MAX            255
+#define ISO9660_DIR_CACHE_ENTRIES   32
+#define ISO9660_DIR_MAX             (4 * 1024 * 1024)
+#define ISO9660_PATH_TABLE_MAX      (1024 * 1024)
+#define ISO9660_CE_MAX              16      // SUSP continuation areas per record
+#define ISO9660_NO_PATH_ENTRY       0xFFFFFFFFu
+#define ISO9660_IO_MAX_BLOCKS       (1u << 18)  // device blocks per read request
+
+// Rock Ridge NM flags
+#define ISO9660_NM_CURRENT          0x02
+#define ISO9660_NM_PARENT           0x04
+
+typedef enum {
+    ISO9660_NAMES_ISO,          // d-characters, ";1" and trailing '.' stripped
+    ISO9660_NAMES_JOLIET,       // UCS-2 from the supplementary descriptor
+    ISO9660_NAMES_ROCK_RIDGE    // NM entries, falling back to the ISO name
+} Iso9660NameSet;
+
+// NUL-terminated names packed back to back
+typedef struct {
+    char* data;
+    uint32_t length;
+    uint32_t capacity;
+} Iso9660NamePool;
+
+typedef struct {
+    uint32_t extent;        // first block of the data, past any extended attribute record
+    uint64_t size;          // 0 for directories known only by their extent
+    uint8_t flags;
+} Iso9660Node;
+
+typedef struct {
+    Iso9660Node node;
+    uint32_t name_offset;
+    uint8_t name_len;
+} Iso9660Dirent;
+
+// Decoded directory extent. Lookups hold a reference; the directory cache
+// only evicts unreferenced entries, and a directory that did not fit in the
+// cache is freed by its last Iso9660PutDir.
+typedef struct {
+    uint32_t extent;
+    Iso9660Dirent* entries;
+    uint32_t count;
+    uint32_t capacity;
+    Iso9660NamePool names;
+    uint32_t refs;
+    int cached;
+    uint64_t last_use;
+} Iso9660Dir;
+
+// Path table entry; entries are sorted by parent, so the children of entry
+// i all follow it
+typedef struct {
+    uint32_t extent;
+    uint32_t parent;        // index into the path table, root is 0
+    uint32_t name_offset;
+    uint8_t name_len;
+} Iso9660PathEntry;
+
+typedef struct Iso9660Volume {
+    struct BlockDevice* device;
+    uint32_t block_size;    // logical block size
+    Iso9660Node root;
+    Iso9660NameSet names;
+    uint8_t susp_skip;      // SP "LEN_SKP": bytes before SUSP entries in each record
+    Iso9660PathEntry* path_table;   // NULL: walk directory records only
+    uint32_t path_count;
+    Iso9660NamePool path_names;
+    Iso9660Dir* dir_cache[ISO9660_DIR_CACHE_ENTRIES];
+    uint64_t dir_clock;
+    RustSpinLock* dir_lock;
+} Iso9660Volume;
+
+typedef struct {
+    Iso9660Volume* vol;
+    uint32_t extent;
+    uint64_t size;
+} Iso9660File;
+
+static Iso9660Volume* g_iso9660_by_dev[MAX_BLOCK_DEVICES] = {0};
+#define volume (*vol)
+
+static uint32_t Iso9660Le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
 
-static uint8_t cdrom_drive = 0xFF;
+// Reads a byte range of the device. Whole device blocks go to the block
+// cache in requests of up to ISO9660_IO_MAX_BLOCKS, which skips the cache
+// for large file extents; only an unaligned head and tail are bounced.
+static int Iso9660ReadBytes(struct BlockDevice* device, uint64_t pos, void* buffer, uint64_t count) {
+    const uint32_t bs = device->block_size;
+    uint8_t* out = buffer;
+    uint8_t* bounce = NULL;
+    uint64_t done = 0;
+    int result = 0;
+
+    while (done < count) {
+        const uint64_t lba = (pos + done) / bs;
+        const uint32_t in_block = (uint32_t)((pos + done) % bs);
+        const uint64_t left = count - done;
+
+        if (in_block == 0 && left >= bs) {
+            const uint32_t blocks = left / bs > ISO9660_IO_MAX_BLOCKS ? ISO9660_IO_MAX_BLOCKS : (uint32_t)(left / bs);
+            if (BlockCacheRead(device->id, lba, blocks, out + done) != 0) {
+                result = -1;
+                break;
+            }
+            done += (uint64_t)blocks * bs;
+            continue;
+        }
 
-static inline char toupper_iso(char c) {
-    if (c >= 'a' && c <= 'z') return (char)(c - 'a' + 'A');
-    return c;
+        if (!bounce) bounce = KernelMemoryAlloc(bs);
+        if (!bounce || BlockCacheRead(device->id, lba, 1, bounce) != 0) {
+            result = -1;
+            break;
+        }
+        uint32_t chunk = bs - in_block;
+        if (chunk > left) chunk = (uint32_t)left;
+        FastMemcpy(out + done, bounce + in_block, chunk);
+        done += chunk;
+    }
+
+    if (bounce) KernelFree(bounce);
+    return result;
 }
 
-// Compare ISO names case-insensitively and ignore version suffix ";n"
-static int IsoNameEquals(const char* a, const char* b) {
-    // Skip leading spaces in ISO entries if any
-    while (*a == ' ') a++;
-    while (*b == ' ') b++;
+static uint32_t Iso9660PoolAdd(Iso9660NamePool* pool, const char* name, uint32_t len) {
+    if (pool->length + len + 1 > pool->capacity) {
+        uint32_t capacity = pool->capacity ? pool->capacity * 2 : 1024;
+        while (capacity < pool->length + len + 1) capacity *= 2;
+        char* data = KernelMemoryAlloc(capacity);
+        if (!data) return ISO9660_NO_PATH_ENTRY;
+        if (pool->data) {
+            FastMemcpy(data, pool->data, pool->length);
+            KernelFree(pool->data);
+        }
+        pool->data = data;
+        pool->capacity = capacity;
+    }
+    const uint32_t offset = pool->length;
+    FastMemcpy(pool->data + offset, name, len);
+    pool->data[offset + len] = '\0';
+    pool->length += len + 1;
+    return offset;
+}
 
-    for (;;) {
-        char ca = *a;
-        char cb = *b;
-        if (ca == ';') ca = '\0';
-        if (cb == ';') cb = '\0';
-        ca = toupper_iso(ca);
-        cb = toupper_iso(cb);
+static int Iso9660NameEquals(const char* a, uint32_t a_len, const char* b, uint32_t b_len) {
+    if (a_len != b_len) return 0;
+    for (uint32_t i = 0; i < a_len; i++) {
+        char ca = a[i];
+        char cb = b[i];
+        if (ca >= 'a' && ca <= 'z') ca = (char)(ca - 'a' + 'A');
+        if (cb >= 'a' && cb <= 'z') cb = (char)(cb - 'a' + 'A');
         if (ca != cb) return 0;
-        if (ca == '\0') return 1;
-        a++; b++;
-    }
-}
-
-static int ReadSector(uint32_t lba, void* buffer) {
-    if (cdrom_drive == 0xFF) {
-        PrintKernel("[ISO] Auto-detecting CD-ROM drive...\n");
-        for (uint8_t i = 0; i < 4; i++) {
-            PrintKernelF("[ISO] Checking drive %d...\n", i);
-            int result = IdeReadLBA2048(i, 16, buffer);
-            if (result == 0) {
-                Iso9660Pvd* pvd = (Iso9660Pvd*)buffer;
-                PrintKernelF("[ISO] Drive %d: PVD type: %d, ID: %.5s\n", i, pvd->type, pvd->id);
-                if (pvd->type == 1 && FastMemcmp(pvd->id, "CD001", 5) == 0) {
-                    cdrom_drive = i;
-                    PrintKernelF("[ISO] CD-ROM detected on drive %d\n", i);
-                    break;
-                }
+    }
+    return 1;
+}
+
+// Decodes a directory or path table identifier into `out` (ISO9660_NAME_MAX
+// bytes) and returns its length
+static uint32_t Iso9660DecodeId(const Iso9660Volume* vol, const uint8_t* id, uint32_t id_len, char* out) {
+    uint32_t n = 0;
+    if (volume.names == ISO9660_NAMES_JOLIET) {
+        // UCS-2 big endian to UTF-8
+        for (uint32_t i = 0; i + 1 < id_len; i += 2) {
+            const uint16_t c = (uint16_t)((id[i] << 8) | id[i + 1]);
+            if (c < 0x80) {
+                if (n + 1 > ISO9660_NAME_MAX) break;
+                out[n++] = (char)c;
+            } else if (c < 0x800) {
+                if (n + 2 > ISO9660_NAME_MAX) break;
+                out[n++] = (char)(0xC0 | (c >> 6));
+                out[n++] = (char)(0x80 | (c & 0x3F));
             } else {
-                PrintKernelF("[ISO] Drive %d: IdeReadLBA2048 failed with code %d\n", i, result);
+                if (n + 3 > ISO9660_NAME_MAX) break;
+                out[n++] = (char)(0xE0 | (c >> 12));
+                out[n++] = (char)(0x80 | ((c >> 6) & 0x3F));
+                out[n++] = (char)(0x80 | (c & 0x3F));
             }
         }
-        if (cdrom_drive == 0xFF) {
-            PrintKernelError("[ISO] No CD-ROM drive found.\n");
-            return -1;
+    } else {
+        n = id_len > ISO9660_NAME_MAX ? ISO9660_NAME_MAX : id_len;
+        FastMemcpy(out, id, n);
+    }
+
+    // "NAME.EXT;1" and "NAME.;1" name the file "NAME.EXT" and "NAME"
+    for (uint32_t i = 0; i < n; i++) {
+        if (out[i] == ';') {
+            n = i;
+            break;
         }
     }
+    if (n > 1 && out[n - 1] == '.') n--;
+    return n;
+}
 
-    if (IdeReadLBA2048(cdrom_drive, lba, buffer) != 0) {
-        PrintKernelF("[ISO] Failed to read LBA %u from drive %d\n", lba, cdrom_drive);
-        return -1;
+// Walks the SUSP entries of a directory record, following CE continuation
+// areas. Stores the Rock Ridge name and applies CL (relocated directory)
+// to `node`. Returns the name length, 0 without an NM entry, or -1 for an
+// RE entry (the relocated copy, which is listed through its CL link).
+static int Iso9660RockRidge(Iso9660Volume* vol, const Iso9660DirEntry* rec, char* name, Iso9660Node* node) {
+    const uint32_t su = ISO9660_RECORD_MIN + rec->file_id_length + ((rec->file_id_length & 1) ? 0 : 1) + volume.susp_skip;
+    const uint8_t* area = (const uint8_t*)rec + su;
+    uint32_t area_len = rec->length > su ? rec->length - su : 0;
+    uint8_t* ce_buffer = NULL;
+    int name_len = 0;
+    int relocated = 0;
+
+    for (int hops = 0;; hops++) {
+        uint32_t ce_block = 0, ce_offset = 0, ce_len = 0;
+        uint32_t pos = 0;
+        while (pos + sizeof(Iso9660SuspEntry) <= area_len) {
+            const Iso9660SuspEntry* e = (const Iso9660SuspEntry*)(area + pos);
+            if (e->length < sizeof(Iso9660SuspEntry) || pos + e->length > area_len) break;
+            const uint32_t data_len = e->length - sizeof(Iso9660SuspEntry);
+
+            if (e->signature[0] == 'N' && e->signature[1] == 'M' && data_len >= 1) {
+                if (!(e->data[0] & (ISO9660_NM_CURRENT | ISO9660_NM_PARENT))) {
+                    uint32_t part = data_len - 1;
+                    if (part > (uint32_t)(ISO9660_NAME_MAX - name_len)) part = ISO9660_NAME_MAX - name_len;
+                    FastMemcpy(name + name_len, e->data + 1, part);
+                    name_len += (int)part;
+                }
+            } else if (e->signature[0] == 'C' && e->signature[1] == 'E' && data_len >= 24) {
+                ce_block = Iso9660Le32(e->data);
+                ce_offset = Iso9660Le32(e->data + 8);
+                ce_len = Iso9660Le32(e->data + 16);
+            } else if (e->signature[0] == 'C' && e->signature[1] == 'L' && data_len >= 8) {
+                node->extent = Iso9660Le32(e->data);
+                node->size = 0;
+                node->flags |= ISO9660_FLAG_DIRECTORY;
+            } else if (e->signature[0] == 'R' && e->signature[1] == 'E') {
+                relocated = 1;
+            } else if (e->signature[0] == 'S' && e->signature[1] == 'T') {
+                break;
+            }
+            pos += e->length;
+        }
+
+        if (ce_len == 0 || hops >= ISO9660_CE_MAX || ce_offset + ce_len > volume.block_size) break;
+        if (!ce_buffer) ce_buffer = KernelMemoryAlloc(volume.block_size);
+        if (!ce_buffer ||
+            Iso9660ReadBytes(volume.device, (uint64_t)ce_block * volume.block_size + ce_offset, ce_buffer, ce_len) != 0) {
+            break;
+        }
+        area = ce_buffer;
+        area_len = ce_len;
     }
 
+    if (ce_buffer) KernelFree(ce_buffer);
+    return relocated ? -1 : name_len;
+}
+
+static void Iso9660FreeDir(Iso9660Dir* dir) {
+    if (dir->entries) KernelFree(dir->entries);
+    if (dir->names.data) KernelFree(dir->names.data);
+    KernelFree(dir);
+}
+
+static int Iso9660DirAdd(Iso9660Dir* dir, const Iso9660Node* node, const char* name, uint32_t name_len) {
+    if (dir->count == dir->capacity) {
+        const uint32_t capacity = dir->capacity ? dir->capacity * 2 : 16;
+        Iso9660Dirent* entries = KernelMemoryAlloc((size_t)capacity * sizeof(Iso9660Dirent));
+        if (!entries) return -1;
+        if (dir->entries) {
+            FastMemcpy(entries, dir->entries, (size_t)dir->count * sizeof(Iso9660Dirent));
+            KernelFree(dir->entries);
+        }
+        dir->entries = entries;
+        dir->capacity = capacity;
+    }
+    const uint32_t offset = Iso9660PoolAdd(&dir->names, name, name_len);
+    if (offset == ISO9660_NO_PATH_ENTRY) return -1;
+
+    Iso9660Dirent* e = &dir->entries[dir->count++];
+    e->node = *node;
+    e->name_offset = offset;
+    e->name_len = (uint8_t)name_len;
     return 0;
 }
 
+// Reads a directory extent in one request and decodes every record
+static Iso9660Dir* Iso9660LoadDir(Iso9660Volume* vol, uint32_t extent) {
+    const uint64_t start = (uint64_t)extent * volume.block_size;
+    uint8_t* data = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
+    if (!data) return NULL;
 
-static Iso9660DirEntry* FindFileInDir(uint32_t dir_lba, uint32_t dir_size, const char* filename) {
-    uint8_t* sector_buffer = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
-    if (!sector_buffer) {
+    // The "." record holds the directory's own size
+    if (Iso9660ReadBytes(volume.device, start, data, ISO9660_SECTOR_SIZE) != 0) {
+        KernelFree(data);
         return NULL;
     }
-
-    uint32_t bytes_read = 0;
-    while (bytes_read < dir_size) {
-        if (ReadSector(dir_lba + (bytes_read / ISO9660_SECTOR_SIZE), sector_buffer) != 0) {
-            KernelFree(sector_buffer);
+    const Iso9660DirEntry* self = (const Iso9660DirEntry*)data;
+    const uint32_t size = self->data_length_le;
+    if (self->length < ISO9660_RECORD_MIN || size == 0 || size > ISO9660_DIR_MAX) {
+        KernelFree(data);
+        return NULL;
+    }
+    if (size > ISO9660_SECTOR_SIZE) {
+        KernelFree(data);
+        data = KernelMemoryAlloc(size);
+        if (!data) return NULL;
+        if (Iso9660ReadBytes(volume.device, start, data, size) != 0) {
+            KernelFree(data);
             return NULL;
         }
+    }
 
-        Iso9660DirEntry* entry = (Iso9660DirEntry*)sector_buffer;
-        uint32_t sector_offset = 0;
-        char entry_filename[256];
-        while (sector_offset < ISO9660_SECTOR_SIZE) {
-            if (entry->length == 0) {
-                // End of directory entries in this sector
-                break;
-            }
-            FastMemset(entry_filename, 0, 256);
-            uint32_t name_len = entry->file_id_length;
-            if (name_len >= sizeof(entry_filename))
-                name_len = sizeof(entry_filename) - 1;
-            FastMemcpy(entry_filename, entry->file_id, name_len);
-            entry_filename[name_len] = 0;
-            PrintKernelF("[ISO] Found entry: '%s' (looking for '%s')\n", entry_filename, filename);
-            char* semicolon = FastStrChr(entry_filename, ';');
-            if (semicolon) {
-                *semicolon = 0;
-            }
-
-            if (IsoNameEquals(entry_filename, filename)) {
-                // Found it! We need to copy the entry to a new buffer, as the sector_buffer will be freed.
-                Iso9660DirEntry* result = KernelMemoryAlloc(entry->length);
-                if (result) {
-                    FastMemcpy(result, entry, entry->length);
+    Iso9660Dir* dir = KernelMemoryAlloc(sizeof(Iso9660Dir));
+    char* name = KernelMemoryAlloc(ISO9660_NAME_MAX + 1);
+    if (!dir || !name) {
+        if (dir) KernelFree(dir);
+        if (name) KernelFree(name);
+        KernelFree(data);
+        return NULL;
+    }
+    FastMemset(dir, 0, sizeof(Iso9660Dir));
+    dir->extent = extent;
+
+    uint32_t pos = 0;
+    int ok = 1;
+    while (ok && pos < size) {
+        const Iso9660DirEntry* rec = (const Iso9660DirEntry*)(data + pos);
+        // Records never cross a sector; a zero length pads to the next one
+        if (rec->length == 0 || rec->length < ISO9660_RECORD_MIN + rec->file_id_length ||
+            pos + rec->length > size) {
+            pos = (pos / ISO9660_SECTOR_SIZE + 1) * ISO9660_SECTOR_SIZE;
+            continue;
+        }
+        pos += rec->length;
+
+        if (rec->file_id_length == 1 && (uint8_t)rec->file_id[0] <= 1) continue; // "." and ".."
+        if (rec->file_flags & ISO9660_FLAG_ASSOCIATED) continue;
+
+        Iso9660Node node = {
+            .extent = rec->extent_loc_le + rec->extended_attribute_length,
+            .size = rec->data_length_le,
+            .flags = rec->file_flags,
+        };
+        int name_len = 0;
+        if (volume.names == ISO9660_NAMES_ROCK_RIDGE) {
+            name_len = Iso9660RockRidge(vol, rec, name, &node);
+            if (name_len < 0) continue;
+        }
+        if (name_len == 0) name_len = (int)Iso9660DecodeId(vol, (const uint8_t*)rec->file_id, rec->file_id_length, name);
+        if (name_len == 0) continue;
+
+        // Files over 4 GiB are split across records with the same name;
+        // pieces recorded back to back are joined into one extent
+        if (dir->count > 0) {
+            Iso9660Dirent* prev = &dir->entries[dir->count - 1];
+            if ((prev->node.flags & ISO9660_FLAG_MULTI_EXTENT) &&
+                Iso9660NameEquals(dir->names.data + prev->name_offset, prev->name_len, name, (uint32_t)name_len)) {
+                if ((uint64_t)prev->node.extent * volume.block_size + prev->node.size ==
+                    (uint64_t)node.extent * volume.block_size) {
+                    prev->node.size += node.size;
+                    prev->node.flags = node.flags;
                 }
-                KernelFree(sector_buffer);
-                return result;
+                continue;
             }
-
-            sector_offset += entry->length;
-            entry = (Iso9660DirEntry*)((uint8_t*)entry + entry->length);
         }
-        bytes_read += ISO9660_SECTOR_SIZE;
+        if (Iso9660DirAdd(dir, &node, name, (uint32_t)name_len) != 0) ok = 0;
     }
 
-    KernelFree(sector_buffer);
-    return NULL;
+    KernelFree(name);
+    KernelFree(data);
+    if (!ok) {
+        Iso9660FreeDir(dir);
+        return NULL;
+    }
+    return dir;
 }
 
-
-int Iso9660Read(const char* path, void* buffer, uint32_t max_size) {
-    // Allocate a buffer for one sector
-    PrintKernelF("ISO9660: Reading '%s'\n", path);
-    uint8_t* sector_buffer = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
-    if (!sector_buffer) {
-        PrintKernelError("Out of memory\n");
-        return -1; // Out of memory
+// Returns a referenced directory, from the cache when possible
+static Iso9660Dir* Iso9660GetDir(Iso9660Volume* vol, uint32_t extent) {
+    if (volume.dir_lock) {
+        rust_spinlock_lock(volume.dir_lock);
+        for (int i = 0; i < ISO9660_DIR_CACHE_ENTRIES; i++) {
+            Iso9660Dir* dir = volume.dir_cache[i];
+            if (dir && dir->extent == extent) {
+                dir->refs++;
+                dir->last_use = ++volume.dir_clock;
+                rust_spinlock_unlock(volume.dir_lock);
+                return dir;
+            }
+        }
+        rust_spinlock_unlock(volume.dir_lock);
+    }
+
+    Iso9660Dir* dir = Iso9660LoadDir(vol, extent);
+    if (!dir) return NULL;
+    dir->refs = 1;
+    if (!volume.dir_lock) return dir;
+
+    rust_spinlock_lock(volume.dir_lock);
+    int slot = -1;
+    for (int i = 0; i < ISO9660_DIR_CACHE_ENTRIES; i++) {
+        Iso9660Dir* cached = volume.dir_cache[i];
+        if (cached && cached->extent == extent) {
+            // Another lookup loaded it meanwhile; keep that copy
+            cached->refs++;
+            cached->last_use = ++volume.dir_clock;
+            rust_spinlock_unlock(volume.dir_lock);
+            Iso9660FreeDir(dir);
+            return cached;
+        }
+        if (!cached && (slot < 0 || volume.dir_cache[slot])) slot = i;
+    }
+    // No free slot: replace the least recently used unreferenced directory
+    for (int i = 0; slot < 0 && i < ISO9660_DIR_CACHE_ENTRIES; i++) {
+        if (volume.dir_cache[i]->refs == 0) slot = i;
+    }
+    for (int i = 0; slot >= 0 && volume.dir_cache[slot] && i < ISO9660_DIR_CACHE_ENTRIES; i++) {
+        Iso9660Dir* cached = volume.dir_cache[i];
+        if (cached->refs == 0 && cached->last_use < volume.dir_cache[slot]->last_use) slot = i;
     }
+    if (slot >= 0) {
+        if (volume.dir_cache[slot]) Iso9660FreeDir(volume.dir_cache[slot]);
+        volume.dir_cache[slot] = dir;
+        dir->cached = 1;
+        dir->last_use = ++volume.dir_clock;
+    }
+    rust_spinlock_unlock(volume.dir_lock);
+    return dir;
+}
 
-    // Find the Primary Volume Descriptor (PVD) at LBA 16
-    PrintKernel("[ISO] Looking for Primary Volume Descriptor...\n");
-    Iso9660Pvd* pvd = NULL;
+static void Iso9660PutDir(Iso9660Volume* vol, Iso9660Dir* dir) {
+    if (volume.dir_lock) rust_spinlock_lock(volume.dir_lock);
+    const int release = --dir->refs == 0 && !dir->cached;
+    if (volume.dir_lock) rust_spinlock_unlock(volume.dir_lock);
+    if (release) Iso9660FreeDir(dir);
+}
 
-    if (ReadSector(16, sector_buffer) != 0) {
-        KernelFree(sector_buffer);
-        PrintKernelError("[ISO] Failed to read PVD sector 16\n");
-        return -1;
+static int Iso9660FindChild(Iso9660Volume* vol, uint32_t dir_extent, const char* name, uint32_t len, Iso9660Node* out) {
+    Iso9660Dir* dir = Iso9660GetDir(vol, dir_extent);
+    if (!dir) return -1;
+    int result = -1;
+    for (uint32_t i = 0; i < dir->count; i++) {
+        const Iso9660Dirent* e = &dir->entries[i];
+        if (Iso9660NameEquals(dir->names.data + e->name_offset, e->name_len, name, len)) {
+            *out = e->node;
+            result = 0;
+            break;
+        }
     }
+    Iso9660PutDir(vol, dir);
+    return result;
+}
 
-    // Debug: Show first 16 bytes of sector
-    PrintKernel("[ISO] First 16 bytes of sector 16: ");
-    for (int i = 0; i < 16; i++) {
-        PrintKernelF("%02X ", sector_buffer[i]);
+static uint32_t Iso9660PathTableFind(Iso9660Volume* vol, uint32_t parent, const char* name, uint32_t len) {
+    for (uint32_t i = parent + 1; i < volume.path_count; i++) {
+        const Iso9660PathEntry* e = &volume.path_table[i];
+        if (e->parent > parent) break;
+        if (e->parent == parent &&
+            Iso9660NameEquals(volume.path_names.data + e->name_offset, e->name_len, name, len)) {
+            return i;
+        }
     }
-    PrintKernel("\n");
-
-    Iso9660Pvd* cand = (Iso9660Pvd*)sector_buffer;
-    PrintKernelF("[ISO] PVD type: %d, ID: %.5s\n", cand->type, cand->id);
+    return ISO9660_NO_PATH_ENTRY;
+}
 
-    if (cand->type == 1 && FastMemcmp(cand->id, "CD001", 5) == 0) {
-        PrintKernel("[ISO] Found valid PVD!\n");
-        pvd = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
-        if (!pvd) {
-            KernelFree(sector_buffer);
-            PrintKernelError("[ISO] Out of memory for PVD\n");
+// Resolves a mount-relative path. Directories come from the path table for
+// as long as the walk stays on it; files and anything else come from the
+// cached directory records.
+static int Iso9660Lookup(Iso9660Volume* vol, const char* path, Iso9660Node* out) {
+    Iso9660Node node = volume.root;
+    uint32_t entry = volume.path_table ? 0 : ISO9660_NO_PATH_ENTRY;
+
+    const char* p = path;
+    while (*p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        const char* end = p;
+        while (*end && *end != '/') end++;
+        const uint32_t len = (uint32_t)(end - p);
+
+        if (!(node.flags & ISO9660_FLAG_DIRECTORY)) return -1;
+        if (entry != ISO9660_NO_PATH_ENTRY) entry = Iso9660PathTableFind(vol, entry, p, len);
+        if (entry != ISO9660_NO_PATH_ENTRY) {
+            node.extent = volume.path_table[entry].extent;
+            node.size = 0;
+            node.flags = ISO9660_FLAG_DIRECTORY;
+        } else if (Iso9660FindChild(vol, node.extent, p, len, &node) != 0) {
             return -1;
         }
-        FastMemcpy(pvd, sector_buffer, ISO9660_SECTOR_SIZE);
-    } else {
-        PrintKernelError("[ISO] Invalid PVD signature\n");
+        p = end;
     }
-    KernelFree(sector_buffer);
 
-    if (!pvd) {
-        PrintKernelError("[ISO] PVD not found - not a valid ISO9660 filesystem\n");
-        return -1;
-    }
-
-    PrintKernel("[ISO] PVD found successfully\n");
+    *out = node;
+    return 0;
+}
 
-    // Get the root directory entry
-    Iso9660DirEntry* root_entry = (Iso9660DirEntry*)pvd->root_directory_record;
+static int Iso9660LoadPathTable(Iso9660Volume* vol, const Iso9660Pvd* vd) {
+    const uint32_t size = vd->path_table_size_le;
+    if (size == 0 || size > ISO9660_PATH_TABLE_MAX) return -1;
 
-    // Traverse the path
-    char* path_copy = KernelMemoryAlloc(FastStrlen(path, 256) + 1);
-    if (!path_copy) {
-        KernelFree(pvd);
+    uint8_t* data = KernelMemoryAlloc(size);
+    if (!data) return -1;
+    if (Iso9660ReadBytes(volume.device, (uint64_t)vd->path_table_loc_le * volume.block_size, data, size) != 0) {
+        KernelFree(data);
         return -1;
     }
-    FastStrCopy(path_copy, path, 256);
 
-    char* current_part = path_copy;
-    Iso9660DirEntry* current_entry = root_entry;
-    uint32_t current_lba = root_entry->extent_loc_le;
-    uint32_t current_size = root_entry->data_length_le;
-
-    // If path is just "/", we can't do much, but let's not crash
-    if (FastStrCmp(path, "/") == 0) {
-        KernelFree(path_copy);
-        KernelFree(pvd);
-        PrintKernelError("Nothing to read\n");
-        return 0; // Not an error, but nothing to read
+    // Records are at least 9 bytes (8 + one identifier byte)
+    const uint32_t capacity = size / 9 + 1;
+    Iso9660PathEntry* table = KernelMemoryAlloc((size_t)capacity * sizeof(Iso9660PathEntry));
+    char* name = KernelMemoryAlloc(ISO9660_NAME_MAX + 1);
+    if (!table || !name) {
+        if (table) KernelFree(table);
+        if (name) KernelFree(name);
+        KernelFree(data);
+        return -1;
     }
 
-    while (*current_part) {
-        if (*current_part == '/') {
-            current_part++;
-            continue;
-        }
-
-        char* next_slash = FastStrChr(current_part, '/');
-        if (next_slash) {
-            *next_slash = 0;
-        }
-
-        Iso9660DirEntry* found_entry = FindFileInDir(current_lba, current_size, current_part);
-        if (current_entry != root_entry) {
-            KernelFree(current_entry);
+    uint32_t count = 0;
+    uint32_t pos = 0;
+    int ok = 1;
+    while (pos + 8 < size && count < capacity) {
+        const Iso9660PathTableRecord* rec = (const Iso9660PathTableRecord*)(data + pos);
+        if (rec->dir_id_len == 0 || pos + 8 + rec->dir_id_len > size) break;
+        const uint32_t parent = rec->parent_dir_num;
+        if (parent == 0 || parent - 1 > count || (count == 0 && parent != 1)) {
+            ok = 0;
+            break;
         }
-        current_entry = found_entry;
 
-        if (!current_entry) {
-            KernelFree(path_copy);
-            KernelFree(pvd);
-            PrintKernelError("Path not found\n");
-            return -1; // Path not found
+        // The root's identifier is a single 0 byte
+        const uint32_t name_len = count == 0 ? 0 : Iso9660DecodeId(vol, (const uint8_t*)rec->dir_id, rec->dir_id_len, name);
+        const uint32_t offset = Iso9660PoolAdd(&volume.path_names, name, name_len);
+        if (offset == ISO9660_NO_PATH_ENTRY) {
+            ok = 0;
+            break;
         }
+        table[count].extent = rec->extent_loc + rec->ext_attr_rec_len;
+        table[count].parent = count == 0 ? 0 : parent - 1;
+        table[count].name_offset = offset;
+        table[count].name_len = (uint8_t)name_len;
+        count++;
+        pos += 8 + rec->dir_id_len + (rec->dir_id_len & 1);
+    }
+
+    KernelFree(name);
+    KernelFree(data);
+    if (!ok || count == 0 || table[0].extent != volume.root.extent) {
+        KernelFree(table);
+        return -1;
+    }
+    volume.path_table = table;
+    volume.path_count = count;
+    return 0;
+}
 
-        current_lba = current_entry->extent_loc_le;
-        current_size = current_entry->data_length_le;
+// Joliet supplementary descriptors announce UCS-2 level 1-3 as "%/@", "%/C" or "%/E"
+static int Iso9660IsJoliet(const Iso9660Pvd* vd) {
+    const uint8_t* esc = vd->escape_sequences;
+    return esc[0] == '%' && esc[1] == '/' && (esc[2] == '@' || esc[2] == 'C' || esc[2] == 'E');
+}
 
-        if (next_slash) {
-            current_part = next_slash + 1;
-        } else {
-            break;
+// Rock Ridge volumes start the root's "." System Use area with an SP entry
+static int Iso9660DetectSusp(Iso9660Volume* vol) {
+    uint8_t* data = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
+    if (!data) return 0;
+
+    int found = 0;
+    if (Iso9660ReadBytes(volume.device, (uint64_t)volume.root.extent * volume.block_size, data, ISO9660_SECTOR_SIZE) == 0) {
+        const Iso9660DirEntry* self = (const Iso9660DirEntry*)data;
+        const uint32_t su = ISO9660_RECORD_MIN + self->file_id_length + ((self->file_id_length & 1) ? 0 : 1);
+        const Iso9660SuspEntry* sp = (const Iso9660SuspEntry*)(data + su);
+        if (self->length >= su + 7 && sp->signature[0] == 'S' && sp->signature[1] == 'P' &&
+            sp->length >= 7 && sp->data[0] == 0xBE && sp->data[1] == 0xEF) {
+            volume.susp_skip = sp->data[2];
+            found = 1;
         }
     }
+    KernelFree(data);
+    return found;
+}
 
-    KernelFree(path_copy);
+int Iso9660Detect(struct BlockDevice* device) {
+    if (!device || !device->read_blocks || !device->block_size) return 0;
 
-    if (!current_entry) {
-        KernelFree(pvd);
-        PrintKernelError("This should not happen\n");
-        return -1; // Should not happen
-    }
+    Iso9660Pvd* vd = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
+    if (!vd) return 0;
+    const int found = Iso9660ReadBytes(device, (uint64_t)ISO9660_VD_START * ISO9660_SECTOR_SIZE, vd, ISO9660_SECTOR_SIZE) == 0 &&
+                      FastMemcmp(vd->id, "CD001", 5) == 0;
+    KernelFree(vd);
+    return found;
+}
 
-    // Read the file data
-    if (current_entry->file_flags & 2) { // directory bit
-        if (current_entry != root_entry) {
-            KernelFree(current_entry);
-        }
-        KernelFree(pvd);
-        PrintKernelError("Path is a directory\n");
+int Iso9660Mount(struct BlockDevice* device, const char* mount_point) {
+    if (!device || !device->read_blocks || !device->block_size) return -1;
+    if (device->id < 0 || device->id >= MAX_BLOCK_DEVICES) return -1;
+    if (g_iso9660_by_dev[device->id]) {
+        PrintKernelWarning("ISO9660: Device is already mounted\n");
         return -1;
     }
-    PrintKernelF("[ISO] Found file: data_length_le=%u, extent_loc_le=%u\n",
-             current_entry->data_length_le, current_entry->extent_loc_le);
-    // Read the file data
-    const uint32_t file_size = current_entry->data_length_le;
-    const uint32_t file_lba  = current_entry->extent_loc_le;
-    // Stat-only mode
-    if (buffer == NULL || max_size == 0) {
-        if (current_entry != root_entry) {
-            KernelFree(current_entry);
+
+    Iso9660Volume* vol = KernelMemoryAlloc(sizeof(Iso9660Volume));
+    Iso9660Pvd* vd = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
+    Iso9660Pvd* pvd = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
+    Iso9660Pvd* svd = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
+    if (!vol || !vd || !pvd || !svd) goto fail;
+    FastMemset(vol, 0, sizeof(Iso9660Volume));
+    volume.device = device;
+
+    volume.dir_lock = rust_spinlock_new();
+    if (!volume.dir_lock) {
+        PrintKernelWarning("ISO9660: Failed to allocate directory cache lock, directories are not cached\n");
+    }
+
+    // Volume descriptors follow the system area up to the set terminator
+    int have_pvd = 0, have_svd = 0;
+    for (uint32_t sector = ISO9660_VD_START; sector < ISO9660_VD_START + ISO9660_VD_MAX; sector++) {
+        if (Iso9660ReadBytes(device, (uint64_t)sector * ISO9660_SECTOR_SIZE, vd, ISO9660_SECTOR_SIZE) != 0) break;
+        if (FastMemcmp(vd->id, "CD001", 5) != 0 || vd->type == ISO9660_VD_TERMINATOR) break;
+        if (vd->type == ISO9660_VD_PRIMARY && !have_pvd) {
+            FastMemcpy(pvd, vd, ISO9660_SECTOR_SIZE);
+            have_pvd = 1;
+        } else if (vd->type == ISO9660_VD_SUPPLEMENTARY && !have_svd && Iso9660IsJoliet(vd)) {
+            FastMemcpy(svd, vd, ISO9660_SECTOR_SIZE);
+            have_svd = 1;
         }
-        KernelFree(pvd);
-        return (int)file_size;
+    }
+    if (!have_pvd) {
+        PrintKernel("ISO9660: No primary volume descriptor\n");
+        goto fail;
     }
 
-    const uint32_t to_read = (file_size < max_size) ? file_size : max_size;
-    uint8_t* read_buffer = (uint8_t*)buffer;
-    uint32_t bytes_read = 0;
-    uint8_t* temp_sector = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
-    if (!temp_sector) {
-        if (current_entry != root_entry) KernelFree(current_entry);
-        KernelFree(pvd);
-        return -1;
+    volume.block_size = pvd->logical_block_size_le;
+    if (volume.block_size != 512 && volume.block_size != 1024 && volume.block_size != ISO9660_SECTOR_SIZE) {
+        PrintKernel("ISO9660: Invalid logical block size\n");
+        goto fail;
     }
-    while (bytes_read < to_read) {
-        uint32_t sector_to_read = file_lba + (bytes_read / ISO9660_SECTOR_SIZE);
-        if (ReadSector(sector_to_read, temp_sector) != 0) {
-            KernelFree(temp_sector);
-            if (current_entry != root_entry) KernelFree(current_entry);
-            KernelFree(pvd);
-            return -1;
-        }
 
-        uint32_t offset_in_sector = bytes_read % ISO9660_SECTOR_SIZE;
-        uint32_t remaining_in_sector = ISO9660_SECTOR_SIZE - offset_in_sector;
-        uint32_t remaining_to_read = to_read - bytes_read;
-        uint32_t chunk_size = (remaining_in_sector < remaining_to_read) ? remaining_in_sector : remaining_to_read;
+    const Iso9660DirEntry* root = (const Iso9660DirEntry*)pvd->root_directory_record;
+    volume.root.extent = root->extent_loc_le + root->extended_attribute_length;
+    volume.root.size = root->data_length_le;
+    volume.root.flags = ISO9660_FLAG_DIRECTORY;
+
+    // Rock Ridge lives in the primary tree; without it prefer the Joliet tree
+    const Iso9660Pvd* names_vd = pvd;
+    if (Iso9660DetectSusp(vol)) {
+        volume.names = ISO9660_NAMES_ROCK_RIDGE;
+    } else if (have_svd) {
+        volume.names = ISO9660_NAMES_JOLIET;
+        root = (const Iso9660DirEntry*)svd->root_directory_record;
+        volume.root.extent = root->extent_loc_le + root->extended_attribute_length;
+        volume.root.size = root->data_length_le;
+        names_vd = svd;
+    } else {
+        volume.names = ISO9660_NAMES_ISO;
+    }
 
-        FastMemcpy(read_buffer + bytes_read, temp_sector + offset_in_sector, chunk_size);
-        bytes_read += chunk_size;
+    // Path table identifiers are never Rock Ridge names
+    if (volume.names != ISO9660_NAMES_ROCK_RIDGE && Iso9660LoadPathTable(vol, names_vd) != 0) {
+        PrintKernelWarning("ISO9660: Failed to load path table, walking directory records\n");
     }
-    KernelFree(temp_sector);
 
-    if (current_entry != root_entry) {
-        KernelFree(current_entry);
+    g_iso9660_by_dev[device->id] = vol;
+    VfsCreateDir(mount_point);
+    if (VfsMount(mount_point, device, &g_iso9660_driver, vol) != 0) {
+        PrintKernel("ISO9660: Failed to register mount point ");
+        PrintKernel(mount_point);
+        PrintKernel("\n");
+        g_iso9660_by_dev[device->id] = NULL;
+        goto fail;
     }
+
+    PrintKernelF("ISO9660: Mounted at %s (%s names, %u directories in path table)\n", mount_point,
+                 volume.names == ISO9660_NAMES_ROCK_RIDGE ? "Rock Ridge" :
+                 volume.names == ISO9660_NAMES_JOLIET ? "Joliet" : "ISO9660",
+                 volume.path_count);
+    KernelFree(vd);
     KernelFree(pvd);
+    KernelFree(svd);
+    return 0;
 
-    return bytes_read;
+fail:
+    if (vol) {
+        if (volume.path_table) KernelFree(volume.path_table);
+        if (volume.path_names.data) KernelFree(volume.path_names.data);
+        if (volume.dir_lock) rust_spinlock_free(volume.dir_lock);
+        KernelFree(vol);
+    }
+    if (vd) KernelFree(vd);
+    if (pvd) KernelFree(pvd);
+    if (svd) KernelFree(svd);
+    return -1;
 }
 
-// This is a simplified version that just prints the directory contents.
-// A more complete implementation would return a list of entries.
-static Iso9660DirEntry** Iso9660ListDir(const char* path) {
-    uint8_t* sector_buffer = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
-    if (!sector_buffer) return NULL;
+int Iso9660Unmount(struct BlockDevice* device) {
+    if (!device) return -1;
+    int id = device->id;
+    if (id < 0 || id >= MAX_BLOCK_DEVICES) return -1;
 
-    Iso9660Pvd* pvd = NULL;
-    for (uint32_t lba = 16; lba < 32; lba++) {
-        if (ReadSector(lba, sector_buffer) != 0) {
-            KernelFree(sector_buffer);
-            return NULL;
-        }
-        if (FastMemcmp(((Iso9660Pvd*)sector_buffer)->id, "CD001", 5) == 0 && ((Iso9660Pvd*)sector_buffer)->type == 1) {
-            pvd = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
-            if (!pvd) {
-                KernelFree(sector_buffer);
-                return NULL;
-            }
-            FastMemcpy(pvd, sector_buffer, ISO9660_SECTOR_SIZE);
-            break;
-        }
-    }
-    KernelFree(sector_buffer);
-    if (!pvd) return NULL;
+    Iso9660Volume* vol = g_iso9660_by_dev[id];
+    if (!vol) return -1; // Not mounted
 
-    Iso9660DirEntry* root_entry = (Iso9660DirEntry*)pvd->root_directory_record;
-    char* path_copy = KernelMemoryAlloc(FastStrlen(path, 256) + 1);
-    if (!path_copy) {
-        KernelFree(pvd);
-        return NULL;
+    for (int i = 0; i < ISO9660_DIR_CACHE_ENTRIES; i++) {
+        if (vol->dir_cache[i]) Iso9660FreeDir(vol->dir_cache[i]);
     }
-    FastStrCopy(path_copy, path, 256);
-
-    char* current_part = path_copy;
-    Iso9660DirEntry* current_entry = root_entry;
-    uint32_t current_lba = root_entry->extent_loc_le;
-    uint32_t current_size = root_entry->data_length_le;
+    if (vol->dir_lock) rust_spinlock_free(vol->dir_lock);
+    if (vol->path_table) KernelFree(vol->path_table);
+    if (vol->path_names.data) KernelFree(vol->path_names.data);
 
-    if (FastStrCmp(path, "/") != 0) {
-        while (*current_part) {
-            if (*current_part == '/') {
-                current_part++;
-                continue;
-            }
-
-            char* next_slash = FastStrChr(current_part, '/');
-            if (next_slash) {
-                *next_slash = 0;
-            }
+    KernelFree(vol);
+    g_iso9660_by_dev[id] = NULL;
+    return 0;
+}
 
-            Iso9660DirEntry* found_entry = FindFileInDir(current_lba, current_size, current_part);
-            if (current_entry != root_entry) {
-                KernelFree(current_entry);
-            }
-            current_entry = found_entry;
+void* Iso9660Open(void* fs_data, const char* path, int flags) {
+    Iso9660Volume* vol = fs_data;
+    if (!vol || !path || (flags & FS_WRITE)) return NULL; // read-only medium
 
-            if (!current_entry) {
-                KernelFree(path_copy);
-                KernelFree(pvd);
-                return NULL; // Path not found
-            }
+    Iso9660Node node;
+    if (Iso9660Lookup(vol, path, &node) != 0 || (node.flags & ISO9660_FLAG_DIRECTORY)) return NULL;
 
-            current_lba = current_entry->extent_loc_le;
-            current_size = current_entry->data_length_le;
+    Iso9660File* file = KernelMemoryAlloc(sizeof(Iso9660File));
+    if (!file) return NULL;
+    file->vol = vol;
+    file->extent = node.extent;
+    file->size = node.size;
+    return file;
+}
 
-            if (next_slash) {
-                current_part = next_slash + 1;
-            } else {
-                break;
-            }
-        }
-    }
+// Extents are contiguous, so any range is a single device read
+int64_t Iso9660ReadAt(void* handle, uint64_t offset, void* buffer, uint64_t count) {
+    Iso9660File* file = handle;
+    if (!file || !buffer) return -1;
+    Iso9660Volume* vol = file->vol;
+    if (offset >= file->size) return 0;
+    if (count > file->size - offset) count = file->size - offset;
+
+    const uint64_t pos = (uint64_t)file->extent * volume.block_size + offset;
+    if (Iso9660ReadBytes(volume.device, pos, buffer, count) != 0) return -1;
+    return (int64_t)count;
+}
 
-    KernelFree(path_copy);
+uint64_t Iso9660FileSize(void* handle) {
+    Iso9660File* file = handle;
+    return file ? file->size : 0;
+}
 
-    if (!current_entry) {
-        KernelFree(pvd);
-        return NULL;
-    }
+void Iso9660Close(void* handle) {
+    if (handle) KernelFree(handle);
+}
 
-    uint32_t dir_lba = current_entry->extent_loc_le;
-    uint32_t dir_size = current_entry->data_length_le;
-    if (current_entry != root_entry) {
-        KernelFree(current_entry);
-    }
+int64_t Iso9660ReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size) {
+    if (!path || !buffer) return -1;
+    void* file = Iso9660Open(fs_data, path, 0);
+    if (!file) return -1;
+    const int64_t bytes_read = max_size ? Iso9660ReadAt(file, 0, buffer, max_size) : 0;
+    Iso9660Close(file);
+    return bytes_read;
+}
 
-    Iso9660DirEntry** entries = KernelMemoryAlloc(sizeof(Iso9660DirEntry*) * 65);
-    if (!entries) {
-        KernelFree(pvd);
-        return NULL;
-    }
-    for (int i = 0; i < 65; i++) entries[i] = NULL;
+int Iso9660ListDir(void* fs_data, const char* path) {
+    Iso9660Volume* vol = fs_data;
+    if (!vol || !path) return -1;
 
-    uint8_t* dir_sector = KernelMemoryAlloc(ISO9660_SECTOR_SIZE);
-    if (!dir_sector) {
-        KernelFree(pvd);
-        KernelFree(entries);
-        return NULL;
+    Iso9660Node node;
+    if (Iso9660Lookup(vol, path, &node) != 0 || !(node.flags & ISO9660_FLAG_DIRECTORY)) return -1;
+    Iso9660Dir* dir = Iso9660GetDir(vol, node.extent);
+    if (!dir) return -1;
+    for (uint32_t i = 0; i < dir->count; i++) {
+        const Iso9660Dirent* e = &dir->entries[i];
+        PrintKernelF("  %s%s\n", dir->names.data + e->name_offset,
+                     (e->node.flags & ISO9660_FLAG_DIRECTORY) ? "/" : "");
     }
+    Iso9660PutDir(vol, dir);
+    return 0;
+}
 
-    uint32_t bytes_read = 0;
-    int entry_count = 0;
-    while (bytes_read < dir_size && entry_count < 64) {
-        if (ReadSector(dir_lba + (bytes_read / ISO9660_SECTOR_SIZE), dir_sector) != 0) {
-            break;
-        }
+int Iso9660IsFile(void* fs_data, const char* path) {
+    Iso9660Node node;
+    if (!fs_data || !path || Iso9660Lookup(fs_data, path, &node) != 0) return 0;
+    return !(node.flags & ISO9660_FLAG_DIRECTORY);
+}
 
-        Iso9660DirEntry* entry = (Iso9660DirEntry*)dir_sector;
-        uint32_t sector_offset = 0;
-        while (sector_offset < ISO9660_SECTOR_SIZE) {
-            if (entry->length == 0) {
-                break;
-            }
-            // Skip . and .. entries
-            if (entry->file_id_length == 1 && (entry->file_id[0] == 0 || entry->file_id[0] == 1)) {
-                sector_offset += entry->length;
-                entry = (Iso9660DirEntry*)((uint8_t*)entry + entry->length);
-                continue;
-            }
+int Iso9660IsDir(void* fs_data, const char* path) {
+    Iso9660Node node;
+    if (!fs_data || !path || Iso9660Lookup(fs_data, path, &node) != 0) return 0;
+    return (node.flags & ISO9660_FLAG_DIRECTORY) != 0;
+}
 
-            Iso9660DirEntry* new_entry = KernelMemoryAlloc(entry->length);
-            if (new_entry) {
-                FastMemcpy(new_entry, entry, entry->length);
-                entries[entry_count++] = new_entry;
-            }
-            sector_offset += entry->length;
-            entry = (Iso9660DirEntry*)((uint8_t*)entry + entry->length);
-        }
-        bytes_read += ISO9660_SECTOR_SIZE;
-    }
+uint64_t Iso9660GetFileSize(void* fs_data, const char* path) {
+    Iso9660Node node;
+    if (!fs_data || !path || Iso9660Lookup(fs_data, path, &node) != 0) return 0;
+    return (node.flags & ISO9660_FLAG_DIRECTORY) ? 0 : node.size;
+}
 
-    KernelFree(dir_sector);
-    KernelFree(pvd);
-    return entries;
+FileSystemDriver g_iso9660_driver = {
+    .name = "ISO9660",
+    .detect = Iso9660Detect,
+    .mount = Iso9660Mount,
+    .unmount = Iso9660Unmount,
+    .read_file = Iso9660ReadFile,
+    .list_dir = Iso9660ListDir,
+    .is_dir = Iso9660IsDir,
+    .is_file = Iso9660IsFile,
+    .get_size = Iso9660GetFileSize,
+    .open = Iso9660Open,
+    .read_at = Iso9660ReadAt,
+    .file_size = Iso9660FileSize,
+    .close = Iso9660Close,
+};
+
+static Iso9660Volume* Iso9660FirstVolume(void) {
+    for (int i = 0; i < MAX_BLOCK_DEVICES; i++) {
+        if (g_iso9660_by_dev[i]) return g_iso9660_by_dev[i];
+    }
+    PrintKernelError("[ISO] No ISO9660 volume mounted\n");
+    return NULL;
 }
 
+int Iso9660Read(const char* path, void* buffer, uint32_t max_size) {
+    Iso9660Volume* vol = Iso9660FirstVolume();
+    if (!vol || !path) return -1;
 
+    // Stat-only mode
+    if (buffer == NULL || max_size == 0) {
+        Iso9660Node node;
+        if (Iso9660Lookup(vol, path, &node) != 0 || (node.flags & ISO9660_FLAG_DIRECTORY)) return -1;
+        return node.size > INT32_MAX ? -1 : (int)node.size;
+    }
+    return Iso9660ReadFile(vol, path, buffer, max_size);
+}
 
 int Iso9660CopyFile(const char* iso_path, const char* vfs_path) {
     int file_size = Iso9660Read(iso_path, NULL, 0);
@@ -471,22 +876,20 @@ int Iso9660CopyFile(const char* iso_path, const char* vfs_path) {
 }
 
 int Iso9660Copy(const char* iso_path, const char* vfs_path) {
-    Iso9660DirEntry** entries = Iso9660ListDir(iso_path);
-    if (!entries) {
-        // If listing directory fails, it might be a file.
-        return Iso9660CopyFile(iso_path, vfs_path);
-    }
-    VfsCreateDir(vfs_path);
+    Iso9660Volume* vol = Iso9660FirstVolume();
+    if (!vol || !iso_path) return -1;
 
-    for (int i = 0; entries[i] != NULL; i++) {
-        char filename[256];
-        FastMemcpy(filename, entries[i]->file_id, entries[i]->file_id_length);
-        filename[entries[i]->file_id_length] = 0;
+    Iso9660Node node;
+    if (Iso9660Lookup(vol, iso_path, &node) != 0) return -1;
+    if (!(node.flags & ISO9660_FLAG_DIRECTORY)) return Iso9660CopyFile(iso_path, vfs_path);
 
-        char* semicolon = FastStrChr(filename, ';');
-        if (semicolon) {
-            *semicolon = 0;
-        }
+    Iso9660Dir* dir = Iso9660GetDir(vol, node.extent);
+    if (!dir) return -1;
+    VfsCreateDir(vfs_path);
+
+    for (uint32_t i = 0; i < dir->count; i++) {
+        const Iso9660Dirent* e = &dir->entries[i];
+        const char* filename = dir->names.data + e->name_offset;
 
         char vfs_filepath[256];
         char iso_filepath[256];
@@ -494,14 +897,13 @@ int Iso9660Copy(const char* iso_path, const char* vfs_path) {
         snprintf(vfs_filepath, sizeof(vfs_filepath), "%s/%s", vfs_path, filename);
         snprintf(iso_filepath, sizeof(iso_filepath), "%s/%s", iso_path, filename);
 
-        if (entries[i]->file_flags & 2) { // Directory
+        if (e->node.flags & ISO9660_FLAG_DIRECTORY) { // Directory
             Iso9660Copy(iso_filepath, vfs_filepath);
         } else { // File
             Iso9660CopyFile(iso_filepath, vfs_filepath);
         }
-        KernelFree(entries[i]);
     }
 
-    KernelFree(entries);
+    Iso9660PutDir(vol, dir);
     return 0;
-}
\ No newline at end of file
+}
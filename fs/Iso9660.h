@@ -1,8 +1,25 @@
 #pragma once
 
+#include <BlockDevice.h>
+#include <FileSystem.h>
 #include <stdint.h>
 
-// ISO9660 Primary Volume Descriptor
+#define ISO9660_SECTOR_SIZE         2048
+#define ISO9660_VD_START            16      // first volume descriptor sector
+
+// Volume descriptor types
+#define ISO9660_VD_PRIMARY          1
+#define ISO9660_VD_SUPPLEMENTARY    2
+#define ISO9660_VD_TERMINATOR       255
+
+// Directory record file_flags
+#define ISO9660_FLAG_HIDDEN         0x01
+#define ISO9660_FLAG_DIRECTORY      0x02
+#define ISO9660_FLAG_ASSOCIATED     0x04
+#define ISO9660_FLAG_MULTI_EXTENT   0x80    // more records follow for this file
+
+// ISO9660 Primary Volume Descriptor. Supplementary descriptors (Joliet)
+// share the layout and keep their escape sequences in escape_sequences.
 typedef struct __attribute__((packed)) {
     uint8_t type;
     char id[5];
@@ -13,7 +30,7 @@ typedef struct __attribute__((packed)) {
     uint8_t unused2[8];
     uint32_t volume_space_size_le;
     uint32_t volume_space_size_be;
-    uint8_t unused3[32];
+    uint8_t escape_sequences[32];
     uint16_t volume_set_size_le;
     uint16_t volume_set_size_be;
     uint16_t volume_sequence_number_le;
@@ -71,6 +88,34 @@ typedef struct __attribute__((packed)) {
     char dir_id[];
 } Iso9660PathTableRecord;
 
+// System Use Sharing Protocol entry (Rock Ridge lives in these)
+typedef struct __attribute__((packed)) {
+    char signature[2];
+    uint8_t length;
+    uint8_t version;
+    uint8_t data[];
+} Iso9660SuspEntry;
+
+// Per-mount volume state, passed to every operation as fs_data
+typedef struct Iso9660Volume Iso9660Volume;
+
+extern FileSystemDriver g_iso9660_driver;
+
+// VFS Interface Functions (read-only)
+int Iso9660Detect(struct BlockDevice* device);
+int Iso9660Mount(struct BlockDevice* device, const char* mount_point);
+int Iso9660Unmount(struct BlockDevice* device);
+int64_t Iso9660ReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size);
+int Iso9660ListDir(void* fs_data, const char* path);
+int Iso9660IsFile(void* fs_data, const char* path);
+int Iso9660IsDir(void* fs_data, const char* path);
+uint64_t Iso9660GetFileSize(void* fs_data, const char* path);
+void* Iso9660Open(void* fs_data, const char* path, int flags);
+int64_t Iso9660ReadAt(void* handle, uint64_t offset, void* buffer, uint64_t count);
+uint64_t Iso9660FileSize(void* handle);
+void Iso9660Close(void* handle);
+
+// Legacy helpers on the first mounted ISO9660 volume, paths are inside the image
 int Iso9660Read(const char* path, void* buffer, uint32_t max_size);
 int Iso9660Copy(const char* iso_path, const char* vfs_path);
 int Iso9660CopyFile(const char* iso_path, const char* vfs_path);
\ No newline at end of file
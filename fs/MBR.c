@@ -8,14 +8,22 @@ static int PartitionReadBlocks(BlockDevice* device, uint64_t start_lba, uint32_t
     if (!device || !device->parent) {
         return -1;
     }
-    return device->parent->read_blocks(device->parent, device->lba_offset + start_lba, count, buffer);
+    // Through the parent queue so whole-disk scheduling and stats see it
+    return BlockDeviceRead(device->parent->id, device->lba_offset + start_lba, count, buffer);
 }
 
 static int PartitionWriteBlocks(BlockDevice* device, uint64_t start_lba, uint32_t count, const void* buffer) {
     if (!device || !device->parent) {
         return -1;
     }
-    return device->parent->write_blocks(device->parent, device->lba_offset + start_lba, count, buffer);
+    return BlockDeviceWrite(device->parent->id, device->lba_offset + start_lba, count, buffer);
+}
+
+static int PartitionDiscardBlocks(BlockDevice* device, uint64_t start_lba, uint64_t count) {
+    if (!device || !device->parent) {
+        return -1;
+    }
+    return BlockDeviceDiscard(device->parent->id, device->lba_offset + start_lba, count);
 }
 
 void ParseMBR(BlockDevice* device) {
@@ -91,6 +99,7 @@ void ParseMBR(BlockDevice* device) {
             if (part_dev) {
                 part_dev->parent = device;
                 part_dev->lba_offset = p->lba_start;
+                if (device->discard_blocks) part_dev->discard_blocks = PartitionDiscardBlocks;
                 PrintKernel("MBR: Partition ");
                 PrintKernel(part_name);
                 PrintKernel(" registered successfully\n");
@@ -1,40 +1,113 @@
 #include <NTFS.h>
 #include <BlockDevice.h>
+#include <BlockCache.h>
+#include <DCache.h>
 #include <Console.h>
 #include <FileSystem.h>
 #include <KernelHeap.h>
 #include <MemOps.h>
+#include <VFRFS.h>
 #include <VFS.h>
 #include <SpinlockRust.h>
 #include <Scheduler.h>
 #include <Rtc.h>
 
+#define NTFS_LCN_HOLE               (-1)    // run without clusters (sparse)
+#define NTFS_RUNMAP_CACHE_ENTRIES   16
+#define NTFS_ATTR_LIST_MAX          (256 * 1024)
+#define NTFS_RESIDENT_ATTR_MIN      24      // common header + resident fields
+#define NTFS_FIXUP_STRIDE           512
+#define NTFS_UPCASE_ENTRIES         65536
+#define NTFS_DIR_INDEX_NAME         "$I30"
+#define NTFS_INDEX_CACHE_ENTRIES    32
+#define NTFS_INDEX_BLOCK_MAX        65536
+#define NTFS_INDEX_MAX_DEPTH        16
+#define NTFS_RECORD_CACHE_ENTRIES   64
+#define NTFS_RECORD_MAX             65536
+#define NTFS_FILE_SIGNATURE         0x454C4946  // "FILE"
+
+// One extent of a non-resident attribute: VCNs [vcn, vcn + length) live at
+// clusters [lcn, lcn + length), or nowhere for a sparse run
 typedef struct {
+    uint64_t vcn;
+    int64_t lcn;
+    uint64_t length;
+} NtfsRun;
+
+// Complete extent map of a non-resident attribute, decoded from all of its
+// mapping pairs including pieces held in extension records
+typedef struct {
+    NtfsRun* runs;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t last;          // run of the previous lookup
+    uint64_t data_size;
+    uint64_t init_size;     // bytes past this read as zeroes
+} NtfsRunMap;
+
+typedef struct {
+    uint64_t record_num;
+    uint32_t type;          // 0: free slot
+    uint64_t last_use;
+    NtfsRunMap map;
+} NtfsRunMapCacheEntry;
+
+// Index block of a directory's $I30 B+tree, fixups applied
+typedef struct {
+    uint64_t dir;
+    uint64_t vcn;
+    uint32_t size;
+    uint64_t last_use;
+    uint8_t* data;          // NULL: free slot
+} NtfsIndexCacheEntry;
+
+// Decoded MFT record, fixups applied
+typedef struct {
+    uint64_t record_num;
+    uint64_t last_use;
+    NtfsMftRecord* data;    // NULL: free slot
+} NtfsRecordCacheEntry;
+
+typedef struct NtfsVolume {
     struct BlockDevice* device;
     NtfsBootSector boot_sector;
     uint32_t bytes_per_sector;
     uint32_t sectors_per_cluster;
     uint32_t bytes_per_cluster;
     uint64_t mft_cluster;
+    NtfsRunMap mft_map;     // $MFT::$DATA; empty: contiguous from mft_cluster
     RustRwLock* lock;
+    NtfsRecordCacheEntry record_cache[NTFS_RECORD_CACHE_ENTRIES];
+    uint64_t record_clock;
+    RustSpinLock* record_lock;
+    // Extent maps by (record, attribute type), LRU replaced
+    NtfsRunMapCacheEntry runmap_cache[NTFS_RUNMAP_CACHE_ENTRIES];
+    uint64_t runmap_clock;
+    RustSpinLock* runmap_lock;
+    uint16_t* upcase;       // $UpCase; NULL folds ASCII only
+    uint32_t upcase_len;
+    NtfsIndexCacheEntry index_cache[NTFS_INDEX_CACHE_ENTRIES];
+    uint64_t index_clock;
+    RustSpinLock* index_lock;
+    struct NtfsFile* open_files; // one per open record, under lock
+    uint32_t unindexed;     // entries created here; not in their parent's index
 } NtfsVolume;
 
 static NtfsVolume* g_ntfs_by_dev[MAX_BLOCK_DEVICES] = {0};
-static NtfsVolume* g_ntfs_active = NULL;
-#define volume (*g_ntfs_active)
+#define volume (*vol)
 
-void NtfsSetActive(BlockDevice* device) {
-    if (!device) { g_ntfs_active = NULL; return; }
-    int id = device->id;
-    if (id < 0 || id >= MAX_BLOCK_DEVICES) { g_ntfs_active = NULL; return; }
-    g_ntfs_active = g_ntfs_by_dev[id];
-}
+static uint32_t NtfsRecordSize(NtfsVolume* vol);
+static int NtfsLoadMftMap(NtfsVolume* vol);
+static int NtfsLoadUpcase(NtfsVolume* vol);
+static void NtfsOpenUpdate(NtfsVolume* vol, uint64_t record_num, const void* data, uint32_t length);
+static void NtfsOpenUnlink(NtfsVolume* vol, uint64_t record_num);
 
 int NtfsDetect(struct BlockDevice* device) {
     if (!device || !device->read_blocks) return 0;
+    if (device->block_size != 512) return 0; // boot sector is read as one block
     
     NtfsBootSector boot;
-    if (device->read_blocks(device, 0, 1, &boot) != 0) return 0;
+    if (BlockCacheRead(device->id, 0, 1, &boot) != 0) return 0;
     
     // Check NTFS signature
     if (boot.signature != 0xAA55) return 0;
@@ -43,8 +116,6 @@ int NtfsDetect(struct BlockDevice* device) {
     return 1;
 }
 
-static FileSystemDriver ntfs_driver = {"NTFS", NtfsDetect, NtfsMount, NtfsUnmount};
-
 int NtfsMount(struct BlockDevice* device, const char* mount_point) {
     if (!device || !device->read_blocks) return -1;
     if (device->id < 0 || device->id >= MAX_BLOCK_DEVICES) return -1;
@@ -55,17 +126,28 @@ int NtfsMount(struct BlockDevice* device, const char* mount_point) {
         FastMemset(vol, 0, sizeof(NtfsVolume));
         g_ntfs_by_dev[device->id] = vol;
     }
-    g_ntfs_active = vol;
 
     if (!volume.lock) volume.lock = rust_rwlock_new();
     if (!volume.lock) {
         PrintKernel("NTFS: Failed to allocate lock\n");
         return -1;
     }
+    if (!volume.runmap_lock) volume.runmap_lock = rust_spinlock_new();
+    if (!volume.runmap_lock) {
+        PrintKernelWarning("NTFS: Failed to allocate run map lock, extent maps are not cached\n");
+    }
+    if (!volume.record_lock) volume.record_lock = rust_spinlock_new();
+    if (!volume.record_lock) {
+        PrintKernelWarning("NTFS: Failed to allocate record cache lock, MFT records are not cached\n");
+    }
+    if (!volume.index_lock) volume.index_lock = rust_spinlock_new();
+    if (!volume.index_lock) {
+        PrintKernelWarning("NTFS: Failed to allocate index lock, index blocks are not cached\n");
+    }
     
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
     
-    if (device->read_blocks(device, 0, 1, &volume.boot_sector) != 0) {
+    if (BlockCacheRead(device->id, 0, 1, &volume.boot_sector) != 0) {
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
@@ -117,8 +199,21 @@ int NtfsMount(struct BlockDevice* device, const char* mount_point) {
         return -1;
     }
 
+    const uint32_t record_size = NtfsRecordSize(vol);
+    if (record_size < NTFS_FIXUP_STRIDE || record_size > NTFS_RECORD_MAX || (record_size & (record_size - 1))) {
+        PrintKernel("NTFS: Invalid MFT record size\n");
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
+    if (volume.mft_map.count == 0 && NtfsLoadMftMap(vol) != 0) {
+        PrintKernelWarning("NTFS: Failed to map $MFT, assuming it is contiguous\n");
+    }
+    if (!volume.upcase && NtfsLoadUpcase(vol) != 0) {
+        PrintKernelWarning("NTFS: Failed to load $UpCase, folding ASCII names only\n");
+    }
+
     VfsCreateDir(mount_point);
-    if (VfsMount(mount_point, device, &ntfs_driver) != 0) {
+    if (VfsMount(mount_point, device, &g_ntfs_driver, vol) != 0) {
         PrintKernel("NTFS: Failed to register mount point ");
         PrintKernel(mount_point);
         PrintKernel("\n");
@@ -156,86 +251,807 @@ int NtfsUnmount(BlockDevice* device) {
     NtfsVolume* vol = g_ntfs_by_dev[id];
     if (!vol) return -1; // Not mounted
 
-    if (g_ntfs_active == vol) {
-        g_ntfs_active = NULL;
-    }
-
     if (vol->lock) {
         rust_rwlock_free(vol->lock);
     }
+    for (int i = 0; i < NTFS_RUNMAP_CACHE_ENTRIES; i++) {
+        if (vol->runmap_cache[i].map.runs) KernelFree(vol->runmap_cache[i].map.runs);
+    }
+    if (vol->runmap_lock) rust_spinlock_free(vol->runmap_lock);
+    for (int i = 0; i < NTFS_INDEX_CACHE_ENTRIES; i++) {
+        if (vol->index_cache[i].data) KernelFree(vol->index_cache[i].data);
+    }
+    if (vol->index_lock) rust_spinlock_free(vol->index_lock);
+    if (vol->upcase) KernelFree(vol->upcase);
+    for (int i = 0; i < NTFS_RECORD_CACHE_ENTRIES; i++) {
+        if (vol->record_cache[i].data) KernelFree(vol->record_cache[i].data);
+    }
+    if (vol->record_lock) rust_spinlock_free(vol->record_lock);
+    if (vol->mft_map.runs) KernelFree(vol->mft_map.runs);
 
+    DCachePurge(vol);
     KernelFree(vol);
     g_ntfs_by_dev[id] = NULL;
 
     return 0;
 }
 
-int NtfsReadMftRecord(uint64_t record_num, NtfsMftRecord* record) {
+static uint32_t NtfsRecordSize(NtfsVolume* vol) {
+    if (volume.boot_sector.clusters_per_file_record > 0) {
+        return volume.boot_sector.clusters_per_file_record * volume.bytes_per_cluster;
+    }
+    return 1 << (-(int8_t)volume.boot_sector.clusters_per_file_record);
+}
+
+// Compares a UTF-16 attribute name with an ASCII one; NULL means unnamed
+static int NtfsNameIs(const uint16_t* name16, uint8_t len16, const char* name) {
+    if (!name) return len16 == 0;
+    for (uint8_t i = 0; i < len16; i++) {
+        if (name[i] == '\0' || name16[i] != (uint8_t)name[i]) return 0;
+    }
+    return name[len16] == '\0';
+}
+
+// Returns the attribute of the given type and name (NULL: unnamed) whose
+// mapping starts at lowest_vcn (resident attributes only match 0), or NULL
+static NtfsAttrHeader* NtfsFindAttr(NtfsMftRecord* record, uint32_t record_size, uint32_t type, const char* name,
+                                    uint64_t lowest_vcn) {
+    if (record->bytes_in_use > record_size) return NULL;
+    uint8_t* attr_ptr = (uint8_t*)record + record->attrs_offset;
+    uint8_t* record_end = (uint8_t*)record + record_size;
+
+    while (attr_ptr + sizeof(NtfsAttrHeader) <= record_end &&
+           attr_ptr < (uint8_t*)record + record->bytes_in_use) {
+        NtfsAttrHeader* attr = (NtfsAttrHeader*)attr_ptr;
+        // Resident attributes may be shorter than the non-resident header
+        if (attr->length < (attr->non_resident ? sizeof(NtfsAttrHeader) : NTFS_RESIDENT_ATTR_MIN)) break;
+        if (attr_ptr + attr->length > record_end) break;
+        if (attr->type == type && attr->name_offset + attr->name_length * 2u <= attr->length &&
+            NtfsNameIs((const uint16_t*)(attr_ptr + attr->name_offset), attr->name_length, name)) {
+            const uint64_t start = attr->non_resident ? attr->nonresident.lowest_vcn : 0;
+            if (start == lowest_vcn) return attr;
+        }
+        attr_ptr += attr->length;
+    }
+    return NULL;
+}
+
+static void NtfsRunMapFree(NtfsRunMap* map) {
+    if (map->runs) KernelFree(map->runs);
+    FastMemset(map, 0, sizeof(NtfsRunMap));
+}
+
+// Appends clusters [vcn, vcn + length) to the map, merging with the last run
+// when both are holes or physically contiguous. VCNs must arrive in order.
+static int NtfsRunMapAppend(NtfsRunMap* map, uint64_t vcn, int64_t lcn, uint64_t length) {
+    if (map->count > 0) {
+        NtfsRun* last = &map->runs[map->count - 1];
+        if (vcn != last->vcn + last->length) return -1;
+        if ((lcn == NTFS_LCN_HOLE && last->lcn == NTFS_LCN_HOLE) ||
+            (lcn != NTFS_LCN_HOLE && last->lcn != NTFS_LCN_HOLE && (uint64_t)last->lcn + last->length == (uint64_t)lcn)) {
+            last->length += length;
+            return 0;
+        }
+    } else if (vcn != 0) {
+        return -1;
+    }
+
+    if (map->count == map->capacity) {
+        const uint32_t capacity = map->capacity ? map->capacity * 2 : 8;
+        NtfsRun* runs = KernelMemoryAlloc((size_t)capacity * sizeof(NtfsRun));
+        if (!runs) return -1;
+        if (map->runs) {
+            FastMemcpy(runs, map->runs, (size_t)map->count * sizeof(NtfsRun));
+            KernelFree(map->runs);
+        }
+        map->runs = runs;
+        map->capacity = capacity;
+    }
+    map->runs[map->count].vcn = vcn;
+    map->runs[map->count].lcn = lcn;
+    map->runs[map->count].length = length;
+    map->count++;
+    return 0;
+}
+
+// Decodes every mapping pair of one non-resident attribute piece into the map.
+// A pair with no offset field is a sparse run; offsets are signed deltas from
+// the previous run's LCN.
+static int NtfsDecodeMappingPairs(NtfsVolume* vol, const NtfsAttrHeader* attr, NtfsRunMap* map) {
+    if (!attr->non_resident) return -1;
+    if (attr->flags & (NTFS_ATTR_FLAG_COMPRESSED | NTFS_ATTR_FLAG_ENCRYPTED)) return -1;
+    const uint16_t mpoff = attr->nonresident.mapping_pairs_offset;
+    if (mpoff < 0x40 || mpoff >= attr->length) return -1;
+
+    const uint8_t* mp = (const uint8_t*)attr + mpoff;
+    const uint8_t* end = (const uint8_t*)attr + attr->length;
+    const uint64_t total_clusters = volume.boot_sector.total_sectors / volume.sectors_per_cluster;
+    uint64_t vcn = attr->nonresident.lowest_vcn;
+    int64_t lcn = 0;
+
+    while (mp < end && *mp != 0) {
+        const uint8_t len_len = *mp & 0x0F;
+        const uint8_t off_len = (*mp >> 4) & 0x0F;
+        mp++;
+        if (len_len == 0 || len_len > 8 || off_len > 8) return -1;
+        if (mp + len_len + off_len > end) return -1;
+
+        uint64_t length = 0;
+        for (uint8_t i = 0; i < len_len; i++) length |= (uint64_t)mp[i] << (8 * i);
+        mp += len_len;
+        if (length == 0 || (int64_t)length < 0) return -1;
+
+        if (off_len == 0) {
+            if (NtfsRunMapAppend(map, vcn, NTFS_LCN_HOLE, length) != 0) return -1;
+        } else {
+            uint64_t delta = 0;
+            for (uint8_t i = 0; i < off_len; i++) delta |= (uint64_t)mp[i] << (8 * i);
+            if (off_len < 8 && (mp[off_len - 1] & 0x80)) delta |= ~0ULL << (off_len * 8);
+            mp += off_len;
+            lcn += (int64_t)delta;
+            if (lcn < 0 || (uint64_t)lcn >= total_clusters || length > total_clusters - (uint64_t)lcn) return -1;
+            if (NtfsRunMapAppend(map, vcn, lcn, length) != 0) return -1;
+        }
+        vcn += length;
+    }
+    return 0;
+}
+
+// Index of the run containing vcn, or -1. Sequential access hits the hint.
+static int NtfsRunMapFind(NtfsRunMap* map, uint64_t vcn) {
+    const uint32_t hint = map->last;
+    for (uint32_t i = hint; i < map->count && i <= hint + 1; i++) {
+        if (vcn >= map->runs[i].vcn && vcn - map->runs[i].vcn < map->runs[i].length) {
+            map->last = i;
+            return (int)i;
+        }
+    }
+    uint32_t lo = 0, hi = map->count;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        const NtfsRun* run = &map->runs[mid];
+        if (vcn < run->vcn) hi = mid;
+        else if (vcn - run->vcn >= run->length) lo = mid + 1;
+        else {
+            map->last = mid;
+            return (int)mid;
+        }
+    }
+    return -1;
+}
+
+#define NTFS_IO_MAX_BYTES (1u << 30)
+
+// Transfers count bytes at offset through the map. Whole clusters move as
+// one request per extent, up to NTFS_IO_MAX_BYTES; sparse runs and bytes past the initialized size
+// read back as zeroes without touching the device. Writes stop at a hole or
+// at the initialized size, since nothing here allocates clusters.
+static int64_t NtfsRunMapIo(NtfsVolume* vol, NtfsRunMap* map, uint64_t offset, void* buffer, uint64_t count, int write) {
+    const uint32_t bpc = volume.bytes_per_cluster;
+    uint8_t* buf = (uint8_t*)buffer;
+    uint8_t* cluster_buffer = NULL;
+    uint64_t done = 0;
+
+    while (done < count) {
+        const uint64_t pos = offset + done;
+        uint32_t chunk = count - done > NTFS_IO_MAX_BYTES ? NTFS_IO_MAX_BYTES : (uint32_t)(count - done);
+
+        if (pos >= map->init_size) {
+            if (write) break;
+            FastMemset(buf + done, 0, chunk);
+            done += chunk;
+            break;
+        }
+        if (chunk > map->init_size - pos) chunk = (uint32_t)(map->init_size - pos);
+
+        const uint64_t vcn = pos / bpc;
+        const uint32_t in_cluster = (uint32_t)(pos % bpc);
+        const int idx = NtfsRunMapFind(map, vcn);
+        if (idx < 0) break;
+        const NtfsRun* run = &map->runs[idx];
+        const uint64_t run_left = (run->vcn + run->length - vcn) * bpc - in_cluster;
+        if (chunk > run_left) chunk = (uint32_t)run_left;
+
+        if (run->lcn == NTFS_LCN_HOLE) {
+            if (write) break;
+            FastMemset(buf + done, 0, chunk);
+            done += chunk;
+            continue;
+        }
+
+        const uint64_t lba = ((uint64_t)run->lcn + (vcn - run->vcn)) * volume.sectors_per_cluster;
+        if (in_cluster == 0 && chunk >= bpc) {
+            chunk -= chunk % bpc;
+            const uint32_t sectors = chunk / bpc * volume.sectors_per_cluster;
+            const int result = write ? BlockCacheWrite(volume.device->id, lba, sectors, buf + done)
+                                     : BlockCacheRead(volume.device->id, lba, sectors, buf + done);
+            if (result != 0) break;
+        } else {
+            if (chunk > bpc - in_cluster) chunk = bpc - in_cluster;
+            if (!cluster_buffer && !(cluster_buffer = KernelMemoryAlloc(bpc))) break;
+            if (BlockCacheRead(volume.device->id, lba, volume.sectors_per_cluster, cluster_buffer) != 0) break;
+            if (write) {
+                FastMemcpy(cluster_buffer + in_cluster, buf + done, chunk);
+                if (BlockCacheWrite(volume.device->id, lba, volume.sectors_per_cluster, cluster_buffer) != 0) break;
+            } else {
+                FastMemcpy(buf + done, cluster_buffer + in_cluster, chunk);
+            }
+        }
+        done += chunk;
+    }
+
+    if (cluster_buffer) KernelFree(cluster_buffer);
+    return (done == 0 && count > 0) ? -1 : (int64_t)done;
+}
+
+// Appends the piece of the attribute starting at lowest_vcn, which lives in
+// record ref, to the map. The first piece also carries the stream sizes.
+static int NtfsDecodePiece(NtfsVolume* vol, NtfsMftRecord* base, uint64_t base_num, uint64_t ref, uint32_t type,
+                           const char* name, uint64_t lowest_vcn, NtfsMftRecord* scratch, NtfsRunMap* map) {
+    const uint32_t record_size = NtfsRecordSize(vol);
+    NtfsMftRecord* record = base;
+    if (ref != base_num) {
+        if (NtfsReadMftRecord(vol, ref, scratch) != 0) return -1;
+        if (!(scratch->flags & 0x1) || (scratch->base_mft_record & NTFS_MFT_REF_MASK) != base_num) return -1;
+        record = scratch;
+    }
+    const NtfsAttrHeader* attr = NtfsFindAttr(record, record_size, type, name, lowest_vcn);
+    if (!attr || NtfsDecodeMappingPairs(vol, attr, map) != 0) return -1;
+    if (lowest_vcn == 0) {
+        map->data_size = attr->nonresident.data_size;
+        map->init_size = attr->nonresident.initialized_size;
+    }
+    return 0;
+}
+
+// Builds the complete extent map of a non-resident attribute,
+// following $ATTRIBUTE_LIST into extension records when the mapping pairs
+// did not fit in the base record.
+static int NtfsBuildRunMap(NtfsVolume* vol, NtfsMftRecord* base, uint64_t base_num, uint32_t type, const char* name,
+                           NtfsRunMap* map) {
+    const uint32_t record_size = NtfsRecordSize(vol);
+    FastMemset(map, 0, sizeof(NtfsRunMap));
+
+    NtfsAttrHeader* list_attr = NtfsFindAttr(base, record_size, NTFS_ATTR_ATTRIBUTE_LIST, NULL, 0);
+    if (!list_attr) {
+        const NtfsAttrHeader* attr = NtfsFindAttr(base, record_size, type, name, 0);
+        if (!attr || NtfsDecodeMappingPairs(vol, attr, map) != 0) {
+            NtfsRunMapFree(map);
+            return -1;
+        }
+        map->data_size = attr->nonresident.data_size;
+        map->init_size = attr->nonresident.initialized_size;
+    } else {
+        // The list itself is either resident or mapped from the base record
+        uint8_t* list = NULL;
+        uint32_t list_size;
+        if (!list_attr->non_resident) {
+            list_size = list_attr->resident.value_length;
+            if (list_attr->resident.value_offset + list_size > list_attr->length) return -1;
+            list = (uint8_t*)list_attr + list_attr->resident.value_offset;
+        } else {
+            NtfsRunMap list_map = {0};
+            if (NtfsDecodeMappingPairs(vol, list_attr, &list_map) != 0 ||
+                list_attr->nonresident.data_size > NTFS_ATTR_LIST_MAX) {
+                NtfsRunMapFree(&list_map);
+                return -1;
+            }
+            list_map.data_size = list_attr->nonresident.data_size;
+            list_map.init_size = list_attr->nonresident.initialized_size;
+            list_size = (uint32_t)list_map.data_size;
+            list = KernelMemoryAlloc(list_size ? list_size : 1);
+            int ok = list && NtfsRunMapIo(vol, &list_map, 0, list, list_size, 0) == (int64_t)list_size;
+            NtfsRunMapFree(&list_map);
+            if (!ok) {
+                if (list) KernelFree(list);
+                return -1;
+            }
+        }
+
+        NtfsMftRecord* scratch = KernelMemoryAlloc(record_size);
+        int ok = scratch != NULL;
+        uint32_t pos = 0;
+        while (ok && pos + sizeof(NtfsAttrListEntry) <= list_size) {
+            const NtfsAttrListEntry* entry = (const NtfsAttrListEntry*)(list + pos);
+            if (entry->length < sizeof(NtfsAttrListEntry) || pos + entry->length > list_size) break;
+            if (entry->type == type && entry->name_offset + entry->name_length * 2u <= entry->length &&
+                NtfsNameIs((const uint16_t*)(list + pos + entry->name_offset), entry->name_length, name)) {
+                ok = NtfsDecodePiece(vol, base, base_num, entry->mft_reference & NTFS_MFT_REF_MASK,
+                                     type, name, entry->lowest_vcn, scratch, map) == 0;
+            }
+            pos += entry->length;
+        }
+        if (scratch) KernelFree(scratch);
+        if (list_attr->non_resident) KernelFree(list);
+        if (!ok || map->count == 0) {
+            NtfsRunMapFree(map);
+            return -1;
+        }
+    }
+
+    if (map->init_size > map->data_size) map->init_size = map->data_size;
+    return 0;
+}
+
+// Copies the extent map of (record, type) into map, decoding it from the
+// base record only on a cache miss. A record has at most one mapped
+// attribute per type here (unnamed, or $I30 for indexes), so the name is
+// not part of the key. The caller frees map->runs.
+static int NtfsLoadRunMap(NtfsVolume* vol, NtfsMftRecord* base, uint64_t record_num, uint32_t type, const char* name,
+                          NtfsRunMap* map) {
+    FastMemset(map, 0, sizeof(NtfsRunMap));
+
+    if (volume.runmap_lock) {
+        rust_spinlock_lock(volume.runmap_lock);
+        for (int i = 0; i < NTFS_RUNMAP_CACHE_ENTRIES; i++) {
+            NtfsRunMapCacheEntry* e = &volume.runmap_cache[i];
+            if (e->type != type || e->record_num != record_num) continue;
+            const size_t bytes = (size_t)e->map.count * sizeof(NtfsRun);
+            map->runs = KernelMemoryAlloc(bytes ? bytes : sizeof(NtfsRun));
+            if (map->runs) {
+                FastMemcpy(map->runs, e->map.runs, bytes);
+                map->count = map->capacity = e->map.count;
+                map->data_size = e->map.data_size;
+                map->init_size = e->map.init_size;
+                e->last_use = ++volume.runmap_clock;
+            }
+            rust_spinlock_unlock(volume.runmap_lock);
+            return map->runs ? 0 : -1;
+        }
+        rust_spinlock_unlock(volume.runmap_lock);
+    }
+
+    if (NtfsBuildRunMap(vol, base, record_num, type, name, map) != 0) return -1;
+    if (!volume.runmap_lock) return 0;
+
+    NtfsRun* copy = KernelMemoryAlloc((size_t)map->count * sizeof(NtfsRun));
+    if (!copy) return 0;
+    FastMemcpy(copy, map->runs, (size_t)map->count * sizeof(NtfsRun));
+
+    rust_spinlock_lock(volume.runmap_lock);
+    NtfsRunMapCacheEntry* victim = &volume.runmap_cache[0];
+    for (int i = 0; i < NTFS_RUNMAP_CACHE_ENTRIES; i++) {
+        NtfsRunMapCacheEntry* e = &volume.runmap_cache[i];
+        if (e->type == type && e->record_num == record_num) {
+            victim = e; // raced with another loader
+            break;
+        }
+        if (e->type == 0) {
+            if (victim->type != 0) victim = e;
+        } else if (victim->type != 0 && e->last_use < victim->last_use) {
+            victim = e;
+        }
+    }
+    NtfsRun* old = victim->map.runs;
+    victim->record_num = record_num;
+    victim->type = type;
+    victim->last_use = ++volume.runmap_clock;
+    victim->map = *map;
+    victim->map.runs = copy;
+    victim->map.capacity = map->count;
+    victim->map.last = 0;
+    rust_spinlock_unlock(volume.runmap_lock);
+
+    if (old) KernelFree(old);
+    return 0;
+}
+
+// Drops cached extent maps of a record whose contents changed or was freed
+static void NtfsRunMapInvalidate(NtfsVolume* vol, uint64_t record_num) {
+    if (!volume.runmap_lock) return;
+    rust_spinlock_lock(volume.runmap_lock);
+    for (int i = 0; i < NTFS_RUNMAP_CACHE_ENTRIES; i++) {
+        NtfsRunMapCacheEntry* e = &volume.runmap_cache[i];
+        if (e->type == 0 || e->record_num != record_num) continue;
+        if (e->map.runs) KernelFree(e->map.runs);
+        FastMemset(e, 0, sizeof(NtfsRunMapCacheEntry));
+    }
+    rust_spinlock_unlock(volume.runmap_lock);
+}
+
+// Undoes the update sequence protection of a FILE or INDX record: the last
+// two bytes of every 512-byte stride must hold the sequence number and are
+// replaced by the originals saved in the array. Fails on a torn write.
+// Records without an update sequence array are accepted as they are.
+static int NtfsApplyFixups(void* buffer, uint32_t size) {
+    uint8_t* buf = (uint8_t*)buffer;
+    const NtfsMftRecord* header = (const NtfsMftRecord*)buffer;
+    const uint32_t usa_offset = header->update_seq_offset;
+    const uint32_t usa_count = header->update_seq_size;
+    if (usa_count == 0) return 0;
+    if (usa_count < 2 || (usa_count - 1) * NTFS_FIXUP_STRIDE > size) return -1;
+    if ((usa_offset & 1) || usa_offset + usa_count * 2 > NTFS_FIXUP_STRIDE - 2) return -1;
+
+    const uint16_t* usa = (const uint16_t*)(buf + usa_offset);
+    for (uint32_t i = 1; i < usa_count; i++) {
+        uint16_t* tail = (uint16_t*)(buf + i * NTFS_FIXUP_STRIDE - 2);
+        if (*tail != usa[0]) return -1;
+        *tail = usa[i];
+    }
+    return 0;
+}
+
+// Inverse of NtfsApplyFixups with the next sequence number, before a write
+static int NtfsProtectFixups(void* buffer, uint32_t size) {
+    uint8_t* buf = (uint8_t*)buffer;
+    const NtfsMftRecord* header = (const NtfsMftRecord*)buffer;
+    const uint32_t usa_offset = header->update_seq_offset;
+    const uint32_t usa_count = header->update_seq_size;
+    if (usa_count == 0) return 0;
+    if (usa_count < 2 || (usa_count - 1) * NTFS_FIXUP_STRIDE > size) return -1;
+    if ((usa_offset & 1) || usa_offset + usa_count * 2 > NTFS_FIXUP_STRIDE - 2) return -1;
+
+    uint16_t* usa = (uint16_t*)(buf + usa_offset);
+    uint16_t usn = (uint16_t)(usa[0] + 1);
+    if (usn == 0 || usn == 0xFFFF) usn = 1;
+    usa[0] = usn;
+    for (uint32_t i = 1; i < usa_count; i++) {
+        uint16_t* tail = (uint16_t*)(buf + i * NTFS_FIXUP_STRIDE - 2);
+        usa[i] = *tail;
+        *tail = usn;
+    }
+    return 0;
+}
+
+// Moves one raw record to or from disk: through the $MFT extent map once it
+// is known, from the boot sector's MFT cluster onwards before that
+static int NtfsMftIo(NtfsVolume* vol, uint64_t record_num, void* buffer, int write) {
+    const uint32_t record_size = NtfsRecordSize(vol);
+    if (volume.mft_map.count > 0) {
+        const uint64_t offset = record_num * record_size;
+        if (offset >= volume.mft_map.data_size) return -1;
+        return NtfsRunMapIo(vol, &volume.mft_map, offset, buffer, record_size, write) == (int64_t)record_size ? 0 : -1;
+    }
+    const uint64_t lba = volume.mft_cluster * volume.sectors_per_cluster + record_num * record_size / volume.bytes_per_sector;
+    const uint32_t sectors = (record_size + volume.bytes_per_sector - 1) / volume.bytes_per_sector;
+    return write ? BlockCacheWrite(volume.device->id, lba, sectors, buffer)
+                 : BlockCacheRead(volume.device->id, lba, sectors, buffer);
+}
+
+// Copies a cached record into record; returns 0 on a hit
+static int NtfsRecordCacheGet(NtfsVolume* vol, uint64_t record_num, NtfsMftRecord* record) {
+    if (!volume.record_lock) return -1;
+    int result = -1;
+    rust_spinlock_lock(volume.record_lock);
+    for (int i = 0; i < NTFS_RECORD_CACHE_ENTRIES; i++) {
+        NtfsRecordCacheEntry* e = &volume.record_cache[i];
+        if (!e->data || e->record_num != record_num) continue;
+        FastMemcpy(record, e->data, NtfsRecordSize(vol));
+        e->last_use = ++volume.record_clock;
+        result = 0;
+        break;
+    }
+    rust_spinlock_unlock(volume.record_lock);
+    return result;
+}
+
+// Stores a decoded record, taking ownership of data; replaces any older copy
+static void NtfsRecordCachePut(NtfsVolume* vol, uint64_t record_num, NtfsMftRecord* data) {
+    if (!volume.record_lock) {
+        KernelFree(data);
+        return;
+    }
+    rust_spinlock_lock(volume.record_lock);
+    NtfsRecordCacheEntry* victim = NULL;
+    for (int i = 0; i < NTFS_RECORD_CACHE_ENTRIES; i++) {
+        NtfsRecordCacheEntry* e = &volume.record_cache[i];
+        if (e->data && e->record_num == record_num) {
+            victim = e;
+            break;
+        }
+        if (!victim || (victim->data && (!e->data || e->last_use < victim->last_use))) victim = e;
+    }
+    NtfsMftRecord* old = victim->data;
+    victim->record_num = record_num;
+    victim->data = data;
+    victim->last_use = ++volume.record_clock;
+    rust_spinlock_unlock(volume.record_lock);
+
+    if (old) KernelFree(old);
+}
+
+// Reads a record with fixups applied. fill controls whether a miss is
+// inserted into the cache; sequential MFT scans pass 0 so they do not
+// evict the working set. The read and the fill happen under the volume
+// read lock: writers cache the records they write under the write lock,
+// so a copy read before a write can never be inserted after it.
+static int NtfsLoadMftRecord(NtfsVolume* vol, uint64_t record_num, NtfsMftRecord* record, int fill) {
     if (!volume.device || !record) return -1;
     if (!volume.lock) return -1;
+    if (NtfsRecordCacheGet(vol, record_num, record) == 0) return 0;
+
+    const uint32_t record_size = NtfsRecordSize(vol);
     rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
+    int result = NtfsMftIo(vol, record_num, record, 0);
 
-    // Calculate MFT record size from boot sector
-    uint32_t mft_record_size;
-    if (volume.boot_sector.clusters_per_file_record > 0) {
-        mft_record_size = volume.boot_sector.clusters_per_file_record * volume.bytes_per_cluster;
-    } else {
-        // Negative value means 2^(-clusters_per_file_record) bytes
-        mft_record_size = 1 << (-(int8_t)volume.boot_sector.clusters_per_file_record);
+    // Never-used records may be all zeroes; only FILE records carry fixups
+    if (result == 0 && record->signature == NTFS_FILE_SIGNATURE && NtfsApplyFixups(record, record_size) != 0) {
+        PrintKernelWarningF("NTFS: MFT record %llu failed its fixup check\n", (unsigned long long)record_num);
+        result = -1;
     }
 
-    // Calculate byte offset of the MFT record
-    uint64_t mft_start_sector = volume.mft_cluster * volume.sectors_per_cluster;
-    uint64_t record_byte_offset = record_num * mft_record_size;
-    uint64_t record_sector = mft_start_sector + (record_byte_offset / volume.bytes_per_sector);
-    
-    // Calculate how many sectors we need to read
-    uint32_t sectors_needed = (mft_record_size + volume.bytes_per_sector - 1) / volume.bytes_per_sector;
-    
-    int result = volume.device->read_blocks(volume.device, record_sector, sectors_needed, record);
+    if (result == 0 && fill) {
+        NtfsMftRecord* copy = KernelMemoryAlloc(record_size);
+        if (copy) {
+            FastMemcpy(copy, record, record_size);
+            NtfsRecordCachePut(vol, record_num, copy);
+        }
+    }
     rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
     return result;
 }
 
-// Minimal parser: extract only the first run from a non-resident attribute's mapping pairs
-// Supports a single contiguous run and returns its absolute LCN and length in clusters.
-static int NtfsParseFirstRun(const NtfsAttrHeader* attr, int64_t* out_lcn, uint64_t* out_clusters) {
-    if (!attr || !out_lcn || !out_clusters) return -1;
-    uint16_t mpoff = attr->nonresident.mapping_pairs_offset;
-    if (mpoff == 0) return -1;
-    const uint8_t* mp = (const uint8_t*)((const uint8_t*)attr + mpoff);
-    uint8_t hdr = *mp++;
-    if (hdr == 0) return -1;
-    uint8_t len_len = hdr & 0x0F;
-    uint8_t off_len = (hdr >> 4) & 0x0F;
-    if (len_len == 0 || len_len > 8 || off_len > 8) return -1;
-
-    uint64_t clusters = 0;
-    for (uint8_t i = 0; i < len_len; i++) {
-        clusters |= ((uint64_t)mp[i]) << (8 * i);
-    }
-    mp += len_len;
-
-    int64_t lcn_delta = 0;
-    if (off_len > 0) {
-        int64_t tmp = 0;
-        for (uint8_t i = 0; i < off_len; i++) {
-            tmp |= ((int64_t)mp[i]) << (8 * i);
+int NtfsReadMftRecord(NtfsVolume* vol, uint64_t record_num, NtfsMftRecord* record) {
+    return NtfsLoadMftRecord(vol, record_num, record, 1);
+}
+
+// Writes a record back with its update sequence re-applied and refreshes
+// the cached copy. Callers hold the volume write lock.
+static int NtfsWriteMftRecord(NtfsVolume* vol, uint64_t record_num, const NtfsMftRecord* record) {
+    const uint32_t record_size = NtfsRecordSize(vol);
+    NtfsMftRecord* disk = KernelMemoryAlloc(record_size);
+    if (!disk) return -1;
+    FastMemcpy(disk, record, record_size);
+
+    if (NtfsProtectFixups(disk, record_size) != 0 || NtfsMftIo(vol, record_num, disk, 1) != 0) {
+        KernelFree(disk);
+        return -1;
+    }
+    NtfsApplyFixups(disk, record_size);
+    NtfsRecordCachePut(vol, record_num, disk);
+    return 0;
+}
+
+// Sets up the update sequence array of a record built in memory and
+// returns the first attribute offset
+static uint16_t NtfsInitRecordHeader(NtfsVolume* vol, NtfsMftRecord* record, uint64_t record_num) {
+    const uint32_t record_size = NtfsRecordSize(vol);
+    record->signature = NTFS_FILE_SIGNATURE;
+    record->update_seq_offset = sizeof(NtfsMftRecord);
+    record->update_seq_size = (uint16_t)(record_size / NTFS_FIXUP_STRIDE + 1);
+    record->bytes_allocated = record_size;
+    record->mft_record_number = (uint32_t)record_num;
+    record->sequence_number = 1;
+    // USN 0 is invalid, so start at 1 (the write bumps it)
+    *(uint16_t*)((uint8_t*)record + record->update_seq_offset) = 1;
+    return (uint16_t)((record->update_seq_offset + record->update_seq_size * 2 + 7) & ~7u);
+}
+
+// Maps the whole $MFT through its own $DATA runs, which may be fragmented
+// and spread over extension records
+static int NtfsLoadMftMap(NtfsVolume* vol) {
+    const uint32_t record_size = NtfsRecordSize(vol);
+    NtfsMftRecord* record = KernelMemoryAlloc(record_size);
+    if (!record) return -1;
+
+    // Until mft_map is set, records are read contiguously from mft_cluster,
+    // which is where $MFT's own record and first extent always are
+    NtfsRunMap map;
+    int result = -1;
+    if (NtfsLoadMftRecord(vol, 0, record, 0) == 0 && record->signature == NTFS_FILE_SIGNATURE &&
+        NtfsBuildRunMap(vol, record, 0, NTFS_ATTR_DATA, NULL, &map) == 0) {
+        if (map.count > 0 && map.runs[0].lcn == (int64_t)volume.mft_cluster) {
+            volume.mft_map = map;
+            result = 0;
+        } else {
+            NtfsRunMapFree(&map);
         }
-        // Sign-extend if highest bit of the most significant byte is set
-        if (mp[off_len - 1] & 0x80) {
-            tmp |= -((int64_t)1 << (off_len * 8));
+    }
+    KernelFree(record);
+    return result;
+}
+
+static uint16_t NtfsUpcase(NtfsVolume* vol, uint16_t c) {
+    if (c < volume.upcase_len) return volume.upcase[c];
+    return (c >= 'a' && c <= 'z') ? (uint16_t)(c - 32) : c;
+}
+
+// COLLATION_FILENAME order: upcased UTF-16 code units, then length
+static int NtfsCollateNames(NtfsVolume* vol, const uint16_t* a, uint32_t a_len, const uint16_t* b, uint32_t b_len) {
+    const uint32_t n = a_len < b_len ? a_len : b_len;
+    for (uint32_t i = 0; i < n; i++) {
+        const uint16_t ca = NtfsUpcase(vol, a[i]);
+        const uint16_t cb = NtfsUpcase(vol, b[i]);
+        if (ca != cb) return ca < cb ? -1 : 1;
+    }
+    return a_len == b_len ? 0 : (a_len < b_len ? -1 : 1);
+}
+
+// Loads $UpCase so lookups collate exactly like the volume's indexes;
+// without it only ASCII letters are folded
+static int NtfsLoadUpcase(NtfsVolume* vol) {
+    const uint32_t record_size = NtfsRecordSize(vol);
+    NtfsMftRecord* record = KernelMemoryAlloc(record_size);
+    if (!record) return -1;
+
+    NtfsRunMap map;
+    int result = -1;
+    if (NtfsReadMftRecord(vol, NTFS_UPCASE_RECORD, record) == 0 &&
+        NtfsLoadRunMap(vol, record, NTFS_UPCASE_RECORD, NTFS_ATTR_DATA, NULL, &map) == 0) {
+        uint32_t bytes = map.data_size < NTFS_UPCASE_ENTRIES * 2 ? (uint32_t)map.data_size : NTFS_UPCASE_ENTRIES * 2;
+        bytes &= ~1u;
+        uint16_t* table = bytes ? KernelMemoryAlloc(bytes) : NULL;
+        if (table && NtfsRunMapIo(vol, &map, 0, table, bytes, 0) == (int64_t)bytes) {
+            volume.upcase = table;
+            volume.upcase_len = bytes / 2;
+            result = 0;
+        } else if (table) {
+            KernelFree(table);
         }
-        lcn_delta = tmp; // First run delta from 0
+        NtfsRunMapFree(&map);
     }
+    KernelFree(record);
+    return result;
+}
 
-    if (clusters == 0 || lcn_delta < 0) return -1; // Don't support sparse or negative LCN in this minimal parser
+// Copies index block vcn of directory dir into block, reading it through the
+// directory's $INDEX_ALLOCATION extent map and fixing it up on a miss
+static int NtfsReadIndexBlock(NtfsVolume* vol, uint64_t dir, NtfsRunMap* alloc, uint64_t vcn, uint32_t block_size,
+                              uint8_t* block) {
+    if (volume.index_lock) {
+        rust_spinlock_lock(volume.index_lock);
+        for (int i = 0; i < NTFS_INDEX_CACHE_ENTRIES; i++) {
+            NtfsIndexCacheEntry* e = &volume.index_cache[i];
+            if (!e->data || e->dir != dir || e->vcn != vcn || e->size != block_size) continue;
+            FastMemcpy(block, e->data, block_size);
+            e->last_use = ++volume.index_clock;
+            rust_spinlock_unlock(volume.index_lock);
+            return 0;
+        }
+        rust_spinlock_unlock(volume.index_lock);
+    }
 
-    *out_clusters = clusters;
-    *out_lcn = lcn_delta; // absolute LCN for the first run
+    // VCNs count clusters, or 512-byte blocks when index blocks are smaller
+    const uint64_t unit = block_size >= volume.bytes_per_cluster ? volume.bytes_per_cluster : NTFS_FIXUP_STRIDE;
+    if (NtfsRunMapIo(vol, alloc, vcn * unit, block, block_size, 0) != (int64_t)block_size) return -1;
+    const NtfsIndexBlock* header = (const NtfsIndexBlock*)block;
+    if (header->signature != NTFS_INDX_SIGNATURE || NtfsApplyFixups(block, block_size) != 0) return -1;
+    if (header->vcn != vcn) return -1;
+
+    if (!volume.index_lock) return 0;
+    uint8_t* copy = KernelMemoryAlloc(block_size);
+    if (!copy) return 0;
+    FastMemcpy(copy, block, block_size);
+
+    rust_spinlock_lock(volume.index_lock);
+    NtfsIndexCacheEntry* victim = &volume.index_cache[0];
+    for (int i = 0; i < NTFS_INDEX_CACHE_ENTRIES; i++) {
+        NtfsIndexCacheEntry* e = &volume.index_cache[i];
+        if (!e->data) {
+            victim = e;
+            break;
+        }
+        if (e->last_use < victim->last_use) victim = e;
+    }
+    uint8_t* old = victim->data;
+    victim->dir = dir;
+    victim->vcn = vcn;
+    victim->size = block_size;
+    victim->data = copy;
+    victim->last_use = ++volume.index_clock;
+    rust_spinlock_unlock(volume.index_lock);
+
+    if (old) KernelFree(old);
     return 0;
 }
 
+// Drops cached index blocks of a directory that changed or was freed
+static void NtfsIndexCacheInvalidate(NtfsVolume* vol, uint64_t dir) {
+    if (!volume.index_lock) return;
+    rust_spinlock_lock(volume.index_lock);
+    for (int i = 0; i < NTFS_INDEX_CACHE_ENTRIES; i++) {
+        NtfsIndexCacheEntry* e = &volume.index_cache[i];
+        if (!e->data || e->dir != dir) continue;
+        KernelFree(e->data);
+        FastMemset(e, 0, sizeof(NtfsIndexCacheEntry));
+    }
+    rust_spinlock_unlock(volume.index_lock);
+}
+
+// Walks the sorted entries [pos, end) of one index node. Returns 1 with *out
+// set on a match, 0 when the name is absent, 2 with *child set when the
+// search continues in a child node, -1 on a malformed node.
+static int NtfsIndexScanNode(NtfsVolume* vol, const uint8_t* pos, const uint8_t* end, const uint16_t* name,
+                             uint32_t name_len, uint64_t* out, uint64_t* child) {
+    while (pos + sizeof(NtfsIndexEntry) <= end) {
+        const NtfsIndexEntry* entry = (const NtfsIndexEntry*)pos;
+        if (entry->length < sizeof(NtfsIndexEntry) || pos + entry->length > end) return -1;
+
+        int cmp = -1; // the end entry sorts after every name
+        if (!(entry->flags & NTFS_INDEX_ENTRY_END)) {
+            const NtfsFilename* fn = (const NtfsFilename*)(pos + sizeof(NtfsIndexEntry));
+            if (entry->key_length < sizeof(NtfsFilename) || sizeof(NtfsIndexEntry) + entry->key_length > entry->length ||
+                sizeof(NtfsFilename) + fn->filename_length * 2u > entry->key_length) {
+                return -1;
+            }
+            // The key is packed and may be unaligned; compare a local copy
+            uint16_t key[255];
+            const uint8_t key_len = fn->filename_length;
+            FastMemcpy(key, (const uint8_t*)fn + sizeof(NtfsFilename), key_len * 2u);
+            cmp = NtfsCollateNames(vol, name, name_len, key, key_len);
+            if (cmp == 0) {
+                *out = entry->mft_reference & NTFS_MFT_REF_MASK;
+                return 1;
+            }
+        }
+        if (cmp < 0) {
+            if (!(entry->flags & NTFS_INDEX_ENTRY_NODE)) return 0;
+            if (entry->length < sizeof(NtfsIndexEntry) + sizeof(uint64_t)) return -1;
+            *child = *(const uint64_t*)(pos + entry->length - sizeof(uint64_t));
+            return 2;
+        }
+        pos += entry->length;
+    }
+    return -1;
+}
+
+// Looks name up by descending the $I30 B+tree of directory dir. Returns 1
+// and sets *out on a hit, 0 if the index has no such name, and -1 when the
+// directory has no usable index.
+static int NtfsIndexLookup(NtfsVolume* vol, uint64_t dir, const char* name, uint32_t name_len, uint64_t* out) {
+    uint16_t name16[256];
+    if (name_len == 0 || name_len > 255) return -1;
+    for (uint32_t i = 0; i < name_len; i++) name16[i] = (uint8_t)name[i];
+
+    const uint32_t record_size = NtfsRecordSize(vol);
+    NtfsMftRecord* record = KernelMemoryAlloc(record_size);
+    if (!record) return -1;
+    if (NtfsReadMftRecord(vol, dir, record) != 0 || !(record->flags & 0x2)) {
+        KernelFree(record);
+        return -1;
+    }
+
+    const NtfsAttrHeader* root_attr = NtfsFindAttr(record, record_size, NTFS_ATTR_INDEX_ROOT, NTFS_DIR_INDEX_NAME, 0);
+    const NtfsIndexRoot* root = NULL;
+    const uint8_t* value_end = NULL;
+    if (root_attr && !root_attr->non_resident &&
+        root_attr->resident.value_offset + root_attr->resident.value_length <= root_attr->length &&
+        root_attr->resident.value_length >= sizeof(NtfsIndexRoot) + sizeof(NtfsIndexHeader)) {
+        root = (const NtfsIndexRoot*)((const uint8_t*)root_attr + root_attr->resident.value_offset);
+        value_end = (const uint8_t*)root + root_attr->resident.value_length;
+    }
+    const uint32_t block_size = root ? root->bytes_per_index_record : 0;
+    if (!root || root->type != NTFS_ATTR_FILENAME || root->collation_rule != NTFS_COLLATION_FILENAME ||
+        block_size < NTFS_FIXUP_STRIDE || block_size > NTFS_INDEX_BLOCK_MAX || (block_size & (block_size - 1))) {
+        KernelFree(record);
+        return -1;
+    }
+
+    const NtfsIndexHeader* header = (const NtfsIndexHeader*)(root + 1);
+    const uint8_t* node_end = value_end;
+    NtfsRunMap alloc = {0};
+    int have_alloc = 0;
+    uint8_t* block = NULL;
+    int result = -1;
+
+    for (int depth = 0; depth < NTFS_INDEX_MAX_DEPTH; depth++) {
+        const uint8_t* start = (const uint8_t*)header + header->entries_offset;
+        const uint8_t* end = (const uint8_t*)header + header->index_length;
+        if (start > end || end > node_end) break;
+
+        uint64_t child = 0;
+        const int step = NtfsIndexScanNode(vol, start, end, name16, name_len, out, &child);
+        if (step != 2) {
+            result = step;
+            break;
+        }
+
+        if (!have_alloc) {
+            if (NtfsLoadRunMap(vol, record, dir, NTFS_ATTR_INDEX_ALLOCATION, NTFS_DIR_INDEX_NAME, &alloc) != 0) break;
+            have_alloc = 1;
+        }
+        if (!block && !(block = KernelMemoryAlloc(block_size))) break;
+        if (NtfsReadIndexBlock(vol, dir, &alloc, child, block_size, block) != 0) break;
+        header = &((const NtfsIndexBlock*)block)->header;
+        node_end = block + block_size;
+    }
+
+    if (block) KernelFree(block);
+    if (have_alloc) NtfsRunMapFree(&alloc);
+    KernelFree(record);
+    return result;
+}
+
 // Return MFT record number for a path in root (single component). 0 on failure.
 static const char* NtfsBaseName(const char* path) {
     if (!path) return NULL;
@@ -249,47 +1065,66 @@ static const char* NtfsBaseName(const char* path) {
     return last;
 }
 
-static int NtfsUtf16EqualsAscii(const uint16_t* u16, uint8_t len16, const char* ascii) {
-    if (!u16 || !ascii) return 0;
-    size_t n = 0;
-    while (ascii[n] != '\0') n++;
-    if ((size_t)len16 != n) return 0;
-    for (size_t i = 0; i < n; i++) {
-        if ((uint8_t)u16[i] != (uint8_t)ascii[i] || (u16[i] >> 8) != 0) return 0;
+// Helper: find child record through the parent's B+tree index, falling back
+// to scanning the MFT for a FILE_NAME with given parent and name. The scan
+// covers directories without a usable index and entries created here, since
+// this driver does not insert into parent indexes; while it has created
+// none, an index miss is final. Both paths match names through $UpCase, and
+// misses are cached as negative entries.
+static uint64_t NtfsFindChild(NtfsVolume* vol, uint64_t parent_mft, const char* name, uint32_t mft_record_size, NtfsMftRecord* rec_buf) {
+    const uint32_t name_len = FastStrlen(name, 256);
+    uint64_t cached;
+    if (DCacheLookup(vol, parent_mft, name, name_len, &cached)) return cached;
+
+    uint64_t child;
+    const int indexed = NtfsIndexLookup(vol, parent_mft, name, name_len, &child);
+    if (indexed == 1 && child != 0) {
+        DCacheInsert(vol, parent_mft, name, name_len, child);
+        return child;
     }
-    return 1;
-}
+    if ((indexed == 0 && volume.unindexed == 0) || name_len == 0 || name_len > 255) {
+        DCacheInsert(vol, parent_mft, name, name_len, 0);
+        return 0;
+    }
+
+    uint16_t name16[255];
+    for (uint32_t i = 0; i < name_len; i++) name16[i] = (uint8_t)name[i];
 
-// Helper: find child record by scanning MFT for a FILE_NAME with given parent and name (ASCII)
-static uint64_t NtfsFindChild(uint64_t parent_mft, const char* name, uint32_t mft_record_size, NtfsMftRecord* rec_buf) {
     const uint32_t max_scan = 4096;
     for (uint32_t i = 0; i < max_scan; i++) {
-        if (NtfsReadMftRecord(i, rec_buf) != 0) continue;
-        if (rec_buf->flags == 0) continue;
+        if (NtfsLoadMftRecord(vol, i, rec_buf, 0) != 0) continue;
+        if (rec_buf->flags == 0 || rec_buf->bytes_in_use > mft_record_size) continue;
         uint8_t* attr_ptr = (uint8_t*)rec_buf + rec_buf->attrs_offset;
-        uint8_t* rec_end = (uint8_t*)rec_buf + mft_record_size;
-        while (attr_ptr + sizeof(NtfsAttrHeader) <= rec_end &&
-               attr_ptr < (uint8_t*)rec_buf + rec_buf->bytes_in_use) {
+        uint8_t* rec_end = (uint8_t*)rec_buf + rec_buf->bytes_in_use;
+        while (attr_ptr + NTFS_RESIDENT_ATTR_MIN <= rec_end) {
             NtfsAttrHeader* attr = (NtfsAttrHeader*)attr_ptr;
-            if (attr->length == 0 || attr->length < sizeof(NtfsAttrHeader)) break;
+            if (attr->length < NTFS_RESIDENT_ATTR_MIN) break;
             if (attr_ptr + attr->length > rec_end) break;
-            if (attr->type == NTFS_ATTR_FILENAME && !attr->non_resident) {
-                NtfsFilename* fn = (NtfsFilename*)(attr_ptr + attr->resident.value_offset);
-                if ((uint64_t)fn->parent_directory == parent_mft && fn->filename_length > 0) {
-                    if (NtfsUtf16EqualsAscii(fn->filename, fn->filename_length, name)) {
+            // A record may carry several names (Win32 and DOS); try each
+            if (attr->type == NTFS_ATTR_FILENAME && !attr->non_resident &&
+                attr->resident.value_offset + attr->resident.value_length <= attr->length &&
+                attr->resident.value_length >= sizeof(NtfsFilename)) {
+                const NtfsFilename* fn = (const NtfsFilename*)(attr_ptr + attr->resident.value_offset);
+                const uint8_t key_len = fn->filename_length;
+                if ((fn->parent_directory & NTFS_MFT_REF_MASK) == parent_mft && key_len == name_len &&
+                    sizeof(NtfsFilename) + key_len * 2u <= attr->resident.value_length) {
+                    uint16_t key[255];
+                    FastMemcpy(key, (const uint8_t*)fn + sizeof(NtfsFilename), key_len * 2u);
+                    if (NtfsCollateNames(vol, name16, name_len, key, key_len) == 0) {
+                        DCacheInsert(vol, parent_mft, name, name_len, i);
                         return i;
                     }
                 }
-                break; // assume single FILE_NAME
             }
             attr_ptr += attr->length;
         }
     }
+    DCacheInsert(vol, parent_mft, name, name_len, 0);
     return 0;
 }
 
 // Resolve parent directory record and extract basename into provided buffer.
-static int NtfsResolveParentAndName(const char* path, uint64_t* out_parent, char* name_buf, size_t name_buf_len) {
+static int NtfsResolveParentAndName(NtfsVolume* vol, const char* path, uint64_t* out_parent, char* name_buf, size_t name_buf_len) {
     if (!path || path[0] != '/' || !out_parent || !name_buf || name_buf_len == 0) return -1;
 
     // Determine MFT record size
@@ -324,7 +1159,7 @@ static int NtfsResolveParentAndName(const char* path, uint64_t* out_parent, char
             if (comp_len >= sizeof(temp)) { KernelFree(rec); return -1; }
             for (size_t i = 0; i < comp_len; i++) temp[i] = comp_start[i];
             temp[comp_len] = '\0';
-            uint64_t child = NtfsFindChild(current, temp, mft_record_size, rec);
+            uint64_t child = NtfsFindChild(vol, current, temp, mft_record_size, rec);
             if (child == 0) { KernelFree(rec); return -1; }
             current = child;
         } else {
@@ -343,7 +1178,7 @@ static int NtfsResolveParentAndName(const char* path, uint64_t* out_parent, char
     return 0;
 }
 
-uint64_t NtfsPathToMftRecord(const char* path) {
+uint64_t NtfsPathToMftRecord(NtfsVolume* vol, const char* path) {
     if (!path || path[0] != '/') return 0;
     if (path[1] == '\0') return 5; // Root directory is MFT record 5
 
@@ -375,7 +1210,7 @@ uint64_t NtfsPathToMftRecord(const char* path) {
         for (size_t i = 0; i < comp_len; i++) name[i] = comp_start[i];
         name[comp_len] = '\0';
         // Look up this child under current
-        uint64_t child = NtfsFindChild(current, name, mft_record_size, rec);
+        uint64_t child = NtfsFindChild(vol, current, name, mft_record_size, rec);
         if (child == 0) { KernelFree(rec); return 0; }
         current = child;
     }
@@ -384,81 +1219,21 @@ uint64_t NtfsPathToMftRecord(const char* path) {
     return current;
 }
 
-int NtfsReadFile(const char* path, void* buffer, uint32_t max_size) {
+int64_t NtfsReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size) {
+    NtfsVolume* vol = fs_data;
     if (!path || !buffer) return -1;
     if (!volume.lock) return -1;
 
-    uint64_t mft_record_num = NtfsPathToMftRecord(path);
-    if (mft_record_num == 0) return -1;
-
-    // Calculate MFT record size
-    uint32_t mft_record_size;
-    if (volume.boot_sector.clusters_per_file_record > 0) {
-        mft_record_size = volume.boot_sector.clusters_per_file_record * volume.bytes_per_cluster;
-    } else {
-        mft_record_size = 1 << (-(int8_t)volume.boot_sector.clusters_per_file_record);
-    }
-    
-    NtfsMftRecord* record = KernelMemoryAlloc(mft_record_size);
-    if (!record) return -1;
-
-    rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
-
-    if (NtfsReadMftRecord(mft_record_num, record) != 0) {
-        KernelFree(record);
-        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-        return -1;
-    }
-
-    // Find DATA attribute
-    uint8_t* attr_ptr   = (uint8_t*)record + record->attrs_offset;
-    uint8_t* record_end = (uint8_t*)record + mft_record_size;
-
-    // Validate bytes_in_use before parsing
-    if (record->bytes_in_use > mft_record_size) {
-        KernelFree(record);
-        rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-        return -1;
-    }
-
-    while (attr_ptr + sizeof(NtfsAttrHeader) <= record_end &&
-           attr_ptr < (uint8_t*)record + record->bytes_in_use) {
-        NtfsAttrHeader* attr = (NtfsAttrHeader*)attr_ptr;
-
-        // Ensure length is sane
-        if (attr->length == 0 || attr->length < sizeof(NtfsAttrHeader))
-            break;
-        if (attr_ptr + attr->length > record_end)
-            break;
-
-        if (attr->type == NTFS_ATTR_DATA && !attr->non_resident) {
-            // Resident data
-            uint32_t data_size = attr->resident.value_length;
-            if (data_size > max_size) data_size = max_size;
-
-            // Validate value offset and total size
-            uint8_t* data_ptr = attr_ptr + attr->resident.value_offset;
-            if (data_ptr + data_size > record_end) {
-                KernelFree(record);
-            rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-                return -1;
-            }
-
-            memcpy(buffer, data_ptr, data_size);
-            KernelFree(record);
-            rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-            return (int)data_size;
-        }
-
-        attr_ptr += attr->length;
-    }
-
-    KernelFree(record);
-    rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
-    return -1;
+    // Whole-file reads go through an open-file object for its extent map
+    void* file = NtfsOpen(vol, path, 0);
+    if (!file) return -1;
+    const int64_t bytes_read = max_size ? NtfsReadAt(file, 0, buffer, max_size) : 0;
+    NtfsClose(file);
+    return bytes_read;
 }
 
-int NtfsListDir(const char* path) {
+int NtfsListDir(void* fs_data, const char* path) {
+    NtfsVolume* vol = fs_data;
     if (!path || path[0] != '/') return -1;
 
     // Determine MFT record size
@@ -469,14 +1244,14 @@ int NtfsListDir(const char* path) {
         mft_record_size = 1u << (-(int8_t)volume.boot_sector.clusters_per_file_record);
     }
 
-    uint64_t dir_mft = (path[0] == '/' && path[1] == '\0') ? 5 : NtfsPathToMftRecord(path);
+    uint64_t dir_mft = (path[0] == '/' && path[1] == '\0') ? 5 : NtfsPathToMftRecord(vol, path);
     if (dir_mft == 0) return -1;
 
     NtfsMftRecord* rec = KernelMemoryAlloc(mft_record_size);
     if (!rec) return -1;
 
     // Optionally verify that target is a directory
-    if (NtfsReadMftRecord(dir_mft, rec) == 0) {
+    if (NtfsReadMftRecord(vol, dir_mft, rec) == 0) {
         if ((rec->flags & 0x2) == 0) {
             KernelFree(rec);
             return -1; // not a directory
@@ -485,7 +1260,7 @@ int NtfsListDir(const char* path) {
 
     const uint32_t max_scan = 4096;
     for (uint32_t i = 0; i < max_scan; i++) {
-        if (NtfsReadMftRecord(i, rec) != 0) continue;
+        if (NtfsLoadMftRecord(vol, i, rec, 0) != 0) continue;
         if (rec->flags == 0) continue;
         uint8_t* attr_ptr = (uint8_t*)rec + rec->attrs_offset;
         uint8_t* rec_end = (uint8_t*)rec + mft_record_size;
@@ -496,7 +1271,7 @@ int NtfsListDir(const char* path) {
             if (attr_ptr + attr->length > rec_end) break;
             if (attr->type == NTFS_ATTR_FILENAME && !attr->non_resident) {
                 NtfsFilename* fn = (NtfsFilename*)(attr_ptr + attr->resident.value_offset);
-                if ((uint64_t)fn->parent_directory == dir_mft && fn->filename_length > 0) {
+                if ((fn->parent_directory & NTFS_MFT_REF_MASK) == dir_mft && fn->filename_length > 0) {
                     // Print ASCII subset of UTF-16
                     for (uint8_t k = 0; k < fn->filename_length; k++) {
                         char ch = (char)(uint8_t)fn->filename[k];
@@ -514,8 +1289,9 @@ int NtfsListDir(const char* path) {
     return 0;
 }
 
-int NtfsIsFile(const char* path) {
-    uint64_t mft_record_num = NtfsPathToMftRecord(path);
+int NtfsIsFile(void* fs_data, const char* path) {
+    NtfsVolume* vol = fs_data;
+    uint64_t mft_record_num = NtfsPathToMftRecord(vol, path);
     if (mft_record_num == 0) return 0;
 
     uint32_t mft_record_size;
@@ -528,7 +1304,7 @@ int NtfsIsFile(const char* path) {
     NtfsMftRecord* record = KernelMemoryAlloc(mft_record_size);
     if (!record) return 0;
 
-    if (NtfsReadMftRecord(mft_record_num, record) != 0) {
+    if (NtfsReadMftRecord(vol, mft_record_num, record) != 0) {
         KernelFree(record);
         return 0;
     }
@@ -538,11 +1314,12 @@ int NtfsIsFile(const char* path) {
     return is_file;
 }
 
-int NtfsIsDir(const char* path) {
+int NtfsIsDir(void* fs_data, const char* path) {
+    NtfsVolume* vol = fs_data;
     if (!path) return 0;
     if (path[0] == '/' && path[1] == '\0') return 1; // Root is directory
 
-    uint64_t mft_record_num = NtfsPathToMftRecord(path);
+    uint64_t mft_record_num = NtfsPathToMftRecord(vol, path);
     if (mft_record_num == 0) return 0;
 
     uint32_t mft_record_size;
@@ -555,7 +1332,7 @@ int NtfsIsDir(const char* path) {
     NtfsMftRecord* record = KernelMemoryAlloc(mft_record_size);
     if (!record) return 0;
 
-    if (NtfsReadMftRecord(mft_record_num, record) != 0) {
+    if (NtfsReadMftRecord(vol, mft_record_num, record) != 0) {
         KernelFree(record);
         return 0;
     }
@@ -565,8 +1342,9 @@ int NtfsIsDir(const char* path) {
     return is_dir;
 }
 
-uint64_t NtfsGetFileSize(const char* path) {
-    uint64_t mft_record_num = NtfsPathToMftRecord(path);
+uint64_t NtfsGetFileSize(void* fs_data, const char* path) {
+    NtfsVolume* vol = fs_data;
+    uint64_t mft_record_num = NtfsPathToMftRecord(vol, path);
     if (mft_record_num == 0) return 0;
 
     uint32_t mft_record_size;
@@ -579,118 +1357,79 @@ uint64_t NtfsGetFileSize(const char* path) {
     NtfsMftRecord* record = KernelMemoryAlloc(mft_record_size);
     if (!record) return 0;
 
-    if (NtfsReadMftRecord(mft_record_num, record) != 0) {
+    if (NtfsReadMftRecord(vol, mft_record_num, record) != 0) {
         KernelFree(record);
         return 0;
     }
 
-    uint8_t* attr_ptr = (uint8_t*)record + record->attrs_offset;
-    uint8_t* record_end = (uint8_t*)record + mft_record_size;
-
-    while (attr_ptr + sizeof(NtfsAttrHeader) <= record_end &&
-           attr_ptr < (uint8_t*)record + record->bytes_in_use) {
-        NtfsAttrHeader* attr = (NtfsAttrHeader*)attr_ptr;
-
-        if (attr->length == 0 || attr->length < sizeof(NtfsAttrHeader)) break;
-        if (attr_ptr + attr->length > record_end) break;
-
-        if (attr->type == NTFS_ATTR_DATA) {
-            if (attr->non_resident) {
-                uint64_t size = attr->nonresident.data_size;
-                KernelFree(record);
-                return size;
-            } else {
-                uint64_t size = attr->resident.value_length;
-                KernelFree(record);
-                return size;
-            }
+    uint64_t size = 0;
+    const NtfsAttrHeader* attr = NtfsFindAttr(record, mft_record_size, NTFS_ATTR_DATA, NULL, 0);
+    if (attr) {
+        size = attr->non_resident ? attr->nonresident.data_size : attr->resident.value_length;
+    } else {
+        // The first piece of DATA lives in an extension record
+        NtfsRunMap map;
+        if (NtfsLoadRunMap(vol, record, mft_record_num, NTFS_ATTR_DATA, NULL, &map) == 0) {
+            size = map.data_size;
+            NtfsRunMapFree(&map);
         }
-
-        attr_ptr += attr->length;
     }
 
     KernelFree(record);
-    return 0;
+    return size;
 }
-int NtfsWriteFile(const char* path, const void* buffer, uint32_t size) {
+
+int64_t NtfsWriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size) {
+    NtfsVolume* vol = fs_data;
     if (!path || !buffer) return -1;
     if (!volume.lock) return -1;
 
-    uint64_t mft_record_num = NtfsPathToMftRecord(path);
+    uint64_t mft_record_num = NtfsPathToMftRecord(vol, path);
     if (mft_record_num == 0) return -1;
 
-    NtfsMftRecord* record = KernelMemoryAlloc(1024);
+    const uint32_t record_size = NtfsRecordSize(vol);
+    NtfsMftRecord* record = KernelMemoryAlloc(record_size);
     if (!record) return -1;
 
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
 
-    if (NtfsReadMftRecord(mft_record_num, record) != 0) {
+    if (NtfsReadMftRecord(vol, mft_record_num, record) != 0) {
         KernelFree(record);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
 
-    uint8_t* attr_ptr   = (uint8_t*)record + record->attrs_offset;
-    uint8_t* record_end = (uint8_t*)record + 1024;
-
-    if (record->bytes_in_use > 1024) {
+    // Only an unnamed resident $DATA is rewritten, within its current size
+    NtfsAttrHeader* attr = NtfsFindAttr(record, record_size, NTFS_ATTR_DATA, NULL, 0);
+    if (!attr || attr->non_resident || size > attr->resident.value_length) {
         KernelFree(record);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
 
-    while (attr_ptr + sizeof(NtfsAttrHeader) <= record_end &&
-           attr_ptr < (uint8_t*)record + record->bytes_in_use) {
-        NtfsAttrHeader* attr = (NtfsAttrHeader*)attr_ptr;
-
-        if (attr->length == 0 || attr->length < sizeof(NtfsAttrHeader))
-            break;
-        if (attr_ptr + attr->length > record_end)
-            break;
-
-        if (attr->type == NTFS_ATTR_DATA && !attr->non_resident) {
-            // Resident data
-            uint32_t data_size = attr->resident.value_length;
-            if (size > data_size) {
-                // Not enough space in resident attribute
-                KernelFree(record);
-                rust_rwlock_write_unlock(volume.lock);
-                return -1; 
-            }
-
-            uint8_t* data_ptr = attr_ptr + attr->resident.value_offset;
-            if (data_ptr + size > record_end) {
-                KernelFree(record);
-                rust_rwlock_write_unlock(volume.lock);
-                return -1;
-            }
-
-            memcpy(data_ptr, buffer, size);
-
-            // Write back the MFT record
-            uint64_t mft_offset = volume.mft_cluster * volume.sectors_per_cluster;
-            uint64_t record_offset = mft_offset + (mft_record_num * 1024 / volume.bytes_per_sector);
-            
-            if (volume.device->write_blocks(volume.device, record_offset, 2, record) != 0) {
-                KernelFree(record);
-                rust_rwlock_write_unlock(volume.lock);
-                return -1;
-            }
+    uint8_t* data_ptr = (uint8_t*)attr + attr->resident.value_offset;
+    if (data_ptr + size > (uint8_t*)record + record_size) {
+        KernelFree(record);
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
 
-            KernelFree(record);
-            rust_rwlock_write_unlock(volume.lock);
-            return (int)size;
-        }
+    memcpy(data_ptr, buffer, size);
 
-        attr_ptr += attr->length;
+    // Write back the MFT record
+    if (NtfsWriteMftRecord(vol, mft_record_num, record) != 0) {
+        KernelFree(record);
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
     }
+    NtfsOpenUpdate(vol, mft_record_num, buffer, (uint32_t)size);
 
     KernelFree(record);
     rust_rwlock_write_unlock(volume.lock);
-    return -1;
+    return (int64_t)size;
 }
 
-static uint64_t NtfsAllocateMftRecord() {
+static uint64_t NtfsAllocateMftRecord(NtfsVolume* vol) {
     // Calculate MFT record size
     uint32_t mft_record_size;
     if (volume.boot_sector.clusters_per_file_record > 0) {
@@ -706,7 +1445,7 @@ static uint64_t NtfsAllocateMftRecord() {
         return 0;
     }
 
-    if (NtfsReadMftRecord(0, mft_record) != 0) {
+    if (NtfsReadMftRecord(vol, 0, mft_record) != 0) {
         PrintKernel("NTFS: Failed to read $MFT (record 0)\n");
         KernelFree(mft_record);
         return 0;
@@ -736,11 +1475,7 @@ static uint64_t NtfsAllocateMftRecord() {
                                 bitmap_data[i] |= (1 << j); // Mark as used
 
                                 // Write the modified $MFT record back (bitmap is resident here)
-                                uint64_t mft_start_sector = volume.mft_cluster * volume.sectors_per_cluster;
-                                uint64_t record_byte_offset = 0 * mft_record_size;
-                                uint64_t record_sector = mft_start_sector + (record_byte_offset / volume.bytes_per_sector);
-                                uint32_t sectors_needed = (mft_record_size + volume.bytes_per_sector - 1) / volume.bytes_per_sector;
-                                volume.device->write_blocks(volume.device, record_sector, sectors_needed, mft_record);
+                                NtfsWriteMftRecord(vol, 0, mft_record);
 
                                 KernelFree(mft_record);
                                 return (uint64_t)i * 8 + j;
@@ -749,60 +1484,46 @@ static uint64_t NtfsAllocateMftRecord() {
                     }
                 }
             } else {
-                // Minimal support for non-resident $MFT::$BITMAP with a single contiguous run
-                int64_t lcn = -1;
-                uint64_t run_clusters = 0;
-                if (NtfsParseFirstRun(attr, &lcn, &run_clusters) != 0 || lcn < 0 || run_clusters == 0) {
+                // Non-resident $MFT::$BITMAP: scan it a cluster at a time
+                // through its extent map and set the first clear bit
+                NtfsRunMap map;
+                if (NtfsLoadRunMap(vol, mft_record, 0, NTFS_ATTR_BITMAP, NULL, &map) != 0) {
                     PrintKernel("NTFS: $MFT::$BITMAP non-resident with unsupported mapping pairs\n");
                     KernelFree(mft_record);
                     return 0;
                 }
-                uint64_t total_bytes = run_clusters * (uint64_t)volume.bytes_per_cluster;
-                if (attr->nonresident.data_size < total_bytes) total_bytes = attr->nonresident.data_size;
-                if (total_bytes == 0) {
-                    PrintKernel("NTFS: $MFT::$BITMAP non-resident but empty\n");
-                    KernelFree(mft_record);
-                    return 0;
-                }
-                uint32_t sectors = (uint32_t)((total_bytes + volume.bytes_per_sector - 1) / volume.bytes_per_sector);
-                uint8_t* bitmap_buf = KernelMemoryAlloc((size_t)sectors * volume.bytes_per_sector);
-                if (!bitmap_buf) {
-                    PrintKernel("NTFS: Failed to alloc bitmap buffer\n");
-                    KernelFree(mft_record);
-                    return 0;
-                }
-                uint64_t start_sector = (uint64_t)lcn * volume.sectors_per_cluster;
-                if (volume.device->read_blocks(volume.device, start_sector, sectors, bitmap_buf) != 0) {
-                    KernelFree(bitmap_buf);
-                    KernelFree(mft_record);
-                    PrintKernel("NTFS: Failed to read non-resident $MFT::$BITMAP\n");
-                    return 0;
-                }
-                // Scan for a free bit within this first run portion
-                uint64_t bytes_scanned = (uint64_t)sectors * volume.bytes_per_sector;
-                for (uint64_t i = 0; i < bytes_scanned; i++) {
-                    if (bitmap_buf[i] != 0xFF) {
+                const uint32_t chunk_size = volume.bytes_per_cluster;
+                uint8_t* bitmap_buf = KernelMemoryAlloc(chunk_size);
+                if (!bitmap_buf) PrintKernel("NTFS: Failed to alloc bitmap buffer\n");
+                uint64_t rec = 0;
+                int stop = !bitmap_buf;
+                for (uint64_t base = 0; !stop && base < map.init_size; base += chunk_size) {
+                    uint32_t want = chunk_size;
+                    if (want > map.init_size - base) want = (uint32_t)(map.init_size - base);
+                    const int n = NtfsRunMapIo(vol, &map, base, bitmap_buf, want, 0);
+                    if (n <= 0) {
+                        PrintKernel("NTFS: Failed to read non-resident $MFT::$BITMAP\n");
+                        break;
+                    }
+                    for (int i = 0; i < n && !stop; i++) {
+                        if (bitmap_buf[i] == 0xFF) continue;
                         for (int j = 0; j < 8; j++) {
-                            if (!(bitmap_buf[i] & (1u << j))) {
-                                bitmap_buf[i] |= (1u << j);
-                                // Write back
-                                if (volume.device->write_blocks(volume.device, start_sector, sectors, bitmap_buf) != 0) {
-                                    PrintKernel("NTFS: Failed to write non-resident $MFT::$BITMAP\n");
-                                    KernelFree(bitmap_buf);
-                                    KernelFree(mft_record);
-                                    return 0;
-                                }
-                                uint64_t rec = (uint64_t)i * 8 + (uint64_t)j;
-                                KernelFree(bitmap_buf);
-                                KernelFree(mft_record);
-                                return rec;
+                            if (bitmap_buf[i] & (1u << j)) continue;
+                            uint8_t byte = bitmap_buf[i] | (uint8_t)(1u << j);
+                            if (NtfsRunMapIo(vol, &map, base + i, &byte, 1, 1) == 1) {
+                                rec = (base + i) * 8 + (uint64_t)j;
+                            } else {
+                                PrintKernel("NTFS: Failed to write non-resident $MFT::$BITMAP\n");
                             }
+                            break;
                         }
+                        stop = 1;
                     }
                 }
-                KernelFree(bitmap_buf);
+                if (bitmap_buf) KernelFree(bitmap_buf);
+                NtfsRunMapFree(&map);
                 KernelFree(mft_record);
-                return 0;
+                return rec;
             }
         }
         attr_ptr += attr->length;
@@ -812,21 +1533,24 @@ static uint64_t NtfsAllocateMftRecord() {
     return 0; // No free records found
 }
 
-int NtfsCreateFile(const char* path) {
+int NtfsCreateFile(void* fs_data, const char* path) {
+    NtfsVolume* vol = fs_data;
     if (!path || !volume.lock) return -1;
 
     uint64_t parent_mft = 5;
     char name[256];
-    if (NtfsResolveParentAndName(path, &parent_mft, name, sizeof(name)) != 0) return -1;
+    if (NtfsResolveParentAndName(vol, path, &parent_mft, name, sizeof(name)) != 0) return -1;
 
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
 
-    uint64_t mft_record_num = NtfsAllocateMftRecord();
+    uint64_t mft_record_num = NtfsAllocateMftRecord(vol);
     if (mft_record_num == 0) {
         PrintKernel("NTFS: No free MFT records\n");
         rust_rwlock_write_unlock(volume.lock);
         return -1; // No free MFT records
     }
+    NtfsRunMapInvalidate(vol, mft_record_num);
+    NtfsIndexCacheInvalidate(vol, mft_record_num);
 
     // Determine MFT record size
     uint32_t mft_record_size;
@@ -845,9 +1569,8 @@ int NtfsCreateFile(const char* path) {
     memset(record, 0, mft_record_size);
 
     // Initialize MFT record header
-    record->signature = 'ELIF';
+    record->attrs_offset = NtfsInitRecordHeader(vol, record, mft_record_num);
     record->flags = 1; // In-use (file)
-    record->attrs_offset = sizeof(NtfsMftRecord);
 
     // Add $STANDARD_INFORMATION attribute
     NtfsAttrHeader* std_info_attr = (NtfsAttrHeader*)((uint8_t*)record + record->attrs_offset);
@@ -888,12 +1611,7 @@ int NtfsCreateFile(const char* path) {
     record->bytes_in_use = (uint32_t)((uint8_t*)file_name_attr + file_name_attr->length - (uint8_t*)record);
 
     // Write back the MFT record
-    uint64_t mft_start_sector = volume.mft_cluster * volume.sectors_per_cluster;
-    uint64_t record_byte_offset = mft_record_num * (uint64_t)mft_record_size;
-    uint64_t record_sector = mft_start_sector + (record_byte_offset / volume.bytes_per_sector);
-    uint32_t sectors_needed = (mft_record_size + volume.bytes_per_sector - 1) / volume.bytes_per_sector;
-
-    if (volume.device->write_blocks(volume.device, record_sector, sectors_needed, record) != 0) {
+    if (NtfsWriteMftRecord(vol, mft_record_num, record) != 0) {
         KernelFree(record);
         rust_rwlock_write_unlock(volume.lock);
         PrintKernel("NTFS: Failed to write MFT record\n");
@@ -901,26 +1619,31 @@ int NtfsCreateFile(const char* path) {
     }
 
     KernelFree(record);
+    DCacheInsert(vol, parent_mft, name, name_len, mft_record_num);
+    volume.unindexed++;
     rust_rwlock_write_unlock(volume.lock);
 
     return 0;
 }
 
-int NtfsCreateDir(const char* path) {
+int NtfsCreateDir(void* fs_data, const char* path) {
+    NtfsVolume* vol = fs_data;
     if (!path || !volume.lock) return -1;
 
     uint64_t parent_mft = 5;
     char name[256];
-    if (NtfsResolveParentAndName(path, &parent_mft, name, sizeof(name)) != 0) return -1;
+    if (NtfsResolveParentAndName(vol, path, &parent_mft, name, sizeof(name)) != 0) return -1;
 
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
 
-    uint64_t mft_record_num = NtfsAllocateMftRecord();
+    uint64_t mft_record_num = NtfsAllocateMftRecord(vol);
     if (mft_record_num == 0) {
         PrintKernel("NTFS: No free MFT records\n");
         rust_rwlock_write_unlock(volume.lock);
         return -1; // No free MFT records
-    } 
+    }
+    NtfsRunMapInvalidate(vol, mft_record_num);
+    NtfsIndexCacheInvalidate(vol, mft_record_num);
 
     uint32_t mft_record_size;
     if (volume.boot_sector.clusters_per_file_record > 0) {
@@ -937,9 +1660,8 @@ int NtfsCreateDir(const char* path) {
     }
     memset(record, 0, mft_record_size);
 
-    record->signature = 'ELIF';
+    record->attrs_offset = NtfsInitRecordHeader(vol, record, mft_record_num);
     record->flags = 2; // Directory
-    record->attrs_offset = sizeof(NtfsMftRecord);
 
     // Add $STANDARD_INFORMATION attribute
     NtfsAttrHeader* std_info_attr = (NtfsAttrHeader*)((uint8_t*)record + record->attrs_offset);
@@ -990,12 +1712,7 @@ int NtfsCreateDir(const char* path) {
 
     record->bytes_in_use = (uint32_t)((uint8_t*)index_root_attr + index_root_attr->length - (uint8_t*)record);
 
-    uint64_t mft_start_sector = volume.mft_cluster * volume.sectors_per_cluster;
-    uint64_t record_byte_offset = mft_record_num * (uint64_t)mft_record_size;
-    uint64_t record_sector = mft_start_sector + (record_byte_offset / volume.bytes_per_sector);
-    uint32_t sectors_needed = (mft_record_size + volume.bytes_per_sector - 1) / volume.bytes_per_sector;
-
-    if (volume.device->write_blocks(volume.device, record_sector, sectors_needed, record) != 0) {
+    if (NtfsWriteMftRecord(vol, mft_record_num, record) != 0) {
         KernelFree(record);
         PrintKernel("NTFS: Failed to write MFT record\n");
         rust_rwlock_write_unlock(volume.lock);
@@ -1003,26 +1720,34 @@ int NtfsCreateDir(const char* path) {
     }
 
     KernelFree(record);
+    DCacheInsert(vol, parent_mft, name, name_len, mft_record_num);
+    volume.unindexed++;
     rust_rwlock_write_unlock(volume.lock);
 
     return 0;
 }
 
-int NtfsDelete(const char* path) {
+int NtfsDelete(void* fs_data, const char* path, int recursive) {
+    (void)recursive;
+    NtfsVolume* vol = fs_data;
     if (!path || !volume.lock) return -1;
 
-    uint64_t mft_record_num = NtfsPathToMftRecord(path);
+    uint64_t mft_record_num = NtfsPathToMftRecord(vol, path);
     if (mft_record_num == 0) return -1;
 
+    uint64_t parent_mft = 5;
+    char name[256];
+    if (NtfsResolveParentAndName(vol, path, &parent_mft, name, sizeof(name)) != 0) return -1;
+
     rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
 
-    NtfsMftRecord* record = KernelMemoryAlloc(1024);
+    NtfsMftRecord* record = KernelMemoryAlloc(NtfsRecordSize(vol));
     if (!record) {
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
 
-    if (NtfsReadMftRecord(mft_record_num, record) != 0) {
+    if (NtfsReadMftRecord(vol, mft_record_num, record) != 0) {
         KernelFree(record);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
@@ -1031,15 +1756,18 @@ int NtfsDelete(const char* path) {
     // Mark MFT record as not in use
     record->flags = 0;
 
-    uint64_t mft_offset = volume.mft_cluster * volume.sectors_per_cluster;
-    uint64_t record_offset = mft_offset + (mft_record_num * 1024 / volume.bytes_per_sector);
-    if (volume.device->write_blocks(volume.device, record_offset, 2, record) != 0) {
+    if (NtfsWriteMftRecord(vol, mft_record_num, record) != 0) {
         KernelFree(record);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
     }
 
     KernelFree(record);
+    NtfsOpenUnlink(vol, mft_record_num);
+    NtfsRunMapInvalidate(vol, mft_record_num);
+    NtfsIndexCacheInvalidate(vol, mft_record_num);
+    DCacheInvalidate(vol, parent_mft, name, StringLength(name));
+    DCacheInvalidateDir(vol, mft_record_num);
 
     // Clear the bit in the $MFT::$BITMAP (MFT allocation bitmap)
     uint32_t mft_record_size;
@@ -1055,7 +1783,7 @@ int NtfsDelete(const char* path) {
         return -1;
     }
 
-    if (NtfsReadMftRecord(0, mft0) != 0) {
+    if (NtfsReadMftRecord(vol, 0, mft0) != 0) {
         KernelFree(mft0);
         rust_rwlock_write_unlock(volume.lock);
         return -1;
@@ -1077,50 +1805,24 @@ int NtfsDelete(const char* path) {
                 uint32_t byte_index = mft_record_num / 8;
                 uint32_t bit_index = mft_record_num % 8;
                 bitmap_data[byte_index] &= ~(1 << bit_index);
-
-                uint64_t mft_start_sector = volume.mft_cluster * volume.sectors_per_cluster;
-                uint64_t record_byte_offset = 0 * mft_record_size;
-                uint64_t record_sector = mft_start_sector + (record_byte_offset / volume.bytes_per_sector);
-                uint32_t sectors_needed = (mft_record_size + volume.bytes_per_sector - 1) / volume.bytes_per_sector;
-                volume.device->write_blocks(volume.device, record_sector, sectors_needed, mft0);
+                NtfsWriteMftRecord(vol, 0, mft0);
             } else {
-                // Minimal support for clearing bit in non-resident $MFT::$BITMAP (first run only)
-                int64_t lcn = -1;
-                uint64_t run_clusters = 0;
-                if (NtfsParseFirstRun(attr, &lcn, &run_clusters) != 0 || lcn < 0 || run_clusters == 0) {
+                NtfsRunMap map;
+                if (NtfsLoadRunMap(vol, mft0, 0, NTFS_ATTR_BITMAP, NULL, &map) != 0) {
                     PrintKernel("NTFS: $MFT::$BITMAP clear-bit unsupported mapping pairs\n");
                     break;
                 }
-                uint64_t total_bytes = run_clusters * (uint64_t)volume.bytes_per_cluster;
-                if (attr->nonresident.data_size < total_bytes) total_bytes = attr->nonresident.data_size;
-                if (total_bytes == 0) {
-                    PrintKernel("NTFS: $MFT::$BITMAP non-resident empty while clearing\n");
-                    break;
-                }
-                uint32_t sectors = (uint32_t)((total_bytes + volume.bytes_per_sector - 1) / volume.bytes_per_sector);
-                uint8_t* bitmap_buf = KernelMemoryAlloc((size_t)sectors * volume.bytes_per_sector);
-                if (!bitmap_buf) {
-                    PrintKernel("NTFS: Failed to alloc bitmap buffer (clear)\n");
-                    break;
-                }
-                uint64_t start_sector = (uint64_t)lcn * volume.sectors_per_cluster;
-                if (volume.device->read_blocks(volume.device, start_sector, sectors, bitmap_buf) != 0) {
+                const uint64_t byte_index = mft_record_num / 8;
+                uint8_t byte;
+                if (byte_index >= map.init_size || NtfsRunMapIo(vol, &map, byte_index, &byte, 1, 0) != 1) {
                     PrintKernel("NTFS: Failed to read non-resident $MFT::$BITMAP (clear)\n");
-                    KernelFree(bitmap_buf);
-                    break;
-                }
-                uint64_t byte_index = mft_record_num / 8;
-                uint32_t bit_index = (uint32_t)(mft_record_num % 8);
-                uint64_t available_bytes = (uint64_t)sectors * volume.bytes_per_sector;
-                if (byte_index < available_bytes) {
-                    bitmap_buf[byte_index] &= (uint8_t)~(1u << bit_index);
-                    if (volume.device->write_blocks(volume.device, start_sector, sectors, bitmap_buf) != 0) {
+                } else {
+                    byte &= (uint8_t)~(1u << (mft_record_num % 8));
+                    if (NtfsRunMapIo(vol, &map, byte_index, &byte, 1, 1) != 1) {
                         PrintKernel("NTFS: Failed to write non-resident $MFT::$BITMAP (clear)\n");
                     }
-                } else {
-                    PrintKernel("NTFS: Clear target outside first run (unsupported)\n");
                 }
-                KernelFree(bitmap_buf);
+                NtfsRunMapFree(&map);
             }
             break;
         }
@@ -1131,4 +1833,214 @@ int NtfsDelete(const char* path) {
     rust_rwlock_write_unlock(volume.lock);
 
     return 0;
-}
\ No newline at end of file
+}
+// Open-file objects: the MFT record is parsed once at open. Resident data is
+// kept in memory; non-resident data is addressed through its extent map.
+// There is one object per record, shared by every handle open on it, so
+// writes through one handle or by path are seen by the others.
+typedef struct NtfsFile {
+    NtfsVolume* vol;
+    uint64_t record_num;
+    uint64_t size;
+    int resident;
+    uint8_t* data;          // resident value copy
+    uint32_t value_offset;  // byte offset of the resident value in the record
+    NtfsRunMap map;
+    uint32_t refs;          // handles open on this object
+    int unlinked;           // record freed; I/O through the handles fails
+    struct NtfsFile* next;  // volume's open_files list
+} NtfsFile;
+
+// Callers hold the volume lock for writing
+static NtfsFile* NtfsFindOpen(NtfsVolume* vol, uint64_t record_num) {
+    for (NtfsFile* file = volume.open_files; file; file = file->next) {
+        if (file->record_num == record_num) return file;
+    }
+    return NULL;
+}
+
+// A path-based write rewrote the head of a record's resident value
+static void NtfsOpenUpdate(NtfsVolume* vol, uint64_t record_num, const void* data, uint32_t length) {
+    NtfsFile* file = NtfsFindOpen(vol, record_num);
+    if (!file || !file->resident) return;
+    if (length > file->size) length = (uint32_t)file->size;
+    FastMemcpy(file->data, data, length);
+}
+
+// The record was freed. Handles keep the object until they close, but it
+// leaves the list so a reuse of the record number opens a fresh one.
+static void NtfsOpenUnlink(NtfsVolume* vol, uint64_t record_num) {
+    for (NtfsFile** link = &volume.open_files; *link; link = &(*link)->next) {
+        NtfsFile* file = *link;
+        if (file->record_num != record_num) continue;
+        *link = file->next;
+        file->next = NULL;
+        file->unlinked = 1;
+        return;
+    }
+}
+
+void* NtfsOpen(void* fs_data, const char* path, int flags) {
+    NtfsVolume* vol = fs_data;
+    if (!path || !volume.lock) return NULL;
+
+    uint64_t record_num = NtfsPathToMftRecord(vol, path);
+    if (record_num == 0 && (flags & FS_CREATE)) {
+        if (NtfsCreateFile(vol, path) == 0) record_num = NtfsPathToMftRecord(vol, path);
+    }
+    if (record_num == 0) return NULL;
+
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+    NtfsFile* file = NtfsFindOpen(vol, record_num);
+    if (file) {
+        file->refs++;
+        rust_rwlock_write_unlock(volume.lock);
+        return file;
+    }
+
+    const uint32_t record_size = NtfsRecordSize(vol);
+    NtfsMftRecord* record = KernelMemoryAlloc(record_size);
+    file = record ? KernelMemoryAlloc(sizeof(NtfsFile)) : NULL;
+    if (!file) {
+        if (record) KernelFree(record);
+        rust_rwlock_write_unlock(volume.lock);
+        return NULL;
+    }
+    FastMemset(file, 0, sizeof(NtfsFile));
+    file->vol = vol;
+    file->record_num = record_num;
+    file->refs = 1;
+
+    int ok = NtfsReadMftRecord(vol, record_num, record) == 0;
+    NtfsAttrHeader* attr = ok ? NtfsFindAttr(record, record_size, NTFS_ATTR_DATA, NULL, 0) : NULL;
+    if (ok && (!attr || attr->non_resident)) {
+        // Non-resident, or split across extension records via $ATTRIBUTE_LIST
+        if (NtfsLoadRunMap(vol, record, record_num, NTFS_ATTR_DATA, NULL, &file->map) != 0) ok = 0;
+        else file->size = file->map.data_size;
+    } else if (ok) {
+        const uint32_t value_offset = (uint32_t)((uint8_t*)attr - (uint8_t*)record) + attr->resident.value_offset;
+        const uint32_t length = attr->resident.value_length;
+        if (value_offset + length > record_size) {
+            ok = 0;
+        } else {
+            file->resident = 1;
+            file->size = length;
+            file->value_offset = value_offset;
+            file->data = KernelMemoryAlloc(length ? length : 1);
+            if (!file->data) ok = 0;
+            else FastMemcpy(file->data, (uint8_t*)record + value_offset, length);
+        }
+    }
+    if (ok) {
+        file->next = volume.open_files;
+        volume.open_files = file;
+    }
+    rust_rwlock_write_unlock(volume.lock);
+
+    KernelFree(record);
+    if (!ok) {
+        NtfsClose(file);
+        return NULL;
+    }
+    return file;
+}
+
+int64_t NtfsReadAt(void* handle, uint64_t offset, void* buffer, uint64_t count) {
+    NtfsFile* file = handle;
+    if (!file || !buffer || file->unlinked) return -1;
+    NtfsVolume* vol = file->vol;
+    if (offset >= file->size) return 0;
+    if (count > file->size - offset) count = file->size - offset;
+
+    // The resident copy is shared, and rewritten under the write lock
+    rust_rwlock_read_lock(volume.lock, GetCurrentProcess()->pid);
+    int64_t result = (int64_t)count;
+    if (file->resident) FastMemcpy(buffer, file->data + offset, count);
+    else result = NtfsRunMapIo(vol, &file->map, offset, buffer, count, 0);
+    rust_rwlock_read_unlock(volume.lock, GetCurrentProcess()->pid);
+    return result;
+}
+
+// Writes stay within the existing data size and never fill sparse runs;
+// attributes are never resized
+int64_t NtfsWriteAt(void* handle, uint64_t offset, const void* buffer, uint64_t count) {
+    NtfsFile* file = handle;
+    if (!file || !buffer) return -1;
+    NtfsVolume* vol = file->vol;
+    if (offset >= file->size) return count ? -1 : 0;
+    if (count > file->size - offset) count = file->size - offset;
+
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+    if (file->unlinked) {
+        rust_rwlock_write_unlock(volume.lock);
+        return -1;
+    }
+
+    if (file->resident) {
+        const uint32_t record_size = NtfsRecordSize(vol);
+        NtfsMftRecord* record = KernelMemoryAlloc(record_size);
+        int64_t result = -1;
+        if (record && NtfsReadMftRecord(vol, file->record_num, record) == 0) {
+            FastMemcpy((uint8_t*)record + file->value_offset + offset, buffer, count);
+            if (NtfsWriteMftRecord(vol, file->record_num, record) == 0) {
+                FastMemcpy(file->data + offset, buffer, count);
+                result = (int64_t)count;
+            }
+        }
+        if (record) KernelFree(record);
+        rust_rwlock_write_unlock(volume.lock);
+        return result;
+    }
+
+    const int64_t result = NtfsRunMapIo(vol, &file->map, offset, (void*)buffer, count, 1);
+    rust_rwlock_write_unlock(volume.lock);
+    return result;
+}
+
+uint64_t NtfsFileSize(void* handle) {
+    NtfsFile* file = handle;
+    return file ? file->size : 0;
+}
+
+void NtfsClose(void* handle) {
+    NtfsFile* file = handle;
+    if (!file) return;
+    NtfsVolume* vol = file->vol;
+    rust_rwlock_write_lock(volume.lock, GetCurrentProcess()->pid);
+    if (file->refs > 1) {
+        file->refs--;
+        rust_rwlock_write_unlock(volume.lock);
+        return;
+    }
+    for (NtfsFile** link = &volume.open_files; *link; link = &(*link)->next) {
+        if (*link == file) {
+            *link = file->next;
+            break;
+        }
+    }
+    rust_rwlock_write_unlock(volume.lock);
+    if (file->data) KernelFree(file->data);
+    NtfsRunMapFree(&file->map);
+    KernelFree(file);
+}
+
+FileSystemDriver g_ntfs_driver = {
+    .name = "NTFS",
+    .detect = NtfsDetect,
+    .mount = NtfsMount,
+    .unmount = NtfsUnmount,
+    .read_file = NtfsReadFile,
+    .write_file = NtfsWriteFile,
+    .list_dir = NtfsListDir,
+    .create_file = NtfsCreateFile,
+    .create_dir = NtfsCreateDir,
+    .remove = NtfsDelete,
+    .is_dir = NtfsIsDir,
+    .is_file = NtfsIsFile,
+    .get_size = NtfsGetFileSize,
+    .open = NtfsOpen,
+    .read_at = NtfsReadAt,
+    .write_at = NtfsWriteAt,
+    .file_size = NtfsFileSize,
+    .close = NtfsClose,
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <BlockDevice.h>
+#include <FileSystem.h>
 #include <stdint.h>
 #include <KernelHeap.h>
 
@@ -81,12 +82,32 @@ typedef struct {
 
 // Attribute Types
 #define NTFS_ATTR_STANDARD_INFO     0x10
+#define NTFS_ATTR_ATTRIBUTE_LIST    0x20
 #define NTFS_ATTR_FILENAME          0x30
 #define NTFS_ATTR_DATA              0x80
 #define NTFS_ATTR_INDEX_ROOT        0x90
 #define NTFS_ATTR_INDEX_ALLOCATION  0xA0
 #define NTFS_ATTR_BITMAP            0xB0
 
+// Attribute header flags
+#define NTFS_ATTR_FLAG_COMPRESSED   0x0001
+#define NTFS_ATTR_FLAG_ENCRYPTED    0x4000
+#define NTFS_ATTR_FLAG_SPARSE       0x8000
+
+// $ATTRIBUTE_LIST entry: where each piece of an attribute split across
+// extension records lives
+typedef struct {
+    uint32_t type;
+    uint16_t length;
+    uint8_t  name_length;
+    uint8_t  name_offset;
+    uint64_t lowest_vcn;
+    uint64_t mft_reference;     // low 48 bits: record number
+    uint16_t instance;
+} __attribute__((packed)) NtfsAttrListEntry;
+
+#define NTFS_MFT_REF_MASK           0x0000FFFFFFFFFFFFULL
+
 typedef struct {
     uint64_t creation_time;
     uint64_t last_modification_time;
@@ -105,15 +126,43 @@ typedef struct {
     uint8_t reserved[3];
 } __attribute__((packed)) NtfsIndexRoot;
 
-// Index Entry
+// Index node header, at the end of NtfsIndexRoot and at offset 0x18 of an
+// index block; offsets are relative to the header itself
+typedef struct {
+    uint32_t entries_offset;
+    uint32_t index_length;
+    uint32_t allocated_size;
+    uint8_t  flags;
+    uint8_t  reserved[3];
+} __attribute__((packed)) NtfsIndexHeader;
+
+// Index block ("INDX") in $INDEX_ALLOCATION, protected by fixups like a
+// FILE record
+typedef struct {
+    uint32_t signature;
+    uint16_t update_seq_offset;
+    uint16_t update_seq_size;
+    uint64_t lsn;
+    uint64_t vcn;
+    NtfsIndexHeader header;
+} __attribute__((packed)) NtfsIndexBlock;
+
+// Index Entry: the key (a FILE_NAME value in directories) follows the
+// header; entries with NTFS_INDEX_ENTRY_NODE end in their child's VCN
 typedef struct {
-    uint64_t mft_record_number;
+    uint64_t mft_reference;
     uint16_t length;
-    uint16_t file_name_length;
-    uint32_t flags;
-    uint16_t file_name[1];
+    uint16_t key_length;
+    uint16_t flags;
+    uint16_t reserved;
 } __attribute__((packed)) NtfsIndexEntry;
 
+#define NTFS_INDEX_ENTRY_NODE       0x01
+#define NTFS_INDEX_ENTRY_END        0x02
+#define NTFS_INDX_SIGNATURE         0x58444E49  // "INDX"
+#define NTFS_COLLATION_FILENAME     0x01
+#define NTFS_UPCASE_RECORD          10
+
 // File Name Attribute
 typedef struct {
     uint64_t parent_directory;
@@ -130,21 +179,32 @@ typedef struct {
     uint16_t filename[];
 } __attribute__((packed)) NtfsFilename;
 
+// Per-mount volume state, passed to every operation as fs_data
+typedef struct NtfsVolume NtfsVolume;
+
+extern FileSystemDriver g_ntfs_driver;
+
 // VFS Interface Functions
 int NtfsDetect(struct BlockDevice* device);
 int NtfsMount(struct BlockDevice* device, const char* mount_point);
 int NtfsUnmount(struct BlockDevice* device);
-int NtfsReadFile(const char* path, void* buffer, uint32_t max_size);
-int NtfsWriteFile(const char* path, const void* buffer, uint32_t size);
-int NtfsListDir(const char* path);
-int NtfsIsFile(const char* path);
-int NtfsIsDir(const char* path);
-uint64_t NtfsGetFileSize(const char* path);
-int NtfsCreateFile(const char* path);
-int NtfsCreateDir(const char* path);
-int NtfsDelete(const char* path);
-void NtfsSetActive(BlockDevice* device);
+int64_t NtfsReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size);
+int64_t NtfsWriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size);
+int NtfsListDir(void* fs_data, const char* path);
+int NtfsIsFile(void* fs_data, const char* path);
+int NtfsIsDir(void* fs_data, const char* path);
+uint64_t NtfsGetFileSize(void* fs_data, const char* path);
+int NtfsCreateFile(void* fs_data, const char* path);
+int NtfsCreateDir(void* fs_data, const char* path);
+int NtfsDelete(void* fs_data, const char* path, int recursive);
+
+// Open-file objects for positioned I/O; FS_CREATE creates a missing file
+void* NtfsOpen(void* fs_data, const char* path, int flags);
+int64_t NtfsReadAt(void* handle, uint64_t offset, void* buffer, uint64_t count);
+int64_t NtfsWriteAt(void* handle, uint64_t offset, const void* buffer, uint64_t count);
+uint64_t NtfsFileSize(void* handle);
+void NtfsClose(void* handle);
 
 // Internal Functions
-int NtfsReadMftRecord(uint64_t record_num, NtfsMftRecord* record);
-uint64_t NtfsPathToMftRecord(const char* path);
\ No newline at end of file
+int NtfsReadMftRecord(NtfsVolume* vol, uint64_t record_num, NtfsMftRecord* record);
+uint64_t NtfsPathToMftRecord(NtfsVolume* vol, const char* path);
\ No newline at end of file
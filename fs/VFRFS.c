@@ -7,19 +7,20 @@
 
 // --- Static Globals ---
 static FsNode* root_node = NULL;
-static FileHandle file_handles[MAX_OPEN_FILES];
-static FsNode fs_nodes[MAX_FS_NODES];
 
-// --- IMPROVED: "Next free" hints to speed up allocation ---
-static uint32_t next_node_idx_hint = 0;
-static uint32_t next_handle_idx_hint = 0;
+// Free nodes are chained through next_sibling, free handles through
+// next_free. handle_table maps fd - 1 to its handle.
+static FsNode* free_nodes = NULL;
+static FileHandle* free_handles = NULL;
+static FileHandle** handle_table = NULL;
+static uint32_t handle_count = 0;
 
 static uint32_t next_node_id = 1;
-static uint32_t next_fd = 1;
 
 // --- Forward Declarations for new helper functions ---
 static void FsDeleteRecursiveI(FsNode* node);
 static FsNode* FsFindParent(const char* path, char* child_name_out);
+static void FsPagesTruncate(FsNode* node, uint64_t size);
 
 // --- Time placeholder ---
 static uint64_t GetCurrentTime(void) {
@@ -29,55 +30,301 @@ static uint64_t GetCurrentTime(void) {
 // --- Node and Handle Management ---
 
 static FsNode* AllocNode(void) {
-    for (int i = 0; i < MAX_FS_NODES; i++) {
-        uint32_t idx = (next_node_idx_hint + i) % MAX_FS_NODES;
-        if (fs_nodes[idx].node_id == 0) {
-            fs_nodes[idx].node_id = next_node_id++;
-            next_node_idx_hint = idx + 1;
-            return &fs_nodes[idx];
+    if (!free_nodes) {
+        FsNode* slab = KernelMemoryAlloc(VFRFS_SLAB_OBJECTS * sizeof(FsNode));
+        if (!slab) return NULL; // No free nodes
+        for (int i = 0; i < VFRFS_SLAB_OBJECTS; i++) {
+            slab[i].next_sibling = free_nodes;
+            free_nodes = &slab[i];
         }
     }
-    return NULL; // No free nodes
+
+    FsNode* node = free_nodes;
+    free_nodes = node->next_sibling;
+    FastMemset(node, 0, sizeof(FsNode));
+    node->node_id = next_node_id++;
+    return node;
 }
 
 static void FreeNode(FsNode* node) {
-    if (node && node >= fs_nodes && node < fs_nodes + MAX_FS_NODES) {
-        if (node->data) {
-            KernelFree(node->data);
-        }
-        FastMemset(node, 0, sizeof(FsNode));
-    }
+    if (!node) return;
+    FsPagesTruncate(node, 0);
+    if (node->child_hash) KernelFree(node->child_hash);
+    FastMemset(node, 0, sizeof(FsNode));
+    node->next_sibling = free_nodes;
+    free_nodes = node;
 }
 
 static FileHandle* AllocHandle(void) {
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        uint32_t idx = (next_handle_idx_hint + i) % MAX_OPEN_FILES;
-        if (file_handles[idx].fd == 0) {
-            file_handles[idx].fd = next_fd++;
-            if (next_fd == 0) next_fd = 1; // Avoid fd=0 and handle wrap-around
-            next_handle_idx_hint = idx + 1;
-            return &file_handles[idx];
+    if (!free_handles) {
+        // Double the fd table and back the new fds with one slab of handles
+        uint32_t grow = handle_count ? handle_count : VFRFS_SLAB_OBJECTS;
+        FileHandle** table = KernelMemoryAlloc((handle_count + grow) * sizeof(FileHandle*));
+        FileHandle* slab = KernelMemoryAlloc(grow * sizeof(FileHandle));
+        if (!table || !slab) {
+            if (table) KernelFree(table);
+            if (slab) KernelFree(slab);
+            return NULL; // No free handles
+        }
+        FastMemset(slab, 0, grow * sizeof(FileHandle));
+        if (handle_table) {
+            FastMemcpy(table, handle_table, handle_count * sizeof(FileHandle*));
+            KernelFree(handle_table);
+        }
+        handle_table = table;
+
+        for (int i = (int)grow - 1; i >= 0; i--) {
+            slab[i].fd = handle_count + (uint32_t)i + 1;
+            slab[i].next_free = free_handles;
+            free_handles = &slab[i];
+            handle_table[handle_count + i] = &slab[i];
         }
+        handle_count += grow;
     }
-    return NULL; // No free handles
+
+    FileHandle* handle = free_handles;
+    free_handles = handle->next_free;
+    handle->next_free = NULL;
+    return handle;
+}
+
+static void FreeHandle(FileHandle* handle) {
+    uint32_t fd = handle->fd;
+    FastMemset(handle, 0, sizeof(FileHandle));
+    handle->fd = fd;
+    handle->next_free = free_handles;
+    free_handles = handle;
 }
 
 static FileHandle* GetHandle(int fd) {
-    if (fd <= 0) return NULL;
-    for (int i = 0; i < MAX_OPEN_FILES; i++) {
-        if (file_handles[i].fd == fd) {
-            return &file_handles[i];
+    if (fd <= 0 || (uint32_t)fd > handle_count) return NULL;
+    FileHandle* handle = handle_table[fd - 1];
+    return handle->node ? handle : NULL;
+}
+
+// --- Directory Index ---
+
+static uint32_t FsNameHash(const char* name) {
+    uint32_t h = 2166136261u; // FNV-1a
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static FsNode* FsLookupChild(FsNode* dir, const char* name, uint32_t hash) {
+    if (!dir->child_hash) return NULL;
+    for (FsNode* child = dir->child_hash[hash & (dir->child_buckets - 1)]; child; child = child->hash_next) {
+        if (child->name_hash == hash && FastStrCmp(child->name, name) == 0) {
+            return child;
         }
     }
     return NULL;
 }
 
+// Adds a named child to dir's index; fails only if dir has no table yet
+// and one cannot be allocated, a failed resize just keeps longer chains
+static int FsHashInsert(FsNode* dir, FsNode* child) {
+    if (dir->child_count >= dir->child_buckets) {
+        uint32_t buckets = dir->child_buckets ? dir->child_buckets * 2 : VFRFS_HASH_MIN_BUCKETS;
+        FsNode** table = KernelMemoryAlloc(buckets * sizeof(FsNode*));
+        if (table) {
+            FastMemset(table, 0, buckets * sizeof(FsNode*));
+            for (uint32_t i = 0; i < dir->child_buckets; i++) {
+                FsNode* n = dir->child_hash[i];
+                while (n) {
+                    FsNode* next = n->hash_next;
+                    n->hash_next = table[n->name_hash & (buckets - 1)];
+                    table[n->name_hash & (buckets - 1)] = n;
+                    n = next;
+                }
+            }
+            if (dir->child_hash) KernelFree(dir->child_hash);
+            dir->child_hash = table;
+            dir->child_buckets = buckets;
+        } else if (!dir->child_hash) {
+            return -1;
+        }
+    }
+
+    FsNode** bucket = &dir->child_hash[child->name_hash & (dir->child_buckets - 1)];
+    child->hash_next = *bucket;
+    *bucket = child;
+    dir->child_count++;
+    return 0;
+}
+
+static void FsHashRemove(FsNode* dir, FsNode* child) {
+    if (!dir->child_hash) return;
+    FsNode** link = &dir->child_hash[child->name_hash & (dir->child_buckets - 1)];
+    while (*link) {
+        if (*link == child) {
+            *link = child->hash_next;
+            child->hash_next = NULL;
+            dir->child_count--;
+            return;
+        }
+        link = &(*link)->hash_next;
+    }
+}
+
+// --- File Pages ---
+
+typedef struct {
+    void* slots[VFRFS_RADIX_SLOTS];
+} FsPageNode;
+
+// Number of pages a tree of the given height can address
+static uint64_t FsPagesSpan(uint32_t height) {
+    const uint32_t shift = height * VFRFS_RADIX_SHIFT;
+    return shift >= 64 ? UINT64_MAX : 1ULL << shift;
+}
+
+static void* FsAllocZeroed(size_t size) {
+    void* p = KernelMemoryAlloc(size);
+    if (p) FastMemset(p, 0, size);
+    return p;
+}
+
+// Returns page `index` of the file, or NULL for a hole. With `create` the
+// tree grows as needed and a zeroed page is allocated in place of the hole.
+static uint8_t* FsPageLookup(FsNode* node, uint64_t index, int create) {
+    while (index >= FsPagesSpan(node->page_height)) {
+        if (!create) return NULL;
+        if (node->pages) {
+            FsPageNode* top = FsAllocZeroed(sizeof(FsPageNode));
+            if (!top) return NULL;
+            top->slots[0] = node->pages;
+            node->pages = top;
+        }
+        node->page_height++;
+    }
+
+    void** slot = &node->pages;
+    for (uint32_t h = node->page_height; h > 0; h--) {
+        if (!*slot) {
+            if (!create) return NULL;
+            *slot = FsAllocZeroed(sizeof(FsPageNode));
+            if (!*slot) return NULL;
+        }
+        const uint32_t i = (uint32_t)(index >> ((h - 1) * VFRFS_RADIX_SHIFT)) & (VFRFS_RADIX_SLOTS - 1);
+        slot = &((FsPageNode*)*slot)->slots[i];
+    }
+    if (!*slot && create) *slot = FsAllocZeroed(VFRFS_PAGE_SIZE);
+    return *slot;
+}
+
+// Frees every page from `first` on below *slot, along with interior nodes
+// left empty. Returns 1 when *slot is gone.
+static int FsPagesTrim(void** slot, uint32_t height, uint64_t first) {
+    if (!*slot) return 1;
+    if (height == 0) {
+        if (first > 0) return 0;
+        KernelFree(*slot);
+        *slot = NULL;
+        return 1;
+    }
+
+    FsPageNode* tree = *slot;
+    const uint64_t span = FsPagesSpan(height - 1);
+    int empty = 1;
+    for (uint32_t i = 0; i < VFRFS_RADIX_SLOTS; i++) {
+        const uint64_t base = i * span;
+        if (first >= base + span) {
+            if (tree->slots[i]) empty = 0;
+            continue;
+        }
+        if (!FsPagesTrim(&tree->slots[i], height - 1, first > base ? first - base : 0)) empty = 0;
+    }
+    if (empty) {
+        KernelFree(tree);
+        *slot = NULL;
+    }
+    return empty;
+}
+
+// Drops the pages past `size` and zeroes the rest of the last one, so that
+// growing the file again reads zeroes there
+static void FsPagesTruncate(FsNode* node, uint64_t size) {
+    const uint64_t keep = (size + VFRFS_PAGE_SIZE - 1) / VFRFS_PAGE_SIZE;
+    FsPagesTrim(&node->pages, node->page_height, keep);
+
+    // Collapse the tree while only its first slot is in use
+    while (node->page_height > 0 && node->pages) {
+        FsPageNode* top = node->pages;
+        int single = 1;
+        for (uint32_t i = 1; i < VFRFS_RADIX_SLOTS && single; i++) {
+            if (top->slots[i]) single = 0;
+        }
+        if (!single) break;
+        node->pages = top->slots[0];
+        node->page_height--;
+        KernelFree(top);
+    }
+    if (!node->pages) node->page_height = 0;
+
+    const uint32_t tail = (uint32_t)(size % VFRFS_PAGE_SIZE);
+    if (tail) {
+        uint8_t* page = FsPageLookup(node, size / VFRFS_PAGE_SIZE, 0);
+        if (page) FastMemset(page + tail, 0, VFRFS_PAGE_SIZE - tail);
+    }
+}
+
+static int FsIsZero(const uint8_t* p, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (p[i]) return 0;
+    }
+    return 1;
+}
+
+static uint64_t FsPagesRead(FsNode* node, uint64_t offset, void* buffer, uint64_t count) {
+    if (offset >= node->size) return 0;
+    if (count > node->size - offset) count = node->size - offset;
+
+    uint8_t* out = buffer;
+    uint64_t done = 0;
+    while (done < count) {
+        const uint64_t pos = offset + done;
+        const uint32_t in_page = (uint32_t)(pos % VFRFS_PAGE_SIZE);
+        uint32_t chunk = VFRFS_PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = (uint32_t)(count - done);
+
+        const uint8_t* page = FsPageLookup(node, pos / VFRFS_PAGE_SIZE, 0);
+        if (page) FastMemcpy(out + done, page + in_page, chunk);
+        else FastMemset(out + done, 0, chunk);
+        done += chunk;
+    }
+    return done;
+}
+
+// Writes that would only put zeroes into a hole leave it unallocated.
+// Returns the bytes written, short on allocation failure.
+static uint64_t FsPagesWrite(FsNode* node, uint64_t offset, const void* buffer, uint64_t count) {
+    const uint8_t* in = buffer;
+    uint64_t done = 0;
+    while (done < count) {
+        const uint64_t pos = offset + done;
+        const uint32_t in_page = (uint32_t)(pos % VFRFS_PAGE_SIZE);
+        uint32_t chunk = VFRFS_PAGE_SIZE - in_page;
+        if (chunk > count - done) chunk = (uint32_t)(count - done);
+
+        uint8_t* page = FsPageLookup(node, pos / VFRFS_PAGE_SIZE, 0);
+        if (!page && !FsIsZero(in + done, chunk)) {
+            page = FsPageLookup(node, pos / VFRFS_PAGE_SIZE, 1);
+            if (!page) break; // Out of memory
+        }
+        if (page) FastMemcpy(page + in_page, in + done, chunk);
+        done += chunk;
+    }
+
+    if (offset + done > node->size) node->size = offset + done;
+    return done;
+}
+
 // --- Core Filesystem Logic ---
 
 int FsInit(void) {
-    FastMemset(file_handles, 0, sizeof(file_handles));
-    FastMemset(fs_nodes, 0, sizeof(fs_nodes));
-
     root_node = AllocNode();
     if (!root_node) return -1;
 
@@ -95,18 +342,25 @@ FsNode* FsCreateNode(const char* name, FsNodeType type, FsNode* parent) {
         return NULL;
     }
 
+    char stored[MAX_FILENAME];
+    FastStrCopy(stored, name, MAX_FILENAME - 1);
+    stored[MAX_FILENAME - 1] = '\0';
+    uint32_t hash = FsNameHash(stored);
+
     // Check if a node with the same name already exists
-    for (FsNode* child = parent->children; child; child = child->next_sibling) {
-        if (FastStrCmp(child->name, name) == 0) {
-            return NULL; // Already exists
-        }
+    if (FsLookupChild(parent, stored, hash)) {
+        return NULL; // Already exists
     }
 
     FsNode* node = AllocNode();
     if (!node) return NULL;
 
-    FastStrCopy(node->name, name, MAX_FILENAME - 1);
-    node->name[MAX_FILENAME - 1] = '\0';
+    FastMemcpy(node->name, stored, MAX_FILENAME);
+    node->name_hash = hash;
+    if (FsHashInsert(parent, node) != 0) {
+        FreeNode(node);
+        return NULL;
+    }
     node->type = type;
     node->parent = parent;
     node->created_time = GetCurrentTime();
@@ -163,17 +417,10 @@ FsNode* FsFind(const char* path) {
             continue;
         }
 
-        // Search for the component in the current directory's children
-        FsNode* child = current->children;
-        while (child) {
-            if (FastStrCmp(child->name, name_buf) == 0) {
-                current = child;
-                break;
-            }
-            child = child->next_sibling;
-        }
-
+        // Look the component up in the current directory's index
+        FsNode* child = FsLookupChild(current, name_buf, FsNameHash(name_buf));
         if (!child) return NULL; // Component not found
+        current = child;
     }
 
     return current;
@@ -185,9 +432,9 @@ FsNode* FsFind(const char* path) {
 int FsOpen(const char* path, FsOpenFlags flags) {
     FsNode* node = FsFind(path);
 
-    // If the file doesn't exist, create it if write flag is set
+    // If the file doesn't exist, create it if asked to
     if (!node) {
-        if (flags & FS_WRITE) {
+        if (flags & FS_CREATE) {
             char filename[MAX_FILENAME];
             FsNode* parent = FsFindParent(path, filename);
             if (!parent) return -1; // Invalid parent path
@@ -215,29 +462,23 @@ int FsOpen(const char* path, FsOpenFlags flags) {
 int FsClose(int fd) {
     FileHandle* handle = GetHandle(fd);
     if (!handle) return -1;
-    FastMemset(handle, 0, sizeof(FileHandle));
+    FreeHandle(handle);
     return 0;
 }
 
-int FsRead(int fd, void* buffer, size_t size) {
+int64_t FsRead(int fd, void* buffer, uint64_t size) {
     FileHandle* handle = GetHandle(fd);
     if (!handle || !(handle->flags & FS_READ) || !buffer) return -1;
 
     FsNode* node = handle->node;
-    if (!node || !node->data) return 0; // Reading from an empty file
-
-    uint64_t readable_size = node->size - handle->position;
-    size_t bytes_to_read = (size > readable_size) ? readable_size : size;
-
-    if (bytes_to_read > 0) {
-        FastMemcpy(buffer, (char*)node->data + handle->position, bytes_to_read);
-        handle->position += bytes_to_read;
-    }
+    if (!node) return 0;
 
-    return bytes_to_read;
+    uint64_t bytes_read = FsPagesRead(node, handle->position, buffer, size);
+    handle->position += bytes_read;
+    return bytes_read;
 }
 
-int FsWrite(int fd, const void* buffer, size_t size) {
+int64_t FsWrite(int fd, const void* buffer, uint64_t size) {
     FileHandle* handle = GetHandle(fd);
     if (!handle || !(handle->flags & FS_WRITE) || !buffer) return -1;
     if (size == 0) return 0;
@@ -245,19 +486,12 @@ int FsWrite(int fd, const void* buffer, size_t size) {
     FsNode* node = handle->node;
     if (!node) return -1;
 
-    uint64_t new_size = handle->position + size;
-    if (new_size > node->size) {
-        void* new_data = KernelReallocate(node->data, new_size);
-        if (!new_data) return -1; // Out of memory
-        node->data = new_data;
-        node->size = new_size;
-    }
-
-    FastMemcpy((char*)node->data + handle->position, buffer, size);
-    handle->position += size;
+    uint64_t written = FsPagesWrite(node, handle->position, buffer, size);
+    if (written == 0) return -1; // Out of memory
+    handle->position += written;
     node->modified_time = GetCurrentTime();
 
-    return size;
+    return written;
 }
 
 int64_t FsSeek(int fd, int64_t offset, int whence) {
@@ -287,6 +521,19 @@ int64_t FsSeek(int fd, int64_t offset, int whence) {
     return new_pos;
 }
 
+// Sets the file size; pages past the new end are freed and growing leaves
+// a hole
+int FsTruncate(int fd, uint64_t size) {
+    FileHandle* handle = GetHandle(fd);
+    if (!handle || !(handle->flags & FS_WRITE) || !handle->node) return -1;
+
+    FsNode* node = handle->node;
+    if (size < node->size) FsPagesTruncate(node, size);
+    node->size = size;
+    node->modified_time = GetCurrentTime();
+    return 0;
+}
+
 // --- Directory and Deletion Operations ---
 
 int FsMkdir(const char* path) {
@@ -302,6 +549,7 @@ static void UnlinkNode(FsNode* node) {
     if (!node || !node->parent) return;
 
     FsNode* parent = node->parent;
+    FsHashRemove(parent, node);
     if (node->prev_sibling) {
         node->prev_sibling->next_sibling = node->next_sibling;
     } else {
@@ -451,16 +699,131 @@ int FsListDir(const char* path) {
 // --- High-Level Wrappers ---
 
 int FsCreateFile(const char* path) {
-    int fd = FsOpen(path, FS_WRITE);
+    int fd = FsOpen(path, FS_WRITE | FS_CREATE);
     if (fd < 0) return -1;
     FsClose(fd);
     return 0;
 }
 
-int FsWriteFile(const char* path, const void* buffer, size_t size) {
-    int fd = FsOpen(path, FS_WRITE | FS_APPEND);
+int64_t FsWriteFile(const char* path, const void* buffer, uint64_t size) {
+    int fd = FsOpen(path, FS_WRITE | FS_APPEND | FS_CREATE);
+    if (fd < 0) return -1;
+    int64_t result = FsWrite(fd, buffer, size);
+    FsClose(fd);
+    return result;
+}
+// --- VFS Driver ---
+// The root RAM filesystem behind the "/" mount; it has no per-mount state,
+// and its open-file handles are the FileHandle objects above.
+
+static int64_t VfrfsReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size) {
+    (void)fs_data;
+    FsNode* node = FsFind(path);
+    if (!node || node->type != FS_FILE) return -1;
+    return (int64_t)FsPagesRead(node, 0, buffer, max_size);
+}
+
+// Replaces the file's contents
+static int64_t VfrfsWriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size) {
+    (void)fs_data;
+    int fd = FsOpen(path, FS_WRITE | FS_CREATE);
     if (fd < 0) return -1;
-    int result = FsWrite(fd, buffer, size);
+    int64_t result = size ? FsWrite(fd, buffer, size) : 0;
+    if (result >= 0 && FsTruncate(fd, (uint64_t)result) != 0) result = -1;
     FsClose(fd);
     return result;
-}
\ No newline at end of file
+}
+
+static int VfrfsListDir(void* fs_data, const char* path) {
+    (void)fs_data;
+    return FsListDir(path);
+}
+
+static int VfrfsCreateFile(void* fs_data, const char* path) {
+    (void)fs_data;
+    return FsCreateFile(path);
+}
+
+static int VfrfsCreateDir(void* fs_data, const char* path) {
+    (void)fs_data;
+    return FsMkdir(path);
+}
+
+static int VfrfsRemove(void* fs_data, const char* path, int recursive) {
+    (void)fs_data;
+    return recursive ? FsDeleteRecursive(path) : FsDelete(path);
+}
+
+static int VfrfsIsDir(void* fs_data, const char* path) {
+    (void)fs_data;
+    FsNode* node = FsFind(path);
+    return node && node->type == FS_DIRECTORY;
+}
+
+static int VfrfsIsFile(void* fs_data, const char* path) {
+    (void)fs_data;
+    FsNode* node = FsFind(path);
+    return node && node->type == FS_FILE;
+}
+
+static uint64_t VfrfsGetSize(void* fs_data, const char* path) {
+    (void)fs_data;
+    FsNode* node = FsFind(path);
+    if (!node || node->type != FS_FILE) return 0;
+    return node->size;
+}
+
+static void* VfrfsOpen(void* fs_data, const char* path, int flags) {
+    (void)fs_data;
+    int fd = FsOpen(path, (FsOpenFlags)flags);
+    return fd < 0 ? NULL : GetHandle(fd);
+}
+
+static int64_t VfrfsReadAt(void* h, uint64_t offset, void* buffer, uint64_t count) {
+    FileHandle* handle = h;
+    if (!handle->node) return -1;
+    if (offset >= handle->node->size) return 0;
+    handle->position = offset;
+    return FsRead(handle->fd, buffer, count);
+}
+
+static int64_t VfrfsWriteAt(void* h, uint64_t offset, const void* buffer, uint64_t count) {
+    FileHandle* handle = h;
+    handle->position = offset;
+    return FsWrite(handle->fd, buffer, count);
+}
+
+static uint64_t VfrfsFileSize(void* h) {
+    FileHandle* handle = h;
+    return handle->node ? handle->node->size : 0;
+}
+
+static int VfrfsTruncate(void* h, uint64_t size) {
+    FileHandle* handle = h;
+    if (!handle->node || size >= handle->node->size) return 0;
+    return FsTruncate(handle->fd, size);
+}
+
+static void VfrfsClose(void* h) {
+    FileHandle* handle = h;
+    FsClose(handle->fd);
+}
+
+FileSystemDriver g_vfrfs_driver = {
+    .name = "VFRFS",
+    .read_file = VfrfsReadFile,
+    .write_file = VfrfsWriteFile,
+    .list_dir = VfrfsListDir,
+    .create_file = VfrfsCreateFile,
+    .create_dir = VfrfsCreateDir,
+    .remove = VfrfsRemove,
+    .is_dir = VfrfsIsDir,
+    .is_file = VfrfsIsFile,
+    .get_size = VfrfsGetSize,
+    .open = VfrfsOpen,
+    .read_at = VfrfsReadAt,
+    .write_at = VfrfsWriteAt,
+    .file_size = VfrfsFileSize,
+    .truncate = VfrfsTruncate,
+    .close = VfrfsClose,
+};
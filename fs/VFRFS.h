@@ -1,13 +1,26 @@
 #ifndef FS_H
 #define FS_H
 
+#include <FileSystem.h>
 #include <stdint.h>
 #include <stddef.h>
 
 #define MAX_FILENAME 64
 #define MAX_PATH 256
-#define MAX_OPEN_FILES 32
-#define MAX_FS_NODES 128
+
+// Nodes and handles are carved from slabs of this many objects; freed ones
+// are recycled and the slabs are never returned
+#define VFRFS_SLAB_OBJECTS 64
+
+// Directories index their children in a hash table that starts at this
+// many buckets and doubles whenever it holds as many children as buckets
+#define VFRFS_HASH_MIN_BUCKETS 8
+
+// File contents are kept in a radix tree of VFRFS_PAGE_SIZE pages with
+// VFRFS_RADIX_SLOTS children per interior node
+#define VFRFS_PAGE_SIZE 4096
+#define VFRFS_RADIX_SHIFT 6
+#define VFRFS_RADIX_SLOTS (1 << VFRFS_RADIX_SHIFT)
 
 // Seek whence values
 #define SEEK_SET 0 // Seek from the beginning of the file
@@ -24,7 +37,8 @@ typedef enum {
 typedef enum {
     FS_READ = 1,
     FS_WRITE = 2,
-    FS_APPEND = 4
+    FS_APPEND = 4,
+    FS_CREATE = 8   // create the file if it does not exist
 } FsOpenFlags;
 
 // Represents a file or directory in the filesystem
@@ -34,12 +48,22 @@ typedef struct FsNode {
     uint64_t size;
     uint64_t created_time;   // Timestamp of creation
     uint64_t modified_time;  // Timestamp of last modification
-    void* data;              // File content for FS_FILE types
+    // File content for FS_FILE types: at height 0 `pages` is the only
+    // page, above that an interior node. Missing pages are holes.
+    void* pages;
+    uint32_t page_height;
     struct FsNode* parent;
 
     // For directories, a linked list of children
     struct FsNode* children;
 
+    // For directories, children hashed by name; chained through hash_next
+    struct FsNode** child_hash;
+    uint32_t child_buckets;
+    uint32_t child_count;
+    uint32_t name_hash;
+    struct FsNode* hash_next;
+
     // --- NEW --- For O(1) child insertion
     struct FsNode* last_child;
 
@@ -50,13 +74,15 @@ typedef struct FsNode {
     uint32_t node_id; // Unique identifier for the node
 } FsNode;
 
-// Represents an open file handle
-typedef struct {
+// Represents an open file handle. Each handle owns its fd for life; a
+// handle with no node is free.
+typedef struct FileHandle {
     FsNode* node;
     uint64_t position;
     FsOpenFlags flags;
     uint32_t fd;
     uint32_t owner_pid;
+    struct FileHandle* next_free;
 } FileHandle;
 
 // Core filesystem functions
@@ -69,9 +95,10 @@ int FsDeleteRecursive(const char* path); // New recursive delete function
 // File operations
 int FsOpen(const char* path, FsOpenFlags flags);
 int FsClose(int fd);
-int FsRead(int fd, void* buffer, size_t size);
-int FsWrite(int fd, const void* buffer, size_t size);
+int64_t FsRead(int fd, void* buffer, uint64_t size);
+int64_t FsWrite(int fd, const void* buffer, uint64_t size);
 int64_t FsSeek(int fd, int64_t offset, int whence);
+int FsTruncate(int fd, uint64_t size);
 
 // Directory operations
 int FsMkdir(const char* path);
@@ -81,6 +108,9 @@ int FsListDir(const char* path);
 
 // Helper/utility functions
 int FsCreateFile(const char* path);
-int FsWriteFile(const char* path, const void* buffer, size_t size);
+int64_t FsWriteFile(const char* path, const void* buffer, uint64_t size);
+
+// VFS driver for the root mount
+extern FileSystemDriver g_vfrfs_driver;
 
 #endif
\ No newline at end of file
@@ -1,13 +1,16 @@
 #include <VFS.h>
 #include <mm/MemOps.h>
+#include <BlockCache.h>
 #include <BlockDevice.h>
 #include <CharDevice.h>
 #include <Console.h>
+#include <DCache.h>
 #include <devfs/DevFS.h>
 #include <procfs/ProcFS.h>
 #include <EXT/Ext2.h>
 #include <FAT/FAT1x.h>
 #include <FileSystem.h>
+#include <Iso9660.h>
 #include <KernelHeap.h>
 #include <NTFS.h>
 #include <Serial.h>
@@ -31,22 +34,20 @@ void VfsListMount() {
                 PrintKernel("None");
             }
             PrintKernel(" | FS Driver: ");
-            if (mounts[i].fs_driver) {
-                PrintKernel(mounts[i].fs_driver->name);
-            } else {
-                PrintKernel("VFRFS");
-            }
+            PrintKernel(mounts[i].fs_driver ? mounts[i].fs_driver->name : "None");
             PrintKernel("\n");
         }
     }
 }
 
-int VfsMount(const char* path, BlockDevice* device, FileSystemDriver* fs_driver) {
+int VfsMount(const char* path, BlockDevice* device, FileSystemDriver* fs_driver, void* fs_data) {
     for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
         if (!mounts[i].active) {
             FastStrCopy(mounts[i].mount_point, path, 64);
+            mounts[i].mount_len = FastStrlen(mounts[i].mount_point, 64);
             mounts[i].device = device;
             mounts[i].fs_driver = fs_driver;
+            mounts[i].fs_data = fs_data;
             mounts[i].active = 1;
 
             if (FastStrCmp(path, "/") != 0) {
@@ -73,10 +74,35 @@ int VfsUmount(const char* path) {
         FsDelete(mount->mount_point);
     }
 
+    if (mount->device) {
+        BlockCacheSync(mount->device->id);
+        BlockCacheInvalidate(mount->device->id);
+    }
+
     mount->active = 0;
     return 0;
 }
 
+// Flushes every mount's in-memory metadata, then the block cache
+int VfsSync(void) {
+    int result = 0;
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        if (!mounts[i].active || !mounts[i].fs_driver || !mounts[i].fs_driver->sync) continue;
+        if (mounts[i].fs_driver->sync(mounts[i].fs_data) != 0) result = -1;
+    }
+    if (BlockCacheSyncAll() != 0) result = -1;
+    return result;
+}
+
+// Idle-time counterpart of VfsSync: each driver writes back only what has
+// aged past its limit
+void VfsWriteback(void) {
+    for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
+        if (!mounts[i].active || !mounts[i].fs_driver || !mounts[i].fs_driver->writeback) continue;
+        mounts[i].fs_driver->writeback(mounts[i].fs_data);
+    }
+}
+
 int VfsUnmountAll() {
     for (int i = VFS_MAX_MOUNTS - 1; i >= 0; i--) {
         if (mounts[i].active) {
@@ -93,36 +119,35 @@ int VfsInit(void) {
         mounts[i].active = 0;
     }
     PrintKernel( "VFS: Mount table cleared\n");
+    DCacheInit();
     ProcFSInit();
 
-    // Register filesystems
-    static FileSystemDriver ntfs_driver = {"NTFS", NtfsDetect, NtfsMount, NtfsUnmount};
-    FileSystemRegister(&ntfs_driver);
+    // Register filesystems. ISO9660 goes first: its signature is strict,
+    // while an El Torito boot sector can pass the FAT check.
+    FileSystemRegister(&g_iso9660_driver);
+    PrintKernel("VFS: ISO9660 driver registered\n");
+    FileSystemRegister(&g_ntfs_driver);
     PrintKernel("VFS: NTFS driver registered\n");
-    static FileSystemDriver fat_driver = {"FAT1x", Fat1xDetect, Fat1xMount, Fat1xUnmount};
-    FileSystemRegister(&fat_driver);
+    FileSystemRegister(&g_fat1x_driver);
     PrintKernel("VFS: FAT1x driver registered\n");
-    static FileSystemDriver ext2_driver = {"EXT2", Ext2Detect, Ext2Mount, Ext2Unmount};
-    FileSystemRegister(&ext2_driver);
+    FileSystemRegister(&g_ext2_driver);
     PrintKernel("VFS: EXT2 driver registered\n");
-    static FileSystemDriver devfs_driver = {"DevFS", NULL, DevfsMount, NULL};
-    FileSystemRegister(&devfs_driver);
+    FileSystemRegister(&g_devfs_driver);
     PrintKernel("VFS: DevFS driver registered\n");
-    static FileSystemDriver procfs_driver = {"ProcFS", NULL, ProcfsMount, NULL};
-    FileSystemRegister(&procfs_driver);
+    FileSystemRegister(&g_procfs_driver);
     PrintKernel("VFS: ProcFS driver registered\n");
 
-    int result = VfsMount("/", NULL, NULL); // RamFS doesn't need a device or driver
+    int result = VfsMount("/", NULL, &g_vfrfs_driver, NULL); // RamFS doesn't need a device
     if (result != 0) {
         SerialWrite("VFS: Failed to mount root\n");
     }
 
-    result = VfsMount(DevicesDir, NULL, &devfs_driver);
+    result = VfsMount(DevicesDir, NULL, &g_devfs_driver, NULL);
     if (result != 0) {
         SerialWrite("VFS: Failed to mount /Devices\n");
     }
 
-    result = VfsMount(RuntimeProcesses, NULL, &procfs_driver);
+    result = VfsMount(RuntimeProcesses, NULL, &g_procfs_driver, NULL);
     if (result != 0) {
         SerialWrite("VFS: Failed to mount /Runtime/Processes\n");
     }
@@ -134,28 +159,18 @@ int VfsInit(void) {
 VfsMountStruct* VfsFindMount(const char* path) {
     int best_match = -1;
     int best_len = 0;
+    const int path_len = FastStrlen(path, 256);
 
     for (int i = 0; i < VFS_MAX_MOUNTS; i++) {
         if (!mounts[i].active) continue;
 
-        int mount_len = FastStrlen(mounts[i].mount_point, 64);
-        int path_len = FastStrlen(path, 256);
-
-        if (path_len >= mount_len) {
-            int matches = 1;
-            for (int j = 0; j < mount_len; j++) {
-                if (path[j] != mounts[i].mount_point[j]) {
-                    matches = 0;
-                    break;
-                }
-            }
+        const int mount_len = mounts[i].mount_len;
+        if (mount_len <= best_len || mount_len > path_len) continue;
+        if (FastMemcmp(path, mounts[i].mount_point, mount_len) != 0) continue;
 
-            if (matches && (mount_len == 1 || path[mount_len] == '/' || path[mount_len] == '\0')) {
-                if (mount_len > best_len) {
-                    best_match = i;
-                    best_len = mount_len;
-                }
-            }
+        if (mount_len == 1 || path[mount_len] == '/' || path[mount_len] == '\0') {
+            best_match = i;
+            best_len = mount_len;
         }
     }
 
@@ -184,181 +199,54 @@ const char* VfsStripMount(const char* path, VfsMountStruct* mount) {
     return local_path_start;
 }
 
-int VfsReadFile(const char* path, void* buffer, uint32_t max_size) {
+// Resolves a path to its mount and the mount-relative path
+static VfsMountStruct* VfsResolve(const char* path, const char** local_path) {
     VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return -1;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return -1;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            Fat1xSetActive(mount->device);
-            return Fat1xReadFile(local_path, buffer, max_size);
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2ReadFile(local_path, buffer, max_size);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsReadFile(local_path, buffer, max_size);
-        } else if (FastStrCmp(mount->fs_driver->name, "DevFS") == 0) {
-            return DevfsReadFile(local_path, buffer, max_size);
-        } else if (FastStrCmp(mount->fs_driver->name, "ProcFS") == 0) {
-            return ProcfsReadFile(local_path, buffer, max_size);
-        }
-    } else {
-        FsNode* node = FsFind(local_path);
-        if (!node || node->type != FS_FILE) return -1;
-        if (node->size == 0) return 0;
-        if (node->data == NULL) return 0;
-        uint32_t copy_size = (node->size < max_size) ? node->size : max_size;
-        FastMemcpy(buffer, node->data, copy_size);
-        return copy_size;
-    }
-
-    return -1;
+    if (!mount || !mount->fs_driver) return NULL;
+    *local_path = VfsStripMount(path, mount);
+    return *local_path ? mount : NULL;
 }
 
-int VfsWriteFile(const char* path, const void* buffer, uint32_t size) {
-    VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return -1;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return -1;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            Fat1xSetActive(mount->device);
-            return Fat1xWriteFile(local_path, buffer, size);
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2WriteFile(local_path, buffer, size);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsWriteFile(local_path, buffer, size);
-        } else if (FastStrCmp(mount->fs_driver->name, "DevFS") == 0) {
-            return DevfsWriteFile(local_path, buffer, size);
-        } else if (FastStrCmp(mount->fs_driver->name, "ProcFS") == 0) {
-            return ProcfsWriteFile(local_path, buffer, size);
-        }
-    } else {
-        int fd = FsOpen(local_path, FS_WRITE);
-        if (fd < 0) return -1;
-        int result = FsWrite(fd, buffer, size);
-        FsClose(fd);
-        return result;
-    }
+int64_t VfsReadFile(const char* path, void* buffer, uint64_t max_size) {
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->read_file) return -1;
+    return mount->fs_driver->read_file(mount->fs_data, local_path, buffer, max_size);
+}
 
-    return -1;
+int64_t VfsWriteFile(const char* path, const void* buffer, uint64_t size) {
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->write_file) return -1;
+    return mount->fs_driver->write_file(mount->fs_data, local_path, buffer, size);
 }
 
 int VfsListDir(const char* path) {
-    VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return -1;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return -1;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            Fat1xSetActive(mount->device);
-            return Fat1xListDirectory(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2ListDir(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsListDir(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "DevFS") == 0) {
-            return DevfsListDir(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "ProcFS") == 0) {
-            return ProcfsListDir(local_path);
-        }
-    } else {
-        return FsListDir(local_path);
-    }
-
-    return -1;
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->list_dir) return -1;
+    return mount->fs_driver->list_dir(mount->fs_data, local_path);
 }
 
 int VfsCreateFile(const char* path) {
-    VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return -1;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return -1;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            Fat1xSetActive(mount->device);
-            return Fat1xCreateFile(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2CreateFile(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsCreateFile(local_path);
-        }
-    } else {
-        int fd = FsOpen(local_path, FS_WRITE);
-        if (fd < 0) return -1;
-        FsClose(fd);
-        return 0;
-    }
-
-    return -1;
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->create_file) return -1;
+    return mount->fs_driver->create_file(mount->fs_data, local_path);
 }
 
 int VfsCreateDir(const char* path) {
-    VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return -1;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return -1;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            Fat1xSetActive(mount->device);
-            return Fat1xCreateDir(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2CreateDir(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsCreateDir(local_path);
-        }
-    } else {
-        return FsMkdir(local_path);
-    }
-
-    return -1;
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->create_dir) return -1;
+    return mount->fs_driver->create_dir(mount->fs_data, local_path);
 }
 
 int VfsDelete(const char* path, bool Recursive) {
-    VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return -1;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return -1;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            Fat1xSetActive(mount->device);
-            if (Recursive) return Fat1xDeleteRecursive(local_path);
-            return Fat1xDeleteFile(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2Delete(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsDelete(local_path);
-        }
-    } else {
-        if (Recursive) return FsDeleteRecursive(local_path);
-        return FsDelete(local_path);
-    }
-
-    return -1;
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->remove) return -1;
+    return mount->fs_driver->remove(mount->fs_data, local_path, Recursive);
 }
 
 int VfsIsDir(const char* path) {
@@ -368,34 +256,11 @@ int VfsIsDir(const char* path) {
             return 1; // Mount points are always directories
         }
     }
-    
-    VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return 0;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return 0;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            Fat1xSetActive(mount->device);
-            return Fat1xIsDirectory(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2IsDir(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsIsDir(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "DevFS") == 0) {
-            return DevfsIsDir(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "ProcFS") == 0) {
-            return ProcfsIsDir(local_path);
-        }
-    } else {
-        FsNode* node = FsFind(local_path);
-        return node && node->type == FS_DIRECTORY;
-    }
 
-    return 0;
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->is_dir) return 0;
+    return mount->fs_driver->is_dir(mount->fs_data, local_path);
 }
 
 int VfsIsFile(const char* path) {
@@ -405,88 +270,25 @@ int VfsIsFile(const char* path) {
             return 0; // Mount points are directories, not files
         }
     }
-    
-    VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return 0;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return 0;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            return Fat1xGetFileSize(local_path) > 0;
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2IsFile(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsIsFile(local_path);
-        }
-    } else {
-        FsNode* node = FsFind(local_path);
-        return node && node->type == FS_FILE;
-    }
 
-    return 0;
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->is_file) return 0;
+    return mount->fs_driver->is_file(mount->fs_data, local_path);
 }
 
 uint64_t VfsGetFileSize(const char* path) {
-    VfsMountStruct* mount = VfsFindMount(path);
-    if (!mount) return 0;
-
-    const char* local_path = VfsStripMount(path, mount);
-    if (!local_path) return 0;
-
-    if (mount->fs_driver) {
-        if (FastStrCmp(mount->fs_driver->name, "FAT1x") == 0) {
-            Fat1xSetActive(mount->device);
-            return Fat1xGetFileSize(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "EXT2") == 0) {
-            Ext2SetActive(mount->device);
-            return Ext2GetFileSize(local_path);
-        } else if (FastStrCmp(mount->fs_driver->name, "NTFS") == 0) {
-            NtfsSetActive(mount->device);
-            return NtfsGetFileSize(local_path);
-        }
-    } else {
-        FsNode* node = FsFind(local_path);
-        if (!node || node->type != FS_FILE) return 0;
-        return node->size;
-    }
-
-    return 0;
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount || !mount->fs_driver->get_size) return 0;
+    return mount->fs_driver->get_size(mount->fs_data, local_path);
 }
 
-int VfsAppendFile(const char* path, const void* buffer, uint32_t size) {
-    // This is a naive implementation. A proper implementation would need
-    // to read the file, append the data in memory, and then write it back.
-    // This is not efficient and not recommended for large files.
-    uint64_t current_size = VfsGetFileSize(path);
-    void* current_content = KernelMemoryAlloc(current_size);
-    if (!current_content) {
-        return -1;
-    }
-
-    int bytes_read = VfsReadFile(path, current_content, current_size);
-    if (bytes_read < 0) {
-        KernelFree(current_content);
-        return -1;
-    }
-
-    void* new_content = KernelMemoryAlloc(current_size + size);
-    if (!new_content) {
-        KernelFree(current_content);
-        return -1;
-    }
-
-    FastMemcpy(new_content, current_content, current_size);
-    FastMemcpy(new_content + current_size, buffer, size);
-
-    int bytes_written = VfsWriteFile(path, new_content, current_size + size);
-
-    KernelFree(current_content);
-    KernelFree(new_content);
-
+int64_t VfsAppendFile(const char* path, const void* buffer, uint64_t size) {
+    int fd = VfsOpen(path, FS_APPEND | FS_CREATE);
+    if (fd < 0) return -1;
+    int64_t bytes_written = VfsWrite(fd, buffer, size);
+    VfsClose(fd);
     return bytes_written;
 }
 
@@ -510,29 +312,8 @@ int VfsCopyFile(const char* src_path, const char* dest_path) {
         return -1;
     }
 
-    size_t buf_size = (size_t)file_size;
-    if ((uint64_t)buf_size != file_size || buf_size == 0) {
-        return -1;
-    }
-
-    void* buffer = KernelMemoryAlloc(buf_size);
-    if (!buffer) {
-        PrintKernelError("Failed to allocate memory\n");
-        return -1;
-    }
-
-    int bytes_read = VfsReadFile(src_path, buffer, (uint32_t)buf_size);
-    if (bytes_read <= 0) {
-        KernelFree(buffer);
-        PrintKernelError("Failed to read source\n");
-        return -1;
-    }
-
-    int bytes_written = VfsWriteFile(dest_path, buffer, (uint32_t)bytes_read);
-    KernelFree(buffer);
-
-    if (bytes_written <= 0) {
-        PrintKernelError("Failed to write destination\n");
+    if (VfsCopyRegion(src_path, 0, dest_path, 0, file_size) != (int64_t)file_size) {
+        PrintKernelError("Failed to copy file contents\n");
         return -1;
     }
 
@@ -565,236 +346,741 @@ int VfsMoveFile(const char* src_path, const char* dest_path) {
     return -1; // Failed to copy file
 }
 
-// Advanced VFS operations - no file descriptors needed!
-int VfsReadAt(const char* path, void* buffer, uint32_t offset, uint32_t count) {
-    uint64_t file_size = VfsGetFileSize(path);
-    if (offset >= file_size) return 0;
-    
-    uint32_t to_read = (offset + count > file_size) ? file_size - offset : count;
-    void* temp_buffer = KernelMemoryAlloc(file_size);
-    if (!temp_buffer) return -1;
-    
-    int bytes_read = VfsReadFile(path, temp_buffer, file_size);
-    if (bytes_read > 0 && offset < bytes_read) {
-        uint32_t copy_size = (offset + to_read > bytes_read) ? bytes_read - offset : to_read;
-        FastMemcpy(buffer, (uint8_t*)temp_buffer + offset, copy_size);
-        KernelFree(temp_buffer);
-        return copy_size;
-    }
-    KernelFree(temp_buffer);
-    return bytes_read < 0 ? -1 : 0;
-}
-
-int VfsWriteAt(const char* path, const void* buffer, uint32_t offset, uint32_t count) {
-    uint64_t file_size = VfsGetFileSize(path);
-    uint32_t new_size = (offset + count > file_size) ? offset + count : file_size;
-    
-    void* temp_buffer = KernelMemoryAlloc(new_size);
-    if (!temp_buffer) return -1;
-    
-    if (file_size > 0) {
-        int bytes_read = VfsReadFile(path, temp_buffer, file_size);
-        if (bytes_read < 0) {
-            KernelFree(temp_buffer);
-            return -1;
-        }
+// Open-file table: the mount and the driver's open-file object are resolved
+// once, so reads and writes go straight to the blocks at the file position
+// instead of round-tripping the whole file through VfsReadFile/VfsWriteFile.
+typedef struct {
+    int in_use;
+    int flags;
+    uint64_t position;
+    VfsMountStruct* mount;
+    void* handle;                   // driver open-file object, NULL for synthetic files
+    char path[VFS_MAX_PATH_LEN];    // synthetic (DevFS/ProcFS) files are read whole by path
+} VfsFile;
+
+static VfsFile open_files[VFS_MAX_OPEN_FILES];
+
+static VfsFile* VfsGetFile(int fd) {
+    if (fd < 0 || fd >= VFS_MAX_OPEN_FILES || !open_files[fd].in_use) return NULL;
+    return &open_files[fd];
+}
+
+static int64_t VfsFileReadAt(VfsFile* file, uint64_t offset, void* buffer, uint64_t count) {
+    if (file->handle) return file->mount->fs_driver->read_at(file->handle, offset, buffer, count);
+
+    // Synthetic files have no stable size and are small; read up to the
+    // end of the window
+    if (offset > UINT32_MAX || count > UINT32_MAX - offset) return -1;
+    uint8_t* temp = KernelMemoryAlloc(offset + count);
+    if (!temp) return -1;
+    int64_t n = VfsReadFile(file->path, temp, offset + count);
+    int64_t result = n < 0 ? -1 : 0;
+    if (n > 0 && (uint64_t)n > offset) {
+        result = n - (int64_t)offset;
+        FastMemcpy(buffer, temp + offset, result);
     }
-    
-    FastMemcpy((uint8_t*)temp_buffer + offset, buffer, count);
-    int result = VfsWriteFile(path, temp_buffer, new_size);
-    KernelFree(temp_buffer);
-    return result >= 0 ? count : -1;
+    KernelFree(temp);
+    return result;
 }
 
-int VfsInsertAt(const char* path, const void* buffer, uint32_t offset, uint32_t count) {
-    uint64_t file_size = VfsGetFileSize(path);
-    uint32_t new_size = file_size + count;
-    
-    void* temp_buffer = KernelMemoryAlloc(new_size);
-    if (!temp_buffer) return -1;
-    
-    if (file_size > 0) {
-        void* old_buffer = KernelMemoryAlloc(file_size);
-        if (!old_buffer) {
-            KernelFree(temp_buffer);
-            return -1;
-        }
-        
-        uint32_t fsz32 = (file_size > (uint64_t)UINT32_MAX) ? UINT32_MAX : (uint32_t)file_size;
-        int rd = VfsReadFile(path, old_buffer, fsz32);
-        if (rd < 0) {
-            KernelFree(old_buffer);
-            KernelFree(temp_buffer);
-            return -1;
+static int64_t VfsFileWriteAt(VfsFile* file, uint64_t offset, const void* buffer, uint64_t count) {
+    if (file->handle) return file->mount->fs_driver->write_at(file->handle, offset, buffer, count);
+
+    // Synthetic files only accept whole writes
+    if (offset != 0) return -1;
+    return VfsWriteFile(file->path, buffer, count);
+}
+
+static uint64_t VfsFileSize(VfsFile* file) {
+    if (file->handle) return file->mount->fs_driver->file_size(file->handle);
+    return VfsGetFileSize(file->path);
+}
+
+int VfsOpen(const char* path, int flags) {
+    if (!path || !(flags & (FS_READ | FS_WRITE | FS_APPEND))) return -1;
+    if (flags & FS_APPEND) flags |= FS_WRITE;
+
+    int fd = -1;
+    for (int i = 0; i < VFS_MAX_OPEN_FILES; i++) {
+        if (!open_files[i].in_use) {
+            fd = i;
+            break;
         }
-        if (offset > (uint32_t)rd) offset = (uint32_t)rd; // clamp
+    }
+    if (fd < 0) return -1;
 
-        FastMemcpy(temp_buffer, old_buffer, offset);
-        FastMemcpy((uint8_t*)temp_buffer + offset, buffer, count);
-        FastMemcpy((uint8_t*)temp_buffer + offset + count,
-                   (uint8_t*)old_buffer + offset,
-                   (uint32_t)rd - offset);
+    const char* local_path;
+    VfsMountStruct* mount = VfsResolve(path, &local_path);
+    if (!mount) return -1;
 
-        KernelFree(old_buffer);
-    } else {
-        FastMemcpy(temp_buffer, buffer, count);
+    VfsFile* file = &open_files[fd];
+    FastMemset(file, 0, sizeof(VfsFile));
+    file->mount = mount;
+    file->flags = flags;
+    FastStrCopy(file->path, path, VFS_MAX_PATH_LEN);
+
+    const FileSystemDriver* driver = mount->fs_driver;
+    if (driver->open) {
+        file->handle = driver->open(mount->fs_data, local_path, flags);
+        if (!file->handle) return -1;
+    } else if (!driver->read_file || (driver->is_dir && driver->is_dir(mount->fs_data, local_path))) {
+        return -1;
+    } else if (!(flags & FS_CREATE) && driver->is_file && !driver->is_file(mount->fs_data, local_path)) {
+        return -1;
     }
-    
-    int result = VfsWriteFile(path, temp_buffer, new_size);
-    KernelFree(temp_buffer);
-    return result >= 0 ? count : -1;
+
+    file->in_use = 1;
+    return fd;
 }
 
-int VfsDeleteAt(const char* path, uint32_t offset, uint32_t count) {
-    uint64_t file_size = VfsGetFileSize(path);
-    if (offset >= file_size) return 0;
-    
-    uint32_t actual_count = (offset + count > file_size) ? file_size - offset : count;
-    uint32_t new_size = file_size - actual_count;
-    
-    if (new_size == 0) {
-        VfsWriteFile(path, "", 0);
-        return actual_count;
-    }
-    
-    void* old_buffer = KernelMemoryAlloc(file_size);
-    void* new_buffer = KernelMemoryAlloc(new_size);
-    if (!old_buffer || !new_buffer) {
-        if (old_buffer) KernelFree(old_buffer);
-        if (new_buffer) KernelFree(new_buffer);
-        return -1;
+int64_t VfsRead(int fd, void* buffer, uint64_t count) {
+    VfsFile* file = VfsGetFile(fd);
+    if (!file || !buffer || !(file->flags & FS_READ)) return -1;
+
+    int64_t n = VfsFileReadAt(file, file->position, buffer, count);
+    if (n > 0) file->position += n;
+    return n;
+}
+
+int64_t VfsWrite(int fd, const void* buffer, uint64_t count) {
+    VfsFile* file = VfsGetFile(fd);
+    if (!file || !buffer || !(file->flags & FS_WRITE)) return -1;
+
+    if (file->flags & FS_APPEND) file->position = VfsFileSize(file);
+    int64_t n = VfsFileWriteAt(file, file->position, buffer, count);
+    if (n > 0) file->position += n;
+    return n;
+}
+
+int64_t VfsSeek(int fd, int64_t offset, int whence) {
+    VfsFile* file = VfsGetFile(fd);
+    if (!file) return -1;
+
+    int64_t base;
+    switch (whence) {
+        case SEEK_SET: base = 0; break;
+        case SEEK_CUR: base = (int64_t)file->position; break;
+        case SEEK_END: base = (int64_t)VfsFileSize(file); break;
+        default: return -1;
     }
-    
-    VfsReadFile(path, old_buffer, file_size);
-    FastMemcpy(new_buffer, old_buffer, offset);
-    FastMemcpy((uint8_t*)new_buffer + offset, (uint8_t*)old_buffer + offset + actual_count, file_size - offset - actual_count);
-    
-    int result = VfsWriteFile(path, new_buffer, new_size);
-    KernelFree(old_buffer);
-    KernelFree(new_buffer);
-    return result >= 0 ? actual_count : -1;
+    if (base + offset < 0) return -1;
+    file->position = (uint64_t)(base + offset);
+    return (int64_t)file->position;
 }
 
-int VfsSwapRegions(const char* path, uint32_t offset1, uint32_t offset2, uint32_t count) {
-    uint64_t file_size = VfsGetFileSize(path);
-    if (offset1 + count > file_size || offset2 + count > file_size) return -1;
-    
-    void* buffer = KernelMemoryAlloc(file_size);
-    void* temp = KernelMemoryAlloc(count);
-    if (!buffer || !temp) {
-        if (buffer) KernelFree(buffer);
-        if (temp) KernelFree(temp);
-        return -1;
+int VfsClose(int fd) {
+    VfsFile* file = VfsGetFile(fd);
+    if (!file) return -1;
+
+    if (file->handle) file->mount->fs_driver->close(file->handle);
+    file->in_use = 0;
+    return 0;
+}
+
+// Advanced VFS operations - no file descriptors needed!
+int64_t VfsReadAt(const char* path, void* buffer, uint64_t offset, uint64_t count) {
+    if (offset > INT64_MAX) return -1;
+    int fd = VfsOpen(path, FS_READ);
+    if (fd < 0) return -1;
+    int64_t result = VfsSeek(fd, (int64_t)offset, SEEK_SET) < 0 ? -1 : VfsRead(fd, buffer, count);
+    VfsClose(fd);
+    return result;
+}
+
+int64_t VfsWriteAt(const char* path, const void* buffer, uint64_t offset, uint64_t count) {
+    if (offset > INT64_MAX) return -1;
+    int fd = VfsOpen(path, FS_WRITE | FS_CREATE);
+    if (fd < 0) return -1;
+    int64_t result = VfsSeek(fd, (int64_t)offset, SEEK_SET) < 0 ? -1 : VfsWrite(fd, buffer, count);
+    VfsClose(fd);
+    return result;
+}
+
+// Region operations stream through one VFS_REGION_CHUNK working buffer
+// over positioned I/O: an edit moves only the bytes behind it, a chunk at
+// a time, so memory stays constant whatever the file size.
+#define VFS_REGION_CHUNK (64 * 1024)
+
+// Matches VfsReplaceBytes collects per pass over the tail
+#define VFS_REPLACE_BATCH 32
+
+// Transfers exactly count bytes; a short transfer is an error
+static int VfsFileReadFull(VfsFile* file, uint64_t offset, void* buffer, uint64_t count) {
+    uint8_t* out = buffer;
+    while (count > 0) {
+        int64_t n = VfsFileReadAt(file, offset, out, count);
+        if (n <= 0) return -1;
+        offset += n;
+        out += n;
+        count -= n;
     }
-    
-    VfsReadFile(path, buffer, file_size);
-    FastMemcpy(temp, (uint8_t*)buffer + offset1, count);
-    FastMemcpy((uint8_t*)buffer + offset1, (uint8_t*)buffer + offset2, count);
-    FastMemcpy((uint8_t*)buffer + offset2, temp, count);
-    
-    int result = VfsWriteFile(path, buffer, file_size);
-    KernelFree(buffer);
-    KernelFree(temp);
-    return result >= 0 ? 0 : -1;
+    return 0;
 }
 
-int VfsFillRegion(const char* path, uint32_t offset, uint32_t count, uint8_t pattern) {
-    uint64_t file_size = VfsGetFileSize(path);
-    uint32_t new_size = (offset + count > file_size) ? offset + count : file_size;
-    
-    void* buffer = KernelMemoryAlloc(new_size);
-    if (!buffer) return -1;
-    
-    // Zero-init whole buffer first
-    FastMemset(buffer, 0, new_size);
-    if (file_size > 0) {
-        uint32_t to_read = (file_size > (uint64_t)new_size) ? new_size : (uint32_t)file_size;
-        VfsReadFile(path, buffer, to_read);
-    }
-    
-    for (uint32_t i = 0; i < count; i++) {
-        ((uint8_t*)buffer)[offset + i] = pattern;
-    }
-    
-    int result = VfsWriteFile(path, buffer, new_size);
+static int VfsFileWriteFull(VfsFile* file, uint64_t offset, const void* buffer, uint64_t count) {
+    const uint8_t* in = buffer;
+    while (count > 0) {
+        int64_t n = VfsFileWriteAt(file, offset, in, count);
+        if (n <= 0) return -1;
+        offset += n;
+        in += n;
+        count -= n;
+    }
+    return 0;
+}
+
+// Only drivers with a truncate hook can shrink a file; rewriting the kept
+// prefix through write_file would need it all in memory at once. Edits
+// that shrink check this before moving any bytes.
+static int VfsFileCanTruncate(const VfsFile* file) {
+    return file->handle && file->mount->fs_driver->truncate;
+}
+
+static int VfsFileTruncate(VfsFile* file, uint64_t size) {
+    if (!VfsFileCanTruncate(file)) return -1;
+    return file->mount->fs_driver->truncate(file->handle, size);
+}
+
+// Opens path for a region operation and allocates its working buffer.
+// Writers need a driver open-file object, and only create a missing file
+// when `create` is set.
+static VfsFile* VfsRegionOpen(const char* path, int flags, int create, uint8_t** buffer) {
+    int fd = VfsOpen(path, create ? flags | FS_CREATE : flags);
+    if (fd < 0) return NULL;
+
+    VfsFile* file = &open_files[fd];
+    if ((flags & FS_WRITE) && !file->handle) {
+        VfsClose(fd);
+        return NULL;
+    }
+    *buffer = KernelMemoryAlloc(VFS_REGION_CHUNK);
+    if (!*buffer) {
+        VfsClose(fd);
+        return NULL;
+    }
+    return file;
+}
+
+static void VfsRegionClose(VfsFile* file, uint8_t* buffer) {
     KernelFree(buffer);
-    return result >= 0 ? count : -1;
+    VfsClose((int)(file - open_files));
 }
 
-int VfsSearchBytes(const char* path, const void* pattern, uint32_t pattern_size, uint32_t start_offset) {
-    uint64_t file_size = VfsGetFileSize(path);
-    if (start_offset >= file_size || pattern_size == 0) return -1;
-    
-    void* buffer = KernelMemoryAlloc(file_size);
-    if (!buffer) return -1;
-    
-    VfsReadFile(path, buffer, file_size);
-    
-    for (uint32_t i = start_offset; i <= file_size - pattern_size; i++) {
-        if (FastMemcmp((uint8_t*)buffer + i, pattern, pattern_size) == 0) {
-            KernelFree(buffer);
-            return i;
+// Moves count bytes from src to dst within the file, overlap allowed. The
+// chunks go in the order that never overwrites bytes still to be moved.
+static int VfsFileShift(VfsFile* file, uint64_t src, uint64_t dst, uint64_t count, uint8_t* buffer) {
+    if (src == dst) return 0;
+    for (uint64_t done = 0; done < count;) {
+        uint64_t chunk = count - done > VFS_REGION_CHUNK ? VFS_REGION_CHUNK : count - done;
+        uint64_t at = dst > src ? count - done - chunk : done;
+        if (VfsFileReadFull(file, src + at, buffer, chunk) != 0 ||
+            VfsFileWriteFull(file, dst + at, buffer, chunk) != 0) return -1;
+        done += chunk;
+    }
+    return 0;
+}
+
+// Copies count bytes between two open files
+static int VfsFileCopy(VfsFile* src, uint64_t src_offset, VfsFile* dst, uint64_t dst_offset, uint64_t count, uint8_t* buffer) {
+    for (uint64_t done = 0; done < count;) {
+        uint64_t chunk = count - done > VFS_REGION_CHUNK ? VFS_REGION_CHUNK : count - done;
+        if (VfsFileReadFull(src, src_offset + done, buffer, chunk) != 0 ||
+            VfsFileWriteFull(dst, dst_offset + done, buffer, chunk) != 0) return -1;
+        done += chunk;
+    }
+    return 0;
+}
+
+// Replaces old_count bytes at offset (clamped to the end of file) with
+// new_count bytes of data, shifting the tail by the difference
+static int VfsFileSplice(VfsFile* file, uint64_t offset, uint64_t old_count, const void* data, uint64_t new_count, uint8_t* buffer) {
+    uint64_t size = VfsFileSize(file);
+    if (offset > size) return -1;
+    if (old_count > size - offset) old_count = size - offset;
+    if (new_count > (uint64_t)INT64_MAX - (size - old_count)) return -1;
+    if (new_count < old_count && !VfsFileCanTruncate(file)) return -1;
+
+    uint64_t tail = size - offset - old_count;
+    if (VfsFileShift(file, offset + old_count, offset + new_count, tail, buffer) != 0) return -1;
+    if (new_count && VfsFileWriteFull(file, offset, data, new_count) != 0) return -1;
+    if (new_count < old_count) return VfsFileTruncate(file, size - old_count + new_count);
+    return 0;
+}
+
+static int VfsFileFill(VfsFile* file, uint64_t offset, uint64_t count, uint8_t pattern, uint8_t* buffer) {
+    FastMemset(buffer, pattern, count > VFS_REGION_CHUNK ? VFS_REGION_CHUNK : count);
+    for (uint64_t done = 0; done < count;) {
+        uint64_t chunk = count - done > VFS_REGION_CHUNK ? VFS_REGION_CHUNK : count - done;
+        if (VfsFileWriteFull(file, offset + done, buffer, chunk) != 0) return -1;
+        done += chunk;
+    }
+    return 0;
+}
+
+// First match of pattern at or after start. Consecutive windows overlap
+// by pattern_size - 1 bytes so matches straddling them are found.
+static int64_t VfsFileSearch(VfsFile* file, const uint8_t* pattern, uint32_t pattern_size, uint64_t start, uint8_t* buffer) {
+    uint64_t file_size = VfsFileSize(file);
+    if (pattern_size == 0 || pattern_size > VFS_REGION_CHUNK ||
+        start >= file_size || pattern_size > file_size - start) return -1;
+
+    for (uint64_t pos = start;;) {
+        uint64_t n = file_size - pos > VFS_REGION_CHUNK ? VFS_REGION_CHUNK : file_size - pos;
+        if (VfsFileReadFull(file, pos, buffer, n) != 0) return -1;
+        for (uint64_t i = 0; i + pattern_size <= n; i++) {
+            if (buffer[i] == pattern[0] && FastMemcmp(buffer + i, pattern, pattern_size) == 0) {
+                return (int64_t)(pos + i);
+            }
         }
+        if (pos + n == file_size) return -1;
+        pos += n - pattern_size + 1;
     }
-    
-    KernelFree(buffer);
-    return -1;
 }
 
-int VfsReverse(const char* path, uint32_t offset, uint32_t count) {
-    uint64_t file_size = VfsGetFileSize(path);
-    if (offset + count > file_size) return -1;
-    
-    void* buffer = KernelMemoryAlloc(file_size);
-    if (!buffer) return -1;
-    
-    VfsReadFile(path, buffer, file_size);
-    
-    uint8_t* data = (uint8_t*)buffer + offset;
-    for (uint32_t i = 0; i < count / 2; i++) {
+static void VfsReverseBytes(uint8_t* data, uint64_t count) {
+    for (uint64_t i = 0; i < count / 2; i++) {
         uint8_t temp = data[i];
         data[i] = data[count - 1 - i];
         data[count - 1 - i] = temp;
     }
-    
-    int result = VfsWriteFile(path, buffer, file_size);
-    KernelFree(buffer);
-    return result >= 0 ? 0 : -1;
 }
 
-int VfsChecksum(const char* path, uint32_t offset, uint32_t count) {
-    uint64_t file_size = VfsGetFileSize(path);
-    if (offset >= file_size) return 0;
-    
-    uint32_t actual_count = (offset + count > file_size) ? file_size - offset : count;
-    void* buffer = KernelMemoryAlloc(file_size);
+// Reverses the region by swapping half-buffer chunks from both ends inward
+static int VfsFileReverse(VfsFile* file, uint64_t offset, uint64_t count, uint8_t* buffer) {
+    const uint64_t half = VFS_REGION_CHUNK / 2;
+    uint8_t* low = buffer;
+    uint8_t* high = buffer + half;
+    uint64_t lo = offset;
+    uint64_t hi = offset + count;
+
+    while (hi - lo >= 2) {
+        uint64_t n = (hi - lo) / 2 > half ? half : (hi - lo) / 2;
+        if (VfsFileReadFull(file, lo, low, n) != 0 || VfsFileReadFull(file, hi - n, high, n) != 0) return -1;
+        VfsReverseBytes(low, n);
+        VfsReverseBytes(high, n);
+        if (VfsFileWriteFull(file, lo, high, n) != 0 || VfsFileWriteFull(file, hi - n, low, n) != 0) return -1;
+        lo += n;
+        hi -= n;
+    }
+    return 0;
+}
+
+// Rotates the region right by `shift` bytes as three reversals, which
+// needs no more than the working buffer
+static int VfsFileRotate(VfsFile* file, uint64_t offset, uint64_t count, uint64_t shift, uint8_t* buffer) {
+    if (count == 0 || shift % count == 0) return 0;
+    shift %= count;
+    if (VfsFileReverse(file, offset, count, buffer) != 0) return -1;
+    if (VfsFileReverse(file, offset, shift, buffer) != 0) return -1;
+    return VfsFileReverse(file, offset + shift, count - shift, buffer);
+}
+
+// Whether [offset, offset + count) lies within a file of the given size
+static inline int VfsRegionFits(uint64_t size, uint64_t offset, uint64_t count) {
+    return offset <= size && count <= size - offset;
+}
+
+int64_t VfsInsertAt(const char* path, const void* buffer, uint64_t offset, uint64_t count) {
     if (!buffer) return -1;
-    
-    VfsReadFile(path, buffer, file_size);
-    
-    uint32_t checksum = 0;
-    uint8_t* data = (uint8_t*)buffer + offset;
-    for (uint32_t i = 0; i < actual_count; i++) {
-        checksum += data[i];
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 1, &chunk);
+    if (!file) return -1;
+
+    uint64_t file_size = VfsFileSize(file);
+    if (offset > file_size) offset = file_size; // clamp
+    int64_t result = VfsFileSplice(file, offset, 0, buffer, count, chunk) == 0 ? (int64_t)count : -1;
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+int64_t VfsDeleteAt(const char* path, uint64_t offset, uint64_t count) {
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    uint64_t file_size = VfsFileSize(file);
+    int64_t result = 0;
+    if (offset < file_size) {
+        uint64_t actual_count = (count > file_size - offset) ? file_size - offset : count;
+        result = VfsFileSplice(file, offset, actual_count, NULL, 0, chunk) == 0 ? (int64_t)actual_count : -1;
     }
-    
-    KernelFree(buffer);
-    return checksum;
+    VfsRegionClose(file, chunk);
+    return result;
 }
 
-int VfsTruncate(const char* path, uint32_t new_size) {
+int VfsReplaceAt(const char* path, const void* buffer, uint64_t offset, uint64_t old_count, uint64_t new_count) {
+    if (!buffer && new_count) return -1;
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    int result = VfsFileSplice(file, offset, old_count, buffer, new_count, chunk);
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+int VfsTruncate(const char* path, uint64_t new_size) {
     uint64_t file_size = VfsGetFileSize(path);
     if (new_size >= file_size) return 0;
-    
-    if (new_size == 0) {
-        return VfsWriteFile(path, "", 0);
+
+    int fd = VfsOpen(path, FS_WRITE);
+    if (fd < 0) return -1;
+    int result = VfsFileTruncate(&open_files[fd], new_size);
+    VfsClose(fd);
+    return result;
+}
+
+int VfsExtend(const char* path, uint64_t additional_size, uint8_t fill_byte) {
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    uint64_t file_size = VfsFileSize(file);
+    int result = -1;
+    if (additional_size <= (uint64_t)INT64_MAX - file_size) {
+        result = VfsFileFill(file, file_size, additional_size, fill_byte, chunk);
+    }
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+int VfsSwapRegions(const char* path, uint64_t offset1, uint64_t offset2, uint64_t count) {
+    // Overlapping regions have no well-defined swap
+    uint64_t gap = offset1 > offset2 ? offset1 - offset2 : offset2 - offset1;
+    if (gap != 0 && gap < count) return -1;
+
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    uint64_t file_size = VfsFileSize(file);
+    int result = -1;
+    if (VfsRegionFits(file_size, offset1, count) && VfsRegionFits(file_size, offset2, count)) {
+        const uint64_t half = VFS_REGION_CHUNK / 2;
+        result = 0;
+        for (uint64_t done = 0; gap && done < count && result == 0;) {
+            uint64_t n = count - done > half ? half : count - done;
+            if (VfsFileReadFull(file, offset1 + done, chunk, n) != 0 ||
+                VfsFileReadFull(file, offset2 + done, chunk + half, n) != 0 ||
+                VfsFileWriteFull(file, offset1 + done, chunk + half, n) != 0 ||
+                VfsFileWriteFull(file, offset2 + done, chunk, n) != 0) result = -1;
+            done += n;
+        }
+    }
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+int64_t VfsFillRegion(const char* path, uint64_t offset, uint64_t count, uint8_t pattern) {
+    if (offset > INT64_MAX || count > (uint64_t)INT64_MAX - offset) return -1;
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 1, &chunk);
+    if (!file) return -1;
+
+    // Drivers zero any gap between the old end of file and offset
+    int64_t result = VfsFileFill(file, offset, count, pattern, chunk) == 0 ? (int64_t)count : -1;
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+// 0 if the regions match, 1 if they differ, -1 if either is out of range
+int VfsCompareRegions(const char* path1, uint64_t offset1, const char* path2, uint64_t offset2, uint64_t count) {
+    uint8_t* chunk;
+    VfsFile* file1 = VfsRegionOpen(path1, FS_READ, 0, &chunk);
+    if (!file1) return -1;
+    int fd2 = VfsOpen(path2, FS_READ);
+    if (fd2 < 0) {
+        VfsRegionClose(file1, chunk);
+        return -1;
+    }
+    VfsFile* file2 = &open_files[fd2];
+
+    int result = -1;
+    if (VfsRegionFits(VfsFileSize(file1), offset1, count) && VfsRegionFits(VfsFileSize(file2), offset2, count)) {
+        const uint64_t half = VFS_REGION_CHUNK / 2;
+        result = 0;
+        for (uint64_t done = 0; done < count && result == 0;) {
+            uint64_t n = count - done > half ? half : count - done;
+            if (VfsFileReadFull(file1, offset1 + done, chunk, n) != 0 ||
+                VfsFileReadFull(file2, offset2 + done, chunk + half, n) != 0) result = -1;
+            else if (FastMemcmp(chunk, chunk + half, n) != 0) result = 1;
+            done += n;
+        }
+    }
+    VfsClose(fd2);
+    VfsRegionClose(file1, chunk);
+    return result;
+}
+
+int64_t VfsCopyRegion(const char* src_path, uint64_t src_offset, const char* dst_path, uint64_t dst_offset, uint64_t count) {
+    if (!src_path || !dst_path || dst_offset > INT64_MAX) return -1;
+
+    // Within one file the regions may overlap; copy as memmove does
+    if (FastStrCmp(src_path, dst_path) == 0) {
+        uint8_t* chunk;
+        VfsFile* file = VfsRegionOpen(src_path, FS_READ | FS_WRITE, 0, &chunk);
+        if (!file) return -1;
+        uint64_t file_size = VfsFileSize(file);
+        if (src_offset > file_size) src_offset = file_size;
+        if (count > file_size - src_offset) count = file_size - src_offset;
+        int64_t result = -1;
+        if (count <= (uint64_t)INT64_MAX - dst_offset &&
+            VfsFileShift(file, src_offset, dst_offset, count, chunk) == 0) result = (int64_t)count;
+        VfsRegionClose(file, chunk);
+        return result;
+    }
+
+    uint8_t* chunk;
+    VfsFile* src = VfsRegionOpen(src_path, FS_READ, 0, &chunk);
+    if (!src) return -1;
+    int dst_fd = VfsOpen(dst_path, FS_READ | FS_WRITE | FS_CREATE);
+    if (dst_fd < 0 || !open_files[dst_fd].handle) {
+        if (dst_fd >= 0) VfsClose(dst_fd);
+        VfsRegionClose(src, chunk);
+        return -1;
+    }
+
+    uint64_t src_size = VfsFileSize(src);
+    if (src_offset > src_size) src_offset = src_size;
+    if (count > src_size - src_offset) count = src_size - src_offset;
+    int64_t result = -1;
+    if (count <= (uint64_t)INT64_MAX - dst_offset &&
+        VfsFileCopy(src, src_offset, &open_files[dst_fd], dst_offset, count, chunk) == 0) result = (int64_t)count;
+
+    VfsClose(dst_fd);
+    VfsRegionClose(src, chunk);
+    return result;
+}
+
+// The region is cut out and reinserted so that it starts at dst_offset;
+// the bytes in between close up behind it and the size is unchanged
+int VfsMoveRegion(const char* path, uint64_t src_offset, uint64_t dst_offset, uint64_t count) {
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    uint64_t file_size = VfsFileSize(file);
+    int result = -1;
+    if (VfsRegionFits(file_size, src_offset, count) && VfsRegionFits(file_size, dst_offset, count)) {
+        if (dst_offset > src_offset) {
+            uint64_t span = dst_offset + count - src_offset;
+            result = VfsFileRotate(file, src_offset, span, span - count, chunk);
+        } else {
+            result = VfsFileRotate(file, dst_offset, src_offset + count - dst_offset, count, chunk);
+        }
+    }
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+int64_t VfsSearchBytes(const char* path, const void* pattern, uint32_t pattern_size, uint64_t start_offset) {
+    if (!pattern) return -1;
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ, 0, &chunk);
+    if (!file) return -1;
+
+    int64_t result = VfsFileSearch(file, pattern, pattern_size, start_offset, chunk);
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+// Replaces every non-overlapping occurrence of old_pattern, scanning left
+// to right, and returns the number replaced. Matches are gathered in
+// batches so each batch moves the tail once: the segments between matches
+// shift by a growing multiple of the size difference, back to front when
+// the file grows and front to back when it shrinks.
+int VfsReplaceBytes(const char* path, const void* old_pattern, uint32_t old_size, const void* new_pattern, uint32_t new_size) {
+    if (!old_pattern || old_size == 0 || (new_size && !new_pattern)) return -1;
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    const int64_t delta = (int64_t)new_size - (int64_t)old_size;
+    if (delta < 0 && !VfsFileCanTruncate(file)) {
+        VfsRegionClose(file, chunk);
+        return -1;
+    }
+    uint64_t match[VFS_REPLACE_BATCH];
+    uint64_t pos = 0;
+    int replaced = 0;
+
+    for (;;) {
+        uint32_t n = 0;
+        for (uint64_t scan = pos; n < VFS_REPLACE_BATCH; n++) {
+            int64_t at = VfsFileSearch(file, old_pattern, old_size, scan, chunk);
+            if (at < 0) break;
+            match[n] = (uint64_t)at;
+            scan = (uint64_t)at + old_size;
+        }
+        if (n == 0) break;
+
+        const uint64_t file_size = VfsFileSize(file);
+        if (delta > 0 && (uint64_t)delta * n > (uint64_t)INT64_MAX - file_size) {
+            replaced = -1;
+            break;
+        }
+
+        int failed = 0;
+        for (uint32_t k = 0; k < n && !failed; k++) {
+            const uint32_t j = delta > 0 ? n - 1 - k : k;
+            const uint64_t seg = match[j] + old_size;
+            const uint64_t seg_end = j + 1 < n ? match[j + 1] : file_size;
+            const uint64_t dst = (uint64_t)((int64_t)seg + (int64_t)(j + 1) * delta);
+            const uint64_t at = (uint64_t)((int64_t)match[j] + (int64_t)j * delta);
+            if (delta > 0) {
+                failed = VfsFileShift(file, seg, dst, seg_end - seg, chunk) != 0 ||
+                         (new_size && VfsFileWriteFull(file, at, new_pattern, new_size) != 0);
+            } else {
+                failed = (new_size && VfsFileWriteFull(file, at, new_pattern, new_size) != 0) ||
+                         VfsFileShift(file, seg, dst, seg_end - seg, chunk) != 0;
+            }
+        }
+        if (!failed && delta < 0) failed = VfsFileTruncate(file, file_size - (uint64_t)(-delta) * n) != 0;
+        if (failed) {
+            replaced = -1;
+            break;
+        }
+
+        replaced += n;
+        pos = (uint64_t)((int64_t)match[n - 1] + (int64_t)(n - 1) * delta) + new_size;
+        if (n < VFS_REPLACE_BATCH) break;
+    }
+
+    VfsRegionClose(file, chunk);
+    return replaced;
+}
+
+int64_t VfsChecksum(const char* path, uint64_t offset, uint64_t count) {
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ, 0, &chunk);
+    if (!file) return -1;
+
+    uint64_t file_size = VfsFileSize(file);
+    uint32_t checksum = 0;
+    int64_t result = 0;
+    if (offset < file_size) {
+        uint64_t actual_count = (count > file_size - offset) ? file_size - offset : count;
+        for (uint64_t done = 0; done < actual_count;) {
+            uint64_t n = actual_count - done > VFS_REGION_CHUNK ? VFS_REGION_CHUNK : actual_count - done;
+            if (VfsFileReadFull(file, offset + done, chunk, n) != 0) {
+                result = -1;
+                break;
+            }
+            for (uint64_t i = 0; i < n; i++) checksum += chunk[i];
+            done += n;
+        }
+        if (result == 0) result = checksum;
+    }
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+int VfsReverse(const char* path, uint64_t offset, uint64_t count) {
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    int result = -1;
+    if (VfsRegionFits(VfsFileSize(file), offset, count)) result = VfsFileReverse(file, offset, count, chunk);
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+// Positive positions rotate towards the end of the region, negative
+// towards its start
+int VfsRotate(const char* path, uint64_t offset, uint64_t count, int64_t positions) {
+    if (count > INT64_MAX) return -1;
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    int result = -1;
+    if (VfsRegionFits(VfsFileSize(file), offset, count)) {
+        int64_t shift = count ? positions % (int64_t)count : 0;
+        if (shift < 0) shift += (int64_t)count;
+        result = VfsFileRotate(file, offset, count, (uint64_t)shift, chunk);
+    }
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+int VfsTransform(const char* path, uint64_t offset, uint64_t count, uint8_t (*transform_func)(uint8_t)) {
+    if (!transform_func) return -1;
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ | FS_WRITE, 0, &chunk);
+    if (!file) return -1;
+
+    int result = -1;
+    if (VfsRegionFits(VfsFileSize(file), offset, count)) {
+        result = 0;
+        for (uint64_t done = 0; done < count && result == 0;) {
+            uint64_t n = count - done > VFS_REGION_CHUNK ? VFS_REGION_CHUNK : count - done;
+            if (VfsFileReadFull(file, offset + done, chunk, n) != 0) {
+                result = -1;
+                break;
+            }
+            for (uint64_t i = 0; i < n; i++) chunk[i] = transform_func(chunk[i]);
+            if (VfsFileWriteFull(file, offset + done, chunk, n) != 0) result = -1;
+            done += n;
+        }
+    }
+    VfsRegionClose(file, chunk);
+    return result;
+}
+
+// log2(x) in 16.16 fixed point for x > 0: the integer part is the top set
+// bit, and each squaring of the normalised mantissa yields a fraction bit
+static uint64_t VfsLog2Fixed(uint64_t x) {
+    uint32_t msb = 63;
+    while (!(x >> msb)) msb--;
+    uint64_t m = msb >= 31 ? x >> (msb - 31) : x << (31 - msb); // 1.31
+    uint64_t result = (uint64_t)msb << 16;
+    for (int bit = 15; bit >= 0; bit--) {
+        m = (m * m) >> 31;
+        if (m >= (2ull << 31)) {
+            m >>= 1;
+            result |= 1ull << bit;
+        }
+    }
+    return result;
+}
+
+// Fills byte_counts[256] with the byte histogram and *entropy, if given,
+// with the Shannon entropy in thousandths of a bit per byte (0 to 8000)
+int VfsAnalyze(const char* path, uint64_t* byte_counts, uint32_t* entropy) {
+    if (!byte_counts) return -1;
+    uint8_t* chunk;
+    VfsFile* file = VfsRegionOpen(path, FS_READ, 0, &chunk);
+    if (!file) return -1;
+
+    FastMemset(byte_counts, 0, 256 * sizeof(uint64_t));
+    uint64_t file_size = VfsFileSize(file);
+    int result = 0;
+    for (uint64_t done = 0; done < file_size;) {
+        uint64_t n = file_size - done > VFS_REGION_CHUNK ? VFS_REGION_CHUNK : file_size - done;
+        if (VfsFileReadFull(file, done, chunk, n) != 0) {
+            result = -1;
+            break;
+        }
+        for (uint64_t i = 0; i < n; i++) byte_counts[chunk[i]]++;
+        done += n;
+    }
+    VfsRegionClose(file, chunk);
+
+    if (result == 0 && entropy) {
+        // H = sum of (c / N) * (log2 N - log2 c), with c and N scaled down
+        // together so the products stay within 64 bits
+        uint64_t bits = 0;
+        if (file_size > 0) {
+            const uint64_t log_total = VfsLog2Fixed(file_size);
+            uint32_t scale = 0;
+            while ((file_size >> scale) >= (1ull << 40)) scale++;
+            for (int i = 0; i < 256; i++) {
+                if (!byte_counts[i]) continue;
+                bits += ((byte_counts[i] >> scale) * (log_total - VfsLog2Fixed(byte_counts[i]))) / (file_size >> scale);
+            }
+        }
+        *entropy = (uint32_t)((bits * 1000) >> 16);
     }
-    
-    void* buffer = KernelMemoryAlloc(new_size);
-    if (!buffer) return -1;
-    
-    VfsReadFile(path, buffer, new_size);
-    int result = VfsWriteFile(path, buffer, new_size);
-    KernelFree(buffer);
     return result;
 }
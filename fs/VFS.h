@@ -8,11 +8,14 @@ struct FileSystemDriver;
 
 // VFS Mount Points
 #define VFS_MAX_MOUNTS 8
+#define VFS_MAX_OPEN_FILES 32
 
 typedef struct {
     char mount_point[64];
+    int mount_len;      // FastStrlen(mount_point), cached for VfsFindMount
     struct BlockDevice* device;
     struct FileSystemDriver* fs_driver;
+    void* fs_data;      // driver's per-mount context
     int active;
 } VfsMountStruct;
 
@@ -53,10 +56,12 @@ static const char * RuntimeMounts = "/Runtime/Mounts";
 
 // VFS Functions
 int VfsInit(void);
-int VfsMount(const char* path, BlockDevice* device, FileSystemDriver* fs_driver);
+int VfsMount(const char* path, BlockDevice* device, FileSystemDriver* fs_driver, void* fs_data);
 int VfsUmount(const char* path);
-int VfsReadFile(const char* path, void* buffer, uint32_t max_size);
-int VfsWriteFile(const char* path, const void* buffer, uint32_t size);
+int VfsSync(void);
+void VfsWriteback(void);
+int64_t VfsReadFile(const char* path, void* buffer, uint64_t max_size);
+int64_t VfsWriteFile(const char* path, const void* buffer, uint64_t size);
 int VfsListDir(const char* path);
 int VfsCreateFile(const char* path);
 int VfsCreateDir(const char* path);
@@ -64,29 +69,36 @@ int VfsDelete(const char* path, bool Recursive);
 int VfsIsDir(const char* path);
 int VfsIsFile(const char* path);
 uint64_t VfsGetFileSize(const char* path);
-int VfsAppendFile(const char* path, const void* buffer, uint32_t size);
+int64_t VfsAppendFile(const char* path, const void* buffer, uint64_t size);
 int VfsCopyFile(const char* src_path, const char* dest_path);
 int VfsMoveFile(const char* src_path, const char* dest_path);
 
-int VfsReadAt(const char* path, void* buffer, uint32_t offset, uint32_t count);
-int VfsWriteAt(const char* path, const void* buffer, uint32_t offset, uint32_t count);
-int VfsInsertAt(const char* path, const void* buffer, uint32_t offset, uint32_t count);
-int VfsDeleteAt(const char* path, uint32_t offset, uint32_t count);
-int VfsReplaceAt(const char* path, const void* buffer, uint32_t offset, uint32_t old_count, uint32_t new_count);
-int VfsTruncate(const char* path, uint32_t new_size);
-int VfsExtend(const char* path, uint32_t additional_size, uint8_t fill_byte);
-int VfsSwapRegions(const char* path, uint32_t offset1, uint32_t offset2, uint32_t count);
-int VfsFillRegion(const char* path, uint32_t offset, uint32_t count, uint8_t pattern);
-int VfsCompareRegions(const char* path1, uint32_t offset1, const char* path2, uint32_t offset2, uint32_t count);
-int VfsCopyRegion(const char* src_path, uint32_t src_offset, const char* dst_path, uint32_t dst_offset, uint32_t count);
-int VfsMoveRegion(const char* path, uint32_t src_offset, uint32_t dst_offset, uint32_t count);
-int VfsSearchBytes(const char* path, const void* pattern, uint32_t pattern_size, uint32_t start_offset);
+// Descriptor-based I/O; flags are FsOpenFlags and FS_CREATE creates the file
+int VfsOpen(const char* path, int flags);
+int64_t VfsRead(int fd, void* buffer, uint64_t count);
+int64_t VfsWrite(int fd, const void* buffer, uint64_t count);
+int64_t VfsSeek(int fd, int64_t offset, int whence);
+int VfsClose(int fd);
+
+int64_t VfsReadAt(const char* path, void* buffer, uint64_t offset, uint64_t count);
+int64_t VfsWriteAt(const char* path, const void* buffer, uint64_t offset, uint64_t count);
+int64_t VfsInsertAt(const char* path, const void* buffer, uint64_t offset, uint64_t count);
+int64_t VfsDeleteAt(const char* path, uint64_t offset, uint64_t count);
+int VfsReplaceAt(const char* path, const void* buffer, uint64_t offset, uint64_t old_count, uint64_t new_count);
+int VfsTruncate(const char* path, uint64_t new_size);
+int VfsExtend(const char* path, uint64_t additional_size, uint8_t fill_byte);
+int VfsSwapRegions(const char* path, uint64_t offset1, uint64_t offset2, uint64_t count);
+int64_t VfsFillRegion(const char* path, uint64_t offset, uint64_t count, uint8_t pattern);
+int VfsCompareRegions(const char* path1, uint64_t offset1, const char* path2, uint64_t offset2, uint64_t count);
+int64_t VfsCopyRegion(const char* src_path, uint64_t src_offset, const char* dst_path, uint64_t dst_offset, uint64_t count);
+int VfsMoveRegion(const char* path, uint64_t src_offset, uint64_t dst_offset, uint64_t count);
+int64_t VfsSearchBytes(const char* path, const void* pattern, uint32_t pattern_size, uint64_t start_offset);
 int VfsReplaceBytes(const char* path, const void* old_pattern, uint32_t old_size, const void* new_pattern, uint32_t new_size);
-int VfsChecksum(const char* path, uint32_t offset, uint32_t count);
-int VfsReverse(const char* path, uint32_t offset, uint32_t count);
-int VfsRotate(const char* path, uint32_t offset, uint32_t count, int positions);
-int VfsTransform(const char* path, uint32_t offset, uint32_t count, uint8_t (*transform_func)(uint8_t));
-int VfsAnalyze(const char* path, uint32_t* byte_counts, uint32_t* entropy);
+int64_t VfsChecksum(const char* path, uint64_t offset, uint64_t count);
+int VfsReverse(const char* path, uint64_t offset, uint64_t count);
+int VfsRotate(const char* path, uint64_t offset, uint64_t count, int64_t positions);
+int VfsTransform(const char* path, uint64_t offset, uint64_t count, uint8_t (*transform_func)(uint8_t));
+int VfsAnalyze(const char* path, uint64_t* byte_counts, uint32_t* entropy);
 
 // Search modes
 #define VFS_SEARCH_FIRST 0
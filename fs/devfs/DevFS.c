@@ -10,7 +10,8 @@ int DevfsMount(struct BlockDevice* device, const char* mount_point) {
     return 0;
 }
 
-int DevfsReadFile(const char* path, void* buffer, uint32_t max_size) {
+int64_t DevfsReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size) {
+    (void)fs_data;
     // The path is the device name, e.g. "/Serial"
     // We need to strip the leading '/'
     const char* dev_name = path + 1;
@@ -18,19 +19,22 @@ int DevfsReadFile(const char* path, void* buffer, uint32_t max_size) {
     if (!dev || !dev->Read) {
         return -1;
     }
-    return dev->Read(dev, buffer, max_size);
+    return dev->Read(dev, buffer, max_size > UINT32_MAX ? UINT32_MAX : (uint32_t)max_size);
 }
 
-int DevfsWriteFile(const char* path, const void* buffer, uint32_t size) {
+int64_t DevfsWriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size) {
+    (void)fs_data;
     const char* dev_name = path + 1;
     CharDevice_t* dev = CharDeviceFind(dev_name);
     if (!dev || !dev->Write) {
         return -1;
     }
-    return dev->Write(dev, buffer, size);
+    if (size > UINT32_MAX) return -1;
+    return dev->Write(dev, buffer, (uint32_t)size);
 }
 
-int DevfsListDir(const char* path) {
+int DevfsListDir(void* fs_data, const char* path) {
+    (void)fs_data;
     // We only support listing the root of /Devices
     if (FastStrCmp(path, "/") != 0) {
         return -1;
@@ -47,10 +51,20 @@ int DevfsListDir(const char* path) {
     return 0;
 }
 
-int DevfsIsDir(const char* path) {
+int DevfsIsDir(void* fs_data, const char* path) {
+    (void)fs_data;
     // Only the root of DevFS is considered a directory
     if (FastStrCmp(path, "/") == 0) {
         return 1;
     }
     return 0;
 }
+
+FileSystemDriver g_devfs_driver = {
+    .name = "DevFS",
+    .mount = DevfsMount,
+    .read_file = DevfsReadFile,
+    .write_file = DevfsWriteFile,
+    .list_dir = DevfsListDir,
+    .is_dir = DevfsIsDir,
+};
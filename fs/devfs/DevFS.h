@@ -2,14 +2,17 @@
 #define VOIDFRAME_DEVFS_H
 
 #include <BlockDevice.h>
+#include <FileSystem.h>
+
+extern FileSystemDriver g_devfs_driver;
 
 // This is a virtual filesystem, so it doesn't have a block device.
 // The mount function is just a placeholder to satisfy the FileSystemDriver struct.
 int DevfsMount(struct BlockDevice* device, const char* mount_point);
 
-int DevfsReadFile(const char* path, void* buffer, uint32_t max_size);
-int DevfsWriteFile(const char* path, const void* buffer, uint32_t size);
-int DevfsListDir(const char* path);
-int DevfsIsDir(const char* path);
+int64_t DevfsReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size);
+int64_t DevfsWriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size);
+int DevfsListDir(void* fs_data, const char* path);
+int DevfsIsDir(void* fs_data, const char* path);
 
 #endif //VOIDFRAME_DEVFS_H
@@ -51,8 +51,17 @@ int ProcfsMount(struct BlockDevice* device, const char* mount_point) {
     return 0;
 }
 
-int ProcfsReadFile(const char* path, void* buffer, uint32_t max_size) {
+int64_t ProcfsReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size) {
+    (void)fs_data;
     if (path[0] != '/') return -1;
+    if (max_size > UINT32_MAX) max_size = UINT32_MAX; // reports are small
+
+    if (FastStrCmp(path, "/diskstats") == 0) {
+        return BlockDeviceFormatDiskStats(buffer, max_size);
+    }
+    if (FastStrCmp(path, "/iolatency") == 0) {
+        return BlockDeviceFormatLatency(buffer, max_size);
+    }
 
     char pid_str[16];
     int i = 1;
@@ -97,22 +106,29 @@ int ProcfsReadFile(const char* path, void* buffer, uint32_t max_size) {
                          pcb->cpu_time_accumulated,
                          pcb->creation_time);
 
-        if (len > max_size) len = max_size;
-        FastMemcpy(buffer, local_buffer, len);
-        return len;
+        if (len < 0) return -1;
+        // snprintf reports the untruncated length
+        uint64_t count = (uint64_t)len < sizeof(local_buffer) ? (uint64_t)len : sizeof(local_buffer) - 1;
+        if (count > max_size) count = max_size;
+        FastMemcpy(buffer, local_buffer, count);
+        return (int64_t)count;
     }
     return -1;
 }
 
-int ProcfsWriteFile(const char* path, const void* buffer, uint32_t size) {
+int64_t ProcfsWriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size) {
+    (void)fs_data;
     (void)path;
     (void)buffer;
     (void)size;
     return -1;
 }
 
-int ProcfsListDir(const char* path) {
+int ProcfsListDir(void* fs_data, const char* path) {
+    (void)fs_data;
     if (FastStrCmp(path, "/") == 0) {
+        PrintKernelF("  diskstats\n");
+        PrintKernelF("  iolatency\n");
         ProcFSEntry* current = proc_list_head;
         while (current) {
             PrintKernelF("  %d/\n", current->pid);
@@ -145,7 +161,8 @@ int ProcfsListDir(const char* path) {
     return -1;
 }
 
-int ProcfsIsDir(const char* path) {
+int ProcfsIsDir(void* fs_data, const char* path) {
+    (void)fs_data;
     if (FastStrCmp(path, "/") == 0) {
         return 1;
     }
@@ -171,4 +188,13 @@ int ProcfsIsDir(const char* path) {
         }
     }
     return 0;
-}
\ No newline at end of file
+}
+
+FileSystemDriver g_procfs_driver = {
+    .name = "ProcFS",
+    .mount = ProcfsMount,
+    .read_file = ProcfsReadFile,
+    .write_file = ProcfsWriteFile,
+    .list_dir = ProcfsListDir,
+    .is_dir = ProcfsIsDir,
+};
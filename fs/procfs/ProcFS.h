@@ -2,6 +2,7 @@
 #define VOIDFRAME_PROCFS_H
 
 #include <BlockDevice.h>
+#include <FileSystem.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -21,19 +22,21 @@ void ProcFSRegisterProcess(uint32_t pid, void* data);
 // Unregisters a process from procfs using its PID.
 void ProcFSUnregisterProcess(uint32_t pid);
 
+extern FileSystemDriver g_procfs_driver;
+
 // Mounts the procfs. This is a dummy function as procfs is a virtual filesystem.
 int ProcfsMount(struct BlockDevice* device, const char* mount_point);
 
 // Reads the content of a file within the procfs.
-int ProcfsReadFile(const char* path, void* buffer, uint32_t max_size);
+int64_t ProcfsReadFile(void* fs_data, const char* path, void* buffer, uint64_t max_size);
 
 // Writes content to a file in procfs. Currently not supported.
-int ProcfsWriteFile(const char* path, const void* buffer, uint32_t size);
+int64_t ProcfsWriteFile(void* fs_data, const char* path, const void* buffer, uint64_t size);
 
 // Lists the directory contents in procfs.
-int ProcfsListDir(const char* path);
+int ProcfsListDir(void* fs_data, const char* path);
 
 // Checks if a given path in procfs is a directory.
-int ProcfsIsDir(const char* path);
+int ProcfsIsDir(void* fs_data, const char* path);
 
 #endif //VOIDFRAME_PROCFS_H
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <Multiboot2.h>
 #include <Console.h>
 #include <VFS.h>
+#include <storage/RamDisk.h>
 extern uint32_t g_multiboot_info_addr;
 
 void InitRDLoad(void) {
@@ -16,10 +17,14 @@ void InitRDLoad(void) {
     
     struct MultibootTag* tag = (struct MultibootTag*)(g_multiboot_info_addr + 8);
     
-    while (tag->type != MULTIBOOT2_TAG_TYPE_END) {
+    for (; tag->type != MULTIBOOT2_TAG_TYPE_END;
+         tag = (struct MultibootTag*)((uint8_t*)tag + ((tag->size + 7) & ~7))) {
         if (tag->type == MULTIBOOT2_TAG_TYPE_MODULE) {
             struct MultibootModuleTag* mod = (struct MultibootModuleTag*)tag;
             uint32_t mod_size = mod->mod_end - mod->mod_start;
+
+            // Disk images are handed to the ramdisk driver instead
+            if (RamDiskIsModule(mod->cmdline)) continue;
             
             PrintKernelF("InitRD: Module: %s\n", mod->cmdline);
             PrintKernelF("InitRD: Start: 0x%08X, End: 0x%08X, Size: %u\n", 
@@ -61,6 +66,5 @@ void InitRDLoad(void) {
                 PrintKernelF("InitRD: Failed to copy %s\n", mod->cmdline);
             }
         }
-        tag = (struct MultibootTag*)((uint8_t*)tag + ((tag->size + 7) & ~7));
     }
 }
\ No newline at end of file
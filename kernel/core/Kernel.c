@@ -3,6 +3,7 @@
 #include <drivers/APIC/APIC.h>
 #include <drivers/storage/Ide.h>
 #include <ACPI.h>
+#include <BlockCache.h>
 #include <CharDevice.h>
 #include <Console.h>
 #include <CRC32.h>
@@ -40,6 +41,7 @@
 #include <stdint.h>
 #include <storage/AHCI.h>
 #include <storage/NVMe.h>
+#include <storage/RamDisk.h>
 #include <virtio/Virtio.h>
 #include <virtio/VirtioBlk.h>
 #include <xHCI/xHCI.h>
@@ -618,6 +620,11 @@ static InitResultT PXS2(void) {
     }
 #endif
 
+#ifdef VF_CONFIG_ENABLE_RAMDISK
+    // RAM disks from the command line and ramdisk modules
+    RamDiskInit();
+#endif
+
     // Initialize RFS
     PrintKernel("Info: Initializing RFS...\n");
     FsInit();
@@ -793,6 +800,8 @@ void KernelMainHigherHalf(void) {
     sti();
 
     while (1) {
+        VfsWriteback();
+        BlockCacheWriteback();
         Yield();
     }
 
@@ -0,0 +1,294 @@
+#include <BlkBench.h>
+#include <BlockCache.h>
+#include <BlockDevice.h>
+#include <Console.h>
+#include <IoScheduler.h>
+#include <KernelHeap.h>
+#include <MemOps.h>
+#include <StringOps.h>
+#include <TSC.h>
+#include <stdlib.h>
+#include <x64.h>
+
+#define BLKBENCH_MAX_QD         32
+#define BLKBENCH_MAX_BLOCK      (1024 * 1024)
+#define BLKBENCH_MAX_SECONDS    300
+
+// Log-linear latency histogram in nanoseconds: values below 8 get their own
+// bucket, above that every power of two is split into 8 sub-buckets, so a
+// reported percentile is within 12.5% of the true value.
+#define BLKBENCH_SUB_BITS       3
+#define BLKBENCH_SUB_BUCKETS    (1 << BLKBENCH_SUB_BITS)
+#define BLKBENCH_HIST_BUCKETS   ((64 - BLKBENCH_SUB_BITS) * BLKBENCH_SUB_BUCKETS)
+
+static uint64_t g_hist[BLKBENCH_HIST_BUCKETS];
+static int g_bench_running = 0;
+static uint64_t g_rng_state = 0;
+
+static uint64_t BenchRandom(void) {
+    uint64_t x = g_rng_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    g_rng_state = x;
+    return x;
+}
+
+static uint32_t HistBucket(uint64_t ns) {
+    if (ns < BLKBENCH_SUB_BUCKETS) return (uint32_t)ns;
+    const uint32_t msb = 63 - __builtin_clzll(ns);
+    const uint32_t sub = (uint32_t)(ns >> (msb - BLKBENCH_SUB_BITS)) & (BLKBENCH_SUB_BUCKETS - 1);
+    uint32_t bucket = (msb - BLKBENCH_SUB_BITS + 1) * BLKBENCH_SUB_BUCKETS + sub;
+    return bucket < BLKBENCH_HIST_BUCKETS ? bucket : BLKBENCH_HIST_BUCKETS - 1;
+}
+
+// Lower bound of a bucket
+static uint64_t HistValue(uint32_t bucket) {
+    if (bucket < BLKBENCH_SUB_BUCKETS) return bucket;
+    const uint32_t msb = bucket / BLKBENCH_SUB_BUCKETS + BLKBENCH_SUB_BITS - 1;
+    const uint64_t sub = bucket % BLKBENCH_SUB_BUCKETS;
+    return (1ULL << msb) | (sub << (msb - BLKBENCH_SUB_BITS));
+}
+
+static uint64_t HistPercentile(uint64_t total, uint32_t per_mille_x10) {
+    // per_mille_x10: 5000 = p50, 9900 = p99, 9990 = p99.9
+    const uint64_t target = (total * per_mille_x10 + 9999) / 10000;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < BLKBENCH_HIST_BUCKETS; b++) {
+        seen += g_hist[b];
+        if (seen >= target && seen) return HistValue(b);
+    }
+    return 0;
+}
+
+static uint64_t TscToNs(uint64_t ticks) {
+    const uint64_t freq = TSCGetFrequency();
+    if (!freq) return 0;
+    return (ticks / freq) * 1000000000ULL + (ticks % freq) * 1000000000ULL / freq;
+}
+
+int BlkBenchRun(const BlkBenchConfig* config, BlkBenchResult* result) {
+    if (!config || !result) return -1;
+    FastMemset(result, 0, sizeof(*result)); // callers read it on failure too
+    BlockDevice* dev = BlockDeviceGet(config->device_id);
+    if (!dev || !dev->block_size || !dev->total_blocks) return -1;
+    if (config->block_bytes == 0 || config->block_bytes % dev->block_size ||
+        config->block_bytes > BLKBENCH_MAX_BLOCK) return -1;
+    if (config->queue_depth == 0 || config->queue_depth > BLKBENCH_MAX_QD) return -1;
+
+    const uint32_t sectors = config->block_bytes / dev->block_size;
+    if (dev->total_blocks < sectors) return -1;
+    const uint64_t slots = dev->total_blocks / sectors; // aligned request positions
+
+    if (g_bench_running) return -1;
+    g_bench_running = 1;
+
+    uint8_t* buffer = KernelMemoryAlloc((uint64_t)config->block_bytes * config->queue_depth);
+    BlockRequest* reqs = KernelMemoryAlloc(sizeof(BlockRequest) * config->queue_depth);
+    if (!buffer || !reqs) {
+        KernelFree(buffer);
+        KernelFree(reqs);
+        g_bench_running = 0;
+        return -1;
+    }
+    for (uint64_t i = 0; i < (uint64_t)config->block_bytes * config->queue_depth; i++) {
+        buffer[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    FastMemset(g_hist, 0, sizeof(g_hist));
+    result->min_ns = UINT64_MAX;
+    g_rng_state = rdtsc() | 1;
+
+    const uint64_t freq = TSCGetFrequency();
+    const uint64_t duration_ticks = freq / 1000 * config->duration_ms;
+    uint64_t next_slot = 0;
+    uint64_t total_ns = 0;
+    int status = 0;
+
+    const uint64_t bench_start = rdtsc();
+    while (rdtsc() - bench_start < duration_ticks) {
+        for (uint32_t i = 0; i < config->queue_depth; i++) {
+            uint64_t slot;
+            if (config->pattern == BLKBENCH_RAND) {
+                slot = BenchRandom() % slots;
+            } else {
+                slot = next_slot;
+                next_slot = (next_slot + 1) % slots;
+            }
+
+            BlockIoOp op = BIO_READ;
+            if (config->mode == BLKBENCH_WRITE) {
+                op = BIO_WRITE;
+            } else if (config->mode == BLKBENCH_MIXED) {
+                op = (BenchRandom() % 100) < config->read_percent ? BIO_READ : BIO_WRITE;
+            }
+
+            reqs[i] = (BlockRequest){
+                .op = op,
+                .lba = slot * sectors,
+                .count = sectors,
+                .buffer = buffer + (uint64_t)i * config->block_bytes
+            };
+        }
+
+        // The whole batch is handed to the queue at once; every request in
+        // it completes when the batch does, so that is its latency.
+        const uint64_t t0 = rdtsc();
+        const int rc = IoSubmit(dev, reqs, config->queue_depth);
+        const uint64_t ns = TscToNs(rdtsc() - t0);
+
+        for (uint32_t i = 0; i < config->queue_depth; i++) {
+            if (reqs[i].status != 0) {
+                result->errors++;
+                continue;
+            }
+            if (reqs[i].op == BIO_READ) result->reads++;
+            else result->writes++;
+            result->bytes += config->block_bytes;
+            g_hist[HistBucket(ns)]++;
+            total_ns += ns;
+            if (ns < result->min_ns) result->min_ns = ns;
+            if (ns > result->max_ns) result->max_ns = ns;
+        }
+        if (rc != 0) {
+            status = -1;
+            break;
+        }
+    }
+    result->elapsed_ns = TscToNs(rdtsc() - bench_start);
+
+    const uint64_t ops = result->reads + result->writes;
+    if (ops) {
+        result->avg_ns = total_ns / ops;
+        result->p50_ns = HistPercentile(ops, 5000);
+        result->p99_ns = HistPercentile(ops, 9900);
+        result->p999_ns = HistPercentile(ops, 9990);
+    } else {
+        result->min_ns = 0;
+    }
+
+    KernelFree(reqs);
+    KernelFree(buffer);
+    g_bench_running = 0;
+    return status;
+}
+
+// Splits off the next space-separated token into out; returns the rest
+static const char* NextToken(const char* s, char* out, uint32_t out_size) {
+    while (*s == ' ') s++;
+    uint32_t n = 0;
+    while (*s && *s != ' ') {
+        if (n + 1 < out_size) out[n++] = *s;
+        s++;
+    }
+    out[n] = '\0';
+    return s;
+}
+
+// Accepts plain bytes or a k/m suffix
+static uint32_t ParseSize(const char* s) {
+    uint32_t value = (uint32_t)atoi(s);
+    while (*s >= '0' && *s <= '9') s++;
+    if (*s == 'k' || *s == 'K') value *= 1024;
+    else if (*s == 'm' || *s == 'M') value *= 1024 * 1024;
+    return value;
+}
+
+static void PrintNs(const char* label, uint64_t ns) {
+    if (ns >= 1000000) PrintKernelF("%s%llu.%llums", label, ns / 1000000, (ns / 100000) % 10);
+    else PrintKernelF("%s%llu.%lluus", label, ns / 1000, (ns / 100) % 10);
+}
+
+static void BlkBenchUsage(void) {
+    PrintKernel("Usage: blkbench <dev> [seq|rand] [read|write|mixed] [bs=4k] [qd=1] [time=5] [mix=70] [force]\n");
+    PrintKernel("  bs    request size (bytes, or with k/m suffix)\n");
+    PrintKernel("  qd    requests submitted per batch (1-32)\n");
+    PrintKernel("  time  duration in seconds\n");
+    PrintKernel("  mix   read percentage for mixed runs\n");
+    PrintKernel("  force required for write and mixed runs; data on the device is destroyed\n");
+}
+
+void BlkBenchHandler(const char* args) {
+    char token[64];
+    const char* p = NextToken(args, token, sizeof(token)); // command name
+    p = NextToken(p, token, sizeof(token));
+    if (!token[0]) {
+        BlkBenchUsage();
+        return;
+    }
+
+    BlockDevice* dev = SearchBlockDevice(token);
+    if (!dev) {
+        PrintKernelErrorF("blkbench: no such device '%s'\n", token);
+        return;
+    }
+
+    BlkBenchConfig cfg = {
+        .device_id = dev->id,
+        .pattern = BLKBENCH_SEQ,
+        .mode = BLKBENCH_READ,
+        .block_bytes = 4096,
+        .queue_depth = 1,
+        .duration_ms = 5000,
+        .read_percent = 70
+    };
+    int force = 0;
+
+    for (;;) {
+        p = NextToken(p, token, sizeof(token));
+        if (!token[0]) break;
+        if (FastStrCmp(token, "seq") == 0) cfg.pattern = BLKBENCH_SEQ;
+        else if (FastStrCmp(token, "rand") == 0) cfg.pattern = BLKBENCH_RAND;
+        else if (FastStrCmp(token, "read") == 0) cfg.mode = BLKBENCH_READ;
+        else if (FastStrCmp(token, "write") == 0) cfg.mode = BLKBENCH_WRITE;
+        else if (FastStrCmp(token, "mixed") == 0) cfg.mode = BLKBENCH_MIXED;
+        else if (FastStrCmp(token, "force") == 0) force = 1;
+        else if (FastStrnCmp(token, "bs=", 3) == 0) cfg.block_bytes = ParseSize(token + 3);
+        else if (FastStrnCmp(token, "qd=", 3) == 0) cfg.queue_depth = (uint32_t)atoi(token + 3);
+        else if (FastStrnCmp(token, "time=", 5) == 0) cfg.duration_ms = (uint32_t)atoi(token + 5) * 1000;
+        else if (FastStrnCmp(token, "mix=", 4) == 0) cfg.read_percent = (uint32_t)atoi(token + 4);
+        else {
+            PrintKernelErrorF("blkbench: unknown option '%s'\n", token);
+            BlkBenchUsage();
+            return;
+        }
+    }
+
+    if (cfg.mode != BLKBENCH_READ && !force) {
+        PrintKernelError("blkbench: write workloads overwrite the device, add 'force' to proceed\n");
+        return;
+    }
+    if (cfg.duration_ms == 0 || cfg.duration_ms > BLKBENCH_MAX_SECONDS * 1000 || cfg.read_percent > 100) {
+        BlkBenchUsage();
+        return;
+    }
+
+    static const char* const mode_names[] = {"read", "write", "mixed"};
+    PrintKernelF("blkbench: %s %s %s bs=%u qd=%u time=%us\n", dev->name,
+                 cfg.pattern == BLKBENCH_SEQ ? "seq" : "rand", mode_names[cfg.mode],
+                 cfg.block_bytes, cfg.queue_depth, cfg.duration_ms / 1000);
+
+    BlkBenchResult r;
+    const int rc = BlkBenchRun(&cfg, &r);
+    // Writes went around the buffer cache; drop whatever it holds for the device
+    if (cfg.mode != BLKBENCH_READ) BlockCacheInvalidate(dev->id);
+    if (rc != 0 && r.reads + r.writes == 0) {
+        PrintKernelError("blkbench: run failed (check bs against the device block size)\n");
+        return;
+    }
+
+    const uint64_t ops = r.reads + r.writes;
+    const uint64_t elapsed = r.elapsed_ns ? r.elapsed_ns : 1;
+    const uint64_t iops = ops * 1000000000ULL / elapsed;
+    const uint64_t kbps = r.bytes * 1000000ULL / elapsed; // bytes/ns * 1e9 / 1e3
+    PrintKernelF("  ops=%llu (r=%llu w=%llu) errors=%llu\n", ops, r.reads, r.writes, r.errors);
+    PrintKernelF("  IOPS=%llu  MB/s=%llu.%llu\n", iops, kbps / 1000, (kbps / 100) % 10);
+    PrintNs("  lat min=", r.min_ns);
+    PrintNs(" avg=", r.avg_ns);
+    PrintNs(" max=", r.max_ns);
+    PrintKernel("\n");
+    PrintNs("  p50=", r.p50_ns);
+    PrintNs(" p99=", r.p99_ns);
+    PrintNs(" p99.9=", r.p999_ns);
+    PrintKernel("\n");
+}
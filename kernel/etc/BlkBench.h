@@ -0,0 +1,47 @@
+#ifndef VOIDFRAME_BLKBENCH_H
+#define VOIDFRAME_BLKBENCH_H
+
+#include <stdint.h>
+
+typedef enum {
+    BLKBENCH_SEQ,
+    BLKBENCH_RAND
+} BlkBenchPattern;
+
+typedef enum {
+    BLKBENCH_READ,
+    BLKBENCH_WRITE,
+    BLKBENCH_MIXED
+} BlkBenchMode;
+
+typedef struct {
+    int device_id;
+    BlkBenchPattern pattern;
+    BlkBenchMode mode;
+    uint32_t block_bytes;   // bytes per request, multiple of the device block size
+    uint32_t queue_depth;   // requests submitted together per batch
+    uint32_t duration_ms;
+    uint32_t read_percent;  // share of reads for BLKBENCH_MIXED
+} BlkBenchConfig;
+
+typedef struct {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t errors;
+    uint64_t bytes;
+    uint64_t elapsed_ns;
+    uint64_t min_ns;
+    uint64_t avg_ns;
+    uint64_t max_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+} BlkBenchResult;
+
+// Runs the workload straight against the device's I/O queue (no buffer
+// cache). Returns 0 on success, -1 on bad configuration or I/O failure.
+int BlkBenchRun(const BlkBenchConfig* config, BlkBenchResult* result);
+
+void BlkBenchHandler(const char* args);
+
+#endif // VOIDFRAME_BLKBENCH_H
@@ -142,7 +142,7 @@ static void EditorLoad(void) {
         return;
     }
 
-    int bytes = VfsReadFile(current_filename, temp_buffer, MAX_BUFFER_SIZE - 1);
+    int64_t bytes = VfsReadFile(current_filename, temp_buffer, MAX_BUFFER_SIZE - 1);
     
     if (bytes <= 0) {
         KernelFree(temp_buffer);
@@ -160,7 +160,7 @@ static void EditorLoad(void) {
     
     FastMemcpy(buffer, temp_buffer, bytes);
     KernelFree(temp_buffer);
-    buffer_size = bytes;
+    buffer_size = (int)bytes; // at most MAX_BUFFER_SIZE - 1
     cursor_pos = 0;
     dirty = 0;
 }
@@ -5,8 +5,11 @@
 #include <ethernet/interface/Icmp.h>
 #include <6502/6502.h>
 #include <ACPI.h>
+#include <BlkBench.h>
+#include <BlockCache.h>
 #include <Compositor.h>
 #include <Console.h>
+#include <DCache.h>
 #include <Editor.h>
 #include <ExecLoader.h>
 #include <Ext2.h>
@@ -15,6 +18,7 @@
 #include <FsUtils.h>
 #include <ISA.h>
 #include <InitRD.h>
+#include <IoScheduler.h>
 #include <Iso9660.h>
 #include <KernelHeap.h>
 #include <mm/dynamic/rust/KernelHeapRust.h>
@@ -218,6 +222,12 @@ static const HelpEntry hw_cmds[] = {
     {"lsmnt", "List Mountpoints"},
     {"mount <type> <dev>", "Mount a filesystem"},
     {"umount <path>", "Unmount a filesystem"},
+    {"sync", "Flush cached blocks to disk"},
+    {"bcstat", "Show block cache statistics"},
+    {"dcstat", "Show dentry cache statistics"},
+    {"fstrim [dev]", "Discard blocks freed by filesystems now"},
+    {"iosched [dev] [policy]", "Show or set the I/O scheduler"},
+    {"iostat [dev]", "Show block I/O statistics"},
     {"beep <x>", "Send beep x times"},
     {"pcbeep <x>", "PC speaker beep  for <x> seconds (200hz)"},
     {"irqmask <irq>", "Mask IRQ"},
@@ -237,6 +247,7 @@ static const HelpEntry dev_cmds[] = {
     {"heapperf <0/1/2>", "Set heap performance level (Rust)"},
     {"regdump", "Dump CPU registers"},
     {"fstest", "Run filesystem tests"},
+    {"blkbench <dev> ...", "Benchmark a block device"},
     {"arptest", "Perform ARP test"},
     {"setup", "Copy system files"},
     {"isocp <iso> <vfs>", "Copy from ISO to VFS"},
@@ -608,7 +619,7 @@ static void CatHandler(const char * args) {
         KernelFree(file);
         return;
     }
-    int bytes = VfsReadFile(full_path, file_buffer, 4095);
+    int64_t bytes = VfsReadFile(full_path, file_buffer, 4095);
     if (bytes >= 0) {
         // Null-terminate and print if non-empty
         file_buffer[(bytes < 4095) ? bytes : 4095] = 0;
@@ -646,7 +657,7 @@ static void FileSizeHandler(const char * args) {
         ResolvePath(filename, full_path, 256);
         const uint64_t size = VfsGetFileSize(full_path);
         PrintKernel("File size: ");
-        PrintKernelInt((uint32_t)size);
+        PrintKernelInt((int64_t)size);
         PrintKernel(" bytes\n");
         KernelFree(filename);
     } else {
@@ -797,7 +808,7 @@ static void FstestHandler(const char * args) {
     PrintKernel("VFS: Contents of /test/hello.txt:\n");
     uint8_t* file_buffer = KernelMemoryAlloc(256);
     if (file_buffer) {
-        int bytes = VfsReadFile("/test/hello.txt", file_buffer, 255);
+        int64_t bytes = VfsReadFile("/test/hello.txt", file_buffer, 255);
         if (bytes > 0) {
             file_buffer[bytes] = 0;
             PrintKernel((char*)file_buffer);
@@ -814,7 +825,7 @@ static void SizeHandler(const char * args) {
         char full_path[256];
         ResolvePath(name, full_path, 256);
         const uint64_t size = VfsGetFileSize(full_path);
-        PrintKernelInt((uint32_t)size);
+        PrintKernelInt((int64_t)size);
         PrintKernel(" bytes\n");
         KernelFree(name);
     } else {
@@ -1244,6 +1255,95 @@ static void UnmountHandler(const char* args) {
     KernelFree(mount_point);
 }
 
+FNDEF(SyncHandler) {
+    if (VfsSync() != 0) {
+        PrintKernelError("sync: some blocks could not be written\n");
+        return;
+    }
+    PrintKernelSuccess("sync: all cached blocks written\n");
+}
+
+FNDEF(FstrimHandler) {
+    int device_id = -1;
+    char* dev_name = GetArg(args, 1);
+    if (dev_name) {
+        BlockDevice* dev = SearchBlockDevice(dev_name);
+        if (!dev) {
+            PrintKernelErrorF("fstrim: no such device '%s'\n", dev_name);
+            KernelFree(dev_name);
+            return;
+        }
+        if (!BlockDeviceCanDiscard(dev->id)) {
+            PrintKernelWarningF("fstrim: %s does not support discard\n", dev->name);
+        }
+        device_id = dev->id;
+        KernelFree(dev_name);
+    }
+
+    BlockCacheStats before, after;
+    BlockCacheGetStats(&before);
+    const int result = BlockCacheDiscardFlush(device_id);
+    BlockCacheGetStats(&after);
+    if (result != 0) PrintKernelError("fstrim: some extents could not be discarded\n");
+    PrintKernelF("fstrim: %llu extents, %llu sectors discarded\n",
+                 (unsigned long long)(after.discards - before.discards),
+                 (unsigned long long)(after.discard_sectors - before.discard_sectors));
+}
+
+FNDEF(BcStatHandler) {
+    BlockCachePrintStats();
+}
+
+FNDEF(DcStatHandler) {
+    DCachePrintStats();
+}
+
+FNDEF(IoSchedHandler) {
+    char* dev_name = GetArg(args, 1);
+    if (!dev_name) {
+        IoSchedulerPrint();
+        return;
+    }
+
+    BlockDevice* dev = SearchBlockDevice(dev_name);
+    if (!dev) {
+        PrintKernelErrorF("iosched: no such device '%s'\n", dev_name);
+        KernelFree(dev_name);
+        return;
+    }
+
+    char* policy = GetArg(args, 2);
+    if (!policy) {
+        PrintKernelF("%s: %s\n", dev->name, IoSchedulerGet(dev->id));
+    } else if (IoSchedulerSet(dev->id, policy) != 0) {
+        PrintKernelErrorF("iosched: unknown policy '%s' (noop, deadline)\n", policy);
+    } else {
+        PrintKernelSuccessF("iosched: %s now uses %s\n", dev->name, policy);
+    }
+
+    KernelFree(policy);
+    KernelFree(dev_name);
+}
+
+FNDEF(IoStatHandler) {
+    char* dev_name = GetArg(args, 1);
+    if (!dev_name) {
+        for (int i = 0; i < MAX_BLOCK_DEVICES; i++) {
+            BlockDevice* dev = BlockDeviceGet(i);
+            if (dev) BlockDevicePrintIoStat(dev, false);
+        }
+        return;
+    }
+
+    BlockDevice* dev = SearchBlockDevice(dev_name);
+    if (dev) {
+        BlockDevicePrintIoStat(dev, true);
+    } else {
+        PrintKernelErrorF("iostat: no such device '%s'\n", dev_name);
+    }
+    KernelFree(dev_name);
+}
+
 FNDEF(GetSerialHandler) {
     char buff[1024];
     SerialReadLine(buff, sizeof(buff));
@@ -1307,6 +1407,7 @@ static const ShellCommand commands[] = {\
     {"edit", EditHandler},
     {"ver", VersionHandler},
     {"fstest", FstestHandler},
+    {"blkbench", BlkBenchHandler},
     {"size", SizeHandler},
     {"heapvallvl", KHeapValidationHandler},
     {"lscpu", LsCPUHandler},
@@ -1327,6 +1428,12 @@ static const ShellCommand commands[] = {\
     {"lsmnt", LsMntHandler},
     {"mount", MountHandler},
     {"umount", UnmountHandler},
+    {"sync", SyncHandler},
+    {"bcstat", BcStatHandler},
+    {"dcstat", DcStatHandler},
+    {"fstrim", FstrimHandler},
+    {"iosched", IoSchedHandler},
+    {"iostat", IoStatHandler},
     {"gserial", GetSerialHandler},
     {"keymap", KeymapHandler},
 };
@@ -55,7 +55,7 @@ uint32_t LoadExecutable(const char* filename, const ExecLoadOptions* options) {
     }
     // Read first few bytes to detect format
     uint8_t header[64];
-    int bytes_read = VfsReadFile(filename, (char*)header, sizeof(header));
+    int64_t bytes_read = VfsReadFile(filename, (char*)header, sizeof(header));
     if (bytes_read < 4) {
         PrintKernelError("EXEC: Cannot read file header\n");
         return 0;
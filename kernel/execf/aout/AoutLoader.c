@@ -75,8 +75,8 @@ uint32_t CreateProcessFromAout(const char* filename, const AoutLoadOptions* opti
         return 0;
     }
 
-    int bytes_read = VfsReadFile(filename, (char*)aout_data, file_size);
-    if (bytes_read != (int)file_size) {
+    int64_t bytes_read = VfsReadFile(filename, (char*)aout_data, file_size);
+    if (bytes_read != (int64_t)file_size) {
         PrintKernelError("AOUT: File read failed\n");
         VMemFreeWithGuards(aout_data, file_size);
         return 0;
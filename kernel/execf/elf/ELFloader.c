@@ -138,7 +138,7 @@ uint32_t CreateProcessFromElf(const char* filename, const ElfLoadOptions* option
     uint64_t file_size = VfsGetFileSize(filename);
     if (file_size == 0 || file_size > MAX_ELF_FILE_SIZE) {
         PrintKernelError("ELF: File too large or empty (");
-        PrintKernelInt((uint32_t)file_size);
+        PrintKernelInt((int64_t)file_size);
         PrintKernel(" bytes)\n");
         return 0;
     }
@@ -151,7 +151,7 @@ uint32_t CreateProcessFromElf(const char* filename, const ElfLoadOptions* option
     }
 
     // 3. Read ELF file from VFS
-    int bytes_read = VfsReadFile(filename, (char*)elf_data, file_size);
+    int64_t bytes_read = VfsReadFile(filename, (char*)elf_data, file_size);
     if (bytes_read <= 0 || (uint64_t)bytes_read != file_size) {
         PrintKernelError("ELF: Failed to read file completely (or incomplete read)\n");
         VMemFreeWithGuards(elf_data, file_size);
@@ -159,7 +159,7 @@ uint32_t CreateProcessFromElf(const char* filename, const ElfLoadOptions* option
     }
 
     PrintKernelSuccess("ELF: File loaded (");
-    PrintKernelInt((uint32_t)bytes_read);
+    PrintKernelInt(bytes_read);
     PrintKernel(" bytes)\n");
 
     // 4. Validate ELF header
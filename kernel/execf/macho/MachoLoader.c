@@ -68,7 +68,7 @@ uint32_t CreateProcessFromMacho(const char* filename, const MachoLoadOptions* op
     }
 
     // 3. Read the file
-    int bytes_read = VfsReadFile(filename, (char*)macho_data, file_size);
+    int64_t bytes_read = VfsReadFile(filename, (char*)macho_data, file_size);
     if (bytes_read <= 0 || (uint64_t)bytes_read != file_size) {
         PrintKernelError("MACH-O: Failed to read file.\n");
         VMemFreeWithGuards(macho_data, file_size);
@@ -138,8 +138,8 @@ uint32_t CreateProcessFromPE(const char* filename, const PELoadOptions* options)
         return 0;
     }
 
-    int bytes_read = VfsReadFile(filename, (char*)pe_data, file_size);
-    if (bytes_read != (int)file_size) {
+    int64_t bytes_read = VfsReadFile(filename, (char*)pe_data, file_size);
+    if (bytes_read != (int64_t)file_size) {
         PrintKernelError("PE: File read failed\n");
         VMemFreeWithGuards(pe_data, file_size);
         return 0;